@@ -16,23 +16,27 @@
 #include "dimmer.h"
 #include "adc.h"
 #include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "er-coap-13-static.h"
 #include "erbium.h"
 #include "rplinfo.h"
+#include "rd-client.h"
+#include "scene.h"
 #include "buttons.h"
 #include "ota-update.h"
 
-#define DEBUG 1
-#if DEBUG
-#define PRINTF(...)     printf(__VA_ARGS__)
-#else
-#define PRINTF(...)
-#endif
+/* Formatted later by dlog_process, out of the CoAP handlers */
+#define DLOG_LEVEL DLOG_LEVEL_INFO
+#include "sys/dlog.h"
+#include "sys/trace.h"
 
 #define COMPANY_NAME              "Astral"
 #if ASTRAL_BOARD_TYPE == ASTRAL_BT_AURA
 #define PRODUCT_MODEL_NAME        "Aura"
+#define RD_ENDPOINT_TYPE          "astral.aura"
 #else
 #define PRODUCT_MODEL_NAME        "Norma"
+#define RD_ENDPOINT_TYPE          "astral.norma"
 #endif
 
 /*
@@ -46,108 +50,71 @@ static uint8_t coap_etag = 0;
 /*http://www.ipso-alliance.org/wp-content/media/draft-ipso-app-framework-04.pdf*/
 
 /* Manufacturer: The manufacturer of the device as a string.*/
-RESOURCE(coap_dev_mfg, METHOD_GET, "dev/mfg", "title=\"Manufacturer\";rt=\"ipso.dev.mfg\"");
-void
-coap_dev_mfg_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = COMPANY_NAME;
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mfg, "dev/mfg", "title=\"Manufacturer\";rt=\"ipso.dev.mfg\"");
 
 /* Model: The model of the device as a string. */
-RESOURCE(coap_dev_mdl, METHOD_GET, "dev/mdl", "title=\"Model\";rt=\"ipso.dev.mdl\"");
-void
-coap_dev_mdl_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = PRODUCT_MODEL_NAME;
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mdl, "dev/mdl", "title=\"Model\";rt=\"ipso.dev.mdl\"");
 
 /* Hardware Revision: The version of the hardware of the device as a string.*/
-RESOURCE(coap_dev_mdl_hw, METHOD_GET, "dev/mdl/hw", "title=\"Hardware revision\";rt=\"ipso.dev.mdl.hw\"");
-void
-coap_dev_mdl_hw_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = "0.1";
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mdl_hw, "dev/mdl/hw", "title=\"Hardware revision\";rt=\"ipso.dev.mdl.hw\"");
 
 /* Software Version: The version of the software embedded in the device as a string.*/
-RESOURCE(coap_dev_mdl_sw, METHOD_GET, "dev/mdl/sw", "title=\"Software revision\";rt=\"ipso.dev.mdl.sw\"");
-void
-coap_dev_mdl_sw_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = "0.1";
-  const int length = strlen(message);
+STATIC_RESOURCE(coap_dev_mdl_sw, "dev/mdl/sw", "title=\"Software revision\";rt=\"ipso.dev.mdl.sw\"");
 
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
+/* Serial: The serial number of the device as a string. */
+STATIC_RESOURCE(coap_dev_ser, "dev/ser", "title=\"Serial Number\";rt=\"ipso.dev.ser\"");
+
+/* Name: The descriptive or functional name of the device as a string.*/
+STATIC_RESOURCE(coap_dev_n, "dev/n", "title=\"Name\";rt=\"ipso.dev.n\"");
+
+/* Power Supply: The type of power supply as an enumeration Table 1.
+    0-Line, 1-Battery 2-Harvestor
+ */
+STATIC_RESOURCE(coap_dev_pwr, "dev/pwr/0", "title=\"Power Source\";rt=\"ipso.dev.pwr\"");
+
+/* Device information never changes, so it is served from a serialized copy. */
+#define DEV_INFO_MAX_AGE          (24UL * 60 * 60)
+
+static void
+activate_dev_info_resource(resource_t *resource, const char *message)
+{
+  if(!coap_activate_static_resource(resource, REST.type.TEXT_PLAIN, DEV_INFO_MAX_AGE, message, strlen(message))) {
+    /* Not served at all, COAP_STATIC_BUFFER_SIZE is too small */
+    printf("dev info: no room for /%s\n", resource->url);
+  }
 }
 
-/* Serial: The serial number of the device as a string. */
-RESOURCE(coap_dev_ser, METHOD_GET, "dev/ser", "title=\"Serial Number\";rt=\"ipso.dev.ser\"");
-void
-coap_dev_ser_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+static void
+activate_dev_info_resources(void)
 {
-  const char *url = NULL;
-  int length;
+  char serial[24];
 
-  REST.get_url(request, &url);
-  length = sprintf((char *)buffer, "%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
+  sprintf(serial, "%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
     linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], linkaddr_node_addr.u8[2],
     linkaddr_node_addr.u8[3], linkaddr_node_addr.u8[4], linkaddr_node_addr.u8[5],
     linkaddr_node_addr.u8[6], linkaddr_node_addr.u8[7]);
 
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
+  activate_dev_info_resource(&resource_coap_dev_mfg, COMPANY_NAME);
+  activate_dev_info_resource(&resource_coap_dev_mdl, PRODUCT_MODEL_NAME);
+  activate_dev_info_resource(&resource_coap_dev_mdl_hw, "0.1");
+  activate_dev_info_resource(&resource_coap_dev_mdl_sw, "0.1");
+  activate_dev_info_resource(&resource_coap_dev_ser, serial);
+  activate_dev_info_resource(&resource_coap_dev_n, "Controls the wall outlets.");
+  activate_dev_info_resource(&resource_coap_dev_pwr, "0"); /* 0-Line, 1-Battery 2-Harvestor */
 }
 
-/* Name: The descriptive or functional name of the device as a string.*/
-RESOURCE(coap_dev_n, METHOD_GET, "dev/n", "title=\"Name\";rt=\"ipso.dev.n\"");
-void
-coap_dev_n_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = "Controls the wall outlets.";
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+/* Directory registration: the EUI-64 names the node, the model its type. */
+static char rd_ep[2 * sizeof(linkaddr_t) + 1];
 
-/* Power Supply: The type of power supply as an enumeration Table 1.
-    0-Line, 1-Battery 2-Harvestor
- */
-RESOURCE(coap_dev_pwr, METHOD_GET, "dev/pwr/0", "title=\"Power Source\";rt=\"ipso.dev.pwr\"");
-void
-coap_dev_pwr_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+static void
+start_rd_client(void)
 {
-  char const * const message = "0"; /* 0-Line, 1-Battery 2-Harvestor */
-  const int length = strlen(message);
+  int i;
 
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
+  for(i = 0; i < sizeof(linkaddr_t); i++) {
+    sprintf(&rd_ep[2 * i], "%02x", linkaddr_node_addr.u8[i]);
+  }
+  rd_client_start(rd_ep, RD_ENDPOINT_TYPE);
 }
 
 /* Power Supply Voltage: The supply level of the device in Volts.*/
@@ -283,11 +250,49 @@ coap_uptime_handler(void* request, void* response, uint8_t *buffer, uint16_t pre
   }                                                                                             \
 
 
+/* Longest transition of a dimmer PUT */
+#define MAX_TRANSITION_MS         600000UL
+
+/*
+ * Transition of a dimmer PUT, ?tt=<ms>&curve=linear|perceptual. Returns 0
+ * if the query is invalid.
+ */
+static int
+get_transition(void *request, uint32_t *duration_ms, uint8_t *curve)
+{
+  const char *value = NULL;
+  int len;
+
+  *duration_ms = 0;
+  *curve = DIMMER_CURVE_LINEAR;
+
+  if((len = REST.get_query_variable(request, "tt", &value)) > 0) {
+    while(len-- > 0) {
+      if(*value < '0' || *value > '9' || *duration_ms > MAX_TRANSITION_MS) {
+        return 0;
+      }
+      *duration_ms = *duration_ms * 10 + *value++ - '0';
+    }
+    if(*duration_ms > MAX_TRANSITION_MS) {
+      return 0;
+    }
+  }
+  if((len = REST.get_query_variable(request, "curve", &value)) > 0) {
+    if(len == 10 && strncmp(value, "perceptual", 10) == 0) {
+      *curve = DIMMER_CURVE_PERCEPTUAL;
+    } else if(len != 6 || strncmp(value, "linear", 6) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 /*
  * Load Dimmer: This resource represents a power controller attached to
  *  the load, which can be controlled as a % between 0-100. A GET on
  *  the resource returns the current state, and a PUT on the resource
- *  sets a new state.
+ *  sets a new state. With ?tt=<ms> the dimmer fades to it locally,
+ *  along a linear or perceptual (&curve=perceptual) curve.
  */
 #define DEFINE_IPSO_COAP_DIMMER_NODE(num)                                                       \
   RESOURCE(coap_power_dimmer_##num, METHOD_GET | METHOD_PUT, "dev/pwr/" #num "/dim",            \
@@ -308,7 +313,7 @@ coap_uptime_handler(void* request, void* response, uint8_t *buffer, uint16_t pre
      if (method & METHOD_GET)                                                                   \
      {                                                                                          \
         int len;                                                                                \
-        PRINTF("GET: 0x%x %s\n", method, url);                                                  \
+        DLOG_DBG("GET: 0x%x dim %d\n", method, num);                                           \
         len = snprintf((char *)buffer, MAX_ASTRAL_PAYLOAD, "%d", dimmer_config[num].percent);   \
         REST.set_response_payload(response, buffer, len);                                       \
      }                                                                                          \
@@ -316,10 +321,12 @@ coap_uptime_handler(void* request, void* response, uint8_t *buffer, uint16_t pre
      {                                                                                          \
         char *incoming = NULL;                                                                  \
         int len = 0, percent = 0;                                                               \
+        uint32_t duration_ms;                                                                   \
+        uint8_t curve;                                                                          \
                                                                                                 \
         len = REST.get_request_payload(request, (const uint8_t **) &incoming);                  \
         percent = (int)atoi(incoming);                                                          \
-        PRINTF("IPSO /dim PUT: percent=%d", percent);                                           \
+        DLOG_DBG("IPSO /dim PUT: percent=%d\n", percent);                                      \
                                                                                                 \
         if(percent < 0 || percent > 100)                                                        \
         {                                                                                       \
@@ -328,18 +335,19 @@ coap_uptime_handler(void* request, void* response, uint8_t *buffer, uint16_t pre
            REST.set_response_payload(response, buffer, len);                                    \
            return;                                                                              \
         }                                                                                       \
+        if(!get_transition(request, &duration_ms, &curve))                                      \
+        {                                                                                       \
+           REST.set_response_status(response, REST.status.BAD_REQUEST);                         \
+           len = snprintf((char *)buffer, MAX_ASTRAL_PAYLOAD, "Invalid transition\n");          \
+           REST.set_response_payload(response, buffer, len);                                    \
+           return;                                                                              \
+        }                                                                                       \
         REST.set_response_status(response, REST.status.CHANGED);                                \
         len = snprintf((char *)buffer, MAX_ASTRAL_PAYLOAD, "%d\n", percent);                    \
         REST.set_response_payload(response, buffer, len);                                       \
                                                                                                 \
-        if(percent == 0)                                                                        \
-        {                                                                                       \
-          dimmer_disable(num);                                                                  \
-        }                                                                                       \
-        else                                                                                    \
-        {                                                                                       \
-          dimmer_enable(num, percent);                                                          \
-        }                                                                                       \
+        /* Without tt, the dimmer is set at once */                                             \
+        dimmer_fade(num, percent, duration_ms, curve);                                          \
      }                                                                                          \
   }
 
@@ -371,6 +379,96 @@ coap_radio_handler(void* request, void* response, uint8_t *buffer, uint16_t pref
   REST.set_response_payload(response, buffer, length);
 }
 
+#if TRACE_ENABLED
+/* The trace ring in binary, block-wise for tools/trace-decode. Recording
+   stops for the first block and starts over after the last one, or when
+   no block has been asked for in TRACE_READ_TIMEOUT. A new request for
+   the first block reads the frozen ring again from the start. */
+#define TRACE_READ_TIMEOUT (30 * CLOCK_SECOND)
+
+static struct ctimer trace_timer;
+
+static void
+trace_read_expired(void *ptr)
+{
+  trace_resume();
+}
+
+RESOURCE(coap_trace, METHOD_GET, "debug/trace", "title=\"Trace\";ct=42");
+
+void
+coap_trace_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  uint16_t length;
+
+  if(*offset == 0) {
+    trace_freeze();
+  }
+  length = trace_read(buffer, *offset, preferred_size);
+  REST.set_header_content_type(response, REST.type.APPLICATION_OCTET_STREAM);
+  REST.set_response_payload(response, buffer, length);
+  if(length < preferred_size) {
+    *offset = -1;
+    ctimer_stop(&trace_timer);
+    trace_resume();
+  } else {
+    *offset += length;
+    ctimer_set(&trace_timer, TRACE_READ_TIMEOUT, trace_read_expired, NULL);
+  }
+}
+#endif /* TRACE_ENABLED */
+
+#if PROCESS_CONF_ACCOUNTING
+/* A line per process: name, calls, run time and its maximum in us,
+   events and polls, their wait in the queue and its maximum in us.
+   DELETE clears the counters. */
+RESOURCE(coap_proc, METHOD_GET | METHOD_DELETE, "debug/proc", "title=\"Processes\";ct=0");
+
+void
+coap_proc_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  struct process *p;
+  char line[80];
+  int32_t pos = 0;
+  int length = 0;
+  int n, skip, copy;
+
+  if(REST.get_method_type(request) == METHOD_DELETE) {
+    process_acct_reset();
+    REST.set_response_status(response, REST.status.DELETED);
+    return;
+  }
+
+  /* The lines that overlap the requested block */
+  for(p = PROCESS_LIST(); p != NULL && length < preferred_size; p = p->next) {
+    n = snprintf(line, sizeof(line), "%s %lu %lu %lu %lu %lu %lu\n",
+                 PROCESS_NAME_STRING(p),
+                 (unsigned long)p->acct.calls,
+                 (unsigned long)process_acct_us(p->acct.time),
+                 (unsigned long)process_acct_us(p->acct.max_time),
+                 (unsigned long)p->acct.events,
+                 (unsigned long)process_acct_us(p->acct.wait),
+                 (unsigned long)process_acct_us(p->acct.max_wait));
+    n = MIN(n, (int)sizeof(line) - 1);
+    if(pos + n > *offset) {
+      skip = *offset > pos ? *offset - pos : 0;
+      copy = MIN(n - skip, preferred_size - length);
+      memcpy(buffer + length, line + skip, copy);
+      length += copy;
+    }
+    pos += n;
+  }
+
+  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
+  REST.set_response_payload(response, buffer, length);
+  if(p == NULL && pos <= *offset + length) {
+    *offset = -1;
+  } else {
+    *offset += length;
+  }
+}
+#endif /* PROCESS_CONF_ACCOUNTING */
+
 /*----------------- Sensors/Buttons -------------------------*/
 
 /*
@@ -380,13 +478,13 @@ static void
 print_sensor_information()
 {
 #if USING_CC2538DK
-  PRINTF("internal voltage %d\n", (int)get_vdd());
+  DLOG_INFO("internal voltage %d\n", (int)get_vdd());
   return;
 #else
   float current_ma, temperature;
   temperature = get_temperature();
   current_ma = get_cs_value(CS_VALUE_TYPE_RMS_CURRENT, 0);
-  PRINTF("Internal Vdd=%dmV Current = %dmA(%dW) Temp = %dC\n",
+  DLOG_INFO("Internal Vdd=%dmV Current = %dmA(%dW) Temp = %dC\n",
          (int)get_vdd(),
          (int)current_ma,
          (int)(current_ma * 220) / 1000,
@@ -407,7 +505,7 @@ handle_button_press(int button_number)
 
   dim_percent = 100 - ((++btn_press_cnt[button_number] % 5) * 25);
 
-  printf("Button pressed %d dimming to %d\n", button_number, dim_percent);
+  DLOG_INFO("Button pressed %d dimming to %d\n", button_number, dim_percent);
   if (dim_percent == 0) {
     dimmer_disable(button_number);
   } else {
@@ -426,27 +524,25 @@ PROCESS_THREAD(astral_coap_server, ev, data)
 {
   PROCESS_BEGIN();
 
-  PRINTF("%s %s %s %s\n", COMPANY_NAME, PRODUCT_MODEL_NAME, __DATE__, __TIME__);
+  dlog_init();
 
-  PRINTF("RF channel: %u\n", CC2538_RF_CONF_CHANNEL);
-  PRINTF("PAN ID: 0x%04X\n", IEEE802154_PANID);
+  DLOG_INFO("%s %s %s %s\n", COMPANY_NAME, PRODUCT_MODEL_NAME, __DATE__, __TIME__);
 
-  PRINTF("uIP buffer: %u\n", UIP_BUFSIZE);
-  PRINTF("LL header: %u\n", UIP_LLH_LEN);
-  PRINTF("IP+UDP header: %u\n", UIP_IPUDPH_LEN);
-  PRINTF("REST max chunk: %u\n", REST_MAX_CHUNK_SIZE);
+  DLOG_INFO("RF channel: %u\n", CC2538_RF_CONF_CHANNEL);
+  DLOG_INFO("PAN ID: 0x%04X\n", IEEE802154_PANID);
+
+  DLOG_INFO("uIP buffer: %u\n", UIP_BUFSIZE);
+  DLOG_INFO("LL header: %u\n", UIP_LLH_LEN);
+  DLOG_INFO("IP+UDP header: %u\n", UIP_IPUDPH_LEN);
+  DLOG_INFO("REST max chunk: %u\n", REST_MAX_CHUNK_SIZE);
 
   /* Initialize the REST engine. */
   rest_init_engine();
+  /* Requests are handled before the periodic work */
+  process_set_priority(&coap_receiver, PROCESS_PRIO_HIGH);
 
   /* Activate the CoAP resources. */
-  rest_activate_resource(&resource_coap_dev_mfg);
-  rest_activate_resource(&resource_coap_dev_mdl);
-  rest_activate_resource(&resource_coap_dev_mdl_hw);
-  rest_activate_resource(&resource_coap_dev_mdl_sw);
-  rest_activate_resource(&resource_coap_dev_ser);
-  rest_activate_resource(&resource_coap_dev_n);
-  rest_activate_resource(&resource_coap_dev_pwr);
+  activate_dev_info_resources();
   rest_activate_resource(&resource_coap_dev_pwr_v);
   rest_activate_resource(&resource_coap_uptime);
   rest_activate_resource(&resource_coap_power_dimmer_0);
@@ -467,14 +563,23 @@ PROCESS_THREAD(astral_coap_server, ev, data)
 
   rplinfo_activate_resources();
   rest_activate_resource(&resource_coap_radio);
+#if TRACE_ENABLED
+  rest_activate_resource(&resource_coap_trace);
+#endif
+#if PROCESS_CONF_ACCOUNTING
+  rest_activate_resource(&resource_coap_proc);
+#endif
+  scene_activate_resources();
 
   ota_update_enable();
 
+  start_rd_client();
+
   /* Handle events */
   while(1) {
     PROCESS_WAIT_EVENT();
     if (ev == PROCESS_EVENT_TIMER) {
-       PRINTF("Timer event - and we havent configured one\n");
+       DLOG_INFO("Timer event - and we havent configured one\n");
     } else {
       if (ev == sensors_event) {
         if (data == &button1_sensor) {
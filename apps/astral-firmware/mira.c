@@ -17,8 +17,11 @@
 #include "adc.h"
 
 #include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "er-coap-13-static.h"
 #include "erbium.h"
 #include "rplinfo.h"
+#include "rd-client.h"
 
 #define DEBUG 1
 #if DEBUG
@@ -29,6 +32,7 @@
 
 #define COMPANY_NAME        "Astral"
 #define PRODUCT_MODEL_NAME  "Mira"
+#define RD_ENDPOINT_TYPE    "astral.mira"
 
 /*
  * A helper function to dump all sensor information.
@@ -62,110 +66,71 @@ print_sensor_information()
 /*http://www.ipso-alliance.org/wp-content/media/draft-ipso-app-framework-04.pdf*/
 
 /* Manufacturer: The manufacturer of the device as a string.*/
-RESOURCE(coap_dev_mfg, METHOD_GET, "dev/mfg", "title=\"Manufacturer\";rt=\"ipso.dev.mfg\"");
-void
-coap_dev_mfg_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = COMPANY_NAME;
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mfg, "dev/mfg", "title=\"Manufacturer\";rt=\"ipso.dev.mfg\"");
 
 /* Model: The model of the device as a string. */
-RESOURCE(coap_dev_mdl, METHOD_GET, "dev/mdl", "title=\"Model\";rt=\"ipso.dev.mdl\"");
-void
-coap_dev_mdl_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = PRODUCT_MODEL_NAME;
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mdl, "dev/mdl", "title=\"Model\";rt=\"ipso.dev.mdl\"");
 
 /* Hardware Revision: The version of the hardware of the device as a string.*/
-RESOURCE(coap_dev_mdl_hw, METHOD_GET, "dev/mdl/hw", "title=\"Hardware revision\";rt=\"ipso.dev.mdl.hw\"");
-void
-coap_dev_mdl_hw_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = "0.1";
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mdl_hw, "dev/mdl/hw", "title=\"Hardware revision\";rt=\"ipso.dev.mdl.hw\"");
 
 /* Software Version: The version of the software embedded in the device as a string.*/
-RESOURCE(coap_dev_mdl_sw, METHOD_GET, "dev/mdl/sw", "title=\"Software revision\";rt=\"ipso.dev.mdl.sw\"");
-void
-coap_dev_mdl_sw_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = "0.1";
-  const int length = strlen(message);
-
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
+STATIC_RESOURCE(coap_dev_mdl_sw, "dev/mdl/sw", "title=\"Software revision\";rt=\"ipso.dev.mdl.sw\"");
 
 /* Serial: The serial number of the device as a string. */
-RESOURCE(coap_dev_ser, METHOD_GET, "dev/ser", "title=\"Serial Number\";rt=\"ipso.dev.ser\"");
-void
-coap_dev_ser_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+STATIC_RESOURCE(coap_dev_ser, "dev/ser", "title=\"Serial Number\";rt=\"ipso.dev.ser\"");
+
+/* Name: The descriptive or functional name of the device as a string.*/
+STATIC_RESOURCE(coap_dev_n, "dev/n", "title=\"Name\";rt=\"ipso.dev.n\"");
+
+/* Power Supply: The type of power supply as an enumeration Table 1.
+    0-Line, 1-Battery 2-Harvestor
+ */
+STATIC_RESOURCE(coap_dev_pwr, "dev/pwr/0", "title=\"Power Source\";rt=\"ipso.dev.pwr\"");
+
+/* Device information never changes, so it is served from a serialized copy. */
+#define DEV_INFO_MAX_AGE          (24UL * 60 * 60)
+
+static void
+activate_dev_info_resource(resource_t *resource, const char *message)
 {
-  const char *url = NULL;
-  int length;
+  if(!coap_activate_static_resource(resource, REST.type.TEXT_PLAIN, DEV_INFO_MAX_AGE, message, strlen(message))) {
+    /* Not served at all, COAP_STATIC_BUFFER_SIZE is too small */
+    printf("dev info: no room for /%s\n", resource->url);
+  }
+}
 
-  REST.get_url(request, &url);
-  PRINTF("GET: %s\n", url);
+static void
+activate_dev_info_resources(void)
+{
+  char serial[24];
 
-  length = sprintf((char *)buffer, "%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
+  sprintf(serial, "%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x",
     linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], linkaddr_node_addr.u8[2],
     linkaddr_node_addr.u8[3], linkaddr_node_addr.u8[4], linkaddr_node_addr.u8[5],
     linkaddr_node_addr.u8[6], linkaddr_node_addr.u8[7]);
 
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
+  activate_dev_info_resource(&resource_coap_dev_mfg, COMPANY_NAME);
+  activate_dev_info_resource(&resource_coap_dev_mdl, PRODUCT_MODEL_NAME);
+  activate_dev_info_resource(&resource_coap_dev_mdl_hw, "0.1");
+  activate_dev_info_resource(&resource_coap_dev_mdl_sw, "0.1");
+  activate_dev_info_resource(&resource_coap_dev_ser, serial);
+  activate_dev_info_resource(&resource_coap_dev_n, COMPANY_NAME " " PRODUCT_MODEL_NAME);
+  activate_dev_info_resource(&resource_coap_dev_pwr, "1"); /* 0-Line, 1-Battery 2-Harvestor */
 }
 
-/* Name: The descriptive or functional name of the device as a string.*/
-RESOURCE(coap_dev_n, METHOD_GET, "dev/n", "title=\"Name\";rt=\"ipso.dev.n\"");
-void
-coap_dev_n_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
-{
-  char const * const message = COMPANY_NAME " " PRODUCT_MODEL_NAME;
-  const int length = strlen(message);
+/* Directory registration: the EUI-64 names the node, the model its type. */
+static char rd_ep[2 * sizeof(linkaddr_t) + 1];
 
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
-}
-
-/* Power Supply: The type of power supply as an enumeration Table 1.
-    0-Line, 1-Battery 2-Harvestor
- */
-RESOURCE(coap_dev_pwr, METHOD_GET, "dev/pwr/0", "title=\"Power Source\";rt=\"ipso.dev.pwr\"");
-void
-coap_dev_pwr_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+static void
+start_rd_client(void)
 {
-  char const * const message = "1"; /* 0-Line, 1-Battery 2-Harvestor */
-  const int length = strlen(message);
+  int i;
 
-  memcpy(buffer, message, length);
-  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
-  REST.set_header_etag(response, (uint8_t *) &length, 1);
-  REST.set_response_payload(response, buffer, length);
+  for(i = 0; i < sizeof(linkaddr_t); i++) {
+    sprintf(&rd_ep[2 * i], "%02x", linkaddr_node_addr.u8[i]);
+  }
+  rd_client_start(rd_ep, RD_ENDPOINT_TYPE);
 }
 
 /* Power Supply Voltage: The supply level of the device in Volts.*/
@@ -232,21 +197,19 @@ PROCESS_THREAD(mira_coap_server, ev, data)
 
   /* Initialize the REST engine. */
   rest_init_engine();
+  /* Requests are handled before the periodic work */
+  process_set_priority(&coap_receiver, PROCESS_PRIO_HIGH);
 
   /* Activate the CoAP resources. */
-  rest_activate_resource(&resource_coap_dev_mfg);
-  rest_activate_resource(&resource_coap_dev_mdl);
-  rest_activate_resource(&resource_coap_dev_mdl_hw);
-  rest_activate_resource(&resource_coap_dev_mdl_sw);
-  rest_activate_resource(&resource_coap_dev_ser);
-  rest_activate_resource(&resource_coap_dev_n);
-  rest_activate_resource(&resource_coap_dev_pwr);
+  activate_dev_info_resources();
   rest_activate_resource(&resource_coap_dev_pwr_v);
   rest_activate_resource(&resource_coap_uptime);
   rest_activate_resource(&resource_coap_radio);
 
   rplinfo_activate_resources();
 
+  start_rd_client();
+
   leds_on(LEDS_GREEN);
 
   /* Handle events */
@@ -16,7 +16,23 @@
 #undef COAP_MAX_OPEN_TRANSACTIONS
 #define COAP_MAX_OPEN_TRANSACTIONS    4
 
+/* The hub, a dashboard and a logger may all observe each outlet.
+   Observers share the CoAP pool with the transactions. */
 #undef COAP_MAX_OBSERVERS
-#define COAP_MAX_OBSERVERS            2
+#define COAP_MAX_OBSERVERS            9
+
+/* Aura lists about 30 resources in /.well-known/core. */
+#undef COAP_LINK_FORMAT_MAX_LINKS
+#define COAP_LINK_FORMAT_MAX_LINKS    40
+
+/* Group requests are forwarded down the DODAG by SMRF, which needs RPL
+   in storing mode with multicast (MOP 3), like the uHub. */
+#include "net/ipv6/multicast/uip-mcast6-engines.h"
+#undef UIP_MCAST6_CONF_ENGINE
+#define UIP_MCAST6_CONF_ENGINE        UIP_MCAST6_ENGINE_SMRF
+
+/* The default group and a few joined through /grp. */
+#undef UIP_CONF_DS6_MADDR_NBU
+#define UIP_CONF_DS6_MADDR_NBU        4
 
 #endif
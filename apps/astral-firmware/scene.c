@@ -0,0 +1,286 @@
+/**
+ * \file
+ *      Multicast groups and scenes of Aura/Norma
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/uiplib.h"
+#include "net/rpl/rpl.h"
+#include "net/rpl/rpl-private.h"
+
+#include "erbium.h"
+#include "rplinfo.h"
+#include "dimmer.h"
+#include "scene.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define SCENE_UNCHANGED  -1
+
+struct scene {
+  uint8_t used;
+  uint8_t id;
+  int8_t level[MAX_TRIACS];  /* SCENE_UNCHANGED or 0-100 */
+};
+
+static struct scene scenes[SCENE_MAX_SCENES];
+
+/*---------------------------------------------------------------------------*/
+static long
+scene_parse_number(const char *s, int len)
+{
+  long n = 0;
+
+  if(len <= 0 || len > 5) {
+    return -1;
+  }
+  while(len-- > 0) {
+    if(*s < '0' || *s > '9') {
+      return -1;
+    }
+    n = n * 10 + *s++ - '0';
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * "100,0,-,40", a level per dimmer
+ */
+static int
+scene_parse_levels(const char *s, int len, int8_t *level)
+{
+  const char *end = s + len;
+  const char *p;
+  long n;
+  int i;
+
+  for(i = 0; i < MAX_TRIACS; i++) {
+    if((p = memchr(s, ',', end - s)) == NULL) {
+      p = end;
+    }
+    if(p - s == 1 && *s == '-') {
+      level[i] = SCENE_UNCHANGED;
+    } else if((n = scene_parse_number(s, p - s)) >= 0 && n <= 100) {
+      level[i] = n;
+    } else {
+      return 0;
+    }
+    if(p == end) {
+      return i == MAX_TRIACS - 1;
+    }
+    s = p + 1;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct scene *
+scene_find(uint8_t id)
+{
+  struct scene *s;
+
+  for(s = scenes; s < scenes + SCENE_MAX_SCENES; s++) {
+    if(s->used && s->id == id) {
+      return s;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+scene_recall(const struct scene *s)
+{
+  int percent[MAX_TRIACS];
+  int i;
+
+  for(i = 0; i < MAX_TRIACS; i++) {
+    percent[i] = s->level[i];
+  }
+  dimmer_set_all(percent);
+}
+/*---------------------------------------------------------------------------*/
+RESOURCE(coap_scene, METHOD_GET | METHOD_PUT | METHOD_POST | METHOD_DELETE | HAS_SUB_RESOURCES,
+         "scn", "title=\"Scenes\";rt=\"astral.scn\"");
+void
+coap_scene_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  const char *url = NULL;
+  const uint8_t *payload = NULL;
+  struct scene *s;
+  int8_t level[MAX_TRIACS];
+  long id;
+  int len;
+  int i;
+
+  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
+
+  len = REST.get_url(request, &url);
+  if(len == 3) {
+    /* The stored scenes */
+    if(REST.get_method_type(request) != METHOD_GET) {
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
+      return;
+    }
+    len = 0;
+    for(s = scenes; s < scenes + SCENE_MAX_SCENES; s++) {
+      if(s->used) {
+        len += snprintf((char *)buffer + len, preferred_size - len, len ? ",%u" : "%u", s->id);
+      }
+    }
+    REST.set_response_payload(response, buffer, MIN(len, preferred_size));
+    return;
+  }
+  if(len < 5 || url[3] != '/' || (id = scene_parse_number(url + 4, len - 4)) < 0 || id > 255) {
+    REST.set_response_status(response, REST.status.NOT_FOUND);
+    return;
+  }
+  s = scene_find(id);
+
+  switch(REST.get_method_type(request)) {
+  case METHOD_PUT:
+    len = REST.get_request_payload(request, &payload);
+    if(!scene_parse_levels((const char *)payload, len, level)) {
+      REST.set_response_status(response, REST.status.BAD_REQUEST);
+      REST.set_response_payload(response, "BadLevels", 9);
+      return;
+    }
+    if(s == NULL) {
+      for(s = scenes; s < scenes + SCENE_MAX_SCENES && s->used; s++);
+      if(s == scenes + SCENE_MAX_SCENES) {
+        REST.set_response_status(response, REST.status.SERVICE_UNAVAILABLE);
+        REST.set_response_payload(response, "ScenesFull", 10);
+        return;
+      }
+      s->used = 1;
+      s->id = id;
+      REST.set_response_status(response, REST.status.CREATED);
+    } else {
+      REST.set_response_status(response, REST.status.CHANGED);
+    }
+    memcpy(s->level, level, sizeof(level));
+    PRINTF("Scene %u stored\n", s->id);
+    return;
+
+  case METHOD_POST:
+    if(s == NULL) {
+      REST.set_response_status(response, REST.status.NOT_FOUND);
+      return;
+    }
+    PRINTF("Scene %u recalled\n", s->id);
+    scene_recall(s);
+    REST.set_response_status(response, REST.status.CHANGED);
+    return;
+
+  case METHOD_DELETE:
+    if(s != NULL) {
+      s->used = 0;
+    }
+    REST.set_response_status(response, REST.status.DELETED);
+    return;
+
+  default:
+    if(s == NULL) {
+      REST.set_response_status(response, REST.status.NOT_FOUND);
+      return;
+    }
+    len = 0;
+    for(i = 0; i < MAX_TRIACS; i++) {
+      if(s->level[i] == SCENE_UNCHANGED) {
+        len += snprintf((char *)buffer + len, preferred_size - len, i ? ",-" : "-");
+      } else {
+        len += snprintf((char *)buffer + len, preferred_size - len, i ? ",%d" : "%d", s->level[i]);
+      }
+    }
+    REST.set_response_payload(response, buffer, len);
+    return;
+  }
+}
+/*---------------------------------------------------------------------------*/
+RESOURCE(coap_group, METHOD_GET | METHOD_POST | METHOD_DELETE, "grp", "title=\"Multicast groups\";rt=\"astral.grp\"");
+void
+coap_group_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  const char *value = NULL;
+  char addr_str[40];
+  uip_ipaddr_t addr;
+  uip_ds6_maddr_t *maddr;
+  rpl_dag_t *dag;
+  int len;
+  int i;
+
+  if(REST.get_method_type(request) == METHOD_GET) {
+    /* ["ff0e::fd",...], the groups RPL forwards to us */
+    len = snprintf((char *)buffer, preferred_size, "[");
+    for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
+      if(uip_ds6_if.maddr_list[i].isused
+         && uip_is_addr_mcast_global(&uip_ds6_if.maddr_list[i].ipaddr)
+         && len + 44 < preferred_size) {
+        len += snprintf((char *)buffer + len, preferred_size - len, len > 1 ? ",\"" : "\"");
+        len += ipaddr_add(&uip_ds6_if.maddr_list[i].ipaddr, (char *)buffer + len);
+        len += snprintf((char *)buffer + len, preferred_size - len, "\"");
+      }
+    }
+    len += snprintf((char *)buffer + len, preferred_size - len, "]");
+    REST.set_header_content_type(response, REST.type.APPLICATION_JSON);
+    REST.set_response_payload(response, buffer, len);
+    return;
+  }
+
+  len = REST.get_query_variable(request, "a", &value);
+  if(len <= 0 || len >= sizeof(addr_str)) {
+    len = 0;
+  } else {
+    memcpy(addr_str, value, len);
+  }
+  addr_str[len] = '\0';
+  if(!uiplib_ip6addrconv(addr_str, &addr) || !uip_is_addr_mcast_global(&addr)) {
+    REST.set_response_status(response, REST.status.BAD_REQUEST);
+    REST.set_response_payload(response, "BadGroup", 8);
+    return;
+  }
+
+  maddr = uip_ds6_maddr_lookup(&addr);
+  if(REST.get_method_type(request) == METHOD_DELETE) {
+    /* The route upstream expires with its DAO lifetime */
+    if(maddr != NULL) {
+      uip_ds6_maddr_rm(maddr);
+    }
+    REST.set_response_status(response, REST.status.DELETED);
+    return;
+  }
+
+  if(maddr == NULL) {
+    if(uip_ds6_maddr_add(&addr) == NULL) {
+      REST.set_response_status(response, REST.status.SERVICE_UNAVAILABLE);
+      REST.set_response_payload(response, "GroupsFull", 10);
+      return;
+    }
+    /* Announce the group now rather than with the next DAO */
+    if((dag = rpl_get_any_dag()) != NULL) {
+      rpl_schedule_dao(dag->instance);
+    }
+    REST.set_response_status(response, REST.status.CREATED);
+  } else {
+    REST.set_response_status(response, REST.status.CHANGED);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+scene_activate_resources(void)
+{
+  uip_ipaddr_t addr;
+
+  SCENE_DEFAULT_GROUP(&addr);
+  uip_ds6_maddr_add(&addr);
+
+  rest_activate_resource(&resource_coap_scene);
+  rest_activate_resource(&resource_coap_group);
+}
+/*---------------------------------------------------------------------------*/
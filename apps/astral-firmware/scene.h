@@ -0,0 +1,47 @@
+/**
+ * \file
+ *      Multicast groups and scenes of Aura/Norma
+ *
+ *      Nodes join IPv6 multicast groups, forwarded down the mesh by SMRF,
+ *      and take non-confirmable CoAP requests sent to them, so that one
+ *      packet reaches every member. Members do not respond to group
+ *      requests.
+ *        GET /grp                 the joined groups
+ *        POST /grp?a=<group>      joins a group
+ *        DELETE /grp?a=<group>    leaves it
+ *      Only global scope groups (ff0e::/16) are announced to RPL, and
+ *      UIP_CONF_DS6_MADDR_NBU bounds how many can be joined.
+ *
+ *      A scene is a level per dimmer, applied to all of them at once:
+ *        PUT /scn/<id>  "100,0,-,40"  stores a scene, '-' leaves a dimmer as is
+ *        POST /scn/<id>               recalls it
+ *        GET /scn/<id>, DELETE /scn/<id>
+ *      with id 0-255, so that e.g. a NON POST /scn/3 to a floor group
+ *      switches every light of the floor.
+ */
+
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "contiki-conf.h"
+
+#ifdef SCENE_CONF_MAX_SCENES
+#define SCENE_MAX_SCENES     SCENE_CONF_MAX_SCENES
+#else
+#define SCENE_MAX_SCENES     16
+#endif
+
+/* Group joined at boot, All CoAP Nodes by default */
+#ifdef SCENE_CONF_DEFAULT_GROUP
+#define SCENE_DEFAULT_GROUP(addr)  SCENE_CONF_DEFAULT_GROUP(addr)
+#else
+#define SCENE_DEFAULT_GROUP(addr)  uip_ip6addr(addr, 0xff0e, 0, 0, 0, 0, 0, 0, 0xfd)
+#endif
+
+/**
+ * \brief Join the default group and activate /grp and /scn. Call after
+ *        rest_init_engine().
+ */
+void scene_activate_resources(void);
+
+#endif /* SCENE_H_ */
@@ -67,12 +67,47 @@
 
 PROCESS(coap_receiver, "CoAP Receiver");
 
+/* Outgoing UDP payload area, where uip_udp_packet_send() expects the datagram. */
+#define UIP_UDP_PAYLOAD           ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+
+/* Largest request that can be moved above a response of COAP_MAX_PACKET_SIZE
+ * in uip_buf (+1 for the response '\0' and +1 for the parser '\0'). */
+#define COAP_MAX_IN_PLACE_REQUEST (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN - COAP_MAX_PACKET_SIZE - 2)
+
 /*----------------------------------------------------------------------------*/
 /*- Variables ----------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
 static service_callback_t service_cbk = NULL;
+static service_callback_t proxy_cbk = NULL;
+/*----------------------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
+#if COAP_ZERO_COPY
+/*
+ * Responses to requests are piggy-backed ACKs or NONs, which are never
+ * retransmitted. Instead of a transaction buffer, they are built in place in
+ * the outgoing UDP payload area of uip_buf. The request is first moved to the
+ * end of uip_buf, so that its parsed options stay valid while the resource
+ * handler writes the response payload.
+ * Returns the new location of the request, or NULL if it is too large.
+ */
+static uint8_t *
+coap_move_request(void)
+{
+  uint8_t *data = (uint8_t *) uip_appdata;
+  uint16_t data_len = uip_datalen();
+
+  if (data_len <= COAP_HEADER_LEN || data_len > COAP_MAX_IN_PLACE_REQUEST
+      || data[1] < COAP_GET || data[1] > COAP_DELETE)
+  {
+    return NULL;
+  }
+
+  data = &uip_buf[UIP_BUFSIZE - data_len - 1];
+  memmove(data, uip_appdata, data_len);
+  return data;
+}
+#endif /* COAP_ZERO_COPY */
 /*----------------------------------------------------------------------------*/
 static
 int
@@ -86,6 +121,15 @@ coap_receive(void)
   static coap_packet_t message[1]; /* This way the packet can be treated as pointer as usual. */
   static coap_packet_t response[1];
   static coap_transaction_t *transaction = NULL;
+  static uint8_t *request_data;
+  static uint8_t *response_buffer;
+  static size_t response_len;
+  static coap_static_t *representation;
+  /* The IP header is overwritten if a handler sends a message, e.g. a separate ACK. */
+  static uip_ipaddr_t peer_addr;
+  static uint16_t peer_port;
+  /* Sent to a multicast group rather than to us alone */
+  static uint8_t group_request;
 
   if (uip_newdata()) {
 
@@ -95,7 +139,25 @@ coap_receive(void)
     PRINTBITS(uip_appdata, uip_datalen());
     PRINTF("\n");
 
-    coap_error_code = coap_parse_message(message, uip_appdata, uip_datalen());
+    uip_ipaddr_copy(&peer_addr, &UIP_IP_BUF->srcipaddr);
+    peer_port = UIP_UDP_BUF->srcport;
+    group_request = uip_is_addr_mcast(&UIP_IP_BUF->destipaddr);
+    transaction = NULL;
+    response_buffer = NULL;
+    response_len = 0;
+
+#if COAP_ZERO_COPY
+    if ((request_data = coap_move_request()))
+    {
+      response_buffer = UIP_UDP_PAYLOAD;
+    }
+    else
+#endif /* COAP_ZERO_COPY */
+    {
+      request_data = uip_appdata;
+    }
+
+    coap_error_code = coap_parse_message(message, request_data, uip_datalen());
 
     if (coap_error_code==NO_ERROR)
     {
@@ -109,8 +171,23 @@ coap_receive(void)
       /* Handle requests. */
       if (message->code >= COAP_GET && message->code <= COAP_DELETE)
       {
-        /* Use transaction buffer for response to confirmable request. */
-        if ( (transaction = coap_new_transaction(message->mid, &UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport)) )
+        /* Use transaction buffer for response if it cannot be built in place. */
+        if (response_buffer==NULL && (transaction = coap_new_transaction(message->mid, &peer_addr, peer_port)))
+        {
+          response_buffer = transaction->packet;
+        }
+
+        if (response_buffer && message->code==COAP_GET && !IS_OPTION(message, COAP_OPTION_PROXY_URI)
+            && (representation = coap_get_static(message)))
+        {
+          /* Static resources are answered from their serialized representation, without a handler. */
+          response_len = coap_serialize_static(representation, message, response_buffer);
+          if (transaction)
+          {
+            transaction->packet_len = response_len;
+          }
+        }
+        else if (response_buffer)
         {
           uint32_t block_num = 0;
           uint16_t block_size = REST_MAX_CHUNK_SIZE;
@@ -144,10 +221,23 @@ coap_receive(void)
           }
 
           /* Invoke resource handler. */
-          if (service_cbk)
+          if (IS_OPTION(message, COAP_OPTION_PROXY_URI))
+          {
+            if (proxy_cbk)
+            {
+              /* Forwarded requests are answered with the Block2 of the origin server. */
+              proxy_cbk(message, response, response_buffer+COAP_MAX_HEADER_SIZE, block_size, &new_offset);
+            }
+            else
+            {
+              coap_error_code = PROXYING_NOT_SUPPORTED_5_05;
+              coap_error_message = "This is a constrained server (Contiki)";
+            }
+          }
+          else if (service_cbk)
           {
             /* Call REST framework and check if found and allowed. */
-            if (service_cbk(message, response, transaction->packet+COAP_MAX_HEADER_SIZE, block_size, &new_offset))
+            if (service_cbk(message, response, response_buffer+COAP_MAX_HEADER_SIZE, block_size, &new_offset))
             {
               if (coap_error_code==NO_ERROR)
               {
@@ -195,16 +285,6 @@ coap_receive(void)
                 } /* if (blockwise request) */
               } /* no errors/hooks */
             } /* successful service callback */
-
-            /* Serialize response. */
-            if (coap_error_code==NO_ERROR)
-            {
-              if ((transaction->packet_len = coap_serialize_message(response, transaction->packet))==0)
-              {
-                coap_error_code = PACKET_SERIALIZATION_ERROR;
-              }
-            }
-
           }
           else
           {
@@ -212,6 +292,26 @@ coap_receive(void)
             coap_error_message = "NoServiceCallbck"; // no a to fit 16 bytes
           } /* if (service callback) */
 
+          /* A message sent by the handler went through uip_buf and overwrote the response. */
+          if (coap_error_code==NO_ERROR && transaction==NULL && !uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &peer_addr))
+          {
+            coap_error_code = INTERNAL_SERVER_ERROR_5_00;
+            coap_error_message = "ResponseLost";
+          }
+
+          /* Serialize response. */
+          if (coap_error_code==NO_ERROR)
+          {
+            if ((response_len = coap_serialize_message(response, response_buffer))==0)
+            {
+              coap_error_code = PACKET_SERIALIZATION_ERROR;
+            }
+            else if (transaction)
+            {
+              transaction->packet_len = response_len;
+            }
+          }
+
         } else {
             coap_error_code = SERVICE_UNAVAILABLE_5_03;
             coap_error_message = "NoFreeTraBuffer";
@@ -234,7 +334,7 @@ coap_receive(void)
         {
           PRINTF("Received RST\n");
           /* Cancel possible subscriptions. */
-          coap_remove_observer_by_mid(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, message->mid);
+          coap_remove_observer_by_mid(&peer_addr, peer_port, message->mid);
         }
 
         if ( (transaction = coap_get_transaction_by_mid(message->mid)) )
@@ -242,7 +342,7 @@ coap_receive(void)
           /* Free transaction memory before callback, as it may create a new transaction. */
           restful_response_handler callback = transaction->callback;
           void *callback_data = transaction->callback_data;
-          coap_clear_transaction(transaction);
+          coap_complete_transaction(transaction);
 
           /* Check if someone registered for the response */
           if (callback) {
@@ -255,9 +355,23 @@ coap_receive(void)
 
     } /* if (parsed correctly) */
 
-    if (coap_error_code==NO_ERROR)
+    if (group_request)
+    {
+      /* All members would answer at once, so group requests get no response, not even an error. */
+      PRINTF("Group request, no response\n");
+      coap_clear_transaction(transaction);
+    }
+    else if (coap_error_code==NO_ERROR)
     {
-      if (transaction) coap_send_transaction(transaction);
+      if (transaction)
+      {
+        coap_send_transaction(transaction);
+      }
+      else if (response_len)
+      {
+        /* Already in place, coap_send_message() does not copy it. */
+        coap_send_message(&peer_addr, peer_port, UIP_UDP_PAYLOAD, response_len);
+      }
     }
     else if (coap_error_code==MANUAL_RESPONSE)
     {
@@ -284,7 +398,7 @@ coap_receive(void)
       /* Reuse input buffer for error message. */
       coap_init_message(message, reply_type, coap_error_code, message->mid);
       coap_set_payload(message, coap_error_message, strlen(coap_error_message));
-      coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, uip_appdata, coap_serialize_message(message, uip_appdata));
+      coap_send_message(&peer_addr, peer_port, UIP_UDP_PAYLOAD, coap_serialize_message(message, UIP_UDP_PAYLOAD));
     }
   } /* if (new data) */
 
@@ -294,6 +408,7 @@ coap_receive(void)
 void
 coap_receiver_init()
 {
+  coap_pool_init();
   process_start(&coap_receiver, NULL);
 }
 /*----------------------------------------------------------------------------*/
@@ -303,6 +418,12 @@ coap_set_service_callback(service_callback_t callback)
   service_cbk = callback;
 }
 /*----------------------------------------------------------------------------*/
+void
+coap_set_proxy_callback(service_callback_t callback)
+{
+  proxy_cbk = callback;
+}
+/*----------------------------------------------------------------------------*/
 rest_resource_flags_t
 coap_get_rest_method(void *packet)
 {
@@ -312,6 +433,203 @@ coap_get_rest_method(void *packet)
 /*- Server part --------------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
 
+/*
+ * The /.well-known/core document is not stored. An index of where each
+ * resource starts in it is built when the resources change, and blocks are
+ * sliced from the url and attributes strings of the resources they cover.
+ */
+typedef struct coap_link {
+  resource_t *resource;
+  uint16_t offset;          /* in the unfiltered document, at the ',' */
+  uint8_t url_len;
+  uint8_t attributes_len;
+#if COAP_LINK_FORMAT_FILTERING
+  uint8_t rt;               /* rt value in the attributes */
+  uint8_t rt_len;
+#endif
+} coap_link_t;
+
+static coap_link_t links[COAP_LINK_FORMAT_MAX_LINKS];
+static uint8_t links_count;
+static uint16_t links_len;
+static uint16_t links_version;
+
+/* <url>;attributes */
+#define LINK_LEN(link) (3 + (link)->url_len + ((link)->attributes_len ? 1 + (link)->attributes_len : 0))
+/*----------------------------------------------------------------------------*/
+const char *
+coap_link_attribute(const char *attributes, size_t len, const char *name, size_t name_len, size_t *value_len)
+{
+  const char *end = attributes + len;
+  const char *value;
+  int quoted;
+
+  while (attributes < end)
+  {
+    if ((size_t) (end - attributes) > name_len && strncmp(attributes, name, name_len)==0 && attributes[name_len]=='=')
+    {
+      value = attributes + name_len + 1;
+      quoted = value < end && *value=='"';
+      value += quoted;
+      for (attributes = value; attributes < end && *attributes!=(quoted ? '"' : ';'); ++attributes);
+      *value_len = attributes - value;
+      return value;
+    }
+    /* Next attribute, a ';' may be quoted. */
+    for (quoted = 0; attributes < end && (quoted || *attributes!=';'); ++attributes)
+    {
+      quoted ^= *attributes=='"';
+    }
+    ++attributes;
+  }
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+int
+coap_link_match(const char *values, size_t values_len, const char *value, size_t value_len)
+{
+  const char *end = values + values_len;
+  const char *next;
+  int prefix = value_len && value[value_len-1]=='*';
+
+  value_len -= prefix;
+  while (values < end)
+  {
+    if ((next = memchr(values, ' ', end - values))==NULL)
+    {
+      next = end;
+    }
+    if (((size_t) (next - values)==value_len || (prefix && (size_t) (next - values) > value_len))
+        && strncmp(values, value, value_len)==0)
+    {
+      return 1;
+    }
+    values = next + 1;
+  }
+  return 0;
+}
+/*----------------------------------------------------------------------------*/
+static void
+coap_link_index(void)
+{
+  resource_t *resource;
+  coap_link_t *link = links;
+#if COAP_LINK_FORMAT_FILTERING
+  const char *rt;
+  size_t rt_len = 0;
+#endif
+
+  links_len = 0;
+  for (resource = (resource_t*)list_head(rest_get_resources()); resource; resource = resource->next)
+  {
+    if (link==links + COAP_LINK_FORMAT_MAX_LINKS)
+    {
+      PRINTF("Link format: no room for /%s\n", resource->url);
+      break;
+    }
+    link->resource = resource;
+    link->offset = links_len;
+    link->url_len = strlen(resource->url);
+    link->attributes_len = strlen(resource->attributes);
+#if COAP_LINK_FORMAT_FILTERING
+    rt = coap_link_attribute(resource->attributes, link->attributes_len, "rt", 2, &rt_len);
+    link->rt = rt ? rt - resource->attributes : 0;
+    link->rt_len = rt ? rt_len : 0;
+#endif
+    links_len += (link > links) + LINK_LEN(link);
+    ++link;
+  }
+  links_count = link - links;
+
+  PRINTF("Link format: %u resources, %u bytes\n", links_count, links_len);
+}
+/*----------------------------------------------------------------------------*/
+static void
+coap_link_update(void)
+{
+  if (links_version != rest_get_resources_version())
+  {
+    links_version = rest_get_resources_version();
+    coap_link_index();
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Copies ",<url>;attributes" from skip on, returns the bytes written.
+ */
+static size_t
+coap_link_copy(coap_link_t *link, int comma, size_t skip, uint8_t *buffer, size_t size)
+{
+  const char *part[4];
+  size_t part_len[4];
+  size_t written = 0;
+  size_t n;
+  int i;
+
+  part[0] = comma ? ",</" : "</";
+  part_len[0] = comma ? 3 : 2;
+  part[1] = link->resource->url;
+  part_len[1] = link->url_len;
+  part[2] = ">;";
+  part_len[2] = link->attributes_len ? 2 : 1;
+  part[3] = link->resource->attributes;
+  part_len[3] = link->attributes_len;
+
+  for (i = 0; i<4 && written<size; ++i)
+  {
+    if (skip >= part_len[i])
+    {
+      skip -= part_len[i];
+      continue;
+    }
+    n = MIN(part_len[i] - skip, size - written);
+    memcpy(buffer + written, part[i] + skip, n);
+    written += n;
+    skip = 0;
+  }
+  return written;
+}
+/*----------------------------------------------------------------------------*/
+size_t
+coap_get_link_format(uint8_t *buffer, size_t size, uint32_t offset)
+{
+  coap_link_t *link;
+  size_t low = 0;
+  size_t high;
+  size_t len = 0;
+
+  coap_link_update();
+  if (offset >= links_len)
+  {
+    return 0;
+  }
+
+  /* Find the resource at the offset, then slice. */
+  for (high = links_count; high - low > 1; )
+  {
+    if (links[(low + high) / 2].offset <= offset)
+    {
+      low = (low + high) / 2;
+    }
+    else
+    {
+      high = (low + high) / 2;
+    }
+  }
+  for (link = links + low; link < links + links_count && len < size; ++link)
+  {
+    len += coap_link_copy(link, link>links, offset + len - link->offset, buffer + len, size - len);
+  }
+  return len;
+}
+/*----------------------------------------------------------------------------*/
+uint16_t
+coap_get_link_format_len(void)
+{
+  coap_link_update();
+  return links_len;
+}
+/*----------------------------------------------------------------------------*/
 /* The discover resource is automatically included for CoAP. */
 RESOURCE(well_known_core, METHOD_GET, ".well-known/core", "ct=40");
 void
@@ -319,152 +637,79 @@ well_known_core_handler(void* request, void* response, uint8_t *buffer, uint16_t
 {
     size_t strpos = 0; /* position in overall string (which is larger than the buffer) */
     size_t bufpos = 0; /* position within buffer (bytes written) */
-    size_t tmplen = 0;
-    resource_t* resource = NULL;
 
 #if COAP_LINK_FORMAT_FILTERING
-    /* For filtering. */
+    coap_link_t *link;
     const char *filter = NULL;
+    const char *value = NULL;
     const char *attrib = NULL;
-    const char *found = NULL;
-    const char *end = NULL;
-    char *value = NULL;
-    char lastchar = '\0';
-    int len = coap_get_header_uri_query(request, &filter);
+    size_t len = coap_get_header_uri_query(request, &filter);
+    size_t name_len = 0;
+    size_t value_len = 0;
+    size_t attrib_len = 0;
+    int match;
+#endif
 
+#if COAP_LINK_FORMAT_FILTERING
     if (len)
     {
-      value = strchr(filter, '=');
-      value[0] = '\0';
+      if ((value = memchr(filter, '=', len))==NULL)
+      {
+        coap_set_status_code(response, BAD_REQUEST_4_00);
+        coap_set_payload(response, "BadFilter", 9);
+        return;
+      }
+      name_len = value - filter;
       ++value;
-      len -= strlen(filter)+1;
-
-      PRINTF("Filter %s = %.*s\n", filter, len, value);
+      value_len = len - name_len - 1;
 
-      if (strcmp(filter,"href")==0 && value[0]=='/')
+      if (name_len==4 && strncmp(filter, "href", 4)==0 && value_len && value[0]=='/')
       {
         ++value;
-        --len;
+        --value_len;
       }
 
-      lastchar = value[len-1];
-      value[len-1] = '\0';
-    }
-#endif
+      PRINTF("Filter %.*s = %.*s\n", name_len, filter, value_len, value);
 
-    for (resource = (resource_t*)list_head(rest_get_resources()); resource; resource = resource->next)
-    {
-#if COAP_LINK_FORMAT_FILTERING
-      /* Filtering */
-      if (len)
+      coap_link_update();
+      for (link = links; link < links + links_count; ++link)
       {
-        if (strcmp(filter,"href")==0)
+        if (name_len==4 && strncmp(filter, "href", 4)==0)
         {
-          attrib=strstr(resource->url, value);
-          if (attrib==NULL || (value[-1]=='/' && attrib!=resource->url)) continue;
-          end = attrib + strlen(attrib);
+          match = coap_link_match(link->resource->url, link->url_len, value, value_len);
         }
-        else
+        else if (name_len==2 && strncmp(filter, "rt", 2)==0)
         {
-          attrib=strstr(resource->attributes, filter);
-          if (attrib==NULL || (attrib[strlen(filter)]!='=' && attrib[strlen(filter)]!='"')) continue;
-          attrib += strlen(filter)+2;
-          end = strchr(attrib, '"');
+          match = coap_link_match(link->resource->attributes + link->rt, link->rt_len, value, value_len);
         }
-
-        PRINTF("Filter: res has attrib %s (%s)\n", attrib, value);
-        found = attrib;
-        while ((found=strstr(found, value))!=NULL) {
-            if (found > end)
-            {
-              found = NULL;
-              break;
-            }
-            if (lastchar==found[len-1] || lastchar=='*')
-            {
-              break;
-            }
-            ++found;
+        else
+        {
+          attrib = coap_link_attribute(link->resource->attributes, link->attributes_len, filter, name_len, &attrib_len);
+          match = attrib && coap_link_match(attrib, attrib_len, value, value_len);
         }
-        if (found==NULL)
+        if (!match)
         {
           continue;
         }
-        PRINTF("Filter: res has prefix %s\n", found);
-        if (lastchar!='*' && (found[len]!='"' && found[len]!=' ' && found[len]!='\0')) continue;
-        PRINTF("Filter: res has match\n");
-      }
-#endif
-
-      PRINTF("res: /%s (%p)\npos: s%d, o%ld, b%d\n", resource->url, resource, strpos, *offset, bufpos);
 
-      if (strpos>0)
-      {
-        if (strpos >= *offset && bufpos < preferred_size)
+        if (bufpos < preferred_size && strpos + (strpos>0) + LINK_LEN(link) > *offset)
         {
-          buffer[bufpos++] = ',';
+          bufpos += coap_link_copy(link, strpos>0, *offset + bufpos - strpos, buffer + bufpos, preferred_size - bufpos);
         }
-        ++strpos;
-      }
+        strpos += (strpos>0) + LINK_LEN(link);
 
-      if (strpos >= *offset && bufpos < preferred_size)
-      {
-        buffer[bufpos++] = '<';
-      }
-      ++strpos;
-
-      if (strpos >= *offset && bufpos < preferred_size)
-      {
-        buffer[bufpos++] = '/';
-      }
-      ++strpos;
-
-      tmplen = strlen(resource->url);
-      if (strpos+tmplen > *offset)
-      {
-        bufpos += snprintf((char *) buffer + bufpos, preferred_size - bufpos + 1,
-                         "%s", resource->url + ((*offset-(int32_t)strpos > 0) ? (*offset-(int32_t)strpos) : 0));
-                                                          /* minimal-net requires these casts */
-        if (bufpos >= preferred_size)
+        /* buffer full and more to come */
+        if (strpos > *offset + bufpos)
         {
           break;
         }
       }
-      strpos += tmplen;
-
-      if (strpos >= *offset && bufpos < preferred_size)
-      {
-        buffer[bufpos++] = '>';
-      }
-      ++strpos;
-
-      if (resource->attributes[0])
-      {
-        if (strpos >= *offset && bufpos < preferred_size)
-        {
-          buffer[bufpos++] = ';';
-        }
-        ++strpos;
-
-        tmplen = strlen(resource->attributes);
-        if (strpos+tmplen > *offset)
-        {
-          bufpos += snprintf((char *) buffer + bufpos, preferred_size - bufpos + 1,
-                         "%s", resource->attributes + (*offset-(int32_t)strpos > 0 ? *offset-(int32_t)strpos : 0));
-          if (bufpos >= preferred_size)
-          {
-            break;
-          }
-        }
-        strpos += tmplen;
-      }
-
-      /* buffer full, but resource not completed yet; or: do not break if resource exactly fills buffer. */
-      if (bufpos >= preferred_size && strpos-bufpos > *offset)
-      {
-        PRINTF("res: BREAK at %s (%p)\n", resource->url, resource);
-        break;
-      }
+    }
+    else
+#endif /* COAP_LINK_FORMAT_FILTERING */
+    {
+      strpos = coap_get_link_format_len();
+      bufpos = coap_get_link_format(buffer, preferred_size, *offset);
     }
 
     if (bufpos>0) {
@@ -481,13 +726,13 @@ well_known_core_handler(void* request, void* response, uint8_t *buffer, uint16_t
       coap_set_payload(response, "BlockOutOfScope", 15);
     }
 
-    if (resource==NULL) {
+    if (strpos <= *offset + bufpos) {
       PRINTF("res: DONE\n");
       *offset = -1;
     }
     else
     {
-      PRINTF("res: MORE at %s (%p)\n", resource->url, resource);
+      PRINTF("res: MORE at %u\n", *offset + bufpos);
       *offset += preferred_size;
     }
 }
@@ -507,8 +752,8 @@ PROCESS_THREAD(coap_receiver, ev, data)
 
     if(ev == tcpip_event) {
       coap_receive();
-    } else if (ev == PROCESS_EVENT_TIMER) {
-      /* retransmissions are handled here */
+    } else if (ev == PROCESS_EVENT_TIMER || ev == PROCESS_EVENT_POLL) {
+      /* retransmissions and CONs released from the NSTART queue are handled here */
       coap_check_transactions();
     }
   } /* while (1) */
@@ -47,6 +47,8 @@
 #include "er-coap-13-transactions.h"
 #include "er-coap-13-observing.h"
 #include "er-coap-13-separate.h"
+#include "er-coap-13-pool.h"
+#include "er-coap-13-static.h"
 
 #include "pt.h"
 
@@ -62,6 +64,9 @@ extern const struct rest_implementation coap_rest_implementation;
 
 void coap_receiver_init(void);
 
+/* Requests with a Proxy-Uri go to this callback instead of the resources. */
+void coap_set_proxy_callback(service_callback_t callback);
+
 /*-----------------------------------------------------------------------------------*/
 /*- Client part ---------------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -91,4 +96,14 @@ PT_THREAD(coap_blocking_request(struct request_state_t *state, process_event_t e
 }
 /*-----------------------------------------------------------------------------------*/
 
+/* The /.well-known/core document of the activated resources, sliced from offset. */
+size_t coap_get_link_format(uint8_t *buffer, size_t size, uint32_t offset);
+uint16_t coap_get_link_format_len(void);
+
+/* Link format helpers: the value of an attribute, without quotes, and
+ * matching a space-separated list of values where a trailing '*' matches a prefix. */
+const char *coap_link_attribute(const char *attributes, size_t len, const char *name, size_t name_len, size_t *value_len);
+int coap_link_match(const char *values, size_t values_len, const char *value, size_t value_len);
+/*-----------------------------------------------------------------------------------*/
+
 #endif /* COAP_SERVER_H_ */
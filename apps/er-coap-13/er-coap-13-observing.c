@@ -40,6 +40,7 @@
 #include <string.h>
 
 #include "er-coap-13-observing.h"
+#include "er-coap-13-pool.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -53,7 +54,6 @@
 #endif
 
 
-MEMB(observers_memb, coap_observer_t, COAP_MAX_OBSERVERS);
 LIST(observers_list);
 
 /*-----------------------------------------------------------------------------------*/
@@ -63,7 +63,8 @@ coap_add_observer(uip_ipaddr_t *addr, uint16_t port, const uint8_t *token, size_
   /* Remove existing observe relationship, if any. */
   coap_remove_observer_by_url(addr, port, url);
 
-  coap_observer_t *o = memb_alloc(&observers_memb);
+  /* Always leave room for a transaction to notify the existing observers. */
+  coap_observer_t *o = coap_pool_alloc(sizeof(coap_observer_t), sizeof(coap_transaction_t));
 
   if (o)
   {
@@ -88,8 +89,8 @@ coap_remove_observer(coap_observer_t *o)
 {
   PRINTF("Removing observer for /%s [0x%02X%02X]\n", o->url, o->token[0], o->token[1]);
 
-  memb_free(&observers_memb, o);
   list_remove(observers_list, o);
+  coap_pool_free(o, sizeof(coap_observer_t));
 }
 
 int
@@ -184,7 +185,14 @@ coap_notify_observers(resource_t *resource, int32_t obs_counter, void *notificat
 
       /*TODO implement special transaction for CON, sharing the same buffer to allow for more observers. */
 
-      if ( (transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port)) )
+      /* A CON notification still queued for the observer's NSTART limit is updated in place. */
+      if ( (transaction = coap_get_transaction_by_mid(obs->last_mid))
+           && (transaction->state!=COAP_TRANSACTION_QUEUED || !uip_ipaddr_cmp(&transaction->addr, &obs->addr) || transaction->port!=obs->port) )
+      {
+        transaction = NULL;
+      }
+
+      if ( transaction || (transaction = coap_new_transaction(coap_get_mid(), &obs->addr, obs->port)) )
       {
         PRINTF("           Observer ");
         PRINT6ADDR(&obs->addr);
@@ -199,7 +207,11 @@ coap_notify_observers(resource_t *resource, int32_t obs_counter, void *notificat
         coap_set_header_token(coap_res, obs->token, obs->token_len);
 
         /* Use CON to check whether client is still there/interested after COAP_OBSERVING_REFRESH_INTERVAL. */
-        if (stimer_expired(&obs->refresh_timer))
+        if (transaction->state==COAP_TRANSACTION_QUEUED)
+        {
+          coap_res->type = COAP_TYPE_CON;
+        }
+        else if (stimer_expired(&obs->refresh_timer))
         {
           PRINTF("           Refreshing with CON\n");
           coap_res->type = COAP_TYPE_CON;
@@ -212,7 +224,10 @@ coap_notify_observers(resource_t *resource, int32_t obs_counter, void *notificat
 
         transaction->packet_len = coap_serialize_message(coap_res, transaction->packet);
 
-        coap_send_transaction(transaction);
+        if (transaction->state!=COAP_TRANSACTION_QUEUED)
+        {
+          coap_send_transaction(transaction);
+        }
       }
     }
   }
@@ -238,7 +253,7 @@ coap_observe_handler(resource_t *resource, void *request, void *response)
          * For demonstration purposes only. A subscription should return the same representation as a normal GET.
          * TODO: Comment the following line for any real application.
          */
-        coap_set_payload(coap_res, content, snprintf(content, sizeof(content), "Added %u/%u", list_length(observers_list), COAP_MAX_OBSERVERS));
+        coap_set_payload(coap_res, content, snprintf(content, sizeof(content), "Added %u", list_length(observers_list)));
       }
       else
       {
@@ -43,6 +43,10 @@
 #include "er-coap-13.h"
 #include "er-coap-13-transactions.h"
 
+/*
+ * Only sizes the shared pool (er-coap-13-pool.h) together with COAP_MAX_OPEN_TRANSACTIONS.
+ * Observers may use more of the pool as long as one transaction still fits.
+ */
 #ifndef COAP_MAX_OBSERVERS
 #define COAP_MAX_OBSERVERS    COAP_MAX_OPEN_TRANSACTIONS-1
 #endif /* COAP_MAX_OBSERVERS */
@@ -50,10 +54,6 @@
 /* Interval in seconds in which NON notifies are changed to CON notifies to check client. */
 #define COAP_OBSERVING_REFRESH_INTERVAL  60
 
-#if COAP_MAX_OPEN_TRANSACTIONS<COAP_MAX_OBSERVERS
-#warning "COAP_MAX_OPEN_TRANSACTIONS smaller than COAP_MAX_OBSERVERS: cannot handle CON notifications"
-#endif
-
 typedef struct coap_observer {
   struct coap_observer *next; /* for LIST */
 
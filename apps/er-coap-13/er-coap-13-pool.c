@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Shared memory pool for CoAP transactions and observers
+ */
+
+#include <string.h>
+
+#include "contiki.h"
+#include "er-coap-13-pool.h"
+#include "er-coap-13-transactions.h"
+#include "er-coap-13-observing.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define UNIT_SIZE   ((sizeof(coap_observer_t) + 3) & ~3)
+#define UNITS(size) (((size) + UNIT_SIZE - 1) / UNIT_SIZE)
+
+#ifndef COAP_POOL_SIZE
+#define COAP_POOL_SIZE (UNIT_SIZE * (COAP_MAX_OPEN_TRANSACTIONS * UNITS(sizeof(coap_transaction_t)) + COAP_MAX_OBSERVERS))
+#endif /* COAP_POOL_SIZE */
+
+#define POOL_UNITS  (COAP_POOL_SIZE / UNIT_SIZE)
+
+#define IS_USED(i)  (used_map[(i) >> 3] & (1 << ((i) & 7)))
+
+struct coap_pool_stats coap_pool_stats;
+
+/* uint32_t for alignment */
+static uint32_t pool[POOL_UNITS * UNIT_SIZE / sizeof(uint32_t)];
+static uint8_t used_map[(POOL_UNITS + 7) / 8];
+static uint16_t used_units;
+
+/*-----------------------------------------------------------------------------------*/
+static void
+mark(uint16_t first, uint16_t n, int used)
+{
+  for ( ; n > 0; --n, ++first)
+  {
+    if (used)
+    {
+      used_map[first >> 3] |= 1 << (first & 7);
+    }
+    else
+    {
+      used_map[first >> 3] &= ~(1 << (first & 7));
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+void
+coap_pool_init(void)
+{
+  memset(used_map, 0, sizeof(used_map));
+  used_units = 0;
+  memset(&coap_pool_stats, 0, sizeof(coap_pool_stats));
+  coap_pool_stats.size = POOL_UNITS * UNIT_SIZE;
+}
+/*-----------------------------------------------------------------------------------*/
+void *
+coap_pool_alloc(size_t size, size_t reserve)
+{
+  uint16_t n = UNITS(size);
+  uint16_t run = 0;
+  uint16_t k;
+  uint16_t i;
+
+  if (n > 0 && POOL_UNITS - used_units >= n + UNITS(reserve))
+  {
+    for (k = 0; k < POOL_UNITS; ++k)
+    {
+      /* First fit from the start, or from the end for long-lived objects */
+      i = reserve ? POOL_UNITS - 1 - k : k;
+      if (IS_USED(i))
+      {
+        run = 0;
+      }
+      else if (++run == n)
+      {
+        if (!reserve)
+        {
+          i -= n - 1;
+        }
+        mark(i, n, 1);
+        used_units += n;
+
+        coap_pool_stats.used = used_units * UNIT_SIZE;
+        if (coap_pool_stats.used > coap_pool_stats.max_used)
+        {
+          coap_pool_stats.max_used = coap_pool_stats.used;
+        }
+        /* Units are reused by objects of another type: hand them out zeroed */
+        memset((uint8_t *) pool + i * UNIT_SIZE, 0, n * UNIT_SIZE);
+        return (uint8_t *) pool + i * UNIT_SIZE;
+      }
+    }
+  }
+
+  PRINTF("CoAP pool: cannot allocate %u bytes (%u/%u used)\n", (unsigned)size, coap_pool_stats.used, coap_pool_stats.size);
+  ++coap_pool_stats.failed;
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+coap_pool_free(void *ptr, size_t size)
+{
+  if (ptr)
+  {
+    uint16_t n = UNITS(size);
+
+    mark(((uint8_t *) ptr - (uint8_t *) pool) / UNIT_SIZE, n, 0);
+    used_units -= n;
+    coap_pool_stats.used = used_units * UNIT_SIZE;
+  }
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Shared memory pool for CoAP transactions and observers
+ *
+ *      Transactions and observers are allocated from one pool instead of
+ *      fixed arrays, so that a node with few retransmissions in flight
+ *      can keep more observe relationships. The pool is split in units
+ *      the size of an observer. Transactions take units from the start
+ *      of the pool, observers from its end, which keeps the free space
+ *      contiguous.
+ *
+ *      COAP_POOL_SIZE defaults to the room for COAP_MAX_OPEN_TRANSACTIONS
+ *      transactions and COAP_MAX_OBSERVERS observers.
+ */
+
+#ifndef COAP_POOL_H_
+#define COAP_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct coap_pool_stats {
+  uint16_t size;        /* bytes */
+  uint16_t used;        /* bytes */
+  uint16_t max_used;    /* bytes */
+  uint16_t failed;      /* refused allocations */
+};
+
+extern struct coap_pool_stats coap_pool_stats;
+
+void coap_pool_init(void);
+
+/*
+ * Allocates size zeroed bytes. A reserve > 0 marks a long-lived object: it is taken
+ * from the end of the pool and only if reserve bytes stay free, so that such
+ * objects cannot starve the transactions.
+ */
+void *coap_pool_alloc(size_t size, size_t reserve);
+void coap_pool_free(void *ptr, size_t size);
+
+#endif /* COAP_POOL_H_ */
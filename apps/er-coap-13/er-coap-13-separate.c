@@ -65,45 +65,37 @@ int
 coap_separate_accept(void *request, coap_separate_t *separate_store)
 {
   coap_packet_t *const coap_req = (coap_packet_t *) request;
-  coap_transaction_t *const t = coap_get_transaction_by_mid(coap_req->mid);
 
   PRINTF("Separate ACCEPT: /%.*s MID %u\n", coap_req->uri_path_len, coap_req->uri_path, coap_req->mid);
-  if (t)
-  {
-    /* Send separate ACK for CON. */
-    if (coap_req->type==COAP_TYPE_CON)
-    {
-      coap_packet_t ack[1];
-      /* ACK with empty code (0) */
-      coap_init_message(ack, COAP_TYPE_ACK, 0, coap_req->mid);
-      /* Serializing into IPBUF: Only overwrites header parts that are already parsed into the request struct. */
-      coap_send_message(&UIP_IP_BUF->srcipaddr, UIP_UDP_BUF->srcport, (uip_appdata), coap_serialize_message(ack, uip_appdata));
-    }
 
-    /* Store remote address. */
-    uip_ipaddr_copy(&separate_store->addr, &t->addr);
-    separate_store->port = t->port;
+  /* Store remote address before the ACK overwrites the IP header. */
+  uip_ipaddr_copy(&separate_store->addr, &UIP_IP_BUF->srcipaddr);
+  separate_store->port = UIP_UDP_BUF->srcport;
 
-    /* Store correct response type. */
-    separate_store->type = coap_req->type==COAP_TYPE_CON ? COAP_TYPE_CON : COAP_TYPE_NON;
-    separate_store->mid = coap_get_mid(); /* if it was a NON, we burned one MID in the engine... */
+  /* Send separate ACK for CON. */
+  if (coap_req->type==COAP_TYPE_CON)
+  {
+    coap_packet_t ack[1];
+    /* ACK with empty code (0) */
+    coap_init_message(ack, COAP_TYPE_ACK, 0, coap_req->mid);
+    /* Serializing into IPBUF: Only overwrites header parts that are already parsed into the request struct. */
+    coap_send_message(&separate_store->addr, separate_store->port, (uip_appdata), coap_serialize_message(ack, uip_appdata));
+  }
 
-    memcpy(separate_store->token, coap_req->token, coap_req->token_len);
-    separate_store->token_len = coap_req->token_len;
+  /* Store correct response type. */
+  separate_store->type = coap_req->type==COAP_TYPE_CON ? COAP_TYPE_CON : COAP_TYPE_NON;
+  separate_store->mid = coap_get_mid(); /* if it was a NON, we burned one MID in the engine... */
 
-    separate_store->block2_num = coap_req->block2_num;
-    separate_store->block2_size = coap_req->block2_size;
+  memcpy(separate_store->token, coap_req->token, coap_req->token_len);
+  separate_store->token_len = coap_req->token_len;
 
-    /* Signal the engine to skip automatic response and clear transaction by engine. */
-    coap_error_code = MANUAL_RESPONSE;
+  separate_store->block2_num = coap_req->block2_num;
+  separate_store->block2_size = coap_req->block2_size;
 
-    return 1;
-  }
-  else
-  {
-    PRINTF("ERROR: Response transaction for separate request not found!\n");
-    return 0;
-  }
+  /* Signal the engine to skip automatic response and clear transaction by engine. */
+  coap_error_code = MANUAL_RESPONSE;
+
+  return 1;
 }
 /*----------------------------------------------------------------------------*/
 void
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for static resources
+ */
+
+#include <string.h>
+
+#include "contiki.h"
+#include "lib/crc16.h"
+#include "er-coap-13-static.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define ALIGN(size)     (((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+LIST(static_list);
+
+/* void * for alignment */
+static void *static_buffer[COAP_STATIC_BUFFER_SIZE / sizeof(void *)];
+static uint16_t static_used;
+
+/*-----------------------------------------------------------------------------------*/
+int
+coap_activate_static_resource(resource_t *resource, unsigned int content_type, uint32_t max_age, const void *payload, size_t length)
+{
+  coap_static_t *representation = (coap_static_t *) ((uint8_t *) static_buffer + static_used);
+  coap_packet_t packet[1];
+  uint16_t etag;
+  uint8_t etag_bytes[COAP_STATIC_ETAG_LEN];
+  size_t len;
+
+  if (length > REST_MAX_CHUNK_SIZE || strlen(resource->url) > 0xFF
+      || static_used + sizeof(coap_static_t) + COAP_HEADER_LEN + COAP_STATIC_OPTIONS_LEN + 1 + length > sizeof(static_buffer))
+  {
+    PRINTF("Static: no room for /%s (%u bytes)\n", resource->url, length);
+    return 0;
+  }
+
+  /* The ETag only changes with the content. */
+  etag = crc16_data(payload, length, content_type);
+  etag_bytes[0] = etag >> 8;
+  etag_bytes[1] = etag;
+
+  coap_init_message(packet, COAP_TYPE_NON, CONTENT_2_05, 0);
+  coap_set_header_etag(packet, etag_bytes, COAP_STATIC_ETAG_LEN);
+  coap_set_header_content_type(packet, content_type);
+  coap_set_header_max_age(packet, max_age);
+  coap_set_payload(packet, payload, length);
+
+  /* Serialize in place and drop the header, the token is empty. */
+  if ((len = coap_serialize_message(packet, representation->data))==0)
+  {
+    return 0;
+  }
+  len -= COAP_HEADER_LEN;
+  memmove(representation->data, representation->data + COAP_HEADER_LEN, len);
+
+  representation->resource = resource;
+  representation->payload_len = length;
+  representation->url_len = strlen(resource->url);
+  representation->options_len = len - length - (length ? 1 : 0);
+
+  static_used += ALIGN(sizeof(coap_static_t) + len);
+  list_add(static_list, representation);
+
+  PRINTF("Static: /%s %u bytes, %u/%u used\n", resource->url, len, static_used, sizeof(static_buffer));
+
+  rest_activate_resource(resource);
+  return 1;
+}
+/*-----------------------------------------------------------------------------------*/
+coap_static_t *
+coap_get_static(coap_packet_t *request)
+{
+  coap_static_t *representation;
+
+  for (representation = (coap_static_t *) list_head(static_list); representation; representation = representation->next)
+  {
+    if (representation->url_len==request->uri_path_len
+        && strncmp(representation->resource->url, request->uri_path, request->uri_path_len)==0)
+    {
+      return representation;
+    }
+  }
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+size_t
+coap_serialize_static(coap_static_t *representation, coap_packet_t *request, uint8_t *buffer)
+{
+  /* The ETag option comes first, its value behind a one byte header. */
+  const uint8_t *etag = representation->data + 1;
+  const uint8_t *max_age;
+  const uint8_t *payload = representation->data + representation->options_len + 1;
+  uint16_t payload_len = representation->payload_len;
+  uint8_t *option = buffer + COAP_HEADER_LEN;
+  uint32_t block_num = 0;
+  uint16_t block_size = REST_MAX_CHUNK_SIZE;
+  uint32_t block_offset = 0;
+  uint32_t block;
+  uint8_t code = CONTENT_2_05;
+  uint8_t szx;
+  uint8_t len;
+
+  /* mirror token */
+  memcpy(option, request->token, request->token_len);
+  option += request->token_len;
+
+  if (IS_OPTION(request, COAP_OPTION_IF_NONE_MATCH)
+      || (IS_OPTION(request, COAP_OPTION_IF_MATCH) && request->if_match_len
+          && (request->if_match_len!=COAP_STATIC_ETAG_LEN || memcmp(request->if_match, etag, COAP_STATIC_ETAG_LEN))))
+  {
+    /* The resource exists and its ETag never changes. */
+    code = PRECONDITION_FAILED_4_12;
+    payload_len = 0;
+  }
+  else if (IS_OPTION(request, COAP_OPTION_ETAG) && request->etag_len==COAP_STATIC_ETAG_LEN
+           && memcmp(request->etag, etag, COAP_STATIC_ETAG_LEN)==0)
+  {
+    /* ETag and Max-Age, but no Content-Format without a payload */
+    code = VALID_2_03;
+    payload_len = 0;
+    memcpy(option, representation->data, 1+COAP_STATIC_ETAG_LEN);
+    option += 1+COAP_STATIC_ETAG_LEN;
+    max_age = representation->data + 1+COAP_STATIC_ETAG_LEN;
+    max_age += 1 + (*max_age & 0x0F);
+    len = *max_age & 0x0F;
+    *option++ = (COAP_OPTION_MAX_AGE-COAP_OPTION_ETAG)<<4 | len;
+    memcpy(option, max_age + 1, len);
+    option += len;
+  }
+  else if (coap_get_header_block2(request, &block_num, NULL, &block_size, &block_offset)
+           && block_offset >= payload_len)
+  {
+    code = BAD_OPTION_4_02;
+    payload = (const uint8_t *) "BlockOutOfScope";
+    payload_len = 15;
+  }
+  else
+  {
+    memcpy(option, representation->data, representation->options_len);
+    option += representation->options_len;
+
+    if (IS_OPTION(request, COAP_OPTION_BLOCK2))
+    {
+      /* Block2 follows Max-Age */
+      block_size = MIN(block_size, REST_MAX_CHUNK_SIZE);
+      for (szx = 0; (16<<szx) < block_size; ++szx);
+      block = block_num<<4 | (payload_len - block_offset > block_size)<<3 | szx;
+      len = block>0xFFFF ? 3 : (block>0xFF ? 2 : 1);
+      *option++ = (COAP_OPTION_BLOCK2-COAP_OPTION_MAX_AGE)<<4 | len;
+      while (len--)
+      {
+        *option++ = (uint8_t) (block>>(8*len));
+      }
+      payload += block_offset;
+      payload_len = MIN(payload_len - block_offset, block_size);
+    }
+  }
+
+  if (payload_len)
+  {
+    *option++ = 0xFF;
+    memcpy(option, payload, payload_len);
+    option += payload_len;
+  }
+
+  /* CON requests are answered with a piggy-backed ACK, NON requests with a NON. */
+  buffer[0] = 1<<COAP_HEADER_VERSION_POSITION | request->token_len<<COAP_HEADER_TOKEN_LEN_POSITION;
+  if (request->type==COAP_TYPE_CON)
+  {
+    buffer[0] |= COAP_TYPE_ACK<<COAP_HEADER_TYPE_POSITION;
+    buffer[2] = (uint8_t) (request->mid>>8);
+    buffer[3] = (uint8_t) request->mid;
+  }
+  else
+  {
+    uint16_t mid = coap_get_mid();
+
+    buffer[0] |= COAP_TYPE_NON<<COAP_HEADER_TYPE_POSITION;
+    buffer[2] = (uint8_t) (mid>>8);
+    buffer[3] = (uint8_t) mid;
+  }
+  buffer[1] = code;
+
+  PRINTF("Static: /%s %u.%02u, %u bytes\n", representation->resource->url, code>>5, code & 0x1F, option - buffer);
+
+  return option - buffer;
+}
+/*-----------------------------------------------------------------------------------*/
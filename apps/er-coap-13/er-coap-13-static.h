@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      CoAP module for static resources
+ *
+ *      The representation of a static resource never changes after its
+ *      activation. Its options (ETag, Content-Format, Max-Age) and payload
+ *      are serialized once into COAP_STATIC_BUFFER_SIZE bytes, and the
+ *      engine answers GET requests by copying them behind the header and
+ *      token, without calling a handler. The ETag is a CRC-16 of the
+ *      content type and payload, so that a client can revalidate with a
+ *      2.03 that carries no payload.
+ */
+
+#ifndef COAP_STATIC_H_
+#define COAP_STATIC_H_
+
+#include "er-coap-13.h"
+
+/*
+ * The buffer holds COAP_MAX_STATIC_RESOURCES representations with payloads of
+ * COAP_STATIC_PAYLOAD_SIZE bytes on average. Its size follows the size of the
+ * pointers, so that the same resources fit on 64-bit native and Cooja builds.
+ */
+#ifndef COAP_MAX_STATIC_RESOURCES
+#define COAP_MAX_STATIC_RESOURCES   8
+#endif /* COAP_MAX_STATIC_RESOURCES */
+
+#ifndef COAP_STATIC_PAYLOAD_SIZE
+#define COAP_STATIC_PAYLOAD_SIZE    16
+#endif /* COAP_STATIC_PAYLOAD_SIZE */
+
+#define COAP_STATIC_ETAG_LEN        2
+
+/* Largest ETag, Content-Format and Max-Age options */
+#define COAP_STATIC_OPTIONS_LEN     (1+COAP_STATIC_ETAG_LEN + 1+2 + 1+4)
+
+#ifndef COAP_STATIC_BUFFER_SIZE
+#define COAP_STATIC_BUFFER_SIZE     (COAP_MAX_STATIC_RESOURCES * (sizeof(coap_static_t) + COAP_STATIC_OPTIONS_LEN + 1 + COAP_STATIC_PAYLOAD_SIZE + sizeof(void *)))
+#endif /* COAP_STATIC_BUFFER_SIZE */
+
+/*
+ * Macro to define a static resource
+ * No handler is needed, the representation is given to coap_activate_static_resource().
+ */
+#define STATIC_RESOURCE(name, url, attributes) \
+resource_t resource_##name = {NULL, METHOD_GET, url, attributes, NULL, NULL, NULL, NULL}
+
+typedef struct coap_static {
+  struct coap_static *next; /* for LIST */
+
+  resource_t *resource;
+  uint16_t payload_len;
+  uint8_t url_len;
+  uint8_t options_len; /* ETag, Content-Format and Max-Age */
+  uint8_t data[];      /* options, payload marker, payload */
+} coap_static_t;
+
+/*
+ * Serializes the representation and activates the resource.
+ * Returns 0 if it does not fit in COAP_STATIC_BUFFER_SIZE or a response.
+ */
+int coap_activate_static_resource(resource_t *resource, unsigned int content_type, uint32_t max_age, const void *payload, size_t length);
+
+coap_static_t *coap_get_static(coap_packet_t *request);
+
+/*
+ * Serializes the response to a GET on a static resource to buffer:
+ * 2.05, 2.03 for a matching ETag, or 4.12 for a failed If-Match/If-None-Match.
+ * Returns the length.
+ */
+size_t coap_serialize_static(coap_static_t *representation, coap_packet_t *request, uint8_t *buffer);
+
+#endif /* COAP_STATIC_H_ */
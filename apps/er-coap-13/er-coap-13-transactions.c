@@ -36,18 +36,22 @@
  *      Matthias Kovatsch <kovatsch@inf.ethz.ch>
  */
 
+#include <string.h>
+
 #include "contiki.h"
 #include "contiki-net.h"
 
 #include "er-coap-13-transactions.h"
 #include "er-coap-13-observing.h"
+#include "er-coap-13-pool.h"
 
 /*
- * Modulo mask (+1 and +0.5 for rounding) for a random number to get the tick number for the random
- * retransmission time between COAP_RESPONSE_TIMEOUT and COAP_RESPONSE_TIMEOUT*COAP_RESPONSE_RANDOM_FACTOR.
+ * Initial retransmission timeout towards a new peer, and bounds of the
+ * estimated one.
  */
-#define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
-#define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
+#define COAP_RTO_INITIAL  (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
+#define COAP_RTO_MIN      (CLOCK_SECOND / 2)
+#define COAP_RTO_MAX      (CLOCK_SECOND * 32)
 
 #define DEBUG 0
 #if DEBUG
@@ -62,12 +66,99 @@
 #endif
 
 
-MEMB(transactions_memb, coap_transaction_t, COAP_MAX_OPEN_TRANSACTIONS);
 LIST(transactions_list);
 
+MEMB(peers_memb, coap_peer_t, COAP_MAX_PEERS);
+LIST(peers_list); /* most recently used first */
+
 
 static struct process *transaction_handler_process = NULL;
 
+/*----------------------------------------------------------------------------*/
+static coap_peer_t *
+coap_get_peer(uip_ipaddr_t *addr, uint16_t port, int create)
+{
+  coap_peer_t *p = NULL;
+  coap_peer_t *idle = NULL;
+
+  for (p = (coap_peer_t*)list_head(peers_list); p; p = p->next)
+  {
+    if (uip_ipaddr_cmp(&p->addr, addr) && p->port==port)
+    {
+      list_remove(peers_list, p);
+      list_push(peers_list, p);
+      return p;
+    }
+    if (p->outstanding==0)
+    {
+      idle = p;
+    }
+  }
+
+  if (!create)
+  {
+    return NULL;
+  }
+
+  if ((p = memb_alloc(&peers_memb))==NULL)
+  {
+    /* Replace the least recently used peer without CONs in flight. */
+    if ((p = idle)==NULL)
+    {
+      return NULL;
+    }
+    list_remove(peers_list, p);
+  }
+
+  memset(p, 0, sizeof(coap_peer_t));
+  uip_ipaddr_copy(&p->addr, addr);
+  p->port = port;
+  p->rto = COAP_RTO_INITIAL;
+  p->last_update = clock_time();
+  list_push(peers_list, p);
+
+  return p;
+}
+/*----------------------------------------------------------------------------*/
+/* CoCoA ageing: an RTO that has not been updated for a while drifts back towards the initial one. */
+static clock_time_t
+coap_peer_rto(coap_peer_t *p)
+{
+  clock_time_t idle = clock_time() - p->last_update;
+
+  if (p->rto < CLOCK_SECOND && idle > 16 * p->rto)
+  {
+    p->rto <<= 1;
+    p->last_update = clock_time();
+  }
+  else if (p->rto > 3 * CLOCK_SECOND && idle > 4 * p->rto)
+  {
+    p->rto = (p->rto + COAP_RTO_INITIAL) / 2;
+    p->last_update = clock_time();
+  }
+  return p->rto;
+}
+/*----------------------------------------------------------------------------*/
+/* RFC 6298 estimator, returns SRTT + k*RTTVAR. */
+static clock_time_t
+coap_rtt_estimate(clock_time_t *srtt, clock_time_t *rttvar, clock_time_t rtt, int k)
+{
+  clock_time_t delta;
+
+  if (*srtt==0)
+  {
+    *srtt = rtt;
+    *rttvar = rtt / 2;
+  }
+  else
+  {
+    delta = *srtt > rtt ? *srtt - rtt : rtt - *srtt;
+    *rttvar = (3 * *rttvar + delta) / 4;
+    *srtt = (7 * *srtt + rtt) / 8;
+  }
+  return *srtt + k * *rttvar;
+}
+/*----------------------------------------------------------------------------*/
 void
 coap_register_as_transaction_handler()
 {
@@ -77,12 +168,15 @@ coap_register_as_transaction_handler()
 coap_transaction_t *
 coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port)
 {
-  coap_transaction_t *t = memb_alloc(&transactions_memb);
+  coap_transaction_t *t = coap_pool_alloc(sizeof(coap_transaction_t), 0);
 
   if (t)
   {
     t->mid = mid;
     t->retrans_counter = 0;
+    t->state = COAP_TRANSACTION_NEW;
+    t->callback = NULL;
+    t->callback_data = NULL;
 
     /* save client address */
     uip_ipaddr_copy(&t->addr, addr);
@@ -99,24 +193,47 @@ coap_send_transaction(coap_transaction_t *t)
 {
   PRINTF("Sending transaction %u\n", t->mid);
 
+  if (t->state==COAP_TRANSACTION_NEW && COAP_TYPE_CON==((COAP_HEADER_TYPE_MASK & t->packet[0])>>COAP_HEADER_TYPE_POSITION))
+  {
+    coap_peer_t *peer = coap_get_peer(&t->addr, t->port, 1);
+    clock_time_t rto = COAP_RTO_INITIAL;
+
+    if (peer)
+    {
+      if (peer->outstanding >= COAP_MAX_CON_PER_PEER)
+      {
+        PRINTF("Queueing transaction %u\n", t->mid);
+        t->state = COAP_TRANSACTION_QUEUED;
+        return;
+      }
+      ++(peer->outstanding);
+      rto = coap_peer_rto(peer);
+    }
+
+    t->state = COAP_TRANSACTION_OUTSTANDING;
+    t->start = clock_time();
+
+    /* CoCoA variable backoff: 3 for small RTOs, 1.5 for large ones, 2 otherwise */
+    t->backoff = rto < CLOCK_SECOND ? 6 : (rto > 3 * CLOCK_SECOND ? 3 : 4);
+
+    /* random retransmission time between RTO and RTO*COAP_RESPONSE_RANDOM_FACTOR */
+    t->retrans_timer.timer.interval = rto + (random_rand() % (((rto * (uint16_t)((COAP_RESPONSE_RANDOM_FACTOR - 1) * 256)) >> 8) + 1));
+    PRINTF("Initial interval %lu ticks\n", (unsigned long)t->retrans_timer.timer.interval);
+  }
+
   coap_send_message(&t->addr, t->port, t->packet, t->packet_len);
 
-  if (COAP_TYPE_CON==((COAP_HEADER_TYPE_MASK & t->packet[0])>>COAP_HEADER_TYPE_POSITION))
+  if (t->state==COAP_TRANSACTION_OUTSTANDING)
   {
     if (t->retrans_counter<COAP_MAX_RETRANSMIT)
     {
       /* Not timed out yet. */
       PRINTF("Keeping transaction %u\n", t->mid);
 
-      if (t->retrans_counter==0)
-      {
-        t->retrans_timer.timer.interval = COAP_RESPONSE_TIMEOUT_TICKS + (random_rand() % (clock_time_t) COAP_RESPONSE_TIMEOUT_BACKOFF_MASK);
-        PRINTF("Initial interval %f\n", (float)t->retrans_timer.timer.interval/CLOCK_SECOND);
-      }
-      else
+      if (t->retrans_counter>0)
       {
-        t->retrans_timer.timer.interval <<= 1; /* double */
-        PRINTF("Doubled (%u) interval %f\n", t->retrans_counter, (float)t->retrans_timer.timer.interval/CLOCK_SECOND);
+        t->retrans_timer.timer.interval = t->retrans_timer.timer.interval * t->backoff / 2;
+        PRINTF("Backed off (%u) interval %lu ticks\n", t->retrans_counter, (unsigned long)t->retrans_timer.timer.interval);
       }
 
       /*FIXME
@@ -158,14 +275,81 @@ coap_clear_transaction(coap_transaction_t *t)
 {
   if (t)
   {
+    coap_transaction_t *next = NULL;
+
     PRINTF("Freeing transaction %u: %p\n", t->mid, t);
 
     etimer_stop(&t->retrans_timer);
     list_remove(transactions_list, t);
-    memb_free(&transactions_memb, t);
+
+    if (t->state==COAP_TRANSACTION_OUTSTANDING)
+    {
+      coap_peer_t *peer = coap_get_peer(&t->addr, t->port, 0);
+
+      if (peer && peer->outstanding)
+      {
+        --(peer->outstanding);
+      }
+
+      /*
+       * The next CON queued for this peer is sent by the transaction handler, not here:
+       * the ACK that cleared t is still in uip_buf for its callback.
+       */
+      for (next = (coap_transaction_t*)list_head(transactions_list); next; next = next->next)
+      {
+        if (next->state==COAP_TRANSACTION_QUEUED && uip_ipaddr_cmp(&next->addr, &t->addr) && next->port==t->port)
+        {
+          process_poll(transaction_handler_process);
+          break;
+        }
+      }
+    }
+
+    coap_pool_free(t, sizeof(coap_transaction_t));
   }
 }
 
+void
+coap_complete_transaction(coap_transaction_t *t)
+{
+  coap_peer_t *peer = NULL;
+
+  /* CoCoA: strong RTT samples from exchanges without retransmission,
+   * weak ones from exchanges with one or two, measured from the first transmission. */
+  if (t->state==COAP_TRANSACTION_OUTSTANDING && t->retrans_counter<=2 && (peer = coap_get_peer(&t->addr, t->port, 0)))
+  {
+    clock_time_t rtt = clock_time() - t->start;
+
+    if (rtt==0)
+    {
+      rtt = 1;
+    }
+
+    if (t->retrans_counter==0)
+    {
+      peer->rto = (peer->rto + coap_rtt_estimate(&peer->strong_srtt, &peer->strong_rttvar, rtt, 4)) / 2;
+    }
+    else
+    {
+      peer->rto = (3 * peer->rto + coap_rtt_estimate(&peer->weak_srtt, &peer->weak_rttvar, rtt, 1)) / 4;
+    }
+
+    if (peer->rto < COAP_RTO_MIN)
+    {
+      peer->rto = COAP_RTO_MIN;
+    }
+    else if (peer->rto > COAP_RTO_MAX)
+    {
+      peer->rto = COAP_RTO_MAX;
+    }
+    peer->last_update = clock_time();
+
+    PRINTF("RTT %lu ticks (%u retransmissions), RTO %lu ticks\n", (unsigned long)rtt, t->retrans_counter, (unsigned long)peer->rto);
+  }
+
+  coap_clear_transaction(t);
+}
+
 coap_transaction_t *
 coap_get_transaction_by_mid(uint16_t mid)
 {
@@ -189,11 +373,25 @@ coap_check_transactions()
 
   for (t = (coap_transaction_t*)list_head(transactions_list); t; t = t->next)
   {
-    if (etimer_expired(&t->retrans_timer))
+    if (t->state==COAP_TRANSACTION_OUTSTANDING && etimer_expired(&t->retrans_timer))
     {
       ++(t->retrans_counter);
       PRINTF("Retransmitting %u (%u)\n", t->mid, t->retrans_counter);
       coap_send_transaction(t);
     }
+    else if (t->state==COAP_TRANSACTION_QUEUED)
+    {
+      /* Queued again if the peer has no room yet. */
+      t->state = COAP_TRANSACTION_NEW;
+      coap_send_transaction(t);
+    }
   }
 }
+
+clock_time_t
+coap_get_peer_rto(uip_ipaddr_t *addr, uint16_t port)
+{
+  coap_peer_t *peer = coap_get_peer(addr, port, 0);
+
+  return peer ? coap_peer_rto(peer) : COAP_RTO_INITIAL;
+}
@@ -43,11 +43,35 @@
 
 /*
  * The number of concurrent messages that can be stored for retransmission in the transaction layer.
+ * Only sizes the shared pool (er-coap-13-pool.h) together with COAP_MAX_OBSERVERS.
  */
 #ifndef COAP_MAX_OPEN_TRANSACTIONS
 #define COAP_MAX_OPEN_TRANSACTIONS 4 
 #endif /* COAP_MAX_OPEN_TRANSACTIONS */
 
+/*
+ * The number of peers for which an RTO estimate is kept (CoCoA). Peers without
+ * CON messages in flight are replaced least recently used first.
+ */
+#ifndef COAP_MAX_PEERS
+#define COAP_MAX_PEERS 4
+#endif /* COAP_MAX_PEERS */
+
+/*
+ * The number of outstanding CON messages per peer (NSTART). Further CONs to the
+ * same peer are queued until one is acknowledged or times out.
+ */
+#ifndef COAP_MAX_CON_PER_PEER
+#define COAP_MAX_CON_PER_PEER 1
+#endif /* COAP_MAX_CON_PER_PEER */
+
+/* transaction states */
+enum {
+  COAP_TRANSACTION_NEW,
+  COAP_TRANSACTION_QUEUED,      /* CON waiting for the peer's NSTART limit */
+  COAP_TRANSACTION_OUTSTANDING  /* CON sent and waiting for its ACK */
+};
+
 /* container for transactions with message buffer and retransmission info */
 typedef struct coap_transaction {
   struct coap_transaction *next; /* for LIST */
@@ -55,6 +79,9 @@ typedef struct coap_transaction {
   uint16_t mid;
   struct etimer retrans_timer;
   uint8_t retrans_counter;
+  uint8_t state;
+  uint8_t backoff; /* retransmission timeout multiplier, in halves */
+  clock_time_t start; /* first transmission, for RTT samples */
 
   uip_ipaddr_t addr;
   uint16_t port;
@@ -66,13 +93,34 @@ typedef struct coap_transaction {
   uint8_t packet[COAP_MAX_PACKET_SIZE+1]; /* +1 for the terminating '\0' to simply and savely use snprintf(buf, len+1, "", ...) in the resource handler. */
 } coap_transaction_t;
 
+/* RTO estimate of a peer, CoCoA style */
+typedef struct coap_peer {
+  struct coap_peer *next; /* for LIST */
+
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint8_t outstanding;
+
+  clock_time_t rto;
+  clock_time_t last_update;
+  clock_time_t strong_srtt;
+  clock_time_t strong_rttvar;
+  clock_time_t weak_srtt;
+  clock_time_t weak_rttvar;
+} coap_peer_t;
+
 void coap_register_as_transaction_handler();
 
 coap_transaction_t *coap_new_transaction(uint16_t mid, uip_ipaddr_t *addr, uint16_t port);
 void coap_send_transaction(coap_transaction_t *t);
 void coap_clear_transaction(coap_transaction_t *t);
+/* Clears a transaction answered by its peer and updates the peer's RTO estimate. */
+void coap_complete_transaction(coap_transaction_t *t);
 coap_transaction_t *coap_get_transaction_by_mid(uint16_t mid);
 
 void coap_check_transactions();
 
+/* Current retransmission timeout towards a peer, in clock ticks. */
+clock_time_t coap_get_peer_rto(uip_ipaddr_t *addr, uint16_t port);
+
 #endif /* COAP_TRANSACTIONS_H_ */
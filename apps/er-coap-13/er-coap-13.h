@@ -45,6 +45,11 @@
 
 #define COAP_LINK_FORMAT_FILTERING           1
 
+/* Resources listed in /.well-known/core, each takes an index entry. */
+#ifndef COAP_LINK_FORMAT_MAX_LINKS
+#define COAP_LINK_FORMAT_MAX_LINKS           32
+#endif
+
 #define COAP_DEFAULT_PORT                    5683
 
 #ifndef COAP_SERVER_PORT
@@ -85,6 +90,15 @@
 #error "UIP_CONF_BUFFER_SIZE too small for REST_MAX_CHUNK_SIZE"
 #endif
 
+/*
+ * Build responses to requests in place in uip_buf instead of a transaction
+ * buffer. Requests too large to leave room for the response fall back to a
+ * transaction buffer.
+ */
+#ifndef COAP_ZERO_COPY
+#define COAP_ZERO_COPY                1
+#endif /* COAP_ZERO_COPY */
+
 /*
  * Maximum number of failed request attempts before action
  */
@@ -129,6 +143,7 @@ typedef enum {
   VALID_2_03 = 67,                      /* NOT_MODIFIED */
   CHANGED_2_04 = 68,                    /* CHANGED */
   CONTENT_2_05 = 69,                    /* OK */
+  CONTINUE_2_31 = 95,                   /* no equivalent, more Block1 blocks expected */
 
   BAD_REQUEST_4_00 = 128,               /* BAD_REQUEST */
   UNAUTHORIZED_4_01 = 129,              /* UNAUTHORIZED */
@@ -41,6 +41,7 @@
 #include <stdio.h> /*for sprintf in rest_set_header_**/
 
 #include "erbium.h"
+#include "sys/trace.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -58,6 +59,9 @@ PROCESS_NAME(rest_manager_process);
 LIST(restful_services);
 LIST(restful_periodic_services);
 
+/* Changed on every activation, for cached resource data such as discovery. */
+static uint16_t resources_version;
+
 
 void
 rest_init_engine(void)
@@ -88,6 +92,7 @@ rest_activate_resource(resource_t* resource)
   }
 
   list_add(restful_services, resource);
+  ++resources_version;
 }
 
 void
@@ -112,6 +117,12 @@ rest_get_resources(void)
   return restful_services;
 }
 
+uint16_t
+rest_get_resources_version(void)
+{
+  return resources_version;
+}
+
 
 void*
 rest_get_user_data(resource_t* resource)
@@ -175,7 +186,9 @@ rest_invoke_restful_service(void* request, void* response, uint8_t *buffer, uint
         if (!resource->pre_handler || resource->pre_handler(resource, request, response))
         {
           /* call handler function*/
+          TRACE_BEGIN(TRACE_ID_COAP, method);
           resource->handler(request, response, buffer, buffer_size, offset);
+          TRACE_END(TRACE_ID_COAP, method);
 
           /*call post handler if it exists*/
           if (resource->post_handler)
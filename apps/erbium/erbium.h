@@ -317,6 +317,11 @@ int rest_invoke_restful_service(void* request, void* response, uint8_t *buffer,
  */
 list_t rest_get_resources(void);
 
+/*
+ * Returns a number that changes whenever a resource is activated
+ */
+uint16_t rest_get_resources_version(void);
+
 /*
  * Getter and setter methods for user specific data.
  */
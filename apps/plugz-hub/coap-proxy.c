@@ -0,0 +1,444 @@
+/**
+ * \file
+ *      Caching CoAP forward proxy of the uHub
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/uiplib.h"
+
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "coap-proxy.h"
+#if !PLUGZ_HUB_CONF_SPLIT
+#include "slip-bridge.h"
+#endif
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define UIP_UDP_PAYLOAD  ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+
+#define PROXY_EMPTY    0
+#define PROXY_PENDING  1 /* The upstream request is in flight */
+#define PROXY_VALID    2 /* Fresh until expires, then revalidated */
+
+/* What a cached response is for */
+struct proxy_key {
+  uip_ipaddr_t addr;
+  uint16_t port;        /* Network byte order */
+  uint16_t block2_size; /* 0 without Block2 */
+  uint32_t block2_num;
+  uint8_t uri_len;
+  char uri[COAP_PROXY_URI_LEN]; /* path\0query\0 */
+};
+
+struct proxy_entry {
+  struct proxy_key key;
+  uint8_t state;
+  uint8_t stored;       /* A response is cached, maybe stale */
+  clock_time_t used;
+  unsigned long expires;
+
+  uint8_t code;
+  uint8_t has_block2;
+  uint8_t block2_more;
+  uint16_t block2_size;
+  uint32_t block2_num;
+  int content_type;     /* -1 without Content-Format */
+  uint8_t etag_len;
+  uint8_t etag[COAP_ETAG_LEN];
+  uint16_t payload_len;
+  uint8_t payload[COAP_PROXY_PAYLOAD_SIZE];
+};
+
+/* A client waiting for an upstream response */
+struct proxy_client {
+  struct proxy_entry *entry;
+  coap_separate_t separate;
+};
+
+static struct proxy_entry entries[COAP_PROXY_ENTRIES];
+static struct proxy_client clients[COAP_PROXY_CLIENTS];
+static struct proxy_key request_key;
+
+/*---------------------------------------------------------------------------*/
+/*
+ * coap://[addr]:port/path?query
+ */
+static int
+proxy_parse_uri(const char *uri, int len, struct proxy_key *key)
+{
+  const char *end = uri + len;
+  const char *p;
+  const char *query;
+  char addr[40];
+  uint32_t port = 0;
+  int path_len;
+  int query_len;
+
+  if(len < 9 || strncmp(uri, "coap://[", 8) != 0) {
+    return 0;
+  }
+  uri += 8;
+  if((p = memchr(uri, ']', end - uri)) == NULL || p - uri >= sizeof(addr)) {
+    return 0;
+  }
+  memcpy(addr, uri, p - uri);
+  addr[p - uri] = '\0';
+  if(!uiplib_ip6addrconv(addr, &key->addr)) {
+    return 0;
+  }
+
+  if(++p < end && *p == ':') {
+    for(++p; p < end && *p >= '0' && *p <= '9' && port <= 0xffff; ++p) {
+      port = port * 10 + *p - '0';
+    }
+    if(port == 0 || port > 0xffff) {
+      return 0;
+    }
+  } else {
+    port = COAP_DEFAULT_PORT;
+  }
+  key->port = UIP_HTONS(port);
+
+  if(p < end && *p == '/') {
+    ++p;
+  } else if(p < end && *p != '?') {
+    return 0;
+  }
+  if((query = memchr(p, '?', end - p)) != NULL) {
+    path_len = query - p;
+    query_len = end - ++query;
+  } else {
+    path_len = end - p;
+    query_len = 0;
+  }
+  if(path_len + query_len + 2 > COAP_PROXY_URI_LEN) {
+    return 0;
+  }
+  memcpy(key->uri, p, path_len);
+  key->uri[path_len] = '\0';
+  memcpy(key->uri + path_len + 1, query, query_len);
+  key->uri[path_len + 1 + query_len] = '\0';
+  key->uri_len = path_len + query_len + 2;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+proxy_key_cmp(const struct proxy_key *a, const struct proxy_key *b)
+{
+  return uip_ipaddr_cmp(&a->addr, &b->addr) && a->port == b->port
+    && a->block2_num == b->block2_num && a->block2_size == b->block2_size
+    && a->uri_len == b->uri_len && memcmp(a->uri, b->uri, a->uri_len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * The entry of key, or one to reuse: an empty one or else the least
+ * recently used that is not pending.
+ */
+static struct proxy_entry *
+proxy_lookup(const struct proxy_key *key)
+{
+  struct proxy_entry *e;
+  struct proxy_entry *victim = NULL;
+
+  for(e = entries; e < entries + COAP_PROXY_ENTRIES; e++) {
+    if(e->state != PROXY_EMPTY && proxy_key_cmp(&e->key, key)) {
+      return e;
+    }
+  }
+  for(e = entries; e < entries + COAP_PROXY_ENTRIES; e++) {
+    if(e->state == PROXY_EMPTY) {
+      return e;
+    }
+    if(e->state == PROXY_VALID
+       && (victim == NULL || (long)(e->used - victim->used) < 0)) {
+      victim = e;
+    }
+  }
+  return victim;
+}
+/*---------------------------------------------------------------------------*/
+static void
+proxy_set_response(struct proxy_entry *e, coap_packet_t *response)
+{
+  unsigned long now = clock_seconds();
+
+  if(e->content_type >= 0) {
+    coap_set_header_content_type(response, e->content_type);
+  }
+  if(e->etag_len > 0) {
+    coap_set_header_etag(response, e->etag, e->etag_len);
+  }
+  coap_set_header_max_age(response, e->expires > now ? e->expires - now : 0);
+  if(e->has_block2) {
+    coap_set_header_block2(response, e->block2_num, e->block2_more, e->block2_size);
+  }
+  coap_set_payload(response, e->payload, e->payload_len);
+}
+/*---------------------------------------------------------------------------*/
+static void
+proxy_send_separate(coap_packet_t *response, coap_separate_t *separate)
+{
+  coap_transaction_t *t;
+
+  if(separate->type == COAP_TYPE_CON
+     && (t = coap_new_transaction(separate->mid, &separate->addr, separate->port)) != NULL) {
+    t->packet_len = coap_serialize_message(response, t->packet);
+    coap_send_transaction(t);
+  } else {
+    /* NON, or no transaction buffer left: sent once */
+    coap_send_message(&separate->addr, separate->port, UIP_UDP_PAYLOAD,
+                      coap_serialize_message(response, UIP_UDP_PAYLOAD));
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Answers the clients waiting for e with its response, or with code.
+ */
+static void
+proxy_resume(struct proxy_entry *e, uint8_t code)
+{
+  static coap_packet_t response[1];
+  struct proxy_client *c;
+
+  for(c = clients; c < clients + COAP_PROXY_CLIENTS; c++) {
+    if(c->entry != e) {
+      continue;
+    }
+    c->entry = NULL;
+
+    coap_separate_resume(response, &c->separate, code ? code : e->code);
+    if(code == 0) {
+      proxy_set_response(e, response);
+    }
+    proxy_send_separate(response, &c->separate);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+proxy_response_handler(void *data, void *packet)
+{
+  struct proxy_entry *e = (struct proxy_entry *)data;
+  coap_packet_t *const response = (coap_packet_t *)packet;
+  const uint8_t *etag = NULL;
+  const uint8_t *payload = NULL;
+  uint32_t max_age;
+  int len;
+
+  if(response == NULL || response->code < CREATED_2_01) {
+    /* Timeout, or an empty ACK: separate responses are not followed */
+    PRINTF("Proxy: upstream timeout\n");
+    e->state = e->stored ? PROXY_VALID : PROXY_EMPTY;
+    proxy_resume(e, GATEWAY_TIMEOUT_5_04);
+    return;
+  }
+
+  /* Keep everything before answering, the clients' messages go through uip_buf. */
+  coap_get_header_max_age(response, &max_age);
+  if(response->code == VALID_2_03 && e->stored) {
+    PRINTF("Proxy: revalidated\n");
+  } else if((len = coap_get_payload(response, &payload)) > COAP_PROXY_PAYLOAD_SIZE) {
+    e->state = PROXY_EMPTY;
+    e->stored = 0;
+    proxy_resume(e, BAD_GATEWAY_5_02);
+    return;
+  } else {
+    e->code = response->code;
+    e->content_type = IS_OPTION(response, COAP_OPTION_CONTENT_TYPE) ? (int)response->content_type : -1;
+    if((e->etag_len = coap_get_header_etag(response, &etag)) > 0) {
+      memcpy(e->etag, etag, e->etag_len);
+    }
+    e->has_block2 = coap_get_header_block2(response, &e->block2_num, &e->block2_more, &e->block2_size, NULL);
+    memcpy(e->payload, payload, len);
+    e->payload_len = len;
+    e->stored = 1;
+  }
+  e->expires = clock_seconds() + max_age;
+  e->state = PROXY_VALID;
+
+  proxy_resume(e, 0);
+}
+/*---------------------------------------------------------------------------*/
+static int
+proxy_forward(struct proxy_entry *e)
+{
+  static coap_packet_t request[1];
+  coap_transaction_t *t;
+  const char *query = e->key.uri + strlen(e->key.uri) + 1;
+
+  if((t = coap_new_transaction(coap_get_mid(), &e->key.addr, e->key.port)) == NULL) {
+    return 0;
+  }
+  t->callback = proxy_response_handler;
+  t->callback_data = e;
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, t->mid);
+  coap_set_header_uri_path(request, e->key.uri);
+  if(*query != '\0') {
+    coap_set_header_uri_query(request, query);
+  }
+  if(e->key.block2_size) {
+    coap_set_header_block2(request, e->key.block2_num, 0, e->key.block2_size);
+  }
+  if(e->stored && e->etag_len > 0) {
+    /* Revalidate */
+    coap_set_header_etag(request, e->etag, e->etag_len);
+  }
+  t->packet_len = coap_serialize_message(request, t->packet);
+  coap_send_transaction(t);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * A request to a multicast group is sent once as NON. Members do not
+ * respond, so the client gets 2.04 as soon as it is sent.
+ */
+static void
+proxy_group(coap_packet_t *coap_req, void *response)
+{
+  static coap_packet_t request[1];
+  static coap_packet_t reply[1];
+  static uint8_t payload[COAP_PROXY_PAYLOAD_SIZE];
+  static coap_separate_t separate;
+  const char *query = request_key.uri + strlen(request_key.uri) + 1;
+  const uint8_t *data = NULL;
+  int len;
+
+  if(coap_req->code == COAP_GET) {
+    coap_set_status_code(response, METHOD_NOT_ALLOWED_4_05);
+    coap_set_payload(response, "NoGroupGet", 10);
+    return;
+  }
+  if((len = coap_get_payload(coap_req, &data)) > sizeof(payload)) {
+    coap_set_status_code(response, REQUEST_ENTITY_TOO_LARGE_4_13);
+    return;
+  }
+
+  /* Copied before the separate ACK and the group request overwrite uip_buf. */
+  memcpy(payload, data, len);
+  coap_init_message(request, COAP_TYPE_NON, coap_req->code, coap_get_mid());
+  if(IS_OPTION(coap_req, COAP_OPTION_CONTENT_TYPE)) {
+    coap_set_header_content_type(request, coap_req->content_type);
+  }
+  coap_set_header_uri_path(request, request_key.uri);
+  if(*query != '\0') {
+    coap_set_header_uri_query(request, query);
+  }
+  coap_set_payload(request, payload, len);
+  coap_separate_accept(coap_req, &separate);
+
+  PRINTF("Proxy: group %s\n", request_key.uri);
+  coap_send_message(&request_key.addr, request_key.port, UIP_UDP_PAYLOAD,
+                    coap_serialize_message(request, UIP_UDP_PAYLOAD));
+
+  coap_separate_resume(reply, &separate, CHANGED_2_04);
+  proxy_send_separate(reply, &separate);
+}
+/*---------------------------------------------------------------------------*/
+static int
+proxy_callback(void *request, void *response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  coap_packet_t *const coap_req = (coap_packet_t *)request;
+  struct proxy_entry *e;
+  struct proxy_client *c;
+  const char *uri = NULL;
+  const uint8_t *etag = NULL;
+  int len;
+
+  len = coap_get_header_proxy_uri(request, &uri);
+  if(!coap_get_header_block2(request, &request_key.block2_num, NULL, &request_key.block2_size, NULL)) {
+    request_key.block2_num = 0;
+    request_key.block2_size = 0;
+  }
+  if(!proxy_parse_uri(uri, len, &request_key)) {
+    coap_set_status_code(response, BAD_REQUEST_4_00);
+    coap_set_payload(response, "BadProxyUri", 11);
+    return 1;
+  }
+  if(uip_is_addr_mcast(&request_key.addr)) {
+    proxy_group(coap_req, response);
+    return 1;
+  }
+  if(coap_req->code != COAP_GET) {
+    coap_set_status_code(response, PROXYING_NOT_SUPPORTED_5_05);
+    coap_set_payload(response, "OnlyGet", 7);
+    return 1;
+  }
+
+  if((e = proxy_lookup(&request_key)) == NULL) {
+    coap_set_status_code(response, SERVICE_UNAVAILABLE_5_03);
+    coap_set_payload(response, "ProxyBusy", 9);
+    return 1;
+  }
+  e->used = clock_time();
+
+  if(e->state == PROXY_VALID && clock_seconds() < e->expires && proxy_key_cmp(&e->key, &request_key)) {
+    PRINTF("Proxy: hit %s\n", e->key.uri);
+    if((len = coap_get_header_etag(request, &etag)) > 0 && len == e->etag_len
+       && memcmp(etag, e->etag, len) == 0 && e->code == CONTENT_2_05) {
+      coap_set_status_code(response, VALID_2_03);
+      coap_set_header_etag(response, e->etag, e->etag_len);
+      coap_set_header_max_age(response, e->expires - clock_seconds());
+    } else {
+      coap_set_status_code(response, e->code);
+      proxy_set_response(e, response);
+    }
+    return 1;
+  }
+
+  for(c = clients; c < clients + COAP_PROXY_CLIENTS && c->entry != NULL; c++);
+  if(c == clients + COAP_PROXY_CLIENTS) {
+    coap_set_status_code(response, SERVICE_UNAVAILABLE_5_03);
+    coap_set_payload(response, "ProxyBusy", 9);
+    return 1;
+  }
+
+  if(e->state == PROXY_PENDING) {
+    /* Coalesced with the request in flight */
+    PRINTF("Proxy: waiting for %s\n", e->key.uri);
+    c->entry = e;
+    coap_separate_accept(request, &c->separate);
+    return 1;
+  }
+
+#if !PLUGZ_HUB_CONF_SPLIT
+  if(slip_bridge_congested()) {
+    /* The responses already queued for the host go first */
+    coap_set_status_code(response, SERVICE_UNAVAILABLE_5_03);
+    coap_set_header_max_age(response, 1);
+    coap_set_payload(response, "UplinkBusy", 10);
+    return 1;
+  }
+#endif
+
+  if(!proxy_key_cmp(&e->key, &request_key)) {
+    memcpy(&e->key, &request_key, sizeof(request_key));
+    e->stored = 0;
+  }
+  PRINTF("Proxy: %s %s\n", e->stored ? "revalidate" : "miss", e->key.uri);
+  e->state = PROXY_PENDING;
+  c->entry = e;
+  /* The separate ACK overwrites the request in uip_buf, the key is a copy. */
+  coap_separate_accept(request, &c->separate);
+  if(!proxy_forward(e)) {
+    e->state = e->stored ? PROXY_VALID : PROXY_EMPTY;
+    proxy_resume(e, SERVICE_UNAVAILABLE_5_03);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+coap_proxy_init(void)
+{
+  coap_set_proxy_callback(proxy_callback);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,56 @@
+/**
+ * \file
+ *      Caching CoAP forward proxy of the uHub
+ *
+ *      GET requests with a Proxy-Uri coap://[addr]:port/path?query are
+ *      forwarded to the node and the response is cached for its Max-Age,
+ *      one entry per resource and block. Requests for a resource that is
+ *      already being fetched wait for that response instead of sending
+ *      their own, and stale entries are revalidated with their ETag, so
+ *      that the mesh carries a request per resource and Max-Age rather
+ *      than per client.
+ *
+ *      PUT, POST and DELETE to a multicast group, e.g.
+ *      coap://[ff0e::fd]/scn/3, are sent once into the mesh as NON and
+ *      answered with 2.04, as group members do not respond.
+ */
+
+#ifndef COAP_PROXY_H_
+#define COAP_PROXY_H_
+
+#include "contiki-conf.h"
+
+#ifdef COAP_PROXY_CONF_ENTRIES
+#define COAP_PROXY_ENTRIES       COAP_PROXY_CONF_ENTRIES
+#else
+#define COAP_PROXY_ENTRIES       8
+#endif
+
+/* Clients waiting for an upstream response, over all entries */
+#ifdef COAP_PROXY_CONF_CLIENTS
+#define COAP_PROXY_CLIENTS       COAP_PROXY_CONF_CLIENTS
+#else
+#define COAP_PROXY_CLIENTS       8
+#endif
+
+/* Path and query of a proxied resource */
+#ifdef COAP_PROXY_CONF_URI_LEN
+#define COAP_PROXY_URI_LEN       COAP_PROXY_CONF_URI_LEN
+#else
+#define COAP_PROXY_URI_LEN       48
+#endif
+
+/* Payload of a cached response, a block of the nodes. Larger ones are
+   answered with 5.02. */
+#ifdef COAP_PROXY_CONF_PAYLOAD_SIZE
+#define COAP_PROXY_PAYLOAD_SIZE  COAP_PROXY_CONF_PAYLOAD_SIZE
+#else
+#define COAP_PROXY_PAYLOAD_SIZE  REST_MAX_CHUNK_SIZE
+#endif
+
+/**
+ * \brief Handle the requests with a Proxy-Uri. Call after rest_init_engine().
+ */
+void coap_proxy_init(void);
+
+#endif /* COAP_PROXY_H_ */
@@ -0,0 +1,90 @@
+/**
+ * \file
+ *      Host half of the split uHub, what border-router.c provides to the
+ *      native-border-router sources
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/uiplib.h"
+#include "net/rpl/rpl.h"
+#include "cmd.h"
+#include "border-router.h"
+#include "border-router-cmds.h"
+#include "hub-host.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern long slip_sent;
+extern long slip_received;
+
+extern int contiki_argc;
+extern char **contiki_argv;
+extern const char *slip_config_ipaddr;
+
+static uint8_t mac_set;
+
+CMD_HANDLERS(border_router_cmd_handler);
+
+/*---------------------------------------------------------------------------*/
+void
+border_router_set_mac(const uint8_t *data)
+{
+  memcpy(uip_lladdr.addr, data, sizeof(uip_lladdr.addr));
+  linkaddr_set_node_addr((linkaddr_t *)uip_lladdr.addr);
+
+  /* The link-local address and the RPL state depend on it */
+  uip_ds6_init();
+  rpl_init();
+
+  mac_set = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+border_router_set_sensors(const char *data, int len)
+{
+  /* slip-radio on the cc2538 has no sensors */
+}
+/*---------------------------------------------------------------------------*/
+void
+border_router_print_stat(void)
+{
+  printf("bytes received over SLIP: %ld\n", slip_received);
+  printf("bytes sent over SLIP: %ld\n", slip_sent);
+}
+/*---------------------------------------------------------------------------*/
+void
+hub_host_init(void)
+{
+  slip_config_handle_arguments(contiki_argc, contiki_argv);
+
+  /* tun init is also responsible for setting up the SLIP connection */
+  tun_init();
+
+  process_start(&border_router_cmd_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+hub_host_request_mac(void)
+{
+  write_to_slip((uint8_t *)"?M", 2);
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+hub_host_mac_set(void)
+{
+  return mac_set;
+}
+/*---------------------------------------------------------------------------*/
+int
+hub_host_get_prefix(uip_ipaddr_t *prefix)
+{
+  if(slip_config_ipaddr == NULL ||
+     !uiplib_ipaddrconv(slip_config_ipaddr, prefix)) {
+    return 0;
+  }
+  memset(&prefix->u8[8], 0, 8);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,38 @@
+/**
+ * \file
+ *      Host half of the split uHub (make SPLIT=1 TARGET=native)
+ *
+ *      The uHub runs as a Linux process on top of native-border-router:
+ *      the 802.15.4 frames go over SLIP to the cc2538 running slip-radio,
+ *      or to a simulated radio, and the IP traffic to a tun interface.
+ *      The radio half owns the MAC address, the prefix is the one given
+ *      on the command line.
+ */
+
+#ifndef HUB_HOST_H_
+#define HUB_HOST_H_
+
+#include "contiki.h"
+#include "net/ip/uip.h"
+
+/**
+ * \brief Handle the command line, open the tun interface and the SLIP
+ *        line to the radio.
+ */
+void hub_host_init(void);
+
+/**
+ * \brief Ask the radio for its MAC address, repeat until
+ *        hub_host_mac_set() is true.
+ */
+void hub_host_request_mac(void);
+
+uint8_t hub_host_mac_set(void);
+
+/**
+ * \brief The /64 prefix of the command line, interface identifier cleared
+ * \return 0 if it can not be parsed
+ */
+int hub_host_get_prefix(uip_ipaddr_t *prefix);
+
+#endif /* HUB_HOST_H_ */
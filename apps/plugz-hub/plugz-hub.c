@@ -9,6 +9,7 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl.h"
+#include "net/ipv6/sicslowpan.h"
 
 #include "net/netstack.h"
 #include "dev/button-sensor.h"
@@ -21,6 +22,14 @@
 #include <ctype.h>
 #include "erbium.h"
 #include "rplinfo.h"
+#include "resource-directory.h"
+#include "coap-proxy.h"
+#if PLUGZ_HUB_CONF_SPLIT
+#include "hub-host.h"
+#endif
+#if PLUGZ_HUB_CONF_TSCH
+#include "net/mac/tsch/tsch.h"
+#endif
 
 #define DEBUG DEBUG_PRINT
 #include "net/ip/uip-debug.h"
@@ -31,12 +40,30 @@
 #define LEDS_DEFRT_RM  (LEDS_RED | LEDS_YELLOW)
 #define LEDS_ON_DELAY  (RTIMER_SECOND >> 1)
 
-uint16_t dag_id[] = {0x1111, 0x1100, 0, 0, 0, 0, 0, 0x0011};
-
 static uip_ipaddr_t prefix;
 static uint8_t prefix_set;
 static struct rtimer rt_dels;
 
+/* The delegated prefix is advertised as this 6LoWPAN context. It is
+   announced for decompression only at first and used for compression
+   once the nodes have had the time to learn it from our DIOs.
+
+   When the prefix changes, the context ID is not rebound right away:
+   a node that still holds the old mapping would decompress into the
+   wrong prefix. The old mapping is advertised decompress-only until
+   every node's copy of it has expired (RFC 6775, section 7.2), and
+   only then is the ID announced again with the new prefix. */
+#define PREFIX_CONTEXT        1
+#define PREFIX_CONTEXT_DELAY  (60 * CLOCK_SECOND)
+#define PREFIX_CONTEXT_RETIRE ((SICSLOWPAN_CONTEXT_LIFETIME + 1) * 60 * CLOCK_SECOND)
+static struct ctimer context_timer;
+
+#define CONTEXT_NONE      0
+#define CONTEXT_LEARNING  1
+#define CONTEXT_COMPRESS  2
+#define CONTEXT_RETIRING  3
+static uint8_t context_state;
+
 PROCESS(border_router_process, "uHub Border Router process");
 
 AUTOSTART_PROCESSES(&border_router_process);
@@ -59,6 +86,7 @@ print_local_addresses(void)
   }
 }
 
+#if !PLUGZ_HUB_CONF_SPLIT
 void
 request_prefix(void)
 {
@@ -69,16 +97,56 @@ request_prefix(void)
   slip_send();
   uip_len = 0;
 }
+#endif /* !PLUGZ_HUB_CONF_SPLIT */
+
+static void
+context_compress(void *ptr)
+{
+  sicslowpan_context_set(PREFIX_CONTEXT, &prefix, SICSLOWPAN_CONTEXT_INFINITE,
+                         SICSLOWPAN_CONTEXT_COMPRESS);
+  context_state = CONTEXT_COMPRESS;
+}
+
+static void
+context_announce(void *ptr)
+{
+  if(sicslowpan_context_set(PREFIX_CONTEXT, &prefix,
+                            SICSLOWPAN_CONTEXT_INFINITE, 0)) {
+    context_state = CONTEXT_LEARNING;
+    ctimer_set(&context_timer, PREFIX_CONTEXT_DELAY, context_compress, NULL);
+  } else {
+    context_state = CONTEXT_NONE;
+  }
+}
 
 void
 set_prefix_64(uip_ipaddr_t *prefix_64)
 {
   uip_ipaddr_t ipaddr;
+  uint8_t changed;
+  changed = !prefix_set || !uip_ipaddr_prefixcmp(&prefix, prefix_64, 64);
+
+  if(changed && context_state == CONTEXT_COMPRESS) {
+    /* Retire the old mapping, it now ages out like a learnt one */
+    sicslowpan_context_set(PREFIX_CONTEXT, &prefix,
+                           SICSLOWPAN_CONTEXT_LIFETIME, 0);
+    context_state = CONTEXT_RETIRING;
+    ctimer_set(&context_timer, PREFIX_CONTEXT_RETIRE, context_announce, NULL);
+  }
+
   memcpy(&prefix, prefix_64, 16);
   memcpy(&ipaddr, prefix_64, 16);
   prefix_set = 1;
   uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
   uip_ds6_addr_add(&ipaddr, 0, ADDR_AUTOCONF);
+
+  /* While retiring, the new prefix is announced once the retirement is
+     over. A decompress-only mapping is used by nobody to compress, so
+     it may be rebound at once. */
+  if(changed && context_state != CONTEXT_RETIRING) {
+    ctimer_stop(&context_timer);
+    context_announce(NULL);
+  }
 }
 
 /*
@@ -137,6 +205,7 @@ PROCESS_THREAD(border_router_process, ev, data)
 {
   static struct etimer et;
   rpl_dag_t *dag;
+  uip_ipaddr_t dag_id;
   static struct uip_ds6_notification ds6_notification_node;
 
   PROCESS_BEGIN();
@@ -153,14 +222,33 @@ PROCESS_THREAD(border_router_process, ev, data)
 
   PRINTF("Starting uHub (%s %s)\n", __DATE__, __TIME__);
 
+#if PLUGZ_HUB_CONF_SPLIT
+  /* The radio half has the MAC address, the prefix is on the command line */
+  hub_host_init();
+  while(!hub_host_mac_set()) {
+    etimer_set(&et, CLOCK_SECOND);
+    hub_host_request_mac();
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  }
+  if(!hub_host_get_prefix(&dag_id)) {
+    PRINTA("Cannot parse the prefix\n");
+    exit(1);
+  }
+  set_prefix_64(&dag_id);
+#else
   /* Request prefix until it has been received */
   while(!prefix_set) {
     etimer_set(&et, CLOCK_SECOND);
     request_prefix();
     PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
   }
+#endif
 
-  dag = rpl_set_root(RPL_DEFAULT_INSTANCE,(uip_ip6addr_t *)dag_id);
+  /* Our global address is the DODAG ID, the nodes find the resource
+     directory there. */
+  memcpy(&dag_id, &prefix, sizeof(dag_id));
+  uip_ds6_set_addr_iid(&dag_id, &uip_lladdr);
+  dag = rpl_set_root(RPL_DEFAULT_INSTANCE, &dag_id);
   if(dag != NULL) {
     rpl_set_prefix(dag, &prefix, 64);
     PRINTF("created a new RPL dag\n");
@@ -171,10 +259,17 @@ PROCESS_THREAD(border_router_process, ev, data)
    */
   NETSTACK_MAC.off(1);
 
+#if PLUGZ_HUB_CONF_TSCH && !PLUGZ_HUB_CONF_SPLIT
+  /* The root sets the timeslots the nodes join */
+  tsch_set_coordinator(1);
+#endif
+
   rest_init_engine();
 
   print_local_addresses();
   rplinfo_activate_resources();
+  resource_directory_activate_resources();
+  coap_proxy_init();
 
   /* Register router add/delete notifications so that we can find new devices
    * that being discovered.
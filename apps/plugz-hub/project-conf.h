@@ -1,10 +1,95 @@
 #ifndef __PROJECT_UHUB_CONF_H__
 #define __PROJECT_UHUB_CONF_H__
 
+#if PLUGZ_HUB_CONF_TSCH && !CONTIKI_TARGET_NATIVE
+#undef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC           tsch_driver
+#if PLUGZ_HUB_CONF_SPLIT
+/* The radio half starts the TSCH network from the sensor hook */
+#define SLIP_RADIO_CONF_SENSORS     slip_radio_tsch
+#endif
+#endif /* PLUGZ_HUB_CONF_TSCH && !CONTIKI_TARGET_NATIVE */
+
+#if PLUGZ_HUB_CONF_SPLIT && !CONTIKI_TARGET_NATIVE
+/* Radio half of the split hub (make SPLIT=1): slip-radio with nothing but
+   the radio, ACKs and RDC, the frames go to the host as they are. */
+#undef UIP_CONF_IPV6_RPL
+#define UIP_CONF_IPV6_RPL           0
+
+#undef UIP_CONF_ROUTER
+#define UIP_CONF_ROUTER             0
+
+#undef UIP_CONF_BUFFER_SIZE
+#define UIP_CONF_BUFFER_SIZE        140
+
+#undef QUEUEBUF_CONF_NUM
+#define QUEUEBUF_CONF_NUM           4
+
+#define CMD_CONF_OUTPUT             slip_radio_cmd_output
+#define CMD_CONF_HANDLERS           slip_radio_cmd_handler,cmd_handler_cc2538
+
+#undef NETSTACK_CONF_MAC
+#define NETSTACK_CONF_MAC           nullmac_driver
+
+#undef NETSTACK_CONF_NETWORK
+#define NETSTACK_CONF_NETWORK       slipnet_driver
+
+#undef NETSTACK_CONF_FRAMER
+#define NETSTACK_CONF_FRAMER        no_framer
+
+#ifndef UART0_CONF_TX_BUF_SIZE
+#define UART0_CONF_TX_BUF_SIZE      512
+#endif
+
+#else /* PLUGZ_HUB_CONF_SPLIT && !CONTIKI_TARGET_NATIVE */
+
+#if PLUGZ_HUB_CONF_SPLIT
+/* Host half of the split hub: sicslowpan, the RPL root, the resource
+   directory and the proxy run in a Linux process, the frames go to the
+   radio over SLIP (native-border-router). Tables are sized for a
+   building rather than for the RAM of the cc2538. */
+#define SLIP_DEV_CONF_SEND_DELAY    (CLOCK_SECOND / 32)
+#define SERIALIZE_ATTRIBUTES        1
+#define CMD_CONF_OUTPUT             border_router_cmd_output
+#define SELECT_CALLBACK             1
+
+#undef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC           border_router_rdc_driver
+
+#undef UIP_CONF_BUFFER_SIZE
+#define UIP_CONF_BUFFER_SIZE        1280
+
+#undef QUEUEBUF_CONF_NUM
+#define QUEUEBUF_CONF_NUM           16
+
+#undef NBR_TABLE_CONF_MAX_NEIGHBORS
+/* 200 neighbors, plus one entry for the CSMA broadcast queue */
+#define NBR_TABLE_CONF_MAX_NEIGHBORS 201
+#undef UIP_CONF_MAX_ROUTES
+#define UIP_CONF_MAX_ROUTES         4096
+
+/* The RD keeps uint8_t indexes, RD_NO_LINKS is 0xff */
+#define RD_CONF_MAX_ENDPOINTS       250
+#define RD_CONF_MAX_LINK_SETS       64
+#define RD_CONF_LINKS_SIZE          32768
+
+#define COAP_PROXY_CONF_ENTRIES     128
+#define COAP_PROXY_CONF_CLIENTS     64
+#define COAP_MAX_OPEN_TRANSACTIONS  64
+#define COAP_MAX_OBSERVERS          128
+#define COAP_MAX_PEERS              32
+#endif /* PLUGZ_HUB_CONF_SPLIT */
+
 #ifndef UIP_FALLBACK_INTERFACE
 #define UIP_FALLBACK_INTERFACE      rpl_interface
 #endif
 
+/* CoAP transactions, proxy entries and RD lifetimes add up to many
+   event timers, kept in a heap rather than a list */
+#ifndef ETIMER_CONF_HEAP
+#define ETIMER_CONF_HEAP            1
+#endif
+
 #ifndef UIP_CONF_BUFFER_SIZE
 #define UIP_CONF_BUFFER_SIZE        1280
 #endif
@@ -12,4 +97,38 @@
 #undef REST_MAX_CHUNK_SIZE
 #define REST_MAX_CHUNK_SIZE         256
 
+/* SLIP over UART0 (astral-cc2538) transmits from a ring buffer drained by the TX interrupt,
+   the CPU hands over most of a 1280 byte packet at once instead of waiting
+   ~110 ms at 115200 baud. */
+#ifndef UART0_CONF_TX_BUF_SIZE
+#define UART0_CONF_TX_BUF_SIZE      1024
+#endif
+
+/* With SLIP over USB (TARGET=plugz-hub, or SLIP_USB=1 on astral-cc2538),
+   bulk transfers of four packets. Packets for the host wait in the SLIP
+   bridge's queues while both are with the controller. */
+#ifndef USB_SERIAL_CONF_TX_BUF_SIZE
+#define USB_SERIAL_CONF_TX_BUF_SIZE 256
+#endif
+
+/* Room for a second full frame from the host while the first one is
+   being routed */
+#ifndef SLIP_CONF_RX_BUFSIZE
+#define SLIP_CONF_RX_BUFSIZE        (2 * UIP_CONF_BUFFER_SIZE + 16)
+#endif
+
+/* Room for the link formats of Aura, Norma and Mira */
+#ifndef RD_CONF_LINKS_SIZE
+#define RD_CONF_LINKS_SIZE          6144
+#endif
+
+/* Group requests of the proxy are forwarded down the DODAG by SMRF,
+   the DODAG then runs in storing mode with multicast (MOP 3). */
+#include "net/ipv6/multicast/uip-mcast6-engines.h"
+#ifndef UIP_MCAST6_CONF_ENGINE
+#define UIP_MCAST6_CONF_ENGINE      UIP_MCAST6_ENGINE_SMRF
+#endif
+
+#endif /* PLUGZ_HUB_CONF_SPLIT && !CONTIKI_TARGET_NATIVE */
+
 #endif /* __PROJECT_UHUB_CONF_H__ */
@@ -0,0 +1,556 @@
+/**
+ * \file
+ *      CoRE Resource Directory of the uHub
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "lib/crc16.h"
+
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "rplinfo.h"
+#include "resource-directory.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define RD_NO_LINKS  0xff
+
+/* A link-format document, shared by the endpoints that registered it */
+struct rd_links {
+  uint16_t offset;
+  uint16_t len;
+  uint16_t crc;
+  uint8_t refs;
+};
+
+/* A registration, free when ep is empty. Its location is rd/<index>. */
+struct rd_endpoint {
+  uip_ipaddr_t addr;
+  unsigned long expires;
+  char ep[RD_EP_LEN];
+  char et[RD_ET_LEN];
+  uint8_t links;
+};
+
+/* A lookup response, sliced to the requested block */
+struct rd_output {
+  uint8_t *buffer;
+  size_t size;
+  size_t offset;
+  size_t strpos;
+  size_t bufpos;
+};
+
+static struct rd_endpoint endpoints[RD_MAX_ENDPOINTS];
+static struct rd_links link_sets[RD_MAX_LINK_SETS];
+
+/* The documents are packed at the start of links_buffer, a block-wise
+   upload is received right after them. */
+static char links_buffer[RD_LINKS_SIZE];
+static uint16_t links_used;
+
+static struct {
+  uip_ipaddr_t addr;
+  unsigned long started;
+  uint16_t len;
+  uint8_t active;
+} upload;
+
+static char location[8];
+
+/*---------------------------------------------------------------------------*/
+static long
+rd_parse_number(const char *s, int len)
+{
+  long n = 0;
+
+  if(len <= 0 || len > 9) {
+    return -1;
+  }
+  while(len-- > 0) {
+    if(*s < '0' || *s > '9') {
+      return -1;
+    }
+    n = n * 10 + *s++ - '0';
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_links_release(uint8_t i)
+{
+  struct rd_links *set;
+  uint16_t end;
+  uint8_t j;
+
+  if(i == RD_NO_LINKS || --link_sets[i].refs > 0) {
+    return;
+  }
+  set = &link_sets[i];
+
+  /* Compact, along with an upload in progress */
+  end = set->offset + set->len;
+  memmove(links_buffer + set->offset, links_buffer + end,
+          links_used + (upload.active ? upload.len : 0) - end);
+  links_used -= set->len;
+  for(j = 0; j < RD_MAX_LINK_SETS; j++) {
+    if(link_sets[j].refs > 0 && link_sets[j].offset > set->offset) {
+      link_sets[j].offset -= set->len;
+    }
+  }
+  PRINTF("RD: freed %u bytes of links, %u used\n", set->len, links_used);
+  set->len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Keeps the len bytes uploaded after links_used, unless the same
+ * document is already stored.
+ */
+static uint8_t
+rd_links_intern(uint16_t len)
+{
+  const char *uploaded = links_buffer + links_used;
+  uint16_t crc = crc16_data((const unsigned char *)uploaded, len, 0);
+  uint8_t i;
+  uint8_t free = RD_NO_LINKS;
+
+  for(i = 0; i < RD_MAX_LINK_SETS; i++) {
+    if(link_sets[i].refs == 0) {
+      if(free == RD_NO_LINKS) {
+        free = i;
+      }
+    } else if(link_sets[i].len == len && link_sets[i].crc == crc &&
+              memcmp(links_buffer + link_sets[i].offset, uploaded, len) == 0) {
+      link_sets[i].refs++;
+      return i;
+    }
+  }
+  if(free != RD_NO_LINKS) {
+    link_sets[free].offset = links_used;
+    link_sets[free].len = len;
+    link_sets[free].crc = crc;
+    link_sets[free].refs = 1;
+    links_used += len;
+    PRINTF("RD: new links %u, %u bytes used\n", free, links_used);
+  }
+  return free;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_remove(struct rd_endpoint *e)
+{
+  PRINTF("RD: remove %s\n", e->ep);
+  rd_links_release(e->links);
+  e->links = RD_NO_LINKS;
+  e->ep[0] = '\0';
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_purge(void)
+{
+  unsigned long now = clock_seconds();
+  struct rd_endpoint *e;
+
+  for(e = endpoints; e < endpoints + RD_MAX_ENDPOINTS; e++) {
+    if(e->ep[0] != '\0' && now >= e->expires) {
+      rd_remove(e);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * The registration of ep, or a free one.
+ */
+static struct rd_endpoint *
+rd_find(const char *ep, int len)
+{
+  struct rd_endpoint *e;
+  struct rd_endpoint *free = NULL;
+
+  for(e = endpoints; e < endpoints + RD_MAX_ENDPOINTS; e++) {
+    if(e->ep[0] == '\0') {
+      if(free == NULL) {
+        free = e;
+      }
+    } else if(strncmp(e->ep, ep, len) == 0 && e->ep[len] == '\0') {
+      return e;
+    }
+  }
+  return free;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Receives the links of a registration, block-wise or not. Returns 1
+ * once upload.len bytes are complete after links_used, otherwise the
+ * response is set.
+ */
+static int
+rd_upload(void *request, void *response)
+{
+  const uint8_t *payload = NULL;
+  int len = coap_get_payload(request, &payload);
+  uint32_t num = 0;
+  uint8_t more = 0;
+  uint16_t size = 0;
+  uint32_t offset = 0;
+  int block = coap_get_header_block1(request, &num, &more, &size, &offset);
+
+  if(offset == 0) {
+    if(upload.active && !uip_ipaddr_cmp(&upload.addr, &UIP_IP_BUF->srcipaddr)
+       && clock_seconds() - upload.started < RD_UPLOAD_TIMEOUT) {
+      coap_set_status_code(response, SERVICE_UNAVAILABLE_5_03);
+      coap_set_header_max_age(response, RD_UPLOAD_TIMEOUT);
+      return 0;
+    }
+    uip_ipaddr_copy(&upload.addr, &UIP_IP_BUF->srcipaddr);
+    upload.len = 0;
+    upload.active = 1;
+  } else if(!upload.active || !uip_ipaddr_cmp(&upload.addr, &UIP_IP_BUF->srcipaddr)
+            || (offset != upload.len && offset + len != upload.len)) {
+    coap_set_status_code(response, BAD_REQUEST_4_00);
+    coap_set_payload(response, "BlockOutOfOrder", 15);
+    return 0;
+  }
+
+  if(links_used + offset + len > RD_LINKS_SIZE) {
+    upload.active = 0;
+    coap_set_status_code(response, REQUEST_ENTITY_TOO_LARGE_4_13);
+    return 0;
+  }
+  /* A retransmitted block is only acknowledged again */
+  memcpy(links_buffer + links_used + offset, payload, len);
+  upload.len = offset + len;
+  upload.started = clock_seconds();
+
+  if(block) {
+    coap_set_header_block1(response, num, more, size);
+  }
+  if(more) {
+    coap_set_status_code(response, CONTINUE_2_31);
+    return 0;
+  }
+  upload.active = 0;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+RESOURCE(rd, METHOD_POST | METHOD_DELETE | HAS_SUB_RESOURCES, "rd", "rt=\"core.rd\";ct=40");
+void
+rd_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  const char *url = NULL;
+  const char *ep = NULL;
+  const char *et = NULL;
+  const char *value = NULL;
+  const uint8_t *payload = NULL;
+  struct rd_endpoint *e = NULL;
+  long lifetime = RD_DEFAULT_LIFETIME;
+  long n;
+  int ep_len = 0;
+  int et_len = 0;
+  int len;
+  uint8_t links;
+
+  rd_purge();
+
+  len = REST.get_url(request, &url);
+  if(len > 3 && url[2] == '/') {
+    n = rd_parse_number(url + 3, len - 3);
+    if(n >= 0 && n < RD_MAX_ENDPOINTS && endpoints[n].ep[0] != '\0') {
+      e = &endpoints[n];
+    }
+  }
+  if(e == NULL && len != 2) {
+    REST.set_response_status(response, REST.status.NOT_FOUND);
+    return;
+  }
+
+  if(REST.get_method_type(request) == METHOD_DELETE) {
+    if(e == NULL) {
+      REST.set_response_status(response, REST.status.METHOD_NOT_ALLOWED);
+      return;
+    }
+    rd_remove(e);
+    REST.set_response_status(response, REST.status.DELETED);
+    return;
+  }
+
+  if((len = REST.get_query_variable(request, "lt", &value)) > 0
+     && (lifetime = rd_parse_number(value, len)) <= 0) {
+    REST.set_response_status(response, REST.status.BAD_REQUEST);
+    REST.set_response_payload(response, "BadLifetime", 11);
+    return;
+  }
+  et_len = REST.get_query_variable(request, "et", &et);
+  if(et_len >= RD_ET_LEN) {
+    REST.set_response_status(response, REST.status.BAD_REQUEST);
+    REST.set_response_payload(response, "BadEt", 5);
+    return;
+  }
+
+  if(e == NULL) {
+    /* Registration, or re-registration of the same endpoint name */
+    ep_len = REST.get_query_variable(request, "ep", &ep);
+    if(ep_len <= 0 || ep_len >= RD_EP_LEN) {
+      REST.set_response_status(response, REST.status.BAD_REQUEST);
+      REST.set_response_payload(response, "BadEp", 5);
+      return;
+    }
+    if((e = rd_find(ep, ep_len)) == NULL) {
+      REST.set_response_status(response, REST.status.SERVICE_UNAVAILABLE);
+      REST.set_response_payload(response, "DirectoryFull", 13);
+      return;
+    }
+  } else if(!IS_OPTION((coap_packet_t *)request, COAP_OPTION_BLOCK1)
+            && coap_get_payload(request, &payload) == 0) {
+    /* Refresh */
+    e->expires = clock_seconds() + lifetime;
+    REST.set_response_status(response, REST.status.CHANGED);
+    return;
+  }
+
+  if(!rd_upload(request, response)) {
+    return;
+  }
+  if(upload.len == 0) {
+    REST.set_response_status(response, REST.status.BAD_REQUEST);
+    REST.set_response_payload(response, "MissingLinks", 12);
+    return;
+  }
+  if((links = rd_links_intern(upload.len)) == RD_NO_LINKS) {
+    REST.set_response_status(response, REST.status.SERVICE_UNAVAILABLE);
+    REST.set_response_payload(response, "DirectoryFull", 13);
+    return;
+  }
+
+  if(e->ep[0] != '\0') {
+    rd_links_release(e->links);
+  }
+  e->links = links;
+  if(et_len > 0) {
+    memcpy(e->et, et, et_len);
+    e->et[et_len] = '\0';
+  } else if(ep_len > 0) {
+    e->et[0] = '\0';
+  }
+  uip_ipaddr_copy(&e->addr, &UIP_IP_BUF->srcipaddr);
+  e->expires = clock_seconds() + lifetime;
+
+  if(ep_len > 0) {
+    memcpy(e->ep, ep, ep_len);
+    e->ep[ep_len] = '\0';
+    PRINTF("RD: registered %s at rd/%u\n", e->ep, (unsigned)(e - endpoints));
+
+    snprintf(location, sizeof(location), "rd/%u", (unsigned)(e - endpoints));
+    REST.set_header_location(response, location);
+    REST.set_response_status(response, REST.status.CREATED);
+  } else {
+    REST.set_response_status(response, REST.status.CHANGED);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_output(struct rd_output *out, const char *data, size_t len)
+{
+  size_t skip;
+  size_t n;
+
+  if(out->strpos + len > out->offset && out->bufpos < out->size) {
+    skip = out->offset > out->strpos ? out->offset - out->strpos : 0;
+    n = MIN(len - skip, out->size - out->bufpos);
+    memcpy(out->buffer + out->bufpos, data + skip, n);
+    out->bufpos += n;
+  }
+  out->strpos += len;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Once past the requested block, the rest is only needed to know that
+ * there is more.
+ */
+static int
+rd_output_full(struct rd_output *out)
+{
+  return out->strpos > out->offset + out->size;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_output_addr(struct rd_output *out, int comma, const uip_ipaddr_t *addr)
+{
+  char buf[52];
+  size_t n;
+
+  n = sprintf(buf, comma ? ",<coap://[" : "<coap://[");
+  n += ipaddr_add(addr, buf + n);
+  buf[n++] = ']';
+  rd_output(out, buf, n);
+}
+/*---------------------------------------------------------------------------*/
+static int
+rd_endpoint_match(void *request, const struct rd_endpoint *e)
+{
+  const char *value = NULL;
+  int len;
+
+  if(e->ep[0] == '\0') {
+    return 0;
+  }
+  if((len = REST.get_query_variable(request, "ep", &value)) > 0
+     && !coap_link_match(e->ep, strlen(e->ep), value, len)) {
+    return 0;
+  }
+  if((len = REST.get_query_variable(request, "et", &value)) > 0
+     && !coap_link_match(e->et, strlen(e->et), value, len)) {
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_lookup_ep(void *request, struct rd_output *out)
+{
+  struct rd_endpoint *e;
+
+  for(e = endpoints; e < endpoints + RD_MAX_ENDPOINTS && !rd_output_full(out); e++) {
+    if(!rd_endpoint_match(request, e)) {
+      continue;
+    }
+    rd_output_addr(out, out->strpos > 0, &e->addr);
+    rd_output(out, ">;ep=\"", 6);
+    rd_output(out, e->ep, strlen(e->ep));
+    if(e->et[0] != '\0') {
+      rd_output(out, "\";et=\"", 6);
+      rd_output(out, e->et, strlen(e->et));
+    }
+    rd_output(out, "\"", 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+rd_lookup_res(void *request, struct rd_output *out)
+{
+  struct rd_endpoint *e;
+  const char *rt = NULL;
+  const char *href = NULL;
+  const char *link;
+  const char *next;
+  const char *end;
+  const char *path;
+  const char *attributes;
+  const char *value;
+  size_t path_len;
+  size_t attributes_len;
+  size_t value_len;
+  int rt_len;
+  int href_len;
+  int quoted;
+
+  rt_len = REST.get_query_variable(request, "rt", &rt);
+  href_len = REST.get_query_variable(request, "href", &href);
+  if(href_len > 0 && *href == '/') {
+    ++href;
+    --href_len;
+  }
+
+  for(e = endpoints; e < endpoints + RD_MAX_ENDPOINTS && !rd_output_full(out); e++) {
+    if(e->links == RD_NO_LINKS || !rd_endpoint_match(request, e)) {
+      continue;
+    }
+    link = links_buffer + link_sets[e->links].offset;
+    end = link + link_sets[e->links].len;
+    for(; link < end && !rd_output_full(out); link = next + 1) {
+      /* A link ends at a ',' outside quotes */
+      for(next = link, quoted = 0; next < end && (quoted || *next != ','); ++next) {
+        quoted ^= *next == '"';
+      }
+      if(*link != '<' || (attributes = memchr(link, '>', next - link)) == NULL) {
+        continue;
+      }
+      path = link + 1;
+      path_len = attributes - path;
+      if(path_len > 0 && *path == '/') {
+        ++path;
+        --path_len;
+      }
+      ++attributes;
+      attributes_len = next - attributes;
+
+      if(path_len == 16 && strncmp(path, ".well-known/core", 16) == 0) {
+        continue;
+      }
+      if(href_len > 0 && !coap_link_match(path, path_len, href, href_len)) {
+        continue;
+      }
+      if(rt_len > 0 && ((value = coap_link_attribute(attributes + 1, attributes_len - (attributes_len > 0),
+                                                     "rt", 2, &value_len)) == NULL
+                        || !coap_link_match(value, value_len, rt, rt_len))) {
+        continue;
+      }
+
+      rd_output_addr(out, out->strpos > 0, &e->addr);
+      rd_output(out, "/", 1);
+      rd_output(out, path, path_len);
+      rd_output(out, ">", 1);
+      rd_output(out, attributes, attributes_len);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+RESOURCE(rd_lookup, METHOD_GET | HAS_SUB_RESOURCES, "rd-lookup", "rt=\"core.rd-lookup\";ct=40");
+void
+rd_lookup_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  struct rd_output out = { buffer, preferred_size, *offset, 0, 0 };
+  const char *url = NULL;
+  int len;
+
+  rd_purge();
+
+  len = REST.get_url(request, &url);
+  if(len == 12 && strncmp(url, "rd-lookup/ep", 12) == 0) {
+    rd_lookup_ep(request, &out);
+  } else if(len == 13 && strncmp(url, "rd-lookup/res", 13) == 0) {
+    rd_lookup_res(request, &out);
+  } else {
+    REST.set_response_status(response, REST.status.NOT_FOUND);
+    return;
+  }
+
+  if(out.bufpos > 0 || out.strpos == 0) {
+    REST.set_header_content_type(response, REST.type.APPLICATION_LINK_FORMAT);
+    REST.set_response_payload(response, buffer, out.bufpos);
+  } else {
+    REST.set_response_status(response, REST.status.BAD_OPTION);
+    REST.set_response_payload(response, "BlockOutOfScope", 15);
+  }
+
+  if(out.strpos <= *offset + out.bufpos) {
+    *offset = -1;
+  } else {
+    *offset += preferred_size;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+resource_directory_activate_resources(void)
+{
+  uint8_t i;
+
+  for(i = 0; i < RD_MAX_ENDPOINTS; i++) {
+    endpoints[i].links = RD_NO_LINKS;
+  }
+  /* Before rd, which would match rd-lookup as a sub-resource */
+  rest_activate_resource(&resource_rd_lookup);
+  rest_activate_resource(&resource_rd);
+}
+/*---------------------------------------------------------------------------*/
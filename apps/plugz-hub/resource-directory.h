@@ -0,0 +1,75 @@
+/**
+ * \file
+ *      CoRE Resource Directory of the uHub
+ *
+ *      Nodes register their /.well-known/core document with
+ *      POST /rd?ep=<name>&et=<type>&lt=<seconds> and get the location
+ *      rd/<n> of the registration back. POST /rd/<n>?lt=<seconds> without
+ *      payload refreshes it, with payload replaces the links, and
+ *      DELETE /rd/<n> removes it. Registrations that are not refreshed
+ *      within their lifetime expire.
+ *
+ *      Lookups answer from the directory instead of querying the nodes
+ *      over the mesh:
+ *        GET /rd-lookup/ep?et=astral.aura            the endpoints
+ *        GET /rd-lookup/res?rt=ipso.pwr.*&ep=<name>   their resources
+ *      with filters ep, et, rt and href, where a trailing '*' matches a
+ *      prefix. Nodes of a same type usually register the same links, so
+ *      identical documents are stored once.
+ */
+
+#ifndef RESOURCE_DIRECTORY_H_
+#define RESOURCE_DIRECTORY_H_
+
+#include "contiki-conf.h"
+
+#ifdef RD_CONF_MAX_ENDPOINTS
+#define RD_MAX_ENDPOINTS     RD_CONF_MAX_ENDPOINTS
+#else
+#define RD_MAX_ENDPOINTS     32
+#endif
+
+/* Distinct link-format documents */
+#ifdef RD_CONF_MAX_LINK_SETS
+#define RD_MAX_LINK_SETS     RD_CONF_MAX_LINK_SETS
+#else
+#define RD_MAX_LINK_SETS     8
+#endif
+
+/* Bytes for all documents, including the one being uploaded */
+#ifdef RD_CONF_LINKS_SIZE
+#define RD_LINKS_SIZE        RD_CONF_LINKS_SIZE
+#else
+#define RD_LINKS_SIZE        3072
+#endif
+
+#ifdef RD_CONF_EP_LEN
+#define RD_EP_LEN            RD_CONF_EP_LEN
+#else
+#define RD_EP_LEN            24
+#endif
+
+#ifdef RD_CONF_ET_LEN
+#define RD_ET_LEN            RD_CONF_ET_LEN
+#else
+#define RD_ET_LEN            16
+#endif
+
+/* Lifetime of a registration without lt, in seconds */
+#ifdef RD_CONF_DEFAULT_LIFETIME
+#define RD_DEFAULT_LIFETIME  RD_CONF_DEFAULT_LIFETIME
+#else
+#define RD_DEFAULT_LIFETIME  86400UL
+#endif
+
+/* A block-wise registration is dropped after this many seconds without
+   its next block */
+#ifdef RD_CONF_UPLOAD_TIMEOUT
+#define RD_UPLOAD_TIMEOUT    RD_CONF_UPLOAD_TIMEOUT
+#else
+#define RD_UPLOAD_TIMEOUT    30
+#endif
+
+void resource_directory_activate_resources(void);
+
+#endif /* RESOURCE_DIRECTORY_H_ */
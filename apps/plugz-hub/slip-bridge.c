@@ -42,10 +42,13 @@
 #include "net/ipv6/uip-ds6.h"
 #include "dev/slip.h"
 #include "dev/uart1.h"
+#include "slip-bridge.h"
 #include <string.h>
 
 #define UIP_IP_BUF        ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 
+#define MIN(a, b)         ((a) < (b) ? (a) : (b))
+
 #define DEBUG DEBUG_NONE
 #include "net/ip/uip-debug.h"
 
@@ -53,6 +56,31 @@ void set_prefix_64(uip_ipaddr_t *);
 
 static uip_ipaddr_t last_sender;
 
+/* A queue is a FIFO of packets, each a length, big endian, and the bytes */
+struct queue {
+  uint8_t *buf;
+  uint16_t size;
+  uint16_t head;
+  uint16_t used;
+};
+
+static uint8_t control_buf[SLIP_BRIDGE_CONTROL_QUEUE_SIZE];
+static uint8_t data_buf[SLIP_BRIDGE_DATA_QUEUE_SIZE];
+static struct queue queues[2] = {
+  { control_buf, sizeof(control_buf), 0, 0 },
+  { data_buf, sizeof(data_buf), 0, 0 },
+};
+static uint8_t congested;
+
+struct slip_bridge_stats slip_bridge_stats;
+
+PROCESS(slip_bridge_process, "SLIP bridge");
+
+/* Rates the host may ask for with ?B */
+static const uint32_t baud_rates[] = {
+  115200, 230400, 460800, 921600
+};
+
 static uip_ipaddr_t *
 get_unicast_address(void)
 {
@@ -98,6 +126,29 @@ slip_input_callback(void)
       }
 
       slip_send();
+    } else if(uip_buf[1] == 'B' && uip_len == 6) {
+      /* ?B and the rate, big endian: answered with !B and the rate
+         switched to after the answer is out, or 0 */
+      uint32_t baud;
+      int i;
+
+      baud = ((uint32_t)uip_buf[2] << 24) | ((uint32_t)uip_buf[3] << 16) |
+        ((uint32_t)uip_buf[4] << 8) | uip_buf[5];
+      for(i = 0; i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++) {
+        if(baud_rates[i] == baud) {
+          break;
+        }
+      }
+      if(i == sizeof(baud_rates) / sizeof(baud_rates[0])) {
+        memset(&uip_buf[2], 0, 4);
+      }
+      uip_buf[0] = '!';
+      slip_send();
+      uip_len = 0;
+      if(i < sizeof(baud_rates) / sizeof(baud_rates[0])) {
+        PRINTF("slip-bridge: switching to %lu baud\n", (unsigned long)baud);
+        slip_arch_set_baud_rate(baud);
+      }
     }
   }
   /* Save the last sender received over SLIP to avoid bouncing the
@@ -105,17 +156,173 @@ slip_input_callback(void)
   uip_ipaddr_copy(&last_sender, &UIP_IP_BUF->srcipaddr);
 }
 
+static void
+queue_write(struct queue *q, const uint8_t *ptr, uint16_t len)
+{
+  uint16_t pos, n;
+
+  pos = q->head + q->used;
+  if(pos >= q->size) {
+    pos -= q->size;
+  }
+  q->used += len;
+  while(len > 0) {
+    n = MIN(len, q->size - pos);
+    memcpy(&q->buf[pos], ptr, n);
+    ptr += n;
+    len -= n;
+    pos = 0;
+  }
+}
+
+static void
+queue_read(struct queue *q, uint8_t *ptr, uint16_t len)
+{
+  uint16_t n;
+
+  q->used -= len;
+  while(len > 0) {
+    n = MIN(len, q->size - q->head);
+    memcpy(ptr, &q->buf[q->head], n);
+    q->head += n;
+    if(q->head == q->size) {
+      q->head = 0;
+    }
+    ptr += n;
+    len -= n;
+  }
+}
+
+static uint16_t
+queue_peek_len(struct queue *q)
+{
+  uint16_t next;
+
+  next = q->head + 1 == q->size ? 0 : q->head + 1;
+  return (q->buf[q->head] << 8) | q->buf[next];
+}
+
+/* Encoded size of a packet, a little for the escapes and the two ENDs */
+static uint16_t
+tx_need(uint16_t len)
+{
+  return len + (len >> 4) + 2;
+}
+
+static uint8_t
+packet_class(void)
+{
+  uint8_t proto;
+
+  proto = UIP_IP_BUF->proto;
+  if(proto == UIP_PROTO_HBHO && uip_len > UIP_IPH_LEN) {
+    /* MLD and the like */
+    proto = uip_buf[UIP_LLH_LEN + UIP_IPH_LEN];
+  }
+  return proto == UIP_PROTO_ICMP6 ? SLIP_BRIDGE_CONTROL : SLIP_BRIDGE_DATA;
+}
+
+static void
+enqueue(uint8_t class)
+{
+  struct queue *q = &queues[class];
+  uint8_t len[2];
+
+  if(q->size - q->used < uip_len + 2) {
+    slip_bridge_stats.dropped[class]++;
+    PRINTF("slip-bridge: queue %u full, %u dropped\n", class, uip_len);
+    return;
+  }
+  len[0] = uip_len >> 8;
+  len[1] = uip_len & 0xff;
+  queue_write(q, len, 2);
+  /* Same split as slip_send() */
+  if(uip_len <= UIP_TCPIP_HLEN) {
+    queue_write(q, &uip_buf[UIP_LLH_LEN], uip_len);
+  } else {
+    queue_write(q, &uip_buf[UIP_LLH_LEN], UIP_TCPIP_HLEN);
+    queue_write(q, (uint8_t *)uip_appdata, uip_len - UIP_TCPIP_HLEN);
+  }
+
+  if(class == SLIP_BRIDGE_DATA && !congested && q->used > q->size / 4 * 3) {
+    congested = 1;
+    slip_bridge_stats.congested++;
+  }
+  process_poll(&slip_bridge_process);
+}
+
+/* Send what the driver has room for, control first. Runs between the
+   events of the stack, uip_buf is free to hold the packet. */
+static void
+drain(void)
+{
+  struct queue *q;
+  uint16_t len, space;
+  uint8_t class;
+
+  for(;;) {
+    class = queues[SLIP_BRIDGE_CONTROL].used > 0 ?
+      SLIP_BRIDGE_CONTROL : SLIP_BRIDGE_DATA;
+    q = &queues[class];
+    if(q->used == 0) {
+      break;
+    }
+    len = queue_peek_len(q);
+    space = slip_arch_tx_space();
+    if(space < tx_need(len) && space < SLIP_BRIDGE_TX_ROOM) {
+      /* The drained callback polls us again */
+      break;
+    }
+    queue_read(q, &uip_buf[UIP_LLH_LEN], 2);
+    queue_read(q, &uip_buf[UIP_LLH_LEN], len);
+    slip_write(&uip_buf[UIP_LLH_LEN], len);
+    slip_bridge_stats.queued[class]++;
+  }
+
+  if(congested && queues[SLIP_BRIDGE_DATA].used <= queues[SLIP_BRIDGE_DATA].size / 4) {
+    congested = 0;
+  }
+}
+
+static void
+tx_drained(void)
+{
+  process_poll(&slip_bridge_process);
+}
+
+int
+slip_bridge_congested(void)
+{
+  return congested;
+}
+
+PROCESS_THREAD(slip_bridge_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+    drain();
+  }
+
+  PROCESS_END();
+}
+
 static void
 init(void)
 {
   slip_arch_init(BAUD2UBR(115200));
   process_start(&slip_process, NULL);
+  process_start(&slip_bridge_process, NULL);
   slip_set_input_callback(slip_input_callback);
+  slip_arch_set_tx_callback(tx_drained);
 }
 
 static void
 output(void)
 {
+  uint8_t class;
+
   if(uip_ipaddr_cmp(&last_sender, &UIP_IP_BUF->srcipaddr)) {
     /* Do not bounce packets back over SLIP if the packet was received
        over SLIP */
@@ -126,7 +333,15 @@ output(void)
     PRINTF("\n");
   } else {
     //PRINTF("SUT: %u\n", uip_len);
-    slip_send();
+    class = packet_class();
+    if(queues[SLIP_BRIDGE_CONTROL].used == 0 &&
+       queues[SLIP_BRIDGE_DATA].used == 0 &&
+       slip_arch_tx_space() >= tx_need(uip_len)) {
+      slip_send();
+      slip_bridge_stats.sent[class]++;
+    } else {
+      enqueue(class);
+    }
   }
 }
 
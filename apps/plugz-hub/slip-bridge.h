@@ -0,0 +1,62 @@
+/**
+ * \file
+ *      Uplink queue of the uHub's SLIP fallback interface
+ *
+ *      Packets for the host are sent at once while the serial driver has
+ *      room for them, queued otherwise and sent as it drains. ICMPv6,
+ *      RPL included, has its own queue that goes out before the queued
+ *      data. When a queue is full the packet is dropped.
+ */
+
+#ifndef SLIP_BRIDGE_H_
+#define SLIP_BRIDGE_H_
+
+#include "contiki-conf.h"
+
+/* Bytes queued for ICMPv6, two bytes of length per packet included */
+#ifdef SLIP_BRIDGE_CONF_CONTROL_QUEUE_SIZE
+#define SLIP_BRIDGE_CONTROL_QUEUE_SIZE SLIP_BRIDGE_CONF_CONTROL_QUEUE_SIZE
+#else
+#define SLIP_BRIDGE_CONTROL_QUEUE_SIZE 512
+#endif
+
+/* Bytes queued for the other packets */
+#ifdef SLIP_BRIDGE_CONF_DATA_QUEUE_SIZE
+#define SLIP_BRIDGE_DATA_QUEUE_SIZE    SLIP_BRIDGE_CONF_DATA_QUEUE_SIZE
+#else
+#define SLIP_BRIDGE_DATA_QUEUE_SIZE    2048
+#endif
+
+/* Room in the buffer of slip-arch from which a packet that does not fit is
+   sent anyway, the rest waiting for room. At most what the drained callback
+   frees: half of the UART ring, or one of the two USB transfers. */
+#ifdef SLIP_BRIDGE_CONF_TX_ROOM
+#define SLIP_BRIDGE_TX_ROOM            SLIP_BRIDGE_CONF_TX_ROOM
+#elif SLIP_ARCH_CONF_USB && defined(USB_SERIAL_CONF_TX_BUF_SIZE)
+#define SLIP_BRIDGE_TX_ROOM            USB_SERIAL_CONF_TX_BUF_SIZE
+#elif !SLIP_ARCH_CONF_USB && defined(UART0_CONF_TX_BUF_SIZE)
+#define SLIP_BRIDGE_TX_ROOM            (UART0_CONF_TX_BUF_SIZE / 2)
+#else
+#define SLIP_BRIDGE_TX_ROOM            256
+#endif
+
+#define SLIP_BRIDGE_CONTROL 0
+#define SLIP_BRIDGE_DATA    1
+
+struct slip_bridge_stats {
+  uint16_t sent[2];     /* Sent at once */
+  uint16_t queued[2];   /* Sent after waiting in the queue */
+  uint16_t dropped[2];  /* Queue full */
+  uint16_t congested;   /* Times the data queue went over 3/4 */
+};
+
+extern struct slip_bridge_stats slip_bridge_stats;
+
+/**
+ * \brief Backpressure: non-zero from the time the data queue is 3/4 full
+ *        until it is down to 1/4. Sources of uplink traffic should hold
+ *        back meanwhile.
+ */
+int slip_bridge_congested(void);
+
+#endif /* SLIP_BRIDGE_H_ */
@@ -0,0 +1,65 @@
+/**
+ * \file
+ *      Radio commands of the uHub when it runs as a slip-radio (SPLIT=1)
+ */
+
+#include "contiki.h"
+#include "dev/cc2538-rf.h"
+#include "cmd.h"
+#if PLUGZ_HUB_CONF_TSCH
+#include "net/mac/tsch/tsch.h"
+#include "slip-radio.h"
+#endif
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/*---------------------------------------------------------------------------*/
+int
+cmd_handler_cc2538(const uint8_t *data, int len)
+{
+  uint8_t buf[4];
+
+  if(len < 2) {
+    return 0;
+  }
+  if(data[0] == '!') {
+    if(data[1] == 'C' && len > 2) {
+      PRINTF("cc2538_cmd: setting channel: %d\n", data[2]);
+      cc2538_rf_channel_set(data[2]);
+      return 1;
+    }
+  } else if(data[0] == '?') {
+    if(data[1] == 'C') {
+      buf[0] = '!';
+      buf[1] = 'C';
+      buf[2] = cc2538_rf_channel_get();
+      PRINTF("cc2538_cmd: getting channel: %d\n", buf[2]);
+      cmd_send(buf, 3);
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+#if PLUGZ_HUB_CONF_TSCH
+/* Run by slip-radio once the RDC is up: the hub is the TSCH coordinator */
+static void
+tsch_init(void)
+{
+  tsch_set_coordinator(1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tsch_send(void)
+{
+}
+/*---------------------------------------------------------------------------*/
+const struct slip_radio_sensors slip_radio_tsch = { tsch_init, tsch_send };
+/*---------------------------------------------------------------------------*/
+#endif /* PLUGZ_HUB_CONF_TSCH */
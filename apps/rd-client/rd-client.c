@@ -0,0 +1,155 @@
+/**
+ * \file
+ *      Registration with the CoRE Resource Directory of the uHub
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/rpl/rpl.h"
+
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "rd-client.h"
+
+#define DEBUG 0
+#if DEBUG
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define RD_CLIENT_PORT  UIP_HTONS(COAP_DEFAULT_PORT)
+
+PROCESS(rd_client_process, "RD client");
+
+static const char *client_ep;
+static const char *client_et;
+static uip_ipaddr_t server_addr;
+static uint16_t registered_version;
+static char location[16];
+static char query[64];
+static const char *lifetime_query;
+static uint8_t chunk[RD_CLIENT_BLOCK_SIZE];
+
+/* Of the last request, 0 if there was no response */
+static uint8_t response_code;
+
+/* Set by rd_client_update(), checked between requests */
+static uint8_t update_requested;
+
+/*---------------------------------------------------------------------------*/
+static void
+rd_client_response(void *response)
+{
+  const char *path = NULL;
+  int len;
+
+  response_code = ((coap_packet_t *)response)->code;
+  if(response_code == CREATED_2_01
+     && (len = coap_get_header_location_path(response, &path)) > 0
+     && len < sizeof(location)) {
+    memcpy(location, path, len);
+    location[len] = '\0';
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rd_client_start(const char *ep, const char *et)
+{
+  client_ep = ep;
+  client_et = et;
+  process_start(&rd_client_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+rd_client_update(void)
+{
+  /* Not a poll: that would end a blocking request as if it had timed out */
+  update_requested = 1;
+  process_post(&rd_client_process, PROCESS_EVENT_CONTINUE, NULL);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rd_client_process, ev, data)
+{
+  static struct etimer et;
+  static coap_packet_t request[1];
+  static uint32_t block_num;
+  static uint8_t more;
+  size_t len;
+  rpl_dag_t *dag;
+
+  PROCESS_BEGIN();
+
+  /* The registration query ends with the lifetime, which alone refreshes */
+  if(client_et != NULL) {
+    len = snprintf(query, sizeof(query), "ep=%s&et=%s&", client_ep, client_et);
+  } else {
+    len = snprintf(query, sizeof(query), "ep=%s&", client_ep);
+  }
+  len = MIN(len, sizeof(query) - 1);
+  lifetime_query = query + len;
+  snprintf(query + len, sizeof(query) - len, "lt=%u", RD_CLIENT_LIFETIME);
+
+  while(1) {
+    if((dag = rpl_get_any_dag()) == NULL) {
+      etimer_set(&et, RD_CLIENT_RETRY);
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+      continue;
+    }
+#ifdef RD_CLIENT_CONF_SERVER
+    RD_CLIENT_CONF_SERVER(&server_addr);
+#else
+    uip_ipaddr_copy(&server_addr, &dag->dag_id);
+#endif
+
+    if(location[0] == '\0' || registered_version != rest_get_resources_version()) {
+      /* Register the link format, one block at a time */
+      registered_version = rest_get_resources_version();
+      location[0] = '\0';
+      block_num = 0;
+      do {
+        len = coap_get_link_format(chunk, RD_CLIENT_BLOCK_SIZE, block_num * RD_CLIENT_BLOCK_SIZE);
+        more = (block_num + 1) * RD_CLIENT_BLOCK_SIZE < coap_get_link_format_len();
+
+        coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
+        coap_set_header_uri_path(request, "rd");
+        coap_set_header_uri_query(request, query);
+        coap_set_header_content_type(request, APPLICATION_LINK_FORMAT);
+        coap_set_header_block1(request, block_num, more, RD_CLIENT_BLOCK_SIZE);
+        coap_set_payload(request, chunk, len);
+
+        response_code = 0;
+        COAP_BLOCKING_REQUEST(&server_addr, RD_CLIENT_PORT, request, rd_client_response);
+        ++block_num;
+      } while(more && response_code == CONTINUE_2_31);
+
+      PRINTF("RD: registration %u.%02u at %s\n",
+             response_code >> 5, response_code & 0x1f, location);
+    } else {
+      /* Refresh, a directory that has lost us answers 4.04 */
+      coap_init_message(request, COAP_TYPE_CON, COAP_POST, 0);
+      coap_set_header_uri_path(request, location);
+      coap_set_header_uri_query(request, lifetime_query);
+
+      response_code = 0;
+      COAP_BLOCKING_REQUEST(&server_addr, RD_CLIENT_PORT, request, rd_client_response);
+
+      PRINTF("RD: refresh %u.%02u\n", response_code >> 5, response_code & 0x1f);
+      if(response_code != CHANGED_2_04) {
+        location[0] = '\0';
+      }
+    }
+
+    if(!update_requested) {
+      etimer_set(&et, location[0] != '\0' ? RD_CLIENT_LIFETIME / 2 * CLOCK_SECOND : RD_CLIENT_RETRY);
+      PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et) || update_requested);
+    }
+    update_requested = 0;
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
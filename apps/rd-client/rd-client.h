@@ -0,0 +1,61 @@
+/**
+ * \file
+ *      Registration with the CoRE Resource Directory of the uHub
+ *
+ *      Once the node has joined a DODAG, the /.well-known/core document
+ *      of its activated resources is POSTed block-wise to /rd of the
+ *      DODAG root, with the endpoint name and type. The registration is
+ *      refreshed at half its lifetime, and made again when the hub has
+ *      forgotten it or when resources are activated.
+ */
+
+#ifndef RD_CLIENT_H_
+#define RD_CLIENT_H_
+
+#include "contiki-conf.h"
+
+/* Lifetime of the registration, in seconds */
+#ifdef RD_CLIENT_CONF_LIFETIME
+#define RD_CLIENT_LIFETIME    RD_CLIENT_CONF_LIFETIME
+#else
+#define RD_CLIENT_LIFETIME    3600
+#endif
+
+/* Delay before trying again without a DODAG or a registration */
+#ifdef RD_CLIENT_CONF_RETRY
+#define RD_CLIENT_RETRY       RD_CLIENT_CONF_RETRY
+#else
+#define RD_CLIENT_RETRY       (30 * CLOCK_SECOND)
+#endif
+
+/* Block size of the registration, a power of two */
+#ifdef RD_CLIENT_CONF_BLOCK_SIZE
+#define RD_CLIENT_BLOCK_SIZE  RD_CLIENT_CONF_BLOCK_SIZE
+#else
+#define RD_CLIENT_BLOCK_SIZE  REST_MAX_CHUNK_SIZE
+#endif
+
+/*
+ * RD_CLIENT_CONF_SERVER(addr) can set the address of the directory
+ * instead of the DODAG ID, e.g.
+ *   #define RD_CLIENT_CONF_SERVER(addr) uip_ip6addr(addr, 0xaaaa, 0, 0, 0, 0, 0, 0, 1)
+ */
+
+/**
+ * \brief Register with the resource directory, and keep registered.
+ * \param ep The endpoint name, unique in the network
+ * \param et The endpoint type, or NULL
+ *
+ * Both strings must stay valid.
+ */
+void rd_client_start(const char *ep, const char *et);
+
+/**
+ * \brief Register again now, for resources activated after the start.
+ *
+ * Without changes to the resources, the registration is refreshed. A
+ * request in progress is completed first.
+ */
+void rd_client_update(void);
+
+#endif /* RD_CLIENT_H_ */
@@ -7,6 +7,7 @@
 #include "net/ip/uip.h"
 #include "net/ipv6/uip-ds6.h"
 #include "net/rpl/rpl.h"
+#include "net/mac/csma.h"
 
 #include "erbium.h"
 #include "er-coap-13-engine.h"
@@ -192,8 +193,64 @@ parents_handler(void* request, void* response, uint8_t *buffer, uint16_t preferr
 
 }
 
+#if CSMA_CONF_STATS
+/*  {"sent":120,"dropped":2,"maxdelay":350,"avgdelay":12}, delays in ms */
+uint16_t create_csma_msg(char *buf, uint16_t size, struct csma_stats *s)
+{
+    int n;
+
+    n = snprintf(buf, size,
+                 "{\"sent\":%u,\"dropped\":%u,\"maxdelay\":%lu,\"avgdelay\":%lu}",
+                 s->sent, s->dropped,
+                 (unsigned long)s->max_delay * 1000 / CLOCK_SECOND,
+                 s->sent == 0 ? 0 :
+                 (unsigned long)(s->total_delay / s->sent) * 1000 / CLOCK_SECOND);
+    if(n >= size) {
+        /* Block sizes below the length of an entry are not supported */
+        n = size - 1;
+    }
+    PRINTF("buf: %s\n", buf);
+    return n;
+}
+
+/* The CSMA counters of one traffic class, index is a CSMA_CLASS_*
+   value; without an index, the number of classes. */
+RESOURCE(csma, METHOD_GET, "rplinfo/csma", "title=\"CSMA queue stats\";rt=\"Data\"");
+void
+csma_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  int32_t strpos = 0;
+  size_t len = 0;
+  uint8_t index;
+  const char *pstr;
+
+  if ((len = REST.get_query_variable(request, "index", &pstr))) {
+
+    index = (uint8_t)atoi(pstr);
+
+    if (index >= CSMA_NUM_CLASSES) {
+      strpos = snprintf((char *)buffer, preferred_size, "{}");
+    } else {
+      strpos = create_csma_msg((char *)buffer, preferred_size, &csma_stats[index]);
+    }
+
+    REST.set_header_content_type(response, APPLICATION_JSON);
+
+  } else { /* index not provided */
+    strpos += snprintf((char *)buffer, preferred_size, "%d", CSMA_NUM_CLASSES);
+  }
+
+  *offset = -1;
+
+  REST.set_response_payload(response, buffer, strpos);
+}
+#endif /* CSMA_CONF_STATS */
+
 void
 rplinfo_activate_resources(void) {
   rest_activate_resource(&resource_parents);
   rest_activate_resource(&resource_routes);
+#if CSMA_CONF_STATS
+  rest_activate_resource(&resource_csma);
+#endif /* CSMA_CONF_STATS */
 }
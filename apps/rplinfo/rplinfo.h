@@ -5,4 +5,7 @@
 
 void rplinfo_activate_resources(void);
 
+/* Writes addr in its compressed text form, returns the length. */
+uint16_t ipaddr_add(const uip_ipaddr_t *addr, char *buf);
+
 #endif
@@ -53,14 +53,34 @@ SHELL_COMMAND(ps_command,
 PROCESS_THREAD(shell_ps_process, ev, data)
 {
   struct process *p;
+  char buf[64];
   PROCESS_BEGIN();
 
+#if PROCESS_CONF_ACCOUNTING
+  shell_output_str(&ps_command, "Processes: calls, run time avg/max us, events, wait avg/max us", "");
+#else
   shell_output_str(&ps_command, "Processes:", "");
+#endif
   for(p = PROCESS_LIST(); p != NULL; p = p->next) {
     char namebuf[30];
     strncpy(namebuf, PROCESS_NAME_STRING(p), sizeof(namebuf));
+#if PROCESS_CONF_ACCOUNTING
+    snprintf(buf, sizeof(buf), ": %lu %lu/%lu %lu %lu/%lu",
+             (unsigned long)p->acct.calls,
+             (unsigned long)process_acct_us(p->acct.calls ? p->acct.time / p->acct.calls : 0),
+             (unsigned long)process_acct_us(p->acct.max_time),
+             (unsigned long)p->acct.events,
+             (unsigned long)process_acct_us(p->acct.events ? p->acct.wait / p->acct.events : 0),
+             (unsigned long)process_acct_us(p->acct.max_wait));
+    shell_output_str(&ps_command, namebuf, buf);
+#else
     shell_output_str(&ps_command, namebuf, "");
+#endif
   }
+  snprintf(buf, sizeof(buf), "%u high queued as normal, %u dropped",
+           process_overflows[PROCESS_PRIO_HIGH],
+           process_overflows[PROCESS_PRIO_NORMAL]);
+  shell_output_str(&ps_command, "Event queue overflows: ", buf);
 
   PROCESS_END();
 }
@@ -59,8 +59,22 @@ uint16_t slip_rubbish, slip_twopackets, slip_overflow, slip_ip_drop;
 #define SLIP_STATISTICS(statement) statement
 #endif
 
-/* Must be at least one byte larger than UIP_BUFSIZE! */
+/* Must be at least one byte larger than UIP_BUFSIZE! Twice that holds a
+   second full frame while the first one is being processed. */
+#ifdef SLIP_CONF_RX_BUFSIZE
+#define RX_BUFSIZE SLIP_CONF_RX_BUFSIZE
+#else
 #define RX_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN + 16)
+#endif
+
+/* The arch takes blocks of encoded bytes with slip_arch_write() */
+#ifdef SLIP_CONF_ARCH_WRITE
+#define SLIP_ARCH_WRITE SLIP_CONF_ARCH_WRITE
+#else
+#define SLIP_ARCH_WRITE 0
+#endif
+
+#define TX_CHUNK 64
 
 enum {
   STATE_TWOPACKETS = 0,	/* We have 2 packets and drop incoming data. */
@@ -86,6 +100,12 @@ static uint8_t rxbuf[RX_BUFSIZE];
 static uint16_t pkt_end;		/* SLIP_END tracker. */
 
 static void (* input_callback)(void) = NULL;
+
+#if SLIP_ARCH_WRITE
+/* Encoded bytes, handed to the arch a chunk at a time */
+static uint8_t txbuf[TX_CHUNK];
+static uint8_t txlen;
+#endif
 /*---------------------------------------------------------------------------*/
 void
 slip_set_input_callback(void (*c)(void))
@@ -93,50 +113,56 @@ slip_set_input_callback(void (*c)(void))
   input_callback = c;
 }
 /*---------------------------------------------------------------------------*/
-/* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
- * was used in slip-bridge.c
- */
-//#if WITH_UIP
-uint8_t
-slip_send(void)
+#if SLIP_ARCH_WRITE
+static void
+tx_flush(void)
+{
+  if(txlen > 0) {
+    slip_arch_write(txbuf, txlen);
+    txlen = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tx_encode(const uint8_t *ptr, uint16_t len)
 {
-  uint16_t i;
-  uint8_t *ptr;
+  const uint8_t *end_ptr = ptr + len;
   uint8_t c;
 
-  slip_arch_writeb(SLIP_END);
-
-  ptr = &uip_buf[UIP_LLH_LEN];
-  for(i = 0; i < uip_len; ++i) {
-    if(i == UIP_TCPIP_HLEN) {
-      ptr = (uint8_t *)uip_appdata;
+  while(ptr < end_ptr) {
+    if(txlen >= TX_CHUNK - 1) {
+      tx_flush();
     }
     c = *ptr++;
     if(c == SLIP_END) {
-      slip_arch_writeb(SLIP_ESC);
+      txbuf[txlen++] = SLIP_ESC;
       c = SLIP_ESC_END;
     } else if(c == SLIP_ESC) {
-      slip_arch_writeb(SLIP_ESC);
+      txbuf[txlen++] = SLIP_ESC;
       c = SLIP_ESC_ESC;
     }
-    slip_arch_writeb(c);
+    txbuf[txlen++] = c;
   }
-  slip_arch_writeb(SLIP_END);
-
-  return UIP_FW_OK;
 }
-//#endif /* WITH_UIP */
 /*---------------------------------------------------------------------------*/
-uint8_t
-slip_write(const void *_ptr, int len)
+static void
+tx_end(void)
+{
+  if(txlen == TX_CHUNK) {
+    tx_flush();
+  }
+  txbuf[txlen++] = SLIP_END;
+}
+#else /* SLIP_ARCH_WRITE */
+#define tx_flush()
+#define tx_end() slip_arch_writeb(SLIP_END)
+/*---------------------------------------------------------------------------*/
+static void
+tx_encode(const uint8_t *ptr, uint16_t len)
 {
-  const uint8_t *ptr = _ptr;
-  uint16_t i;
   uint8_t c;
 
-  slip_arch_writeb(SLIP_END);
-
-  for(i = 0; i < len; ++i) {
+  while(len-- > 0) {
     c = *ptr++;
     if(c == SLIP_END) {
       slip_arch_writeb(SLIP_ESC);
@@ -147,7 +173,39 @@ slip_write(const void *_ptr, int len)
     }
     slip_arch_writeb(c);
   }
-  slip_arch_writeb(SLIP_END);
+}
+#endif /* SLIP_ARCH_WRITE */
+/*---------------------------------------------------------------------------*/
+/* slip_send: forward (IPv4) packets with {UIP_FW_NETIF(..., slip_send)}
+ * was used in slip-bridge.c
+ */
+//#if WITH_UIP
+uint8_t
+slip_send(void)
+{
+  tx_end();
+
+  if(uip_len <= UIP_TCPIP_HLEN) {
+    tx_encode(&uip_buf[UIP_LLH_LEN], uip_len);
+  } else {
+    tx_encode(&uip_buf[UIP_LLH_LEN], UIP_TCPIP_HLEN);
+    tx_encode((uint8_t *)uip_appdata, uip_len - UIP_TCPIP_HLEN);
+  }
+
+  tx_end();
+  tx_flush();
+
+  return UIP_FW_OK;
+}
+//#endif /* WITH_UIP */
+/*---------------------------------------------------------------------------*/
+uint8_t
+slip_write(const void *_ptr, int len)
+{
+  tx_end();
+  tx_encode(_ptr, len);
+  tx_end();
+  tx_flush();
 
   return len;
 }
@@ -393,3 +451,58 @@ slip_input_byte(unsigned char c)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Appends a run of bytes that need no unescaping, as slip_input_byte()
+ * would one at a time.
+ */
+static void
+rx_append(const uint8_t *ptr, uint16_t len)
+{
+  uint16_t room, first;
+
+  room = (begin > end ? begin : begin + RX_BUFSIZE) - end - 1;
+  if(len > room) {		/* rxbuf is full */
+    state = STATE_RUBBISH;
+    SLIP_STATISTICS(slip_overflow++);
+    end = pkt_end;		/* remove rubbish */
+    return;
+  }
+
+  first = RX_BUFSIZE - end;
+  if(first > len) {
+    first = len;
+  }
+  memcpy(&rxbuf[end], ptr, first);
+  memcpy(rxbuf, ptr + first, len - first);
+  end += len;
+  if(end >= RX_BUFSIZE) {
+    end -= RX_BUFSIZE;
+  }
+
+  if(rxbuf[begin] == 'C' && memchr(ptr, 'T', len) != NULL) {
+    process_poll(&slip_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+slip_input_block(const uint8_t *ptr, uint16_t len)
+{
+  const uint8_t *end_ptr = ptr + len;
+  const uint8_t *run;
+  int ret = 0;
+
+  while(ptr < end_ptr) {
+    if(state == STATE_OK) {
+      for(run = ptr; ptr < end_ptr && *ptr != SLIP_END && *ptr != SLIP_ESC; ptr++);
+      if(ptr > run) {
+        rx_append(run, ptr - run);
+      }
+      if(ptr == end_ptr) {
+        break;
+      }
+    }
+    ret |= slip_input_byte(*ptr++);
+  }
+  return ret;
+}
+/*---------------------------------------------------------------------------*/
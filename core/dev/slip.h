@@ -62,6 +62,16 @@ uint8_t slip_send(void);
  */
 int slip_input_byte(unsigned char c);
 
+/**
+ * Input a block of SLIP bytes, e.g. a drained FIFO or DMA buffer.
+ *
+ * Same as calling slip_input_byte() for each byte, but runs of bytes
+ * that need no unescaping are copied at once.
+ *
+ * \return Non-zero if the CPU should be powered up, zero otherwise.
+ */
+int slip_input_block(const uint8_t *buf, uint16_t len);
+
 uint8_t slip_write(const void *ptr, int len);
 
 /* Did we receive any bytes lately? */
@@ -83,4 +93,23 @@ void slip_set_input_callback(void (*callback)(void));
 void slip_arch_init(unsigned long ubr);
 void slip_arch_writeb(unsigned char c);
 
+/*
+ * Optional, for architectures that buffer what slip_arch_writeb()
+ * transmits (cc2538): the room left in that buffer, and a callback
+ * called, possibly from an interrupt, once it has drained.
+ */
+uint16_t slip_arch_tx_space(void);
+void slip_arch_set_tx_callback(void (*callback)(void));
+
+/*
+ * Optional: write a block of encoded bytes, used by slip_send() and
+ * slip_write() when SLIP_CONF_ARCH_WRITE is set, and change the rate of
+ * the serial line once the bytes written so far are out. A write that
+ * does not fit waits for room, over USB on the cc2538 only for a short
+ * while before the rest is dropped. Callers that queue frames check
+ * slip_arch_tx_space() first.
+ */
+void slip_arch_write(const uint8_t *buf, uint16_t len);
+void slip_arch_set_baud_rate(unsigned long baud);
+
 #endif /* SLIP_H_ */
@@ -66,6 +66,7 @@
 #include "net/rime/rime.h"
 #include "net/ipv6/sicslowpan.h"
 #include "net/netstack.h"
+#include "sys/ctimer.h"
 
 #if UIP_CONF_IPV6
 
@@ -98,6 +99,15 @@ void uip_log(char *msg);
 #define UIP_LOG(m)
 #endif /* UIP_LOGGING == 1 */
 
+/* MAC priority of outgoing packets (PACKETBUF_ATTR_PRIORITY_*). A
+   project can classify its own traffic with a function that looks at
+   the IPv6 packet in uip_buf. */
+#ifdef SICSLOWPAN_CONF_PRIORITY
+#define SICSLOWPAN_PRIORITY() SICSLOWPAN_CONF_PRIORITY()
+#else
+#define SICSLOWPAN_PRIORITY() packet_priority()
+#endif
+
 #ifdef SICSLOWPAN_CONF_MAX_MAC_TRANSMISSIONS
 #define SICSLOWPAN_MAX_MAC_TRANSMISSIONS SICSLOWPAN_CONF_MAX_MAC_TRANSMISSIONS
 #else
@@ -367,6 +377,7 @@ addr_context_lookup_by_prefix(uip_ipaddr_t *ipaddr)
   int i;
   for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
     if((addr_contexts[i].used == 1) &&
+       (addr_contexts[i].flags & SICSLOWPAN_CONTEXT_COMPRESS) &&
        uip_ipaddr_prefixcmp(&addr_contexts[i].prefix, ipaddr, 64)) {
       return &addr_contexts[i];
     }
@@ -1019,8 +1030,221 @@ uncompress_hdr_hc06(uint16_t ip_len)
   return;
 }
 /** @} */
+
+/*--------------------------------------------------------------------*/
+/** \name Dynamic address contexts
+ * @{                                                                 */
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0
+static struct ctimer context_timer;
+
+/* Age the dynamic contexts once per minute. A context whose lifetime
+   runs out is first kept for decompression only, so that packets
+   already compressed against it by our neighbors can still be read
+   (RFC 6775, section 7.2), and removed a minute later. */
+static void
+context_periodic(void *ptr)
+{
+  int i;
+  int active;
+
+  active = 0;
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    if(addr_contexts[i].used != 1 ||
+       (addr_contexts[i].flags & SICSLOWPAN_CONTEXT_STATIC) ||
+       addr_contexts[i].lifetime == SICSLOWPAN_CONTEXT_INFINITE) {
+      continue;
+    }
+    if(addr_contexts[i].lifetime > 0) {
+      addr_contexts[i].lifetime--;
+    }
+    if(addr_contexts[i].lifetime == 0) {
+      if(addr_contexts[i].flags & SICSLOWPAN_CONTEXT_COMPRESS) {
+        PRINTFI("sicslowpan: context %u expired, decompression only\n",
+                addr_contexts[i].number);
+        addr_contexts[i].flags &= ~SICSLOWPAN_CONTEXT_COMPRESS;
+        addr_contexts[i].lifetime = 1;
+      } else {
+        PRINTFI("sicslowpan: context %u removed\n", addr_contexts[i].number);
+        addr_contexts[i].used = 0;
+        continue;
+      }
+    }
+    active = 1;
+  }
+
+  if(active) {
+    ctimer_reset(&context_timer);
+  }
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix,
+                       uint16_t lifetime, uint8_t flags)
+{
+  struct sicslowpan_addr_context *ctx;
+  int i;
+
+  if(number > 15) {
+    return 0;
+  }
+
+  ctx = addr_context_lookup_by_number(number);
+  if(ctx != NULL && (ctx->flags & SICSLOWPAN_CONTEXT_STATIC)) {
+    return 0;
+  }
+
+  if(lifetime == 0) {
+    if(ctx != NULL) {
+      PRINTFI("sicslowpan: context %u withdrawn\n", number);
+      ctx->used = 0;
+    }
+    return 1;
+  }
+
+  if(ctx == NULL) {
+    for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+      if(addr_contexts[i].used != 1) {
+        ctx = &addr_contexts[i];
+        break;
+      }
+    }
+    if(ctx == NULL) {
+      PRINTFI("sicslowpan: no room for context %u\n", number);
+      return 0;
+    }
+  }
+
+  if(ctx->used != 1 || memcmp(ctx->prefix, prefix, 8) != 0 ||
+     (ctx->flags ^ flags) & SICSLOWPAN_CONTEXT_COMPRESS) {
+    PRINTFI("sicslowpan: context %u = %02x%02x:%02x%02x:%02x%02x:%02x%02x::/64%s\n",
+            number, prefix->u8[0], prefix->u8[1], prefix->u8[2],
+            prefix->u8[3], prefix->u8[4], prefix->u8[5], prefix->u8[6],
+            prefix->u8[7],
+            (flags & SICSLOWPAN_CONTEXT_COMPRESS) ? "" : " (decompress only)");
+  }
+
+  ctx->used = 1;
+  ctx->number = number;
+  ctx->flags = flags & (SICSLOWPAN_CONTEXT_COMPRESS | SICSLOWPAN_CONTEXT_LEARNT);
+  ctx->lifetime = lifetime;
+  memcpy(ctx->prefix, prefix, 8);
+
+  if(lifetime != SICSLOWPAN_CONTEXT_INFINITE &&
+     ctimer_expired(&context_timer)) {
+    ctimer_set(&context_timer, 60 * CLOCK_SECOND, context_periodic, NULL);
+  }
+  return 1;
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_6co_get(int index, uint8_t *body)
+{
+  struct sicslowpan_addr_context *ctx;
+  uint16_t lifetime;
+  int i;
+
+  for(i = 0; i < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS; i++) {
+    ctx = &addr_contexts[i];
+    /* Static contexts are configured on every node already. */
+    if(ctx->used != 1 || (ctx->flags & SICSLOWPAN_CONTEXT_STATIC)) {
+      continue;
+    }
+    if(index-- > 0) {
+      continue;
+    }
+
+    lifetime = ctx->lifetime;
+    if(lifetime > SICSLOWPAN_CONTEXT_LIFETIME) {
+      lifetime = SICSLOWPAN_CONTEXT_LIFETIME;
+    }
+    body[0] = 64;
+    body[1] = ctx->number & 0x0f;
+    if(ctx->flags & SICSLOWPAN_CONTEXT_COMPRESS) {
+      body[1] |= 0x10;
+    }
+    body[2] = 0;
+    body[3] = 0;
+    body[4] = lifetime >> 8;
+    body[5] = lifetime & 0xff;
+    memcpy(&body[6], ctx->prefix, 8);
+    return 1;
+  }
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+int
+sicslowpan_6co_input(const uint8_t *body, uint8_t len)
+{
+  struct sicslowpan_addr_context *ctx;
+  uip_ipaddr_t prefix;
+  uint16_t lifetime;
+  uint8_t number;
+  uint8_t flags;
+  int changed;
+
+  /* Only contexts of up to 64 bits fit in our table. */
+  if(len < SICSLOWPAN_6CO_BODY_LEN || body[0] == 0 || body[0] > 64) {
+    return 0;
+  }
+  number = body[1] & 0x0f;
+  flags = SICSLOWPAN_CONTEXT_LEARNT;
+  if(body[1] & 0x10) {
+    flags |= SICSLOWPAN_CONTEXT_COMPRESS;
+  }
+  lifetime = ((uint16_t)body[4] << 8) | body[5];
+
+  memset(&prefix, 0, sizeof(prefix));
+  memcpy(&prefix, &body[6], (body[0] + 7) / 8);
+  if(body[0] & 7) {
+    prefix.u8[body[0] / 8] &= 0xff << (8 - (body[0] & 7));
+  }
+
+  /* A context we originate ourselves is not overridden by the copy our
+     neighbors advertise back to us. */
+  ctx = addr_context_lookup_by_number(number);
+  if(ctx != NULL && !(ctx->flags & SICSLOWPAN_CONTEXT_LEARNT)) {
+    return 0;
+  }
+  if(ctx == NULL) {
+    changed = lifetime != 0;
+  } else {
+    changed = lifetime == 0 || memcmp(ctx->prefix, &prefix, 8) != 0 ||
+      ((ctx->flags ^ flags) & SICSLOWPAN_CONTEXT_COMPRESS);
+  }
+
+  /* Learnt contexts always age, they live on only as long as our
+     parent keeps advertising them. */
+  if(lifetime == SICSLOWPAN_CONTEXT_INFINITE) {
+    lifetime--;
+  }
+  return sicslowpan_context_set(number, &prefix, lifetime, flags) && changed;
+}
+#endif /* SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 */
+/** @} */
 #endif /* SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC06 */
 
+#if SICSLOWPAN_COMPRESSION != SICSLOWPAN_COMPRESSION_HC06 || \
+  SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS == 0
+/* Without IPHC contexts there is nothing to install or advertise. */
+int
+sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix,
+                       uint16_t lifetime, uint8_t flags)
+{
+  return 0;
+}
+int
+sicslowpan_6co_get(int index, uint8_t *body)
+{
+  return 0;
+}
+int
+sicslowpan_6co_input(const uint8_t *body, uint8_t len)
+{
+  return 0;
+}
+#endif
+
 
 #if SICSLOWPAN_COMPRESSION == SICSLOWPAN_COMPRESSION_HC1
 /*--------------------------------------------------------------------*/
@@ -1314,6 +1538,46 @@ packet_sent(void *ptr, int status, int transmissions)
   }
   last_tx_status = status;
 }
+#ifndef SICSLOWPAN_CONF_PRIORITY
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Default MAC priority of the IPv6 packet in uip_buf: RPL and ND
+ * control messages first, TCP stream data last.
+ *
+ * RPL data and control packets may carry a hop-by-hop header, so the
+ * extension headers are skipped to find the upper layer protocol.
+ */
+static uint8_t
+packet_priority(void)
+{
+  uint8_t proto;
+  uint16_t offset;
+  struct uip_ext_hdr *ext;
+
+  proto = UIP_IP_BUF->proto;
+  offset = UIP_LLH_LEN + UIP_IPH_LEN;
+  while(proto == UIP_PROTO_HBHO || proto == UIP_PROTO_DESTO ||
+        proto == UIP_PROTO_ROUTING || proto == UIP_PROTO_FRAG) {
+    if(offset + sizeof(struct uip_ext_hdr) > UIP_LLH_LEN + uip_len) {
+      break;
+    }
+    ext = (struct uip_ext_hdr *)&uip_buf[offset];
+    /* The fragment header has a fixed size, the others count 8-octet
+       units beyond the first. */
+    offset += proto == UIP_PROTO_FRAG ? 8 : (ext->len + 1) << 3;
+    proto = ext->next;
+  }
+
+  if(proto == UIP_PROTO_ICMP6) {
+    return PACKETBUF_ATTR_PRIORITY_HIGH;
+  }
+  if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
+     PACKETBUF_ATTR_PACKET_TYPE_STREAM) {
+    return PACKETBUF_ATTR_PRIORITY_LOW;
+  }
+  return PACKETBUF_ATTR_PRIORITY_NORMAL;
+}
+#endif /* SICSLOWPAN_CONF_PRIORITY */
 /*--------------------------------------------------------------------*/
 /**
  * \brief This function is called by the 6lowpan code to send out a
@@ -1329,6 +1593,9 @@ send_packet(linkaddr_t *dest)
    */
   packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest);
 
+  /* The MAC layer serves packets by priority */
+  packetbuf_set_attr(PACKETBUF_ATTR_PRIORITY, SICSLOWPAN_PRIORITY());
+
 #if NETSTACK_CONF_BRIDGE_MODE
   /* This needs to be explicitly set here for bridge mode to work */
   packetbuf_set_addr(PACKETBUF_ADDR_SENDER,(void*)&uip_lladdr);
@@ -1873,6 +2140,8 @@ sicslowpan_init(void)
 #if SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS > 0 
   addr_contexts[0].used   = 1;
   addr_contexts[0].number = 0;
+  addr_contexts[0].flags  = SICSLOWPAN_CONTEXT_STATIC | SICSLOWPAN_CONTEXT_COMPRESS;
+  addr_contexts[0].lifetime = SICSLOWPAN_CONTEXT_INFINITE;
 #ifdef SICSLOWPAN_CONF_ADDR_CONTEXT_0
 	SICSLOWPAN_CONF_ADDR_CONTEXT_0;
 #else
@@ -1889,11 +2158,15 @@ sicslowpan_init(void)
 	  if (i==1) {
 	    addr_contexts[1].used   = 1;
 		addr_contexts[1].number = 1;
+		addr_contexts[1].flags  = SICSLOWPAN_CONTEXT_STATIC | SICSLOWPAN_CONTEXT_COMPRESS;
+		addr_contexts[1].lifetime = SICSLOWPAN_CONTEXT_INFINITE;
 		SICSLOWPAN_CONF_ADDR_CONTEXT_1;
 #ifdef SICSLOWPAN_CONF_ADDR_CONTEXT_2
       } else if (i==2) {
 	  	addr_contexts[2].used   = 1;
 		addr_contexts[2].number = 2;
+		addr_contexts[2].flags  = SICSLOWPAN_CONTEXT_STATIC | SICSLOWPAN_CONTEXT_COMPRESS;
+		addr_contexts[2].lifetime = SICSLOWPAN_CONTEXT_INFINITE;
 		SICSLOWPAN_CONF_ADDR_CONTEXT_2;
 #endif
       } else {
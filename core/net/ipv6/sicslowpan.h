@@ -221,9 +221,41 @@
 struct sicslowpan_addr_context {
   uint8_t used; /* possibly use as prefix-length */
   uint8_t number;
+  uint8_t flags;
+  uint16_t lifetime; /* minutes */
   uint8_t prefix[8];
 };
 
+/**
+ * \name Address context flags and lifetimes
+ * @{
+ */
+/** The context may be used to compress, not only to decompress */
+#define SICSLOWPAN_CONTEXT_COMPRESS   0x01
+/** Configured at compile time, never replaced or aged */
+#define SICSLOWPAN_CONTEXT_STATIC     0x02
+/** Learnt from a 6CO option, so it may be replaced by the next one */
+#define SICSLOWPAN_CONTEXT_LEARNT     0x04
+
+#define SICSLOWPAN_CONTEXT_INFINITE   0xffff
+/** @} */
+
+/**
+ * \brief Valid lifetime, in minutes, advertised in 6CO options. A node
+ * that stops hearing a context forgets it at most this long after.
+ */
+#ifdef SICSLOWPAN_CONF_CONTEXT_LIFETIME
+#define SICSLOWPAN_CONTEXT_LIFETIME   SICSLOWPAN_CONF_CONTEXT_LIFETIME
+#else
+#define SICSLOWPAN_CONTEXT_LIFETIME   60
+#endif
+
+/**
+ * \brief Length of a 6LoWPAN Context Option body (RFC 6775, section
+ * 4.2) carrying a 64-bit prefix, without the option type and length.
+ */
+#define SICSLOWPAN_6CO_BODY_LEN       14
+
 /**
  * \name Address compressibility test functions
  * @{
@@ -320,6 +352,30 @@ struct sicslowpan_nh_compressor {
 
 int sicslowpan_get_last_rssi(void);
 
+/**
+ * \brief Install, refresh or remove an address context.
+ * \param number The context ID, 0-15
+ * \param prefix The context prefix; only the first 64 bits are used
+ * \param lifetime Valid lifetime in minutes, 0 removes the context
+ * \param flags SICSLOWPAN_CONTEXT_COMPRESS if the context may be used
+ * for compression, SICSLOWPAN_CONTEXT_LEARNT if it came from a 6CO option
+ * \return 1 on success, 0 if the table is full or the context is static
+ */
+int sicslowpan_context_set(uint8_t number, const uip_ipaddr_t *prefix,
+                           uint16_t lifetime, uint8_t flags);
+
+/**
+ * \brief Write the body of the index:th 6CO option to advertise.
+ * \return 1 if body was filled in, 0 if there are no more contexts
+ */
+int sicslowpan_6co_get(int index, uint8_t *body);
+
+/**
+ * \brief Process the body of a received 6CO option.
+ * \return 1 if a context was added, changed or removed, 0 otherwise
+ */
+int sicslowpan_6co_input(const uint8_t *body, uint8_t len);
+
 extern const struct network_driver sicslowpan_driver;
 
 #endif /* SICSLOWPAN_H_ */
@@ -72,6 +72,7 @@
 #include "net/ipv6/uip-icmp6.h"
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
+#include "net/ipv6/sicslowpan.h"
 #include "lib/random.h"
 
 #if UIP_CONF_IPV6
@@ -716,6 +717,21 @@ uip_nd6_ra_output(uip_ipaddr_t * dest)
 
   uip_len += UIP_ND6_OPT_MTU_LEN;
   nd6_opt_offset += UIP_ND6_OPT_MTU_LEN;
+
+#if UIP_ND6_6CO
+  /* 6LoWPAN contexts */
+  {
+    int i;
+    for(i = 0; sicslowpan_6co_get(i, (uint8_t *)UIP_ND6_OPT_HDR_BUF +
+                                  UIP_ND6_OPT_HDR_LEN); i++) {
+      UIP_ND6_OPT_HDR_BUF->type = UIP_ND6_OPT_6CO;
+      UIP_ND6_OPT_HDR_BUF->len = UIP_ND6_OPT_6CO_LEN >> 3;
+      uip_len += UIP_ND6_OPT_6CO_LEN;
+      nd6_opt_offset += UIP_ND6_OPT_6CO_LEN;
+    }
+  }
+#endif /* UIP_ND6_6CO */
+
   UIP_IP_BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
   UIP_IP_BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
 
@@ -853,6 +869,13 @@ ra_input(void)
       uip_ds6_if.link_mtu =
         uip_ntohl(((uip_nd6_opt_mtu *) UIP_ND6_OPT_HDR_BUF)->mtu);
       break;
+#if UIP_ND6_6CO
+    case UIP_ND6_OPT_6CO:
+      PRINTF("Processing 6CO option in RA\n");
+      sicslowpan_6co_input((uint8_t *)UIP_ND6_OPT_HDR_BUF + UIP_ND6_OPT_HDR_LEN,
+                           (UIP_ND6_OPT_HDR_BUF->len << 3) - UIP_ND6_OPT_HDR_LEN);
+      break;
+#endif /* UIP_ND6_6CO */
     case UIP_ND6_OPT_PREFIX_INFO:
       PRINTF("Processing PREFIX option in RA\n");
       nd6_opt_prefix_info = (uip_nd6_opt_prefix_info *) UIP_ND6_OPT_HDR_BUF;
@@ -76,6 +76,12 @@
 #else
 #define UIP_ND6_SEND_NA UIP_CONF_ND6_SEND_NA
 #endif
+/* Carry the dynamic 6LoWPAN compression contexts in RAs (RFC 6775) */
+#ifndef UIP_CONF_ND6_6CO
+#define UIP_ND6_6CO                         0
+#else
+#define UIP_ND6_6CO UIP_CONF_ND6_6CO
+#endif
 #define UIP_ND6_MAX_RA_INTERVAL             600
 #define UIP_ND6_MIN_RA_INTERVAL             (UIP_ND6_MAX_RA_INTERVAL / 3)
 #define UIP_ND6_M_FLAG                      0
@@ -134,6 +140,7 @@
 #define UIP_ND6_OPT_PREFIX_INFO         3
 #define UIP_ND6_OPT_REDIRECTED_HDR      4
 #define UIP_ND6_OPT_MTU                 5
+#define UIP_ND6_OPT_6CO                 34
 /** @} */
 
 /** \name ND6 option types */
@@ -156,6 +163,7 @@
 #define UIP_ND6_OPT_HDR_LEN            2
 #define UIP_ND6_OPT_PREFIX_INFO_LEN    32
 #define UIP_ND6_OPT_MTU_LEN            8
+#define UIP_ND6_OPT_6CO_LEN            16
 
 
 /* Length of TLLAO and SLLAO options, it is L2 dependant */
@@ -117,12 +117,24 @@ struct hdr {
 #define SYNC_CYCLE_STARTS                    1
 #endif
 
+/* Send the frames queued for a neighbor back-to-back after a single
+   wake-up, with the frame pending bit set on all but the last one. */
+#ifdef CONTIKIMAC_CONF_WITH_BURST
+#define WITH_BURST                   CONTIKIMAC_CONF_WITH_BURST
+#else
+#define WITH_BURST                   1
+#endif
+
 /* Are we currently receiving a burst? */
 static int we_are_receiving_burst = 0;
 
 /* INTER_PACKET_DEADLINE is the maximum time a receiver waits for the
    next packet of a burst when FRAME_PENDING is set. */
+#ifdef CONTIKIMAC_CONF_INTER_PACKET_DEADLINE
+#define INTER_PACKET_DEADLINE               CONTIKIMAC_CONF_INTER_PACKET_DEADLINE
+#else
 #define INTER_PACKET_DEADLINE               CLOCK_SECOND / 32
+#endif
 
 /* ContikiMAC performs periodic channel checks. Each channel check
    consists of two or more CCA checks. CCA_COUNT_MAX is the number of
@@ -888,6 +900,13 @@ qsend_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
 
     /* Prepare the packetbuf */
     queuebuf_to_packetbuf(curr->buf);
+    if(!WITH_BURST ||
+       linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER), &linkaddr_null)) {
+      /* Broadcasts are not acked, so a burst would keep all neighbors
+         awake without knowing if they got the previous frames. The
+         rest of the list is sent by the MAC layer later. */
+      next = NULL;
+    }
     if(next != NULL) {
       packetbuf_set_attr(PACKETBUF_ATTR_PENDING, 1);
     }
@@ -50,6 +50,7 @@
 
 #include "lib/list.h"
 #include "lib/memb.h"
+#include "net/nbr-table.h"
 
 #include <string.h>
 
@@ -84,35 +85,65 @@
 #error Change CSMA_CONF_MAX_MAC_TRANSMISSIONS in contiki-conf.h or in your Makefile.
 #endif /* CSMA_CONF_MAX_MAC_TRANSMISSIONS < 1 */
 
+/* Packets of the other classes leave this many packet buffers to
+   control traffic */
+#ifdef CSMA_CONF_CONTROL_RESERVE
+#define CSMA_CONTROL_RESERVE CSMA_CONF_CONTROL_RESERVE
+#else
+#define CSMA_CONTROL_RESERVE 1
+#endif /* CSMA_CONF_CONTROL_RESERVE */
+
 /* Packet metadata */
 struct qbuf_metadata {
   mac_callback_t sent;
   void *cptr;
   uint8_t max_transmissions;
+  uint8_t class;
+#if CSMA_CONF_STATS
+  clock_time_t enqueued;
+#endif /* CSMA_CONF_STATS */
+};
+
+/* Neighbor queue states */
+enum {
+  QUEUE_READY,      /* Waiting for the scheduler */
+  QUEUE_SENDING,    /* Handed over to the RDC layer */
+  QUEUE_BACKOFF,    /* Waiting for a retransmission */
 };
 
-/* Every neighbor has its own packet queue */
+/* Every neighbor has its own packet queue, kept in the neighbor table
+   while it holds packets. The packets are sorted by class. Broadcast
+   packets are queued under the null address, so while broadcasts are
+   pending they take one entry of the neighbor table, which all tables
+   share: when the table is full this evicts the oldest unlocked entry,
+   e.g. an ND neighbor. NBR_TABLE_CONF_MAX_NEIGHBORS should count one
+   extra entry for it. */
 struct neighbor_queue {
-  struct neighbor_queue *next;
-  linkaddr_t addr;
   struct ctimer transmit_timer;
+  uint16_t served;
+  uint8_t state;
   uint8_t transmissions;
   uint8_t collisions, deferrals;
   LIST_STRUCT(queued_packet_list);
 };
 
-/* The maximum number of co-existing neighbor queues */
-#ifdef CSMA_CONF_MAX_NEIGHBOR_QUEUES
-#define CSMA_MAX_NEIGHBOR_QUEUES CSMA_CONF_MAX_NEIGHBOR_QUEUES
-#else
-#define CSMA_MAX_NEIGHBOR_QUEUES 2
-#endif /* CSMA_CONF_MAX_NEIGHBOR_QUEUES */
-
 #define MAX_QUEUED_PACKETS QUEUEBUF_NUM
-MEMB(neighbor_memb, struct neighbor_queue, CSMA_MAX_NEIGHBOR_QUEUES);
+NBR_TABLE(struct neighbor_queue, neighbor_queues);
 MEMB(packet_memb, struct rdc_buf_list, MAX_QUEUED_PACKETS);
 MEMB(metadata_memb, struct qbuf_metadata, MAX_QUEUED_PACKETS);
-LIST(neighbor_list);
+static uint8_t queued_packets;
+
+/* The scheduler serves the neighbor whose first packet has the best
+   class; within a class, the neighbor that was served the longest ago. */
+static struct ctimer schedule_timer;
+static uint16_t service_counter;
+
+#if CSMA_CONF_STATS
+struct csma_stats csma_stats[CSMA_NUM_CLASSES];
+#define CSMA_STATS_ADD(class, field, v) csma_stats[class].field += (v)
+#else
+#define CSMA_STATS_ADD(class, field, v)
+#endif /* CSMA_CONF_STATS */
 
 static void packet_sent(void *ptr, int status, int num_transmissions);
 static void transmit_packet_list(void *ptr);
@@ -121,14 +152,13 @@ static void transmit_packet_list(void *ptr);
 static struct neighbor_queue *
 neighbor_queue_from_addr(const linkaddr_t *addr)
 {
-  struct neighbor_queue *n = list_head(neighbor_list);
-  while(n != NULL) {
-    if(linkaddr_cmp(&n->addr, addr)) {
-      return n;
-    }
-    n = list_item_next(n);
-  }
-  return NULL;
+  return nbr_table_get_from_lladdr(neighbor_queues, addr);
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+packet_class(struct rdc_buf_list *q)
+{
+  return ((struct qbuf_metadata *)q->ptr)->class;
 }
 /*---------------------------------------------------------------------------*/
 static clock_time_t
@@ -148,6 +178,65 @@ default_timebase(void)
   return time;
 }
 /*---------------------------------------------------------------------------*/
+static struct neighbor_queue *
+next_neighbor(void)
+{
+  struct neighbor_queue *n;
+  struct neighbor_queue *best;
+  struct rdc_buf_list *q;
+
+  best = NULL;
+  for(n = nbr_table_head(neighbor_queues); n != NULL;
+      n = nbr_table_next(neighbor_queues, n)) {
+    q = list_head(n->queued_packet_list);
+    if(n->state != QUEUE_READY || q == NULL) {
+      continue;
+    }
+    if(best == NULL ||
+       packet_class(q) < packet_class(list_head(best->queued_packet_list)) ||
+       (packet_class(q) == packet_class(list_head(best->queued_packet_list)) &&
+        (int16_t)(n->served - best->served) < 0)) {
+      best = n;
+    }
+  }
+  return best;
+}
+/*---------------------------------------------------------------------------*/
+static void
+run_scheduler(void *ptr)
+{
+  struct neighbor_queue *n;
+
+  n = next_neighbor();
+  if(n != NULL) {
+    n->state = QUEUE_SENDING;
+    n->served = ++service_counter;
+    transmit_packet_list(n);
+    /* Each neighbor has at most one frame list in flight, but several
+       neighbors may: the RDC layer may not be done with n yet, so let
+       the next ready neighbor go from a fresh timer callback. */
+    if(next_neighbor() != NULL) {
+      ctimer_set(&schedule_timer, 0, run_scheduler, NULL);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+schedule(void)
+{
+  /* Always from a timer: this may be called from within the RDC layer */
+  ctimer_set(&schedule_timer, 0, run_scheduler, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+backoff_expired(void *ptr)
+{
+  struct neighbor_queue *n = ptr;
+
+  n->state = QUEUE_READY;
+  schedule();
+}
+/*---------------------------------------------------------------------------*/
 static void
 transmit_packet_list(void *ptr)
 {
@@ -163,33 +252,31 @@ transmit_packet_list(void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
-static void
+/* Returns 1 if the neighbor still has packets queued, 0 if it was
+   removed. */
+static int
 free_packet(struct neighbor_queue *n, struct rdc_buf_list *p)
 {
-  if(p != NULL) {
-    /* Remove packet from list and deallocate */
-    list_remove(n->queued_packet_list, p);
-
-    queuebuf_free(p->buf);
-    memb_free(&metadata_memb, p->ptr);
-    memb_free(&packet_memb, p);
-    PRINTF("csma: free_queued_packet, queue length %d\n",
-        list_length(n->queued_packet_list));
-    if(list_head(n->queued_packet_list) != NULL) {
-      /* There is a next packet. We reset current tx information */
-      n->transmissions = 0;
-      n->collisions = 0;
-      n->deferrals = 0;
-      /* Set a timer for next transmissions */
-      ctimer_set(&n->transmit_timer, default_timebase(),
-                 transmit_packet_list, n);
-    } else {
-      /* This was the last packet in the queue, we free the neighbor */
-      ctimer_stop(&n->transmit_timer);
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
-    }
+  /* Remove packet from list and deallocate */
+  list_remove(n->queued_packet_list, p);
+
+  queuebuf_free(p->buf);
+  memb_free(&metadata_memb, p->ptr);
+  memb_free(&packet_memb, p);
+  queued_packets--;
+  PRINTF("csma: free_queued_packet, queue length %d\n",
+         list_length(n->queued_packet_list));
+  if(list_head(n->queued_packet_list) != NULL) {
+    /* There is a next packet. We reset current tx information */
+    n->transmissions = 0;
+    n->collisions = 0;
+    n->deferrals = 0;
+    return 1;
   }
+  /* This was the last packet in the queue, we free the neighbor */
+  ctimer_stop(&n->transmit_timer);
+  nbr_table_remove(neighbor_queues, n);
+  return 0;
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -231,84 +318,114 @@ packet_sent(void *ptr, int status, int num_transmissions)
     }
   }
 
-  if(q != NULL) {
-    metadata = (struct qbuf_metadata *)q->ptr;
-
-    if(metadata != NULL) {
-      sent = metadata->sent;
-      cptr = metadata->cptr;
-      num_tx = n->transmissions;
-      if(status == MAC_TX_COLLISION ||
-         status == MAC_TX_NOACK) {
-
-        /* If the transmission was not performed because of a
-           collision or noack, we must retransmit the packet. */
-
-        switch(status) {
-        case MAC_TX_COLLISION:
-          PRINTF("csma: rexmit collision %d\n", n->transmissions);
-          break;
-        case MAC_TX_NOACK:
-          PRINTF("csma: rexmit noack %d\n", n->transmissions);
-          break;
-        default:
-          PRINTF("csma: rexmit err %d, %d\n", status, n->transmissions);
-        }
-
-        /* The retransmission time must be proportional to the channel
-           check interval of the underlying radio duty cycling layer. */
-        time = default_timebase();
-
-        /* The retransmission time uses a truncated exponential backoff
-         * so that the interval between the transmissions increase with
-         * each retransmit. */
-        backoff_exponent = num_tx;
-
-        /* Truncate the exponent if needed. */
-        if(backoff_exponent > CSMA_MAX_BACKOFF_EXPONENT) {
-          backoff_exponent = CSMA_MAX_BACKOFF_EXPONENT;
-        }
-
-        /* Proceed to exponentiation. */
-        backoff_transmissions = 1 << backoff_exponent;
-
-        /* Pick a time for next transmission, within the interval:
-         * [time, time + 2^backoff_exponent * time[ */
-        time = time + (random_rand() % (backoff_transmissions * time));
-
-        if(n->transmissions < metadata->max_transmissions) {
-          PRINTF("csma: retransmitting with time %lu %p\n", time, q);
-          ctimer_set(&n->transmit_timer, time,
-                     transmit_packet_list, n);
-          /* This is needed to correctly attribute energy that we spent
-             transmitting this packet. */
-          queuebuf_update_attr_from_packetbuf(q->buf);
-        } else {
-          PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
-                 status, n->transmissions, n->collisions);
-          free_packet(n, q);
-          mac_call_sent_callback(sent, cptr, status, num_tx);
-        }
-      } else {
-        if(status == MAC_TX_OK) {
-          PRINTF("csma: rexmit ok %d\n", n->transmissions);
-        } else {
-          PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
-        }
-        free_packet(n, q);
-        mac_call_sent_callback(sent, cptr, status, num_tx);
-      }
+  if(q == NULL || q->ptr == NULL) {
+    if(n->state == QUEUE_SENDING) {
+      n->state = QUEUE_READY;
+      schedule();
     }
+    return;
   }
+
+  metadata = (struct qbuf_metadata *)q->ptr;
+  sent = metadata->sent;
+  cptr = metadata->cptr;
+  num_tx = n->transmissions;
+  if(status == MAC_TX_COLLISION ||
+     status == MAC_TX_NOACK) {
+
+    /* If the transmission was not performed because of a
+       collision or noack, we must retransmit the packet. */
+
+    switch(status) {
+    case MAC_TX_COLLISION:
+      PRINTF("csma: rexmit collision %d\n", n->transmissions);
+      break;
+    case MAC_TX_NOACK:
+      PRINTF("csma: rexmit noack %d\n", n->transmissions);
+      break;
+    default:
+      PRINTF("csma: rexmit err %d, %d\n", status, n->transmissions);
+    }
+
+    /* The retransmission time must be proportional to the channel
+       check interval of the underlying radio duty cycling layer. */
+    time = default_timebase();
+
+    /* The retransmission time uses a truncated exponential backoff
+     * so that the interval between the transmissions increase with
+     * each retransmit. */
+    backoff_exponent = num_tx;
+
+    /* Truncate the exponent if needed. */
+    if(backoff_exponent > CSMA_MAX_BACKOFF_EXPONENT) {
+      backoff_exponent = CSMA_MAX_BACKOFF_EXPONENT;
+    }
+
+    /* Proceed to exponentiation. */
+    backoff_transmissions = 1 << backoff_exponent;
+
+    /* Pick a time for next transmission, within the interval:
+     * [time, time + 2^backoff_exponent * time[ */
+    time = time + (random_rand() % (backoff_transmissions * time));
+
+    if(n->transmissions < metadata->max_transmissions) {
+      PRINTF("csma: retransmitting with time %lu %p\n", time, q);
+      n->state = QUEUE_BACKOFF;
+      ctimer_set(&n->transmit_timer, time, backoff_expired, n);
+      /* This is needed to correctly attribute energy that we spent
+         transmitting this packet. */
+      queuebuf_update_attr_from_packetbuf(q->buf);
+      return;
+    }
+    PRINTF("csma: drop with status %d after %d transmissions, %d collisions\n",
+           status, n->transmissions, n->collisions);
+  } else {
+    if(status == MAC_TX_OK) {
+      PRINTF("csma: rexmit ok %d\n", n->transmissions);
+    } else {
+      PRINTF("csma: rexmit failed %d: %d\n", n->transmissions, status);
+    }
+  }
+
+  if(status == MAC_TX_OK) {
+    CSMA_STATS_ADD(metadata->class, sent, 1);
+#if CSMA_CONF_STATS
+    time = clock_time() - metadata->enqueued;
+    CSMA_STATS_ADD(metadata->class, total_delay, time);
+    if(time > csma_stats[metadata->class].max_delay) {
+      csma_stats[metadata->class].max_delay = time;
+    }
+#endif /* CSMA_CONF_STATS */
+  } else {
+    CSMA_STATS_ADD(metadata->class, dropped, 1);
+  }
+
+  if(free_packet(n, q)) {
+    if(status == MAC_TX_OK) {
+      /* The neighbor just acked a frame, so there is no reason to back
+         off before the next one. With ContikiMAC this turns frames
+         queued during a burst into the next burst. */
+      n->state = QUEUE_READY;
+      schedule();
+    } else {
+      n->state = QUEUE_BACKOFF;
+      ctimer_set(&n->transmit_timer, default_timebase(), backoff_expired, n);
+    }
+  }
+  mac_call_sent_callback(sent, cptr, status, num_tx);
 }
 /*---------------------------------------------------------------------------*/
 static void
 send_packet(mac_callback_t sent, void *ptr)
 {
   struct rdc_buf_list *q;
+  struct rdc_buf_list *p;
+  struct rdc_buf_list *prev;
   struct neighbor_queue *n;
+  struct qbuf_metadata *metadata;
   static uint8_t initialized = 0;
   static uint16_t seqno;
+  uint8_t class;
   const linkaddr_t *addr = packetbuf_addr(PACKETBUF_ADDR_RECEIVER);
 
   if(!initialized) {
@@ -324,21 +441,41 @@ send_packet(mac_callback_t sent, void *ptr)
   }
   packetbuf_set_attr(PACKETBUF_ATTR_MAC_SEQNO, seqno++);
 
+  if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
+     PACKETBUF_ATTR_PACKET_TYPE_ACK ||
+     packetbuf_attr(PACKETBUF_ATTR_PRIORITY) == PACKETBUF_ATTR_PRIORITY_HIGH) {
+    class = CSMA_CLASS_CONTROL;
+  } else if(packetbuf_attr(PACKETBUF_ATTR_PRIORITY) ==
+            PACKETBUF_ATTR_PRIORITY_LOW) {
+    class = CSMA_CLASS_BULK;
+  } else {
+    class = CSMA_CLASS_DEFAULT;
+  }
+
+  if(class != CSMA_CLASS_CONTROL &&
+     queued_packets >= MAX_QUEUED_PACKETS - CSMA_CONTROL_RESERVE) {
+    PRINTF("csma: queue full for class %u, dropping packet\n", class);
+    CSMA_STATS_ADD(class, dropped, 1);
+    mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
+    return;
+  }
+
   /* Look for the neighbor entry */
   n = neighbor_queue_from_addr(addr);
   if(n == NULL) {
     /* Allocate a new neighbor entry */
-    n = memb_alloc(&neighbor_memb);
+    n = nbr_table_add_lladdr(neighbor_queues, addr);
     if(n != NULL) {
-      /* Init neighbor entry */
-      linkaddr_copy(&n->addr, addr);
+      /* Keep the entry while it has packets queued */
+      nbr_table_lock(neighbor_queues, n);
+      n->state = QUEUE_READY;
+      /* New neighbors get in line behind the ones already waiting */
+      n->served = service_counter;
       n->transmissions = 0;
       n->collisions = 0;
       n->deferrals = 0;
       /* Init packet list for this neighbor */
       LIST_STRUCT_INIT(n, queued_packet_list);
-      /* Add neighbor to the list */
-      list_add(neighbor_list, n);
     }
   }
 
@@ -350,7 +487,7 @@ send_packet(mac_callback_t sent, void *ptr)
       if(q->ptr != NULL) {
 	q->buf = queuebuf_new_from_packetbuf();
 	if(q->buf != NULL) {
-	  struct qbuf_metadata *metadata = (struct qbuf_metadata *)q->ptr;
+	  metadata = (struct qbuf_metadata *)q->ptr;
 	  /* Neighbor and packet successfully allocated */
 	  if(packetbuf_attr(PACKETBUF_ATTR_MAX_MAC_TRANSMISSIONS) == 0) {
 	    /* Use default configuration for max transmissions */
@@ -361,17 +498,31 @@ send_packet(mac_callback_t sent, void *ptr)
 	  }
 	  metadata->sent = sent;
 	  metadata->cptr = ptr;
-
-	  if(packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE) ==
-	     PACKETBUF_ATTR_PACKET_TYPE_ACK) {
+	  metadata->class = class;
+#if CSMA_CONF_STATS
+	  metadata->enqueued = clock_time();
+#endif /* CSMA_CONF_STATS */
+
+	  /* Queue the packet behind those of the same or a better class.
+	     The first packet stays first while it is being sent. */
+	  prev = NULL;
+	  for(p = list_head(n->queued_packet_list); p != NULL;
+	      p = list_item_next(p)) {
+	    if(packet_class(p) > class &&
+	       (prev != NULL || n->state == QUEUE_READY)) {
+	      break;
+	    }
+	    prev = p;
+	  }
+	  if(prev == NULL) {
 	    list_push(n->queued_packet_list, q);
 	  } else {
-	    list_add(n->queued_packet_list, q);
+	    list_insert(n->queued_packet_list, prev, q);
 	  }
+	  queued_packets++;
 
-	  /* If q is the first packet in the neighbor's queue, send asap */
-	  if(list_head(n->queued_packet_list) == q) {
-	    ctimer_set(&n->transmit_timer, 0, transmit_packet_list, n);
+	  if(n->state == QUEUE_READY) {
+	    schedule();
 	  }
 	  return;
 	}
@@ -383,13 +534,13 @@ send_packet(mac_callback_t sent, void *ptr)
     }
     /* The packet allocation failed. Remove and free neighbor entry if empty. */
     if(list_length(n->queued_packet_list) == 0) {
-      list_remove(neighbor_list, n);
-      memb_free(&neighbor_memb, n);
+      nbr_table_remove(neighbor_queues, n);
     }
     PRINTF("csma: could not allocate packet, dropping packet\n");
   } else {
     PRINTF("csma: could not allocate neighbor, dropping packet\n");
   }
+  CSMA_STATS_ADD(class, dropped, 1);
   mac_call_sent_callback(sent, ptr, MAC_TX_ERR, 1);
 }
 /*---------------------------------------------------------------------------*/
@@ -425,7 +576,7 @@ init(void)
 {
   memb_init(&packet_memb);
   memb_init(&metadata_memb);
-  memb_init(&neighbor_memb);
+  nbr_table_register(neighbor_queues, NULL);
 }
 /*---------------------------------------------------------------------------*/
 const struct mac_driver csma_driver = {
@@ -43,6 +43,32 @@
 
 #include "net/mac/mac.h"
 #include "dev/radio.h"
+#include "sys/clock.h"
+
+/* Traffic classes, served in this order. Packets get their class from
+   PACKETBUF_ATTR_PRIORITY: high priority packets and link layer acks
+   are control traffic, low priority packets are bulk traffic. Within a
+   class, the neighbors are served round-robin. */
+#define CSMA_CLASS_CONTROL 0
+#define CSMA_CLASS_DEFAULT 1
+#define CSMA_CLASS_BULK    2
+#define CSMA_NUM_CLASSES   3
+
+#ifndef CSMA_CONF_STATS
+#define CSMA_CONF_STATS 0
+#endif /* CSMA_CONF_STATS */
+
+#if CSMA_CONF_STATS
+struct csma_stats {
+  uint16_t sent;          /* Packets acked, or sent if broadcast */
+  uint16_t dropped;       /* Packets dropped, queue full or no ack */
+  clock_time_t max_delay; /* Longest time from queued to sent */
+  uint32_t total_delay;   /* Sum of the time from queued to sent */
+};
+
+/* Per-class counters, indexed by CSMA_CLASS_* */
+extern struct csma_stats csma_stats[CSMA_NUM_CLASSES];
+#endif /* CSMA_CONF_STATS */
 
 extern const struct mac_driver csma_driver;
 
@@ -0,0 +1,208 @@
+/**
+ * \addtogroup rdc
+ * @{
+ */
+/**
+ * \file
+ *         TSCH slotframes and links
+ */
+
+#include "contiki.h"
+#include "lib/list.h"
+#include "lib/memb.h"
+#include "net/mac/tsch/tsch-schedule.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+MEMB(slotframe_memb, struct tsch_slotframe, TSCH_SCHEDULE_MAX_SLOTFRAMES);
+MEMB(link_memb, struct tsch_link, TSCH_SCHEDULE_MAX_LINKS);
+/* Sorted by handle */
+LIST(slotframe_list);
+
+/*---------------------------------------------------------------------------*/
+void
+tsch_schedule_init(void)
+{
+  memb_init(&slotframe_memb);
+  memb_init(&link_memb);
+  list_init(slotframe_list);
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_slotframe *
+tsch_schedule_get_slotframe(uint16_t handle)
+{
+  struct tsch_slotframe *sf;
+
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    if(sf->handle == handle) {
+      return sf;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_slotframe *
+tsch_schedule_add_slotframe(uint16_t handle, uint16_t size)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_slotframe *s;
+  struct tsch_slotframe *prev;
+
+  if(size == 0 || tsch_schedule_get_slotframe(handle) != NULL) {
+    return NULL;
+  }
+  sf = memb_alloc(&slotframe_memb);
+  if(sf == NULL) {
+    PRINTF("tsch-schedule: no room for slotframe %u\n", handle);
+    return NULL;
+  }
+  sf->handle = handle;
+  sf->size = size;
+  LIST_STRUCT_INIT(sf, links_list);
+
+  /* Keep the list sorted by handle, the lowest handle has priority */
+  prev = NULL;
+  for(s = list_head(slotframe_list); s != NULL && s->handle < handle;
+      s = list_item_next(s)) {
+    prev = s;
+  }
+  if(prev == NULL) {
+    list_push(slotframe_list, sf);
+  } else {
+    list_insert(slotframe_list, prev, sf);
+  }
+  PRINTF("tsch-schedule: add slotframe %u size %u\n", handle, size);
+  return sf;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe)
+{
+  struct tsch_link *l;
+
+  if(slotframe == NULL) {
+    return 0;
+  }
+  while((l = list_pop(slotframe->links_list)) != NULL) {
+    memb_free(&link_memb, l);
+  }
+  list_remove(slotframe_list, slotframe);
+  memb_free(&slotframe_memb, slotframe);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_link *
+tsch_schedule_add_link(struct tsch_slotframe *slotframe,
+                       uint8_t link_options, const linkaddr_t *addr,
+                       uint16_t timeslot, uint16_t channel_offset)
+{
+  struct tsch_link *l;
+
+  if(slotframe == NULL || timeslot >= slotframe->size) {
+    return NULL;
+  }
+  /* One link per timeslot and slotframe */
+  for(l = list_head(slotframe->links_list); l != NULL; l = list_item_next(l)) {
+    if(l->timeslot == timeslot) {
+      list_remove(slotframe->links_list, l);
+      break;
+    }
+  }
+  if(l == NULL) {
+    l = memb_alloc(&link_memb);
+    if(l == NULL) {
+      PRINTF("tsch-schedule: no room for link\n");
+      return NULL;
+    }
+  }
+  linkaddr_copy(&l->addr, addr != NULL ? addr : &linkaddr_null);
+  l->timeslot = timeslot;
+  l->channel_offset = channel_offset;
+  l->link_options = link_options;
+  list_add(slotframe->links_list, l);
+  PRINTF("tsch-schedule: add link sf %u ts %u ch %u opt %x\n",
+         slotframe->handle, timeslot, channel_offset, link_options);
+  return l;
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_schedule_remove_link(struct tsch_slotframe *slotframe,
+                          struct tsch_link *link)
+{
+  if(slotframe == NULL || link == NULL) {
+    return 0;
+  }
+  list_remove(slotframe->links_list, link);
+  memb_free(&link_memb, link);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+struct tsch_link *
+tsch_schedule_get_link(const struct tsch_asn *asn, uint16_t *time_offset)
+{
+  struct tsch_slotframe *sf;
+  struct tsch_link *l;
+  struct tsch_link *active;
+  uint16_t timeslot;
+  uint16_t offset;
+
+  active = NULL;
+  *time_offset = 0xffff;
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    timeslot = TSCH_ASN_MOD(*asn, sf->size);
+    for(l = list_head(sf->links_list); l != NULL; l = list_item_next(l)) {
+      if(l->timeslot == timeslot && active == NULL) {
+        active = l;
+      }
+      /* Timeslots until this link is active again, 1 to size */
+      offset = (l->timeslot + sf->size - timeslot - 1) % sf->size + 1;
+      if(offset < *time_offset) {
+        *time_offset = offset;
+      }
+    }
+  }
+  if(*time_offset == 0xffff) {
+    /* Empty schedule, check again a slotframe later */
+    *time_offset = TSCH_SCHEDULE_DEFAULT_LENGTH;
+  }
+  return active;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+tsch_schedule_max_size(void)
+{
+  struct tsch_slotframe *sf;
+  uint16_t size;
+
+  size = 0;
+  for(sf = list_head(slotframe_list); sf != NULL; sf = list_item_next(sf)) {
+    if(sf->size > size) {
+      size = sf->size;
+    }
+  }
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_schedule_create_minimal(void)
+{
+  struct tsch_slotframe *sf;
+
+  sf = tsch_schedule_get_slotframe(0);
+  if(sf != NULL) {
+    tsch_schedule_remove_slotframe(sf);
+  }
+  sf = tsch_schedule_add_slotframe(0, TSCH_SCHEDULE_DEFAULT_LENGTH);
+  tsch_schedule_add_link(sf,
+                         LINK_OPTION_TX | LINK_OPTION_RX |
+                         LINK_OPTION_SHARED | LINK_OPTION_TIME_KEEPING,
+                         &linkaddr_null, 0, 0);
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
@@ -0,0 +1,104 @@
+/**
+ * \addtogroup rdc
+ * @{
+ */
+/**
+ * \file
+ *         TSCH slotframes and links
+ *
+ *         A slotframe is a number of timeslots that repeats over time.
+ *         Each link of a slotframe allocates one of its timeslots and a
+ *         channel offset for transmitting to a neighbor, or to anyone
+ *         for broadcast links, and/or for listening. When slotframes
+ *         overlap, the one with the lowest handle wins.
+ */
+
+#ifndef TSCH_SCHEDULE_H_
+#define TSCH_SCHEDULE_H_
+
+#include "contiki-conf.h"
+#include "lib/list.h"
+#include "net/linkaddr.h"
+#include "net/mac/tsch/tsch.h"
+
+#ifdef TSCH_SCHEDULE_CONF_MAX_SLOTFRAMES
+#define TSCH_SCHEDULE_MAX_SLOTFRAMES TSCH_SCHEDULE_CONF_MAX_SLOTFRAMES
+#else
+#define TSCH_SCHEDULE_MAX_SLOTFRAMES 2
+#endif
+
+#ifdef TSCH_SCHEDULE_CONF_MAX_LINKS
+#define TSCH_SCHEDULE_MAX_LINKS      TSCH_SCHEDULE_CONF_MAX_LINKS
+#else
+#define TSCH_SCHEDULE_MAX_LINKS      8
+#endif
+
+/* Length of the slotframe of the minimal schedule (6TiSCH minimal):
+   one shared timeslot every TSCH_SCHEDULE_DEFAULT_LENGTH. */
+#ifdef TSCH_SCHEDULE_CONF_DEFAULT_LENGTH
+#define TSCH_SCHEDULE_DEFAULT_LENGTH TSCH_SCHEDULE_CONF_DEFAULT_LENGTH
+#else
+#define TSCH_SCHEDULE_DEFAULT_LENGTH 7
+#endif
+
+/* Link options */
+#define LINK_OPTION_TX              0x01
+#define LINK_OPTION_RX              0x02
+#define LINK_OPTION_SHARED          0x04
+#define LINK_OPTION_TIME_KEEPING    0x08
+
+struct tsch_link {
+  struct tsch_link *next;
+  /* The neighbor, linkaddr_null for broadcast and shared links */
+  linkaddr_t addr;
+  uint16_t timeslot;
+  uint16_t channel_offset;
+  uint8_t link_options;
+};
+
+struct tsch_slotframe {
+  struct tsch_slotframe *next;
+  uint16_t handle;
+  uint16_t size;
+  LIST_STRUCT(links_list);
+};
+
+void tsch_schedule_init(void);
+
+/**
+ * \brief Create the minimal schedule: a single slotframe of
+ * TSCH_SCHEDULE_DEFAULT_LENGTH timeslots with one shared link for all
+ * traffic, including EBs, at timeslot 0 and channel offset 0.
+ */
+void tsch_schedule_create_minimal(void);
+
+struct tsch_slotframe *tsch_schedule_add_slotframe(uint16_t handle,
+                                                   uint16_t size);
+struct tsch_slotframe *tsch_schedule_get_slotframe(uint16_t handle);
+int tsch_schedule_remove_slotframe(struct tsch_slotframe *slotframe);
+
+struct tsch_link *tsch_schedule_add_link(struct tsch_slotframe *slotframe,
+                                         uint8_t link_options,
+                                         const linkaddr_t *addr,
+                                         uint16_t timeslot,
+                                         uint16_t channel_offset);
+int tsch_schedule_remove_link(struct tsch_slotframe *slotframe,
+                              struct tsch_link *link);
+
+/**
+ * \brief Find the link active at a given ASN.
+ * \param asn The ASN
+ * \param time_offset Set to the number of timeslots from asn to the
+ * next timeslot that has an active link, at least 1
+ * \return The active link, or NULL if the timeslot is idle
+ */
+struct tsch_link *tsch_schedule_get_link(const struct tsch_asn *asn,
+                                         uint16_t *time_offset);
+
+/**
+ * \brief Length of the longest slotframe, in timeslots.
+ */
+uint16_t tsch_schedule_max_size(void);
+
+#endif /* TSCH_SCHEDULE_H_ */
+/** @} */
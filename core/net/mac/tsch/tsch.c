@@ -0,0 +1,775 @@
+/**
+ * \addtogroup rdc
+ * @{
+ */
+/**
+ * \file
+ *         Time-slotted channel hopping (IEEE 802.15.4e TSCH) RDC driver
+ *
+ *         The timeslots are run by a protothread from the rtimer: it
+ *         sets the rtimer for the waits within a timeslot and only
+ *         busy-waits the short ones and the ACK, which the radio driver
+ *         process would otherwise read first. Frames are received
+ *         through the radio driver and packet_input() as usual; the
+ *         timeslot operation only keeps the radio on when a frame is
+ *         expected. The radio driver sets PACKETBUF_ATTR_TIMESTAMP to the
+ *         low 16 bits of the rtimer at the SFD of the frame, as
+ *         cc2538-rf and cooja-radio do, for the synchronization on EBs
+ *         and the drift correction.
+ *
+ *         EBs carry the ASN, the join priority and the slotframe length
+ *         of the sender in the beacon payload. This follows the contents
+ *         of the 802.15.4e TSCH Synchronization IE, but framer-802154 has
+ *         no Information Element support, so it does not interoperate
+ *         with other TSCH implementations.
+ */
+
+#include "contiki.h"
+#include "net/mac/tsch/tsch.h"
+#include "net/mac/tsch/tsch-schedule.h"
+#include "net/mac/frame802154.h"
+#include "net/mac/mac-sequence.h"
+#include "net/packetbuf.h"
+#include "net/queuebuf.h"
+#include "net/netstack.h"
+#include "lib/random.h"
+#include "sys/timer.h"
+#include "sys/pt.h"
+#include <string.h>
+
+#if CONTIKI_TARGET_COOJA
+#include "lib/simEnvChange.h"
+#include "sys/cooja_mt.h"
+#include "dev/cooja-radio.h"
+#endif /* CONTIKI_TARGET_COOJA */
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...) printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+/* The radio API has no channel selection, so it is done through the
+   platform: Cooja directly, others with TSCH_CONF_SET_CHANNEL. */
+#if CONTIKI_TARGET_COOJA
+#define TSCH_SET_CHANNEL(c) radio_set_channel(c)
+#elif defined(TSCH_CONF_SET_CHANNEL)
+#define TSCH_SET_CHANNEL(c) TSCH_CONF_SET_CHANNEL(c)
+#else
+#define TSCH_SET_CHANNEL(c) (void)(c)
+#endif
+
+/* Cooja only advances time when the mote yields */
+#if CONTIKI_TARGET_COOJA
+#define BUSYWAIT_UNTIL_ABS(cond, t)                             \
+  while(!(cond) && RTIMER_CLOCK_LT(RTIMER_NOW(), (t))) {        \
+    simProcessRunValue = 1;                                     \
+    cooja_mt_yield();                                           \
+  }
+#else
+#define BUSYWAIT_UNTIL_ABS(cond, t)                             \
+  while(!(cond) && RTIMER_CLOCK_LT(RTIMER_NOW(), (t)))
+#endif
+
+#define US_TO_RTIMERTICKS(us) \
+  ((rtimer_clock_t)(((uint32_t)(us) * RTIMER_SECOND + 999999) / 1000000))
+
+#define TS_LENGTH       US_TO_RTIMERTICKS(TSCH_TS_LENGTH)
+#define TS_TX_OFFSET    US_TO_RTIMERTICKS(TSCH_TS_TX_OFFSET)
+#define TS_RX_GUARD     US_TO_RTIMERTICKS(TSCH_TS_RX_GUARD)
+#define TS_ACK_WAIT     US_TO_RTIMERTICKS(TSCH_TS_ACK_WAIT)
+#define RADIO_TX_DELAY  US_TO_RTIMERTICKS(TSCH_RADIO_TX_DELAY)
+/* An ACK frame on air, with some margin */
+#define TS_MAX_ACK      US_TO_RTIMERTICKS(1000)
+
+/* The slot operation needs the rtimer set at least this far ahead */
+#define SLOT_MIN_AHEAD  2
+
+#define ACK_LEN 3
+
+/* EB payload: ASN (5 bytes, little endian), join priority, slotframe
+   length (2 bytes, little endian) */
+#define EB_LEN          8
+#define EB_ASN          0
+#define EB_JOIN_PRIO    5
+#define EB_SF_SIZE      6
+
+/* Channel hopping while scanning for EBs */
+#define SCAN_PERIOD     CLOCK_SECOND
+
+static const uint8_t hopping_sequence[] = TSCH_HOPPING_SEQUENCE;
+#define HOPPING_SEQUENCE_LEN sizeof(hopping_sequence)
+
+/* Outgoing frames. packet_input() and send_packet() run in process
+   context and fill in QUEUED entries; the slot operation sends them
+   from the rtimer interrupt and marks them DONE, after which
+   tsch_process calls the MAC callbacks. */
+enum {
+  PACKET_FREE,
+  PACKET_QUEUED,
+  PACKET_DONE,
+};
+
+struct tsch_packet {
+  struct queuebuf *qb;
+  mac_callback_t sent;
+  void *ptr;
+  linkaddr_t addr;
+  uint16_t order;
+  volatile uint8_t state;
+  uint8_t ret;
+  uint8_t transmissions;
+  /* Offset of the ASN in EB frames, 0 for other frames */
+  uint8_t eb_asn_offset;
+};
+
+static struct tsch_packet queue[TSCH_QUEUE_SIZE];
+static uint16_t queue_order;
+
+/* Network state */
+static volatile uint8_t associated;
+static uint8_t coordinator;
+static uint8_t join_priority = 0xff;
+static linkaddr_t time_source;
+static clock_time_t last_sync;
+static struct timer eb_timer;
+static uint8_t eb_seqno;
+
+/* Timeslot state, owned by the slot operation once associated */
+static struct rtimer slot_timer;
+static struct pt slot_pt;
+static struct pt slot_child_pt;
+static struct tsch_packet *slot_packet;
+static rtimer_clock_t slot_wait_end;
+static struct tsch_asn current_asn;
+static rtimer_clock_t current_slot_start;
+static volatile int16_t drift_correction;
+
+/* Set by the slot operation for packet_input() */
+static volatile uint8_t radio_kept_on;
+static volatile uint8_t rx_start_valid;
+static volatile rtimer_clock_t rx_expected_time;
+
+PROCESS(tsch_process, "TSCH");
+
+static void schedule_slot_operation(uint16_t timeslot_diff);
+static void tsch_slot_operation(struct rtimer *t, void *ptr);
+
+/* Wait within a timeslot: from the rtimer, or busy if too close. The
+   slot is given up if we left the network in the meantime. */
+#define SLOT_WAIT_UNTIL_ABS(pt, t) do {                                 \
+    slot_wait_end = (t);                                                \
+    if(RTIMER_CLOCK_LT(RTIMER_NOW() + SLOT_MIN_AHEAD, slot_wait_end)) {  \
+      rtimer_set(&slot_timer, slot_wait_end, 1, tsch_slot_operation, NULL); \
+      PT_YIELD(pt);                                                     \
+      if(!associated) {                                                 \
+        PT_EXIT(pt);                                                    \
+      }                                                                 \
+    } else {                                                            \
+      BUSYWAIT_UNTIL_ABS(0, slot_wait_end);                             \
+    }                                                                   \
+  } while(0)
+/*---------------------------------------------------------------------------*/
+static struct tsch_packet *
+queue_get(const struct tsch_link *link)
+{
+  struct tsch_packet *p;
+  struct tsch_packet *oldest;
+  int broadcast_link;
+
+  broadcast_link = linkaddr_cmp(&link->addr, &linkaddr_null);
+  oldest = NULL;
+  for(p = queue; p < queue + TSCH_QUEUE_SIZE; p++) {
+    if(p->state != PACKET_QUEUED) {
+      continue;
+    }
+    /* Shared links without a neighbor serve every destination */
+    if(!broadcast_link && !linkaddr_cmp(&link->addr, &p->addr)) {
+      continue;
+    }
+    if(oldest == NULL || (int16_t)(p->order - oldest->order) < 0) {
+      oldest = p;
+    }
+  }
+  return oldest;
+}
+/*---------------------------------------------------------------------------*/
+static struct tsch_packet *
+queue_add(mac_callback_t sent, void *ptr)
+{
+  struct tsch_packet *p;
+
+  for(p = queue; p < queue + TSCH_QUEUE_SIZE; p++) {
+    if(p->state == PACKET_FREE) {
+      p->qb = queuebuf_new_from_packetbuf();
+      if(p->qb == NULL) {
+        return NULL;
+      }
+      p->sent = sent;
+      p->ptr = ptr;
+      linkaddr_copy(&p->addr, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+      p->order = queue_order++;
+      p->transmissions = 0;
+      p->eb_asn_offset = 0;
+      p->state = PACKET_QUEUED;
+      return p;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+queue_done(void)
+{
+  struct tsch_packet *p;
+
+  for(p = queue; p < queue + TSCH_QUEUE_SIZE; p++) {
+    if(p->state != PACKET_DONE) {
+      continue;
+    }
+    queuebuf_to_packetbuf(p->qb);
+    queuebuf_free(p->qb);
+    p->qb = NULL;
+    p->state = PACKET_FREE;
+    if(p->eb_asn_offset == 0) {
+      mac_call_sent_callback(p->sent, p->ptr, p->ret, p->transmissions);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Sends slot_packet, from the rtimer interrupt */
+static
+PT_THREAD(slot_tx(struct pt *pt))
+{
+  static uint8_t *frame;
+  static uint8_t len;
+  static uint8_t dsn;
+  static rtimer_clock_t tx_end;
+  uint8_t ackbuf[ACK_LEN + 2];
+  int tx;
+
+  PT_BEGIN(pt);
+
+  frame = queuebuf_dataptr(slot_packet->qb);
+  len = queuebuf_datalen(slot_packet->qb);
+  dsn = frame[2];
+
+  if(slot_packet->eb_asn_offset != 0) {
+    frame[slot_packet->eb_asn_offset + EB_ASN] = current_asn.ls4b;
+    frame[slot_packet->eb_asn_offset + EB_ASN + 1] = current_asn.ls4b >> 8;
+    frame[slot_packet->eb_asn_offset + EB_ASN + 2] = current_asn.ls4b >> 16;
+    frame[slot_packet->eb_asn_offset + EB_ASN + 3] = current_asn.ls4b >> 24;
+    frame[slot_packet->eb_asn_offset + EB_ASN + 4] = current_asn.ms1b;
+  }
+
+  NETSTACK_RADIO.prepare(frame, len);
+  SLOT_WAIT_UNTIL_ABS(pt, current_slot_start + TS_TX_OFFSET - RADIO_TX_DELAY);
+
+  tx = NETSTACK_RADIO.transmit(len);
+  if(tx == RADIO_TX_COLLISION) {
+    slot_packet->ret = MAC_TX_COLLISION;
+  } else if(tx != RADIO_TX_OK) {
+    slot_packet->ret = MAC_TX_ERR;
+  } else if(linkaddr_cmp(&slot_packet->addr, &linkaddr_null)) {
+    slot_packet->ret = MAC_TX_OK;
+  } else {
+    /* Busy-wait for the ACK, the radio driver process must not get it */
+    NETSTACK_RADIO.on();
+    tx_end = RTIMER_NOW();
+    BUSYWAIT_UNTIL_ABS(NETSTACK_RADIO.receiving_packet() ||
+                       NETSTACK_RADIO.pending_packet(),
+                       tx_end + TS_ACK_WAIT);
+    if(NETSTACK_RADIO.receiving_packet()) {
+      tx_end = RTIMER_NOW();
+      BUSYWAIT_UNTIL_ABS(!NETSTACK_RADIO.receiving_packet(),
+                         tx_end + TS_MAX_ACK);
+    }
+    slot_packet->ret = MAC_TX_NOACK;
+    if(NETSTACK_RADIO.pending_packet()) {
+      if(NETSTACK_RADIO.read(ackbuf, sizeof(ackbuf)) == ACK_LEN &&
+         (ackbuf[0] & 7) == FRAME802154_ACKFRAME && ackbuf[2] == dsn) {
+        slot_packet->ret = MAC_TX_OK;
+      } else {
+        /* Not an ack or ack not for us: collision */
+        slot_packet->ret = MAC_TX_COLLISION;
+      }
+    }
+  }
+  NETSTACK_RADIO.off();
+
+  PT_END(pt);
+}
+/*---------------------------------------------------------------------------*/
+/* Listens for a frame, from the rtimer interrupt */
+static
+PT_THREAD(slot_rx(struct pt *pt))
+{
+  static rtimer_clock_t expected;
+
+  PT_BEGIN(pt);
+
+  expected = current_slot_start + TS_TX_OFFSET;
+  SLOT_WAIT_UNTIL_ABS(pt, expected - TS_RX_GUARD);
+  rx_expected_time = expected;
+  rx_start_valid = 1;
+  NETSTACK_RADIO.on();
+  SLOT_WAIT_UNTIL_ABS(pt, expected + TS_RX_GUARD);
+
+  if(NETSTACK_RADIO.receiving_packet() ||
+     NETSTACK_RADIO.pending_packet()) {
+    /* The radio driver reads the frame from process context; the radio
+       stays on until packet_input() has it, or the next timeslot. */
+    radio_kept_on = 1;
+  } else {
+    /* Nothing, or a frame packet_input() has had already */
+    rx_start_valid = 0;
+    NETSTACK_RADIO.off();
+  }
+
+  PT_END(pt);
+}
+/*---------------------------------------------------------------------------*/
+static
+PT_THREAD(slot_operation(struct pt *pt))
+{
+  static struct tsch_link *link;
+  static uint16_t timeslot_diff;
+  struct tsch_asn channel_asn;
+
+  PT_BEGIN(pt);
+
+  if(!associated) {
+    PT_EXIT(pt);
+  }
+
+  if(radio_kept_on) {
+    radio_kept_on = 0;
+    NETSTACK_RADIO.off();
+  }
+
+  link = tsch_schedule_get_link(&current_asn, &timeslot_diff);
+  if(link != NULL) {
+    channel_asn = current_asn;
+    TSCH_ASN_INC(channel_asn, link->channel_offset);
+    TSCH_SET_CHANNEL(hopping_sequence[TSCH_ASN_MOD(channel_asn,
+                                                   HOPPING_SEQUENCE_LEN)]);
+
+    slot_packet = NULL;
+    if(link->link_options & LINK_OPTION_TX) {
+      slot_packet = queue_get(link);
+    }
+    if(slot_packet != NULL) {
+      PT_SPAWN(pt, &slot_child_pt, slot_tx(&slot_child_pt));
+      if(!associated) {
+        /* disassociate() has ended the packet */
+        PT_EXIT(pt);
+      }
+      slot_packet->transmissions++;
+      slot_packet->state = PACKET_DONE;
+      process_poll(&tsch_process);
+    } else if(link->link_options & LINK_OPTION_RX) {
+      PT_SPAWN(pt, &slot_child_pt, slot_rx(&slot_child_pt));
+      if(!associated) {
+        PT_EXIT(pt);
+      }
+    } else {
+      NETSTACK_RADIO.off();
+    }
+  }
+
+  current_slot_start += drift_correction;
+  drift_correction = 0;
+  schedule_slot_operation(timeslot_diff);
+
+  PT_END(pt);
+}
+/*---------------------------------------------------------------------------*/
+static void
+tsch_slot_operation(struct rtimer *t, void *ptr)
+{
+  slot_operation(&slot_pt);
+}
+/*---------------------------------------------------------------------------*/
+/* Move on to the next active timeslot that is still ahead of us and
+   set the slot timer for it. */
+static void
+schedule_slot_operation(uint16_t timeslot_diff)
+{
+  while(1) {
+    TSCH_ASN_INC(current_asn, timeslot_diff);
+    current_slot_start += (rtimer_clock_t)timeslot_diff * TS_LENGTH;
+    if(tsch_schedule_get_link(&current_asn, &timeslot_diff) != NULL &&
+       RTIMER_CLOCK_LT(RTIMER_NOW() + SLOT_MIN_AHEAD, current_slot_start)) {
+      break;
+    }
+  }
+  rtimer_set(&slot_timer, current_slot_start, 1, tsch_slot_operation, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+associate(void)
+{
+  PRINTF("tsch: associated, asn %lu join priority %u\n",
+         (unsigned long)current_asn.ls4b, join_priority);
+  last_sync = clock_time();
+  drift_correction = 0;
+  radio_kept_on = 0;
+  rx_start_valid = 0;
+  PT_INIT(&slot_pt);
+  /* Spread the EBs of nodes that join at the same time */
+  timer_set(&eb_timer, random_rand() % TSCH_EB_PERIOD);
+  NETSTACK_RADIO.off();
+  associated = 1;
+  schedule_slot_operation(0);
+}
+/*---------------------------------------------------------------------------*/
+static void
+disassociate(void)
+{
+  struct tsch_packet *p;
+
+  PRINTF("tsch: left the network\n");
+  associated = 0;
+  join_priority = 0xff;
+  for(p = queue; p < queue + TSCH_QUEUE_SIZE; p++) {
+    if(p->state == PACKET_QUEUED) {
+      p->ret = MAC_TX_ERR;
+      p->state = PACKET_DONE;
+    }
+  }
+  queue_done();
+  NETSTACK_RADIO.on();
+}
+/*---------------------------------------------------------------------------*/
+static void
+eb_send(void)
+{
+  frame802154_t params;
+  struct tsch_packet *p;
+  uint8_t *eb;
+  int hdr_len;
+
+  for(p = queue; p < queue + TSCH_QUEUE_SIZE; p++) {
+    if(p->state == PACKET_QUEUED && p->eb_asn_offset != 0) {
+      /* The previous EB has not been sent yet */
+      return;
+    }
+  }
+
+  packetbuf_clear();
+  eb = packetbuf_dataptr();
+  memset(eb, 0, EB_LEN);
+  eb[EB_JOIN_PRIO] = join_priority;
+  eb[EB_SF_SIZE] = TSCH_SCHEDULE_DEFAULT_LENGTH & 0xff;
+  eb[EB_SF_SIZE + 1] = TSCH_SCHEDULE_DEFAULT_LENGTH >> 8;
+  packetbuf_set_datalen(EB_LEN);
+
+  memset(&params, 0, sizeof(params));
+  params.fcf.frame_type = FRAME802154_BEACONFRAME;
+  params.fcf.frame_version = FRAME802154_IEEE802154_2003;
+  params.fcf.dest_addr_mode = FRAME802154_SHORTADDRMODE;
+  params.fcf.src_addr_mode = sizeof(linkaddr_t) == 2 ?
+    FRAME802154_SHORTADDRMODE : FRAME802154_LONGADDRMODE;
+  params.seq = eb_seqno++;
+  params.dest_pid = IEEE802154_PANID;
+  params.src_pid = IEEE802154_PANID;
+  params.dest_addr[0] = 0xff;
+  params.dest_addr[1] = 0xff;
+  linkaddr_copy((linkaddr_t *)&params.src_addr, &linkaddr_node_addr);
+  params.payload = packetbuf_dataptr();
+  params.payload_len = EB_LEN;
+
+  hdr_len = frame802154_hdrlen(&params);
+  if(!packetbuf_hdralloc(hdr_len)) {
+    return;
+  }
+  frame802154_create(&params, packetbuf_hdrptr(), hdr_len);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_null);
+
+  p = queue_add(NULL, NULL);
+  if(p != NULL) {
+    p->eb_asn_offset = hdr_len;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+eb_input(frame802154_t *frame, rtimer_clock_t rx_start)
+{
+  uint8_t *eb;
+
+  if(frame->payload_len < EB_LEN) {
+    return;
+  }
+  eb = frame->payload;
+  if((eb[EB_SF_SIZE] | (eb[EB_SF_SIZE + 1] << 8)) !=
+     TSCH_SCHEDULE_DEFAULT_LENGTH || eb[EB_JOIN_PRIO] == 0xff) {
+    PRINTF("tsch: EB for another schedule\n");
+    return;
+  }
+
+  current_asn.ls4b = (uint32_t)eb[EB_ASN] |
+    ((uint32_t)eb[EB_ASN + 1] << 8) |
+    ((uint32_t)eb[EB_ASN + 2] << 16) |
+    ((uint32_t)eb[EB_ASN + 3] << 24);
+  current_asn.ms1b = eb[EB_ASN + 4];
+  current_slot_start = rx_start - TS_TX_OFFSET;
+  join_priority = eb[EB_JOIN_PRIO] + 1;
+  linkaddr_copy(&time_source, (linkaddr_t *)&frame->src_addr);
+  associate();
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_packet(mac_callback_t sent, void *ptr)
+{
+  int ret;
+
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, &linkaddr_node_addr);
+  packetbuf_set_attr(PACKETBUF_ATTR_MAC_ACK, 1);
+
+  if(!associated) {
+    PRINTF("tsch: not associated, dropping\n");
+    ret = MAC_TX_ERR;
+  } else if(NETSTACK_FRAMER.create() < 0) {
+    PRINTF("tsch: send failed, too large header\n");
+    ret = MAC_TX_ERR_FATAL;
+  } else if(queue_add(sent, ptr) == NULL) {
+    /* Let the MAC layer try again later */
+    PRINTF("tsch: queue full\n");
+    ret = MAC_TX_COLLISION;
+  } else {
+    return;
+  }
+  mac_call_sent_callback(sent, ptr, ret, 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *buf_list)
+{
+  /* Frames are sent one at a time: the MAC layer passes on the next
+     one from the sent callback. */
+  if(buf_list != NULL) {
+    queuebuf_to_packetbuf(buf_list->buf);
+    send_packet(sent, ptr);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* The SFD time of the frame in the packetbuf, from its low 16 bits */
+static rtimer_clock_t
+rx_timestamp(void)
+{
+  rtimer_clock_t now = RTIMER_NOW();
+
+  return now - (uint16_t)((uint16_t)now -
+                          packetbuf_attr(PACKETBUF_ATTR_TIMESTAMP));
+}
+/*---------------------------------------------------------------------------*/
+static void
+packet_input(void)
+{
+  frame802154_t frame;
+  rtimer_clock_t rx_start;
+  uint8_t in_slot;
+  int duplicate;
+
+  if(packetbuf_datalen() == ACK_LEN ||
+     frame802154_parse(packetbuf_dataptr(), packetbuf_datalen(),
+                       &frame) == 0) {
+    /* Ignore acks and broken frames */
+    goto done;
+  }
+
+  /* Received in an RX timeslot, with an expected time */
+  in_slot = rx_start_valid &&
+    RTIMER_CLOCK_LT(RTIMER_NOW(), rx_expected_time + TS_LENGTH);
+  rx_start_valid = 0;
+  rx_start = rx_timestamp();
+
+  if(!associated) {
+    if(frame.fcf.frame_type == FRAME802154_BEACONFRAME) {
+      eb_input(&frame, rx_start);
+    }
+    return;
+  }
+
+  /* Drift correction, from any frame of our time source */
+  if(in_slot && !coordinator &&
+     linkaddr_cmp((linkaddr_t *)&frame.src_addr, &time_source)) {
+    int16_t drift = (int16_t)(rx_start - rx_expected_time);
+    if(drift > (int16_t)TS_RX_GUARD) {
+      drift = TS_RX_GUARD;
+    } else if(drift < -(int16_t)TS_RX_GUARD) {
+      drift = -(int16_t)TS_RX_GUARD;
+    }
+    drift_correction += drift;
+    last_sync = clock_time();
+  }
+
+  if(frame.fcf.frame_type != FRAME802154_DATAFRAME) {
+    goto done;
+  }
+
+#if TSCH_SEND_802154_ACK
+  if(frame.fcf.ack_required != 0 &&
+     linkaddr_cmp((linkaddr_t *)&frame.dest_addr, &linkaddr_node_addr)) {
+    uint8_t ackdata[ACK_LEN] = {0, 0, 0};
+
+    ackdata[0] = FRAME802154_ACKFRAME;
+    ackdata[1] = 0;
+    ackdata[2] = frame.seq;
+    NETSTACK_RADIO.send(ackdata, ACK_LEN);
+  }
+#endif /* TSCH_SEND_802154_ACK */
+
+  if(NETSTACK_FRAMER.parse() < 0) {
+    PRINTF("tsch: failed to parse %u\n", packetbuf_datalen());
+  } else if(!linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                          &linkaddr_node_addr) &&
+            !linkaddr_cmp(packetbuf_addr(PACKETBUF_ADDR_RECEIVER),
+                          &linkaddr_null)) {
+    PRINTF("tsch: not for us\n");
+  } else {
+    duplicate = mac_sequence_is_duplicate();
+    if(duplicate) {
+      PRINTF("tsch: drop duplicate link layer packet %u\n",
+             packetbuf_attr(PACKETBUF_ATTR_PACKET_ID));
+    } else {
+      mac_sequence_register_seqno();
+    }
+    if(radio_kept_on) {
+      radio_kept_on = 0;
+      NETSTACK_RADIO.off();
+    }
+    if(!duplicate) {
+      NETSTACK_MAC.input();
+    }
+    return;
+  }
+
+done:
+  if(associated && radio_kept_on) {
+    radio_kept_on = 0;
+    NETSTACK_RADIO.off();
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tsch_process, ev, data)
+{
+  static struct etimer et;
+
+  PROCESS_BEGIN();
+
+  etimer_set(&et, SCAN_PERIOD);
+  while(1) {
+    PROCESS_WAIT_EVENT();
+
+    if(ev == PROCESS_EVENT_POLL) {
+      queue_done();
+    }
+
+    if(etimer_expired(&et)) {
+      etimer_reset(&et);
+      if(associated) {
+        if(!coordinator &&
+           clock_time() - last_sync > TSCH_DESYNC_THRESHOLD) {
+          disassociate();
+        } else if(timer_expired(&eb_timer)) {
+          eb_send();
+          timer_set(&eb_timer, TSCH_EB_PERIOD / 2 +
+                    random_rand() % (TSCH_EB_PERIOD / 2));
+        }
+      } else {
+        /* EBs are sent on all channels in turn, listen on any */
+        TSCH_SET_CHANNEL(hopping_sequence[random_rand() %
+                                          HOPPING_SEQUENCE_LEN]);
+        NETSTACK_RADIO.on();
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+tsch_set_coordinator(int enable)
+{
+  if(enable == coordinator) {
+    return;
+  }
+  coordinator = enable;
+  if(associated) {
+    disassociate();
+  }
+  if(coordinator) {
+    memset(&current_asn, 0, sizeof(current_asn));
+    current_slot_start = RTIMER_NOW();
+    join_priority = 0;
+    associate();
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+tsch_is_associated(void)
+{
+  return associated;
+}
+/*---------------------------------------------------------------------------*/
+uint8_t
+tsch_join_priority(void)
+{
+  return join_priority;
+}
+/*---------------------------------------------------------------------------*/
+static int
+on(void)
+{
+  if(!associated) {
+    return NETSTACK_RADIO.on();
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+off(int keep_radio_on)
+{
+  /* The timeslots decide when the radio is on once associated */
+  if(keep_radio_on || !associated) {
+    return NETSTACK_RADIO.on();
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+channel_check_interval(void)
+{
+  unsigned long interval;
+
+  /* One slotframe: that is how long a frame may wait for its link */
+  interval = (unsigned long)tsch_schedule_max_size() * TSCH_TS_LENGTH *
+    CLOCK_SECOND / 1000000;
+  return interval > 0 ? interval : 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+init(void)
+{
+  tsch_schedule_init();
+  tsch_schedule_create_minimal();
+  process_start(&tsch_process, NULL);
+  TSCH_SET_CHANNEL(hopping_sequence[0]);
+  NETSTACK_RADIO.on();
+}
+/*---------------------------------------------------------------------------*/
+const struct rdc_driver tsch_driver = {
+  "tsch",
+  init,
+  send_packet,
+  send_list,
+  packet_input,
+  on,
+  off,
+  channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+/** @} */
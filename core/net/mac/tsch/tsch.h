@@ -0,0 +1,154 @@
+/**
+ * \addtogroup rdc
+ * @{
+ */
+/**
+ * \file
+ *         Time-slotted channel hopping (IEEE 802.15.4e TSCH) RDC driver
+ *
+ *         Time is split in timeslots counted by the Absolute Slot
+ *         Number (ASN). Timeslots are grouped in slotframes that repeat
+ *         over time; the links of the schedule (tsch-schedule.h) tell
+ *         in which timeslots a node transmits or listens, and on which
+ *         channel offset. The physical channel of a timeslot is taken
+ *         from the hopping sequence at (ASN + channel offset).
+ *
+ *         One node is the coordinator and starts the network. Every
+ *         associated node sends Enhanced Beacons (EBs) with its ASN;
+ *         a new node listens for an EB and adopts the ASN and timeslot
+ *         boundaries of its sender, which becomes its time source.
+ *         Every frame then received from the time source corrects the
+ *         clock drift.
+ *
+ *         The driver is selected with
+ *         \code
+ *         #define NETSTACK_CONF_MAC csma_driver
+ *         #define NETSTACK_CONF_RDC tsch_driver
+ *         \endcode
+ *         and core/net/mac/tsch in MODULES. CSMA above keeps the
+ *         per-neighbor queues and retransmissions; TSCH sends each
+ *         frame in the next matching timeslot.
+ */
+
+#ifndef TSCH_H_
+#define TSCH_H_
+
+#include "contiki-conf.h"
+#include "net/mac/rdc.h"
+#include "net/linkaddr.h"
+#include "sys/rtimer.h"
+
+/* Timeslot timing, in microseconds (802.15.4e defaults for 10 ms
+   timeslots). */
+#ifdef TSCH_CONF_TS_LENGTH
+#define TSCH_TS_LENGTH             TSCH_CONF_TS_LENGTH
+#else
+#define TSCH_TS_LENGTH             10000
+#endif
+
+/* Start of the frame, from the start of the timeslot */
+#ifdef TSCH_CONF_TS_TX_OFFSET
+#define TSCH_TS_TX_OFFSET          TSCH_CONF_TS_TX_OFFSET
+#else
+#define TSCH_TS_TX_OFFSET          2120
+#endif
+
+/* The receiver listens this long before and after the expected start
+   of the frame */
+#ifdef TSCH_CONF_TS_RX_GUARD
+#define TSCH_TS_RX_GUARD           TSCH_CONF_TS_RX_GUARD
+#else
+#define TSCH_TS_RX_GUARD           2200
+#endif
+
+/* How long the sender waits for an ACK after its frame */
+#ifdef TSCH_CONF_TS_ACK_WAIT
+#define TSCH_TS_ACK_WAIT           TSCH_CONF_TS_ACK_WAIT
+#else
+#define TSCH_TS_ACK_WAIT           1400
+#endif
+
+/* Time from NETSTACK_RADIO.transmit() to the start of the frame on
+   air; the sender calls transmit() this long before the TX offset. */
+#ifdef TSCH_CONF_RADIO_TX_DELAY
+#define TSCH_RADIO_TX_DELAY        TSCH_CONF_RADIO_TX_DELAY
+#else
+#define TSCH_RADIO_TX_DELAY        300
+#endif
+
+/* Channels used for hopping. The default is 4 channels away from the
+   common Wi-Fi channels 1, 6 and 11. */
+#ifdef TSCH_CONF_HOPPING_SEQUENCE
+#define TSCH_HOPPING_SEQUENCE      TSCH_CONF_HOPPING_SEQUENCE
+#else
+#define TSCH_HOPPING_SEQUENCE      { 15, 25, 26, 20 }
+#endif
+
+/* Period of the Enhanced Beacons sent by associated nodes */
+#ifdef TSCH_CONF_EB_PERIOD
+#define TSCH_EB_PERIOD             TSCH_CONF_EB_PERIOD
+#else
+#define TSCH_EB_PERIOD             (16 * CLOCK_SECOND)
+#endif
+
+/* A node that has not heard from its time source for this long leaves
+   the network and scans for EBs again. */
+#ifdef TSCH_CONF_DESYNC_THRESHOLD
+#define TSCH_DESYNC_THRESHOLD      TSCH_CONF_DESYNC_THRESHOLD
+#else
+#define TSCH_DESYNC_THRESHOLD      (4 * TSCH_EB_PERIOD)
+#endif
+
+/* Number of frames waiting for a timeslot */
+#ifdef TSCH_CONF_QUEUE_SIZE
+#define TSCH_QUEUE_SIZE            TSCH_CONF_QUEUE_SIZE
+#else
+#define TSCH_QUEUE_SIZE            4
+#endif
+
+/* Radios without hardware auto-ACK need TSCH to send ACKs itself */
+#ifdef TSCH_CONF_SEND_802154_ACK
+#define TSCH_SEND_802154_ACK       TSCH_CONF_SEND_802154_ACK
+#else
+#define TSCH_SEND_802154_ACK       0
+#endif
+
+/* 802.15.4e Absolute Slot Number, a 5-byte counter */
+struct tsch_asn {
+  uint32_t ls4b;
+  uint8_t ms1b;
+};
+
+#define TSCH_ASN_INC(asn, inc) do {              \
+    uint32_t new_ls4b = (asn).ls4b + (inc);      \
+    if(new_ls4b < (asn).ls4b) { (asn).ms1b++; }  \
+    (asn).ls4b = new_ls4b;                       \
+  } while(0)
+
+/* ASN modulo div, for div up to 16 bits */
+#define TSCH_ASN_MOD(asn, div)                                      \
+  ((uint16_t)((((uint32_t)(asn).ms1b *                              \
+                (((0xffffffff % (div)) + 1) % (div))) +             \
+               (asn).ls4b % (div)) % (div)))
+
+extern const struct rdc_driver tsch_driver;
+
+/**
+ * \brief Start a new network with this node as its coordinator, or
+ * stop being the coordinator and join an existing network.
+ */
+void tsch_set_coordinator(int enable);
+
+/**
+ * \brief Tell if the node is synchronized to a TSCH network.
+ */
+int tsch_is_associated(void);
+
+/**
+ * \brief Our distance to the coordinator, 0 for the coordinator itself,
+ * 0xff when not associated.
+ */
+uint8_t tsch_join_priority(void);
+
+#endif /* TSCH_H_ */
+/** @} */
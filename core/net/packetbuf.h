@@ -332,6 +332,10 @@ struct packetbuf_addr {
 #define PACKETBUF_ATTR_PACKET_TYPE_STREAM_END 3
 #define PACKETBUF_ATTR_PACKET_TYPE_TIMESTAMP 4
 
+#define PACKETBUF_ATTR_PRIORITY_NORMAL       0
+#define PACKETBUF_ATTR_PRIORITY_HIGH         1
+#define PACKETBUF_ATTR_PRIORITY_LOW          2
+
 enum {
   PACKETBUF_ATTR_NONE,
 
@@ -364,6 +368,10 @@ enum {
   PACKETBUF_ATTR_EPACKET_TYPE,
   PACKETBUF_ATTR_ERELIABLE,
 
+  /* Scope 0, added after the others so that the attribute numbers
+     exchanged with slip-radio stay the same. */
+  PACKETBUF_ATTR_PRIORITY,
+
   /* These must be last */
   PACKETBUF_ADDR_SENDER,
   PACKETBUF_ADDR_RECEIVER,
@@ -0,0 +1,56 @@
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/**
+ * \file
+ *         DODAG checkpoint driver storing the checkpoint in a CFS file.
+ */
+
+#include "contiki.h"
+#include "net/rpl/rpl.h"
+#include "cfs/cfs.h"
+
+#if UIP_CONF_IPV6
+/*---------------------------------------------------------------------------*/
+#define CHECKPOINT_FILE "rpl-checkpoint"
+/*---------------------------------------------------------------------------*/
+static int
+load(struct rpl_checkpoint *cp)
+{
+  int fd;
+  int len;
+
+  fd = cfs_open(CHECKPOINT_FILE, CFS_READ);
+  if(fd < 0) {
+    return 0;
+  }
+  len = cfs_read(fd, cp, sizeof(*cp));
+  cfs_close(fd);
+  return len == sizeof(*cp);
+}
+/*---------------------------------------------------------------------------*/
+static int
+store(const struct rpl_checkpoint *cp)
+{
+  int fd;
+  int len;
+
+  cfs_remove(CHECKPOINT_FILE);
+  fd = cfs_open(CHECKPOINT_FILE, CFS_WRITE);
+  if(fd < 0) {
+    return 0;
+  }
+  len = cfs_write(fd, cp, sizeof(*cp));
+  cfs_close(fd);
+  return len == sizeof(*cp);
+}
+/*---------------------------------------------------------------------------*/
+const struct rpl_checkpoint_driver rpl_checkpoint_cfs = {
+  "cfs",
+  load,
+  store
+};
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_CONF_IPV6 */
+/** @} */
@@ -0,0 +1,274 @@
+/**
+ * \addtogroup uip6
+ * @{
+ */
+/**
+ * \file
+ *         DODAG checkpoints for a fast rejoin after a power loss.
+ *
+ *         Whenever a node joins a DODAG or changes its preferred parent,
+ *         the DODAG ID, version, configuration and the preferred parent
+ *         are written to non-volatile storage once the state has been
+ *         stable for RPL_CHECKPOINT_DELAY. At boot the checkpoint is
+ *         replayed as if the parent had just sent us a DIO, so the node
+ *         has a default route and sends its DAO right away.
+ *
+ *         The restored parent is provisional until it confirms itself
+ *         with a DIO. It is asked for one with unicast DIS messages; if it
+ *         never answers, the restored DODAG is dropped and the node goes
+ *         back to the regular DIS/DIO join.
+ */
+
+#include "contiki.h"
+#include "net/rpl/rpl-private.h"
+#include "net/ipv6/uip-ds6.h"
+#include "lib/crc16.h"
+#include "lib/random.h"
+#include "sys/ctimer.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define DEBUG DEBUG_NONE
+#include "net/ip/uip-debug.h"
+
+#if UIP_CONF_IPV6 && RPL_WITH_CHECKPOINT
+/*---------------------------------------------------------------------------*/
+/* Number of unicast DIS sent to a restored parent before giving up. */
+#ifdef RPL_CONF_CHECKPOINT_DIS_ATTEMPTS
+#define RPL_CHECKPOINT_DIS_ATTEMPTS  RPL_CONF_CHECKPOINT_DIS_ATTEMPTS
+#else
+#define RPL_CHECKPOINT_DIS_ATTEMPTS  3
+#endif
+
+/* Upper bound of the random delay before the first DIS; later attempts
+   double it. Spreads the validation traffic of a mass reboot. */
+#ifdef RPL_CONF_CHECKPOINT_DIS_DELAY
+#define RPL_CHECKPOINT_DIS_DELAY     RPL_CONF_CHECKPOINT_DIS_DELAY
+#else
+#define RPL_CHECKPOINT_DIS_DELAY     (8 * CLOCK_SECOND)
+#endif
+
+#define CHECKPOINT_CRC_LEN           offsetof(struct rpl_checkpoint, crc)
+/*---------------------------------------------------------------------------*/
+extern const struct rpl_checkpoint_driver RPL_CHECKPOINT_DRIVER;
+
+/* The checkpoint currently in storage. */
+static struct rpl_checkpoint stored;
+static uint8_t stored_valid;
+
+static struct ctimer store_timer;
+static struct ctimer validate_timer;
+static uint8_t provisional;
+static uint8_t dis_attempts;
+/*---------------------------------------------------------------------------*/
+static int
+checkpoint_build(struct rpl_checkpoint *cp)
+{
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  rpl_parent_t *parent;
+  uip_ipaddr_t *parent_addr;
+  const uip_lladdr_t *lladdr;
+
+  instance = default_instance;
+  if(instance == NULL || instance->current_dag == NULL) {
+    return 0;
+  }
+  dag = instance->current_dag;
+  parent = dag->preferred_parent;
+  if(!dag->joined || parent == NULL || dag->rank == ROOT_RANK(instance)) {
+    return 0;
+  }
+  parent_addr = rpl_get_parent_ipaddr(parent);
+  if(parent_addr == NULL) {
+    return 0;
+  }
+  lladdr = uip_ds6_nbr_lladdr_from_ipaddr(parent_addr);
+  if(lladdr == NULL) {
+    return 0;
+  }
+
+  /* Padding must be zero for the CRC and for comparisons. */
+  memset(cp, 0, sizeof(*cp));
+  uip_ipaddr_copy(&cp->dag_id, &dag->dag_id);
+  uip_ipaddr_copy(&cp->parent, parent_addr);
+  memcpy(&cp->parent_lladdr, lladdr, sizeof(cp->parent_lladdr));
+  memcpy(&cp->prefix_info, &dag->prefix_info, sizeof(cp->prefix_info));
+  cp->parent_rank = parent->rank;
+  cp->rank = dag->rank;
+  cp->max_rankinc = instance->max_rankinc;
+  cp->min_hoprankinc = instance->min_hoprankinc;
+  cp->ocp = instance->of->ocp;
+  cp->lifetime_unit = instance->lifetime_unit;
+  cp->instance_id = instance->instance_id;
+  cp->version = dag->version;
+  cp->mop = instance->mop;
+  cp->grounded = dag->grounded;
+  cp->preference = dag->preference;
+  cp->dtsn = parent->dtsn;
+  cp->dio_intdoubl = instance->dio_intdoubl;
+  cp->dio_intmin = instance->dio_intmin;
+  cp->dio_redundancy = instance->dio_redundancy;
+  cp->default_lifetime = instance->default_lifetime;
+  cp->crc = crc16_data((unsigned char *)cp, CHECKPOINT_CRC_LEN, 0);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Ranks and DTSNs move with every DIO; only a change of DODAG, version,
+   prefix or parent is worth a write. */
+static int
+checkpoint_changed(const struct rpl_checkpoint *a,
+                   const struct rpl_checkpoint *b)
+{
+  return !uip_ipaddr_cmp(&a->dag_id, &b->dag_id) ||
+    !uip_ipaddr_cmp(&a->parent, &b->parent) ||
+    a->instance_id != b->instance_id ||
+    a->version != b->version ||
+    memcmp(&a->prefix_info, &b->prefix_info, sizeof(a->prefix_info)) != 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_store_timer(void *ptr)
+{
+  struct rpl_checkpoint cp;
+
+  if(provisional || !checkpoint_build(&cp)) {
+    return;
+  }
+  if(stored_valid && !checkpoint_changed(&cp, &stored)) {
+    return;
+  }
+
+  PRINTF("RPL: Checkpointing DAG version %u through parent ",
+         cp.version);
+  PRINT6ADDR(&cp.parent);
+  PRINTF("\n");
+
+  if(RPL_CHECKPOINT_DRIVER.store(&cp)) {
+    memcpy(&stored, &cp, sizeof(stored));
+    stored_valid = 1;
+  } else {
+    PRINTF("RPL: Failed to store checkpoint in %s\n",
+           RPL_CHECKPOINT_DRIVER.name);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_checkpoint_schedule(void)
+{
+  ctimer_set(&store_timer, RPL_CHECKPOINT_DELAY, handle_store_timer, NULL);
+}
+/*---------------------------------------------------------------------------*/
+static void
+handle_validate_timer(void *ptr)
+{
+  rpl_instance_t *instance;
+
+  if(!provisional) {
+    return;
+  }
+
+  instance = rpl_get_instance(stored.instance_id);
+  if(instance == NULL) {
+    provisional = 0;
+    return;
+  }
+
+  if(dis_attempts < RPL_CHECKPOINT_DIS_ATTEMPTS) {
+    PRINTF("RPL: Asking restored parent ");
+    PRINT6ADDR(&stored.parent);
+    PRINTF(" for a DIO\n");
+    dis_output(&stored.parent);
+    dis_attempts++;
+    ctimer_set(&validate_timer,
+               (RPL_CHECKPOINT_DIS_DELAY << dis_attempts), handle_validate_timer,
+               NULL);
+    return;
+  }
+
+  PRINTF("RPL: Restored parent did not answer, dropping restored DAG\n");
+  provisional = 0;
+  rpl_free_instance(instance);
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_checkpoint_parent_confirmed(rpl_instance_t *instance)
+{
+  if(provisional && instance->instance_id == stored.instance_id) {
+    PRINTF("RPL: Restored DAG confirmed by preferred parent\n");
+    provisional = 0;
+    ctimer_stop(&validate_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+rpl_checkpoint_restore(void)
+{
+  rpl_dio_t dio;
+  uip_ds6_nbr_t *nbr;
+
+  stored_valid = 0;
+  provisional = 0;
+
+  if(!RPL_CHECKPOINT_DRIVER.load(&stored)) {
+    PRINTF("RPL: No checkpoint in %s\n", RPL_CHECKPOINT_DRIVER.name);
+    return;
+  }
+  if(crc16_data((unsigned char *)&stored, CHECKPOINT_CRC_LEN, 0) !=
+     stored.crc || rpl_find_of(stored.ocp) == NULL) {
+    PRINTF("RPL: Ignoring invalid checkpoint\n");
+    return;
+  }
+  stored_valid = 1;
+
+  nbr = uip_ds6_nbr_lookup(&stored.parent);
+  if(nbr == NULL) {
+    nbr = uip_ds6_nbr_add(&stored.parent, &stored.parent_lladdr,
+                          1, NBR_REACHABLE);
+    if(nbr == NULL) {
+      return;
+    }
+    stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+  }
+
+  /* Replay the parent's last DIO. */
+  memset(&dio, 0, sizeof(dio));
+  uip_ipaddr_copy(&dio.dag_id, &stored.dag_id);
+  dio.ocp = stored.ocp;
+  dio.rank = stored.parent_rank;
+  dio.grounded = stored.grounded;
+  dio.mop = stored.mop;
+  dio.preference = stored.preference;
+  dio.version = stored.version;
+  dio.instance_id = stored.instance_id;
+  dio.dtsn = stored.dtsn;
+  dio.dag_intdoubl = stored.dio_intdoubl;
+  dio.dag_intmin = stored.dio_intmin;
+  dio.dag_redund = stored.dio_redundancy;
+  dio.default_lifetime = stored.default_lifetime;
+  dio.lifetime_unit = stored.lifetime_unit;
+  dio.dag_max_rankinc = stored.max_rankinc;
+  dio.dag_min_hoprankinc = stored.min_hoprankinc;
+  memcpy(&dio.prefix_info, &stored.prefix_info, sizeof(dio.prefix_info));
+
+  PRINTF("RPL: Restoring DAG ");
+  PRINT6ADDR(&stored.dag_id);
+  PRINTF(" version %u through parent ", stored.version);
+  PRINT6ADDR(&stored.parent);
+  PRINTF("\n");
+
+  rpl_process_dio(&stored.parent, &dio);
+  if(rpl_get_instance(stored.instance_id) == NULL) {
+    return;
+  }
+
+  provisional = 1;
+  dis_attempts = 0;
+  ctimer_set(&validate_timer,
+             random_rand() % RPL_CHECKPOINT_DIS_DELAY, handle_validate_timer,
+             NULL);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_CONF_IPV6 && RPL_WITH_CHECKPOINT */
+/** @} */
@@ -186,4 +186,79 @@
 #define RPL_DEFAULT_LIFETIME            RPL_CONF_DEFAULT_LIFETIME
 #endif
 
+/*
+ * Checkpoint the joined DODAG (DODAG ID and version, preferred parent,
+ * its rank and the default route through it) to non-volatile storage,
+ * so that a node rejoins immediately after a power loss instead of
+ * rebuilding the DODAG through DIS/DIO exchange.
+ */
+#ifdef RPL_CONF_WITH_CHECKPOINT
+#define RPL_WITH_CHECKPOINT         RPL_CONF_WITH_CHECKPOINT
+#else
+#define RPL_WITH_CHECKPOINT         0
+#endif /* RPL_CONF_WITH_CHECKPOINT */
+
+/*
+ * The storage used for checkpoints. This should be defined to be the
+ * name of an rpl_checkpoint_driver object linked into the system image.
+ */
+#ifdef RPL_CONF_CHECKPOINT_DRIVER
+#define RPL_CHECKPOINT_DRIVER       RPL_CONF_CHECKPOINT_DRIVER
+#else
+#define RPL_CHECKPOINT_DRIVER       rpl_checkpoint_cfs
+#endif /* RPL_CONF_CHECKPOINT_DRIVER */
+
+/*
+ * How long a changed DODAG state must stay stable before it is written
+ * out. This keeps parent flapping from wearing out the storage.
+ */
+#ifdef RPL_CONF_CHECKPOINT_DELAY
+#define RPL_CHECKPOINT_DELAY        RPL_CONF_CHECKPOINT_DELAY
+#else
+#define RPL_CHECKPOINT_DELAY        (30 * CLOCK_SECOND)
+#endif /* RPL_CONF_CHECKPOINT_DELAY */
+
+/*
+ * Number of own DAOs per second a router accepts from its children.
+ * DAOs over the limit are answered with a rejecting DAO ACK, and the
+ * child retries after its backoff. Only DAOs that request an ACK are
+ * limited, forwarded DAOs always pass. 0 disables the limit.
+ */
+#ifdef RPL_CONF_DAO_RATE_LIMIT
+#define RPL_DAO_RATE_LIMIT          RPL_CONF_DAO_RATE_LIMIT
+#else
+#define RPL_DAO_RATE_LIMIT          0
+#endif /* RPL_CONF_DAO_RATE_LIMIT */
+
+/*
+ * Number of targets a storing router collects from forwarded DAOs
+ * before passing them on to its parent in one DAO. 0 forwards every
+ * DAO as it arrives.
+ */
+#ifdef RPL_CONF_DAO_AGGREGATION
+#define RPL_DAO_AGGREGATION         RPL_CONF_DAO_AGGREGATION
+#else
+#define RPL_DAO_AGGREGATION         0
+#endif /* RPL_CONF_DAO_AGGREGATION */
+
+/*
+ * How long forwarded DAO targets are held for aggregation.
+ */
+#ifdef RPL_CONF_DAO_AGGREGATION_DELAY
+#define RPL_DAO_AGGREGATION_DELAY   RPL_CONF_DAO_AGGREGATION_DELAY
+#else
+#define RPL_DAO_AGGREGATION_DELAY   (CLOCK_SECOND)
+#endif /* RPL_CONF_DAO_AGGREGATION_DELAY */
+
+/*
+ * Carry the dynamic 6LoWPAN compression contexts in DIOs as 6CO
+ * options. Contexts are installed from the preferred parent's DIOs
+ * and advertised on to our own children.
+ */
+#ifdef RPL_CONF_WITH_6CO
+#define RPL_WITH_6CO                RPL_CONF_WITH_6CO
+#else
+#define RPL_WITH_6CO                0
+#endif /* RPL_CONF_WITH_6CO */
+
 #endif /* RPL_CONF_H */
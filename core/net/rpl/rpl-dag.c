@@ -426,6 +426,9 @@ rpl_set_default_route(rpl_instance_t *instance, uip_ipaddr_t *from)
     if(instance->def_route == NULL) {
       return 0;
     }
+#if RPL_WITH_CHECKPOINT
+    rpl_checkpoint_schedule();
+#endif /* RPL_WITH_CHECKPOINT */
   } else {
     PRINTF("RPL: Removing default route\n");
     if(instance->def_route != NULL) {
@@ -510,7 +513,7 @@ rpl_free_instance(rpl_instance_t *instance)
   rpl_set_default_route(instance, NULL);
 
   ctimer_stop(&instance->dio_timer);
-  ctimer_stop(&instance->dao_timer);
+  rpl_cancel_dao(instance);
 
   if(default_instance == instance) {
     default_instance = NULL;
@@ -1299,6 +1302,9 @@ rpl_process_dio(uip_ipaddr_t *from, rpl_dio_t *dio)
     /* We received a new DIO from our preferred parent.
      * Call uip_ds6_defrt_add to set a fresh value for the lifetime counter */
     uip_ds6_defrt_add(from, RPL_LIFETIME(instance, instance->default_lifetime));
+#if RPL_WITH_CHECKPOINT
+    rpl_checkpoint_parent_confirmed(instance);
+#endif /* RPL_WITH_CHECKPOINT */
   }
   p->dtsn = dio->dtsn;
 }
@@ -48,6 +48,7 @@
 #include "net/ipv6/uip-ds6.h"
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-icmp6.h"
+#include "net/ipv6/sicslowpan.h"
 #include "net/rpl/rpl-private.h"
 #include "net/packetbuf.h"
 #include "net/ipv6/multicast/uip-mcast6.h"
@@ -157,6 +158,10 @@ dis_input(void)
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
   PRINTF("\n");
 
+  if(uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
+    rpl_dis_heard();
+  }
+
   for(instance = &instance_table[0], end = instance + RPL_MAX_INSTANCES;
       instance < end; ++instance) {
     if(instance->used == 1) {
@@ -204,6 +209,7 @@ dis_output(uip_ipaddr_t *addr)
   PRINT6ADDR(addr);
   PRINTF("\n");
 
+  RPL_STAT(rpl_stats.dis_sent++);
   uip_icmp6_send(addr, ICMP6_RPL, RPL_CODE_DIS, 2);
 }
 /*---------------------------------------------------------------------------*/
@@ -218,6 +224,15 @@ dio_input(void)
   int len;
   uip_ipaddr_t from;
   uip_ds6_nbr_t *nbr;
+#if RPL_WITH_6CO
+  /* 6CO bodies are applied after the DIO is processed, which may
+     overwrite uip_buf. */
+  uint8_t contexts[SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS][SICSLOWPAN_6CO_BODY_LEN];
+  uint8_t context_count = 0;
+  uint8_t context_changed = 0;
+  rpl_instance_t *instance;
+  rpl_parent_t *parent;
+#endif /* RPL_WITH_6CO */
 
   memset(&dio, 0, sizeof(dio));
 
@@ -405,6 +420,19 @@ dio_input(void)
       PRINTF("RPL: Copying prefix information\n");
       memcpy(&dio.prefix_info.prefix, &buffer[i + 16], 16);
       break;
+#if RPL_WITH_6CO
+    case RPL_OPTION_6CO:
+      if(len < 2 + SICSLOWPAN_6CO_BODY_LEN) {
+        PRINTF("RPL: Invalid 6CO, len = %d\n", len);
+        RPL_STAT(rpl_stats.malformed_msgs++);
+        return;
+      }
+      if(context_count < SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS) {
+        memcpy(contexts[context_count++], &buffer[i + 2],
+               SICSLOWPAN_6CO_BODY_LEN);
+      }
+      break;
+#endif /* RPL_WITH_6CO */
     default:
       PRINTF("RPL: Unsupported suboption type in DIO: %u\n",
 	(unsigned)subopt_type);
@@ -417,6 +445,26 @@ dio_input(void)
 
   rpl_process_dio(&from, &dio);
 
+#if RPL_WITH_6CO
+  /* Only the preferred parent's contexts are trusted, so that all
+     nodes on a path agree on them. A new context is passed on to our
+     children right away, before anyone compresses with it. */
+  instance = rpl_get_instance(dio.instance_id);
+  if(instance != NULL && instance->current_dag != NULL) {
+    parent = instance->current_dag->preferred_parent;
+    if(parent != NULL &&
+       uip_ipaddr_cmp(rpl_get_parent_ipaddr(parent), &from)) {
+      for(i = 0; i < context_count; i++) {
+        context_changed |= sicslowpan_6co_input(contexts[i],
+                                                SICSLOWPAN_6CO_BODY_LEN);
+      }
+      if(context_changed) {
+        rpl_reset_dio_timer(instance);
+      }
+    }
+  }
+#endif /* RPL_WITH_6CO */
+
   uip_len = 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -542,6 +590,17 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
            dag->prefix_info.length);
   }
 
+#if RPL_WITH_6CO
+  {
+    int index;
+    for(index = 0; sicslowpan_6co_get(index, &buffer[pos + 2]); index++) {
+      buffer[pos++] = RPL_OPTION_6CO;
+      buffer[pos++] = SICSLOWPAN_6CO_BODY_LEN;
+      pos += SICSLOWPAN_6CO_BODY_LEN;
+    }
+  }
+#endif /* RPL_WITH_6CO */
+
 #if RPL_LEAF_ONLY
 #if (DEBUG) & DEBUG_PRINT
   if(uc_addr == NULL) {
@@ -570,6 +629,272 @@ dio_output(rpl_instance_t *instance, uip_ipaddr_t *uc_addr)
 #endif /* RPL_LEAF_ONLY */
 }
 /*---------------------------------------------------------------------------*/
+/* A DAO target with the lifetime of the Transit option that covers it. */
+struct dao_target {
+  uip_ipaddr_t prefix;
+  uint8_t prefixlen;
+  uint8_t lifetime;
+};
+
+#define DAO_REJECTED  0
+#define DAO_ACCEPTED  1
+#define DAO_NO_PATH   2
+/*---------------------------------------------------------------------------*/
+static int
+dao_add_target(unsigned char *buffer, int pos, uip_ipaddr_t *prefix,
+               uint8_t prefixlen, uint8_t lifetime)
+{
+  /* create target subopt */
+  buffer[pos++] = RPL_OPTION_TARGET;
+  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = prefixlen;
+  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
+  pos += ((prefixlen + 7) / CHAR_BIT);
+
+  /* Create a transit information sub-option. */
+  buffer[pos++] = RPL_OPTION_TRANSIT;
+  buffer[pos++] = 4;
+  buffer[pos++] = 0; /* flags - ignored */
+  buffer[pos++] = 0; /* path control - ignored */
+  buffer[pos++] = 0; /* path seq - ignored */
+  buffer[pos++] = lifetime;
+
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+static int
+dao_add_header(unsigned char *buffer, rpl_instance_t *instance,
+               rpl_dag_t *dag, uint8_t flags)
+{
+  int pos;
+
+  RPL_LOLLIPOP_INCREMENT(dao_sequence);
+  pos = 0;
+
+  buffer[pos++] = instance->instance_id;
+  buffer[pos] = flags;
+#if RPL_DAO_SPECIFY_DAG
+  buffer[pos] |= RPL_DAO_D_FLAG;
+#endif /* RPL_DAO_SPECIFY_DAG */
+  ++pos;
+  buffer[pos++] = 0; /* reserved */
+  buffer[pos++] = dao_sequence;
+#if RPL_DAO_SPECIFY_DAG
+  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
+  pos+=sizeof(dag->dag_id);
+#endif /* RPL_DAO_SPECIFY_DAG */
+
+  return pos;
+}
+/*---------------------------------------------------------------------------*/
+#if RPL_DAO_AGGREGATION
+/* Targets of forwarded DAOs waiting to be passed on in one DAO. */
+static struct dao_target aggregated[RPL_DAO_AGGREGATION];
+static uint8_t aggregated_count;
+static rpl_instance_t *aggregated_instance;
+static struct ctimer aggregation_timer;
+/*---------------------------------------------------------------------------*/
+static void
+dao_aggregation_flush(void *ptr)
+{
+  rpl_instance_t *instance;
+  rpl_dag_t *dag;
+  unsigned char *buffer;
+  uip_ipaddr_t *addr;
+  int pos;
+  int i;
+
+  ctimer_stop(&aggregation_timer);
+
+  instance = aggregated_instance;
+  if(aggregated_count == 0 || instance == NULL || !instance->used) {
+    aggregated_count = 0;
+    return;
+  }
+
+  dag = instance->current_dag;
+  if(dag == NULL || dag->preferred_parent == NULL ||
+     (addr = rpl_get_parent_ipaddr(dag->preferred_parent)) == NULL) {
+    PRINTF("RPL: No parent for %u aggregated DAO targets\n", aggregated_count);
+    aggregated_count = 0;
+    return;
+  }
+
+  /* The targets were acknowledged hop-by-hop already and will be
+     refreshed by their owners; no ACK is requested. */
+  buffer = UIP_ICMP_PAYLOAD;
+  pos = dao_add_header(buffer, instance, dag, 0);
+  for(i = 0; i < aggregated_count; i++) {
+    pos = dao_add_target(buffer, pos, &aggregated[i].prefix,
+                         aggregated[i].prefixlen, aggregated[i].lifetime);
+  }
+
+  PRINTF("RPL: Forwarding %u aggregated DAO targets to parent ",
+         aggregated_count);
+  PRINT6ADDR(addr);
+  PRINTF("\n");
+
+  aggregated_count = 0;
+  RPL_STAT(rpl_stats.dao_sent++);
+  uip_icmp6_send(addr, ICMP6_RPL, RPL_CODE_DAO, pos);
+}
+/*---------------------------------------------------------------------------*/
+/* Queues a target for forwarding. May send the queued targets right
+   away, which overwrites uip_buf. */
+static void
+dao_aggregate(rpl_instance_t *instance, struct dao_target *target)
+{
+  int i;
+
+  if(aggregated_count > 0 && aggregated_instance != instance) {
+    dao_aggregation_flush(NULL);
+  }
+
+  for(i = 0; i < aggregated_count; i++) {
+    if(aggregated[i].prefixlen == target->prefixlen &&
+       uip_ipaddr_cmp(&aggregated[i].prefix, &target->prefix)) {
+      aggregated[i].lifetime = target->lifetime;
+      return;
+    }
+  }
+
+  memcpy(&aggregated[aggregated_count++], target, sizeof(*target));
+  aggregated_instance = instance;
+
+  if(aggregated_count == RPL_DAO_AGGREGATION) {
+    dao_aggregation_flush(NULL);
+  } else if(aggregated_count == 1) {
+    ctimer_set(&aggregation_timer, RPL_DAO_AGGREGATION_DELAY,
+               dao_aggregation_flush, NULL);
+  }
+}
+#endif /* RPL_DAO_AGGREGATION */
+/*---------------------------------------------------------------------------*/
+#if RPL_DAO_RATE_LIMIT
+/* Token bucket holding up to one second's worth of DAOs. */
+static uint8_t dao_tokens;
+static clock_time_t dao_tokens_updated;
+/*---------------------------------------------------------------------------*/
+static int
+dao_rate_ok(void)
+{
+  clock_time_t now;
+  clock_time_t elapsed;
+  unsigned long refill;
+
+  now = clock_time();
+  elapsed = now - dao_tokens_updated;
+  /* A second refills the whole bucket, more would only overflow the
+     multiplication after a long idle period. */
+  if(elapsed > CLOCK_SECOND) {
+    elapsed = CLOCK_SECOND;
+  }
+  refill = ((unsigned long)elapsed * RPL_DAO_RATE_LIMIT) / CLOCK_SECOND;
+  if(refill > 0) {
+    if(dao_tokens + refill >= RPL_DAO_RATE_LIMIT) {
+      dao_tokens = RPL_DAO_RATE_LIMIT;
+      dao_tokens_updated = now;
+    } else {
+      dao_tokens += refill;
+      dao_tokens_updated += (refill * CLOCK_SECOND) / RPL_DAO_RATE_LIMIT;
+    }
+  }
+
+  if(dao_tokens == 0) {
+    return 0;
+  }
+  dao_tokens--;
+  return 1;
+}
+#endif /* RPL_DAO_RATE_LIMIT */
+/*---------------------------------------------------------------------------*/
+/* Installs or removes the route to one DAO target. */
+static int
+dao_input_target(rpl_instance_t *instance, rpl_dag_t *dag,
+                 uip_ipaddr_t *dao_sender_addr, int learned_from,
+                 rpl_parent_t *parent, struct dao_target *target)
+{
+  uip_ds6_route_t *rep;
+  uip_ds6_nbr_t *nbr;
+
+  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
+          (unsigned)target->lifetime, (unsigned)target->prefixlen);
+  PRINT6ADDR(&target->prefix);
+  PRINTF("\n");
+
+#if RPL_CONF_MULTICAST
+  if(uip_is_addr_mcast_global(&target->prefix)) {
+    mcast_group = uip_mcast6_route_add(&target->prefix);
+    if(mcast_group) {
+      mcast_group->dag = dag;
+      mcast_group->lifetime = RPL_LIFETIME(instance, target->lifetime);
+    }
+    return DAO_ACCEPTED;
+  }
+#endif
+
+  rep = uip_ds6_route_lookup(&target->prefix);
+
+  if(target->lifetime == RPL_ZERO_LIFETIME) {
+    PRINTF("RPL: No-Path DAO received\n");
+    /* No-Path DAO received; invoke the route purging routine. */
+    if(rep != NULL &&
+       rep->state.nopath_received == 0 &&
+       rep->length == target->prefixlen &&
+       uip_ds6_route_nexthop(rep) != NULL &&
+       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), dao_sender_addr)) {
+      PRINTF("RPL: Setting expiration timer for prefix ");
+      PRINT6ADDR(&target->prefix);
+      PRINTF("\n");
+      rep->state.nopath_received = 1;
+      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
+      return DAO_NO_PATH;
+    }
+    return DAO_REJECTED;
+  }
+
+  PRINTF("RPL: adding DAO route\n");
+
+  if((nbr = uip_ds6_nbr_lookup(dao_sender_addr)) == NULL) {
+    if((nbr = uip_ds6_nbr_add(dao_sender_addr,
+                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
+                              0, NBR_REACHABLE)) != NULL) {
+      /* set reachable timer */
+      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
+      PRINTF("RPL: Neighbor added to neighbor cache ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+    } else {
+      PRINTF("RPL: Out of Memory, dropping DAO from ");
+      PRINT6ADDR(dao_sender_addr);
+      PRINTF(", ");
+      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
+      PRINTF("\n");
+      return DAO_REJECTED;
+    }
+  } else {
+    PRINTF("RPL: Neighbor already in neighbor cache\n");
+  }
+
+  rpl_lock_parent(parent);
+
+  rep = rpl_add_route(dag, &target->prefix, target->prefixlen,
+                      dao_sender_addr);
+  if(rep == NULL) {
+    RPL_STAT(rpl_stats.mem_overflows++);
+    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+    return DAO_REJECTED;
+  }
+
+  rep->state.lifetime = RPL_LIFETIME(instance, target->lifetime);
+  rep->state.learned_from = learned_from;
+
+  return DAO_ACCEPTED;
+}
+/*---------------------------------------------------------------------------*/
 static void
 dao_input(void)
 {
@@ -579,25 +904,25 @@ dao_input(void)
   unsigned char *buffer;
   uint16_t sequence;
   uint8_t instance_id;
-  uint8_t lifetime;
-  uint8_t prefixlen;
   uint8_t flags;
   uint8_t subopt_type;
   /*
   uint8_t pathcontrol;
   uint8_t pathsequence;
   */
-  uip_ipaddr_t prefix;
-  uip_ds6_route_t *rep;
+  struct dao_target targets[RPL_DAO_MAX_TARGETS];
   uint8_t buffer_length;
+  int count;
+  int covered;
   int pos;
   int len;
   int i;
   int learned_from;
+  int result;
+  int forward;
+  int accepted;
   rpl_parent_t *parent;
-  uip_ds6_nbr_t *nbr;
 
-  prefixlen = 0;
   parent = NULL;
 
   uip_ipaddr_copy(&dao_sender_addr, &UIP_IP_BUF->srcipaddr);
@@ -620,8 +945,6 @@ dao_input(void)
     return;
   }
 
-  lifetime = instance->default_lifetime;
-
   flags = buffer[pos++];
   /* reserved */
   pos++;
@@ -665,7 +988,10 @@ dao_input(void)
     }
   }
 
-  /* Check if there are any RPL options present. */
+  /* Check if there are any RPL options present. A Transit option
+     applies to all the Target options before it. */
+  count = 0;
+  covered = 0;
   for(i = pos; i < buffer_length; i += len) {
     subopt_type = buffer[i];
     if(subopt_type == RPL_OPTION_PAD1) {
@@ -678,122 +1004,106 @@ dao_input(void)
     switch(subopt_type) {
     case RPL_OPTION_TARGET:
       /* Handle the target option. */
-      prefixlen = buffer[i + 3];
-      memset(&prefix, 0, sizeof(prefix));
-      memcpy(&prefix, buffer + i + 4, (prefixlen + 7) / CHAR_BIT);
+      if(buffer[i + 3] > sizeof(uip_ipaddr_t) * CHAR_BIT) {
+        RPL_STAT(rpl_stats.malformed_msgs++);
+        return;
+      }
+      if(count == RPL_DAO_MAX_TARGETS) {
+        PRINTF("RPL: Too many DAO targets, ignoring the rest\n");
+        break;
+      }
+      targets[count].prefixlen = buffer[i + 3];
+      memset(&targets[count].prefix, 0, sizeof(targets[count].prefix));
+      memcpy(&targets[count].prefix, buffer + i + 4,
+             (targets[count].prefixlen + 7) / CHAR_BIT);
+      targets[count].lifetime = instance->default_lifetime;
+      count++;
       break;
     case RPL_OPTION_TRANSIT:
       /* The path sequence and control are ignored. */
       /*      pathcontrol = buffer[i + 3];
               pathsequence = buffer[i + 4];*/
-      lifetime = buffer[i + 5];
+      for(; covered < count; covered++) {
+        targets[covered].lifetime = buffer[i + 5];
+      }
       /* The parent address is also ignored. */
       break;
     }
   }
 
-  PRINTF("RPL: DAO lifetime: %u, prefix length: %u prefix: ",
-          (unsigned)lifetime, (unsigned)prefixlen);
-  PRINT6ADDR(&prefix);
-  PRINTF("\n");
-
-#if RPL_CONF_MULTICAST
-  if(uip_is_addr_mcast_global(&prefix)) {
-    mcast_group = uip_mcast6_route_add(&prefix);
-    if(mcast_group) {
-      mcast_group->dag = dag;
-      mcast_group->lifetime = RPL_LIFETIME(instance, lifetime);
-    }
-    goto fwd_dao;
+  if(count == 0) {
+    PRINTF("RPL: DAO without targets\n");
+    return;
   }
-#endif
-
-  rep = uip_ds6_route_lookup(&prefix);
-
-  if(lifetime == RPL_ZERO_LIFETIME) {
-    PRINTF("RPL: No-Path DAO received\n");
-    /* No-Path DAO received; invoke the route purging routine. */
-    if(rep != NULL &&
-       rep->state.nopath_received == 0 &&
-       rep->length == prefixlen &&
-       uip_ds6_route_nexthop(rep) != NULL &&
-       uip_ipaddr_cmp(uip_ds6_route_nexthop(rep), &dao_sender_addr)) {
-      PRINTF("RPL: Setting expiration timer for prefix ");
-      PRINT6ADDR(&prefix);
-      PRINTF("\n");
-      rep->state.nopath_received = 1;
-      rep->state.lifetime = DAO_EXPIRATION_TIMEOUT;
 
-      /* We forward the incoming no-path DAO to our parent, if we have
-         one. */
-      if(dag->preferred_parent != NULL &&
-         rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
-        PRINTF("RPL: Forwarding no-path DAO to parent ");
-        PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
-        PRINTF("\n");
-        uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
-                       ICMP6_RPL, RPL_CODE_DAO, buffer_length);
-      }
-      if(flags & RPL_DAO_K_FLAG) {
-        dao_ack_output(instance, &dao_sender_addr, sequence);
-      }
-    }
+#if RPL_DAO_RATE_LIMIT
+  /*
+   * Only limit DAOs that the child sent for itself (its global address
+   * has the interface identifier of its link-local address) and will
+   * retransmit. Forwarded DAOs were acknowledged further down already.
+   */
+  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO &&
+     (flags & RPL_DAO_K_FLAG) && count == 1 &&
+     targets[0].lifetime != RPL_ZERO_LIFETIME &&
+     memcmp(&targets[0].prefix.u8[8], &dao_sender_addr.u8[8], 8) == 0 &&
+     !dao_rate_ok()) {
+    PRINTF("RPL: DAO rate limit reached, rejecting DAO from ");
+    PRINT6ADDR(&dao_sender_addr);
+    PRINTF("\n");
+    RPL_STAT(rpl_stats.dao_rate_limited++);
+    dao_ack_output(instance, &dao_sender_addr, sequence,
+                   RPL_DAO_ACK_UNABLE_TO_ACCEPT);
+    uip_len = 0;
     return;
   }
-
-  PRINTF("RPL: adding DAO route\n");
-
-  if((nbr = uip_ds6_nbr_lookup(&dao_sender_addr)) == NULL) {
-    if((nbr = uip_ds6_nbr_add(&dao_sender_addr,
-                              (uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER),
-                              0, NBR_REACHABLE)) != NULL) {
-      /* set reachable timer */
-      stimer_set(&nbr->reachable, UIP_ND6_REACHABLE_TIME / 1000);
-      PRINTF("RPL: Neighbor added to neighbor cache ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-    } else {
-      PRINTF("RPL: Out of Memory, dropping DAO from ");
-      PRINT6ADDR(&dao_sender_addr);
-      PRINTF(", ");
-      PRINTLLADDR((uip_lladdr_t *)packetbuf_addr(PACKETBUF_ADDR_SENDER));
-      PRINTF("\n");
-      return;
+#endif /* RPL_DAO_RATE_LIMIT */
+
+  forward = 0;
+  accepted = 0;
+  for(i = 0; i < count; i++) {
+    result = dao_input_target(instance, dag, &dao_sender_addr, learned_from,
+                              parent, &targets[i]);
+    if(result == DAO_NO_PATH ||
+       (result == DAO_ACCEPTED &&
+        learned_from == RPL_ROUTE_FROM_UNICAST_DAO)) {
+      accepted++;
+      forward |= 1 << i;
     }
-  } else {
-    PRINTF("RPL: Neighbor already in neighbor cache\n");
   }
 
-  rpl_lock_parent(parent);
-
-  rep = rpl_add_route(dag, &prefix, prefixlen, &dao_sender_addr);
-  if(rep == NULL) {
-    RPL_STAT(rpl_stats.mem_overflows++);
-    PRINTF("RPL: Could not add a route after receiving a DAO\n");
+  if(accepted == 0) {
     return;
   }
 
-  rep->state.lifetime = RPL_LIFETIME(instance, lifetime);
-  rep->state.learned_from = learned_from;
-
-#if RPL_CONF_MULTICAST
-fwd_dao:
-#endif
-
-  if(learned_from == RPL_ROUTE_FROM_UNICAST_DAO) {
-    if(dag->preferred_parent != NULL &&
-       rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
+  if(dag->preferred_parent != NULL &&
+     rpl_get_parent_ipaddr(dag->preferred_parent) != NULL) {
+#if RPL_DAO_AGGREGATION
+    /* No-Path and multicast DAOs come alone and are forwarded at once. */
+    if(count > 1 ||
+       (targets[0].lifetime != RPL_ZERO_LIFETIME &&
+        !uip_is_addr_mcast(&targets[0].prefix))) {
+      for(i = 0; i < count; i++) {
+        if(forward & (1 << i)) {
+          dao_aggregate(instance, &targets[i]);
+        }
+      }
+    } else
+#endif /* RPL_DAO_AGGREGATION */
+    {
       PRINTF("RPL: Forwarding DAO to parent ");
       PRINT6ADDR(rpl_get_parent_ipaddr(dag->preferred_parent));
       PRINTF("\n");
+      /* We acknowledge it below, an ACK from the parent for the
+         sequence number of the child could be taken for ours. */
+      buffer[1] &= ~RPL_DAO_K_FLAG;
+      RPL_STAT(rpl_stats.dao_sent++);
       uip_icmp6_send(rpl_get_parent_ipaddr(dag->preferred_parent),
                      ICMP6_RPL, RPL_CODE_DAO, buffer_length);
     }
-    if(flags & RPL_DAO_K_FLAG) {
-      dao_ack_output(instance, &dao_sender_addr, sequence);
-    }
+  }
+  if(flags & RPL_DAO_K_FLAG) {
+    dao_ack_output(instance, &dao_sender_addr, sequence,
+                   RPL_DAO_ACK_UNCONDITIONAL_ACCEPT);
   }
   uip_len = 0;
 }
@@ -811,6 +1121,15 @@ dao_output(rpl_parent_t *parent, uint8_t lifetime)
 
   /* Sending a DAO with own prefix as target */
   dao_output_target(parent, &prefix, lifetime);
+
+#if RPL_CONF_DAO_ACK
+  /* Keep sending our own DAO until it is acknowledged. */
+  if(lifetime != RPL_ZERO_LIFETIME && parent != NULL &&
+     parent->dag != NULL && parent->dag->instance != NULL) {
+    parent->dag->instance->my_dao_seqno = dao_sequence;
+    rpl_schedule_dao_retransmission(parent->dag->instance);
+  }
+#endif /* RPL_CONF_DAO_ACK */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -819,7 +1138,7 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   rpl_dag_t *dag;
   rpl_instance_t *instance;
   unsigned char *buffer;
-  uint8_t prefixlen;
+  uint8_t flags;
   int pos;
 
   /* Destination Advertisement Object */
@@ -856,41 +1175,13 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 
   buffer = UIP_ICMP_PAYLOAD;
 
-  RPL_LOLLIPOP_INCREMENT(dao_sequence);
-  pos = 0;
-
-  buffer[pos++] = instance->instance_id;
-  buffer[pos] = 0;
-#if RPL_DAO_SPECIFY_DAG
-  buffer[pos] |= RPL_DAO_D_FLAG;
-#endif /* RPL_DAO_SPECIFY_DAG */
+  flags = 0;
 #if RPL_CONF_DAO_ACK
-  buffer[pos] |= RPL_DAO_K_FLAG;
+  flags |= RPL_DAO_K_FLAG;
 #endif /* RPL_CONF_DAO_ACK */
-  ++pos;
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = dao_sequence;
-#if RPL_DAO_SPECIFY_DAG
-  memcpy(buffer + pos, &dag->dag_id, sizeof(dag->dag_id));
-  pos+=sizeof(dag->dag_id);
-#endif /* RPL_DAO_SPECIFY_DAG */
-
-  /* create target subopt */
-  prefixlen = sizeof(*prefix) * CHAR_BIT;
-  buffer[pos++] = RPL_OPTION_TARGET;
-  buffer[pos++] = 2 + ((prefixlen + 7) / CHAR_BIT);
-  buffer[pos++] = 0; /* reserved */
-  buffer[pos++] = prefixlen;
-  memcpy(buffer + pos, prefix, (prefixlen + 7) / CHAR_BIT);
-  pos += ((prefixlen + 7) / CHAR_BIT);
-
-  /* Create a transit information sub-option. */
-  buffer[pos++] = RPL_OPTION_TRANSIT;
-  buffer[pos++] = 4;
-  buffer[pos++] = 0; /* flags - ignored */
-  buffer[pos++] = 0; /* path control - ignored */
-  buffer[pos++] = 0; /* path seq - ignored */
-  buffer[pos++] = lifetime;
+  pos = dao_add_header(buffer, instance, dag, flags);
+  pos = dao_add_target(buffer, pos, prefix,
+                       sizeof(*prefix) * CHAR_BIT, lifetime);
 
   PRINTF("RPL: Sending DAO with prefix ");
   PRINT6ADDR(prefix);
@@ -899,6 +1190,7 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
   PRINTF("\n");
 
   if(rpl_get_parent_ipaddr(parent) != NULL) {
+    RPL_STAT(rpl_stats.dao_sent++);
     uip_icmp6_send(rpl_get_parent_ipaddr(parent), ICMP6_RPL, RPL_CODE_DAO, pos);
   }
 }
@@ -906,15 +1198,17 @@ dao_output_target(rpl_parent_t *parent, uip_ipaddr_t *prefix, uint8_t lifetime)
 static void
 dao_ack_input(void)
 {
-#if DEBUG
+#if DEBUG || RPL_CONF_DAO_ACK
   unsigned char *buffer;
-  uint8_t buffer_length;
   uint8_t instance_id;
   uint8_t sequence;
   uint8_t status;
+#if RPL_CONF_DAO_ACK
+  rpl_instance_t *instance;
+  uip_ipaddr_t *parent_addr;
+#endif /* RPL_CONF_DAO_ACK */
 
   buffer = UIP_ICMP_PAYLOAD;
-  buffer_length = uip_len - uip_l3_icmp_hdr_len;
 
   instance_id = buffer[0];
   sequence = buffer[2];
@@ -924,16 +1218,39 @@ dao_ack_input(void)
     sequence, status);
   PRINT6ADDR(&UIP_IP_BUF->srcipaddr);
   PRINTF("\n");
-#endif /* DEBUG */
+
+#if RPL_CONF_DAO_ACK
+  instance = rpl_get_instance(instance_id);
+  /* Forwarded DAOs go without the K flag, only ours are acknowledged */
+  if(instance != NULL && sequence == instance->my_dao_seqno &&
+     !ctimer_expired(&instance->dao_retransmit_timer) &&
+     instance->current_dag != NULL &&
+     instance->current_dag->preferred_parent != NULL &&
+     (parent_addr =
+      rpl_get_parent_ipaddr(instance->current_dag->preferred_parent)) != NULL &&
+     uip_ipaddr_cmp(parent_addr, &UIP_IP_BUF->srcipaddr)) {
+    if(status < RPL_DAO_ACK_UNABLE_TO_ACCEPT) {
+      ctimer_stop(&instance->dao_retransmit_timer);
+    } else {
+      /* The parent is busy; the retransmission timer is still running
+         with a longer timeout than the last one. */
+      PRINTF("RPL: DAO rejected, backing off\n");
+      RPL_STAT(rpl_stats.dao_rejected++);
+    }
+  }
+#endif /* RPL_CONF_DAO_ACK */
+#endif /* DEBUG || RPL_CONF_DAO_ACK */
   uip_len = 0;
 }
 /*---------------------------------------------------------------------------*/
 void
-dao_ack_output(rpl_instance_t *instance, uip_ipaddr_t *dest, uint8_t sequence)
+dao_ack_output(rpl_instance_t *instance, uip_ipaddr_t *dest, uint8_t sequence,
+               uint8_t status)
 {
   unsigned char *buffer;
 
-  PRINTF("RPL: Sending a DAO ACK with sequence number %d to ", sequence);
+  PRINTF("RPL: Sending a DAO ACK with sequence number %d and status %d to ",
+         sequence, status);
   PRINT6ADDR(dest);
   PRINTF("\n");
 
@@ -942,7 +1259,7 @@ dao_ack_output(rpl_instance_t *instance, uip_ipaddr_t *dest, uint8_t sequence)
   buffer[0] = instance->instance_id;
   buffer[1] = 0;
   buffer[2] = sequence;
-  buffer[3] = 0;
+  buffer[3] = status;
 
   uip_icmp6_send(dest, ICMP6_RPL, RPL_CODE_DAO_ACK, 4);
 }
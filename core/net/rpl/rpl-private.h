@@ -87,6 +87,9 @@
 #define RPL_OPTION_SOLICITED_INFO        7
 #define RPL_OPTION_PREFIX_INFO           8
 #define RPL_OPTION_TARGET_DESC           9
+/* 6LoWPAN Context Option (RFC 6775) carried in DIOs; no type has been
+   assigned by IANA for this, so pick one from the unassigned range. */
+#define RPL_OPTION_6CO                   0x22
 
 #define RPL_DAO_K_FLAG                   0x80 /* DAO ACK requested */
 #define RPL_DAO_D_FLAG                   0x40 /* DODAG ID present */
@@ -110,6 +113,38 @@
 #define RPL_DAO_LATENCY                 (CLOCK_SECOND * 4)
 #endif /* RPL_DAO_LATENCY */
 
+/* Upper bound of the rank-aware DAO timer, see schedule_dao(). */
+#ifdef RPL_CONF_DAO_MAX_LATENCY
+#define RPL_DAO_MAX_LATENCY             RPL_CONF_DAO_MAX_LATENCY
+#else /* RPL_CONF_DAO_MAX_LATENCY */
+#define RPL_DAO_MAX_LATENCY             (CLOCK_SECOND * 16)
+#endif /* RPL_DAO_MAX_LATENCY */
+
+/* Time to wait for a DAO ACK before the first retransmission. The
+   timeout doubles for every retransmission. */
+#ifdef RPL_CONF_DAO_ACK_TIMEOUT
+#define RPL_DAO_ACK_TIMEOUT             RPL_CONF_DAO_ACK_TIMEOUT
+#else /* RPL_CONF_DAO_ACK_TIMEOUT */
+#define RPL_DAO_ACK_TIMEOUT             (CLOCK_SECOND * 4)
+#endif /* RPL_DAO_ACK_TIMEOUT */
+
+#ifdef RPL_CONF_DAO_MAX_RETRANSMISSIONS
+#define RPL_DAO_MAX_RETRANSMISSIONS     RPL_CONF_DAO_MAX_RETRANSMISSIONS
+#else /* RPL_CONF_DAO_MAX_RETRANSMISSIONS */
+#define RPL_DAO_MAX_RETRANSMISSIONS     5
+#endif /* RPL_DAO_MAX_RETRANSMISSIONS */
+
+/* Largest number of targets accepted in one DAO. */
+#ifdef RPL_CONF_DAO_MAX_TARGETS
+#define RPL_DAO_MAX_TARGETS             RPL_CONF_DAO_MAX_TARGETS
+#else /* RPL_CONF_DAO_MAX_TARGETS */
+#define RPL_DAO_MAX_TARGETS             8
+#endif /* RPL_DAO_MAX_TARGETS */
+
+/* DAO ACK status values. Values of 128 and above are rejections. */
+#define RPL_DAO_ACK_UNCONDITIONAL_ACCEPT  0
+#define RPL_DAO_ACK_UNABLE_TO_ACCEPT      128
+
 /* Special value indicating immediate removal. */
 #define RPL_ZERO_LIFETIME               0
 
@@ -206,13 +241,23 @@
 #define RPL_DAG_MC_ETX_DIVISOR		256
 
 /* DIS related */
+#ifdef RPL_CONF_DIS_SEND
+#define RPL_DIS_SEND                    RPL_CONF_DIS_SEND
+#else
 #define RPL_DIS_SEND                    1
+#endif
 #ifdef  RPL_DIS_INTERVAL_CONF
 #define RPL_DIS_INTERVAL                RPL_DIS_INTERVAL_CONF
 #else
 #define RPL_DIS_INTERVAL                60
 #endif
-#define RPL_DIS_START_DELAY             5
+/* DIS are sent with exponential backoff, starting from this interval
+   (in seconds) up to RPL_DIS_INTERVAL. */
+#ifdef  RPL_DIS_MIN_INTERVAL_CONF
+#define RPL_DIS_MIN_INTERVAL            RPL_DIS_MIN_INTERVAL_CONF
+#else
+#define RPL_DIS_MIN_INTERVAL            8
+#endif
 /*---------------------------------------------------------------------------*/
 /* Lollipop counters */
 
@@ -265,6 +310,12 @@ struct rpl_stats {
   uint16_t malformed_msgs;
   uint16_t resets;
   uint16_t parent_switch;
+  uint16_t dao_retransmissions;
+  uint16_t dao_rejected;
+  uint16_t dao_rate_limited;
+  uint16_t dis_suppressed;
+  uint16_t dao_sent;
+  uint16_t dis_sent;
 };
 typedef struct rpl_stats rpl_stats_t;
 
@@ -288,7 +339,7 @@ void dis_output(uip_ipaddr_t *addr);
 void dio_output(rpl_instance_t *, uip_ipaddr_t *uc_addr);
 void dao_output(rpl_parent_t *, uint8_t lifetime);
 void dao_output_target(rpl_parent_t *, uip_ipaddr_t *, uint8_t lifetime);
-void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t);
+void dao_ack_output(rpl_instance_t *, uip_ipaddr_t *, uint8_t, uint8_t);
 void rpl_icmp6_register_handlers(void);
 
 /* RPL logic functions. */
@@ -332,10 +383,21 @@ rpl_of_t *rpl_find_of(rpl_ocp_t);
 void rpl_schedule_dao(rpl_instance_t *);
 void rpl_schedule_dao_immediately(rpl_instance_t *);
 void rpl_cancel_dao(rpl_instance_t *instance);
+#if RPL_CONF_DAO_ACK
+void rpl_schedule_dao_retransmission(rpl_instance_t *instance);
+#endif /* RPL_CONF_DAO_ACK */
+void rpl_dis_heard(void);
 
 void rpl_reset_dio_timer(rpl_instance_t *);
 void rpl_reset_periodic_timer(void);
 
+/* DODAG checkpoints. */
+#if RPL_WITH_CHECKPOINT
+void rpl_checkpoint_restore(void);
+void rpl_checkpoint_schedule(void);
+void rpl_checkpoint_parent_confirmed(rpl_instance_t *instance);
+#endif /* RPL_WITH_CHECKPOINT */
+
 /* Route poisoning. */
 void rpl_poison_routes(rpl_dag_t *, rpl_parent_t *);
 
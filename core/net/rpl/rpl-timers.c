@@ -57,11 +57,28 @@ static void handle_periodic_timer(void *ptr);
 static void new_dio_interval(rpl_instance_t *instance);
 static void handle_dio_timer(void *ptr);
 
+#if RPL_DIS_SEND
+/* Seconds until the next DIS, and the current DIS backoff interval. */
 static uint16_t next_dis;
+static uint16_t dis_interval;
+/* Set if another node solicited DIOs during the current interval. */
+static uint8_t dis_heard;
+#endif /* RPL_DIS_SEND */
 
 /* dio_send_ok is true if the node is ready to send DIOs */
 static uint8_t dio_send_ok;
 
+/*---------------------------------------------------------------------------*/
+#if RPL_DIS_SEND
+/* Picks a random point in the second half of the DIS interval, so that
+   nodes that booted together do not solicit at the same time. */
+static void
+new_dis_interval(void)
+{
+  next_dis = dis_interval / 2 + random_rand() % (dis_interval / 2 + 1);
+  dis_heard = 0;
+}
+#endif /* RPL_DIS_SEND */
 /*---------------------------------------------------------------------------*/
 static void
 handle_periodic_timer(void *ptr)
@@ -71,15 +88,37 @@ handle_periodic_timer(void *ptr)
 
   /* handle DIS */
 #if RPL_DIS_SEND
-  next_dis++;
-  if(rpl_get_any_dag() == NULL && next_dis >= RPL_DIS_INTERVAL) {
-    next_dis = 0;
-    dis_output(NULL);
+  if(rpl_get_any_dag() != NULL) {
+    /* Start over quickly if the DAG is lost. */
+    dis_interval = RPL_DIS_MIN_INTERVAL;
+    new_dis_interval();
+  } else if(next_dis > 0 && --next_dis == 0) {
+    /* A DIS from a neighbor makes its DIO answers reach us as well. */
+    if(dis_heard) {
+      PRINTF("RPL: Suppressing DIS\n");
+      RPL_STAT(rpl_stats.dis_suppressed++);
+    } else {
+      dis_output(NULL);
+    }
+    if(dis_interval < RPL_DIS_INTERVAL / 2) {
+      dis_interval *= 2;
+    } else {
+      dis_interval = RPL_DIS_INTERVAL;
+    }
+    new_dis_interval();
   }
 #endif
   ctimer_reset(&periodic_timer);
 }
 /*---------------------------------------------------------------------------*/
+void
+rpl_dis_heard(void)
+{
+#if RPL_DIS_SEND
+  dis_heard = 1;
+#endif /* RPL_DIS_SEND */
+}
+/*---------------------------------------------------------------------------*/
 static void
 new_dio_interval(rpl_instance_t *instance)
 {
@@ -171,9 +210,10 @@ handle_dio_timer(void *ptr)
 void
 rpl_reset_periodic_timer(void)
 {
-  next_dis = RPL_DIS_INTERVAL / 2 +
-    ((uint32_t)RPL_DIS_INTERVAL * (uint32_t)random_rand()) / RANDOM_RAND_MAX -
-    RPL_DIS_START_DELAY;
+#if RPL_DIS_SEND
+  dis_interval = RPL_DIS_MIN_INTERVAL;
+  new_dis_interval();
+#endif
   ctimer_set(&periodic_timer, CLOCK_SECOND, handle_periodic_timer, NULL);
 }
 /*---------------------------------------------------------------------------*/
@@ -237,6 +277,9 @@ handle_dao_timer(void *ptr)
   /* Send the DAO to the DAO parent set -- the preferred parent in our case. */
   if(instance->current_dag->preferred_parent != NULL) {
     PRINTF("RPL: handle_dao_timer - sending DAO\n");
+#if RPL_CONF_DAO_ACK
+    instance->my_dao_transmissions = 0;
+#endif /* RPL_CONF_DAO_ACK */
     /* Set the route lifetime to the default value. */
     dao_output(instance->current_dag->preferred_parent, instance->default_lifetime);
 
@@ -275,10 +318,54 @@ handle_dao_timer(void *ptr)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if RPL_CONF_DAO_ACK
+static void
+handle_dao_retransmit_timer(void *ptr)
+{
+  rpl_instance_t *instance;
+
+  instance = (rpl_instance_t *)ptr;
+
+  if(instance->current_dag == NULL ||
+     instance->current_dag->preferred_parent == NULL) {
+    /* A new DAO is scheduled when we get a new parent. */
+    return;
+  }
+
+  if(instance->my_dao_transmissions > RPL_DAO_MAX_RETRANSMISSIONS) {
+    PRINTF("RPL: No DAO ACK after %u retransmissions, giving up\n",
+           RPL_DAO_MAX_RETRANSMISSIONS);
+    return;
+  }
+
+  PRINTF("RPL: No DAO ACK, retransmitting DAO\n");
+  RPL_STAT(rpl_stats.dao_retransmissions++);
+  dao_output(instance->current_dag->preferred_parent,
+             instance->default_lifetime);
+}
+/*---------------------------------------------------------------------------*/
+/* Called for every own DAO that was sent. The timeout doubles with
+   every transmission and is randomized to break up nodes that lost
+   their DAOs in the same collision. */
+void
+rpl_schedule_dao_retransmission(rpl_instance_t *instance)
+{
+  clock_time_t timeout;
+
+  timeout = RPL_DAO_ACK_TIMEOUT << instance->my_dao_transmissions;
+  timeout += random_rand() % timeout;
+  instance->my_dao_transmissions++;
+
+  ctimer_set(&instance->dao_retransmit_timer, timeout,
+             handle_dao_retransmit_timer, instance);
+}
+#endif /* RPL_CONF_DAO_ACK */
+/*---------------------------------------------------------------------------*/
 static void
 schedule_dao(rpl_instance_t *instance, clock_time_t latency)
 {
   clock_time_t expiration_time;
+  rpl_rank_t depth;
 
   if(rpl_get_mode() == RPL_MODE_FEATHER) {
     return;
@@ -290,6 +377,21 @@ schedule_dao(rpl_instance_t *instance, clock_time_t latency)
     PRINTF("RPL: DAO timer already scheduled\n");
   } else {
     if(latency != 0) {
+      /*
+       * The DAOs of deeper nodes have to be forwarded by every router
+       * on the way to the root. Spread them over a window that grows
+       * with the depth, so that the routers close to the root are not
+       * hit by the whole network at once.
+       */
+      if(instance->current_dag != NULL) {
+        depth = DAG_RANK(instance->current_dag->rank, instance);
+        if(depth > 1 && latency < RPL_DAO_MAX_LATENCY) {
+          latency += (latency / 2) * (depth - 1);
+          if(latency > RPL_DAO_MAX_LATENCY) {
+            latency = RPL_DAO_MAX_LATENCY;
+          }
+        }
+      }
       expiration_time = latency / 2 +
         (random_rand() % (latency));
     } else {
@@ -321,6 +423,9 @@ rpl_cancel_dao(rpl_instance_t *instance)
 {
   ctimer_stop(&instance->dao_timer);
   ctimer_stop(&instance->dao_lifetime_timer);
+#if RPL_CONF_DAO_ACK
+  ctimer_stop(&instance->dao_retransmit_timer);
+#endif /* RPL_CONF_DAO_ACK */
 }
 /*---------------------------------------------------------------------------*/
 #endif /* UIP_CONF_IPV6 */
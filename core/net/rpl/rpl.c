@@ -312,6 +312,10 @@ rpl_init(void)
 #endif
 
   RPL_OF.reset(NULL);
+
+#if RPL_WITH_CHECKPOINT
+  rpl_checkpoint_restore();
+#endif /* RPL_WITH_CHECKPOINT */
 }
 /*---------------------------------------------------------------------------*/
 #endif /* UIP_CONF_IPV6 */
@@ -225,8 +225,60 @@ struct rpl_instance {
   struct ctimer dio_timer;
   struct ctimer dao_timer;
   struct ctimer dao_lifetime_timer;
+#if RPL_CONF_DAO_ACK
+  struct ctimer dao_retransmit_timer;
+  uint8_t my_dao_seqno;
+  uint8_t my_dao_transmissions;
+#endif /* RPL_CONF_DAO_ACK */
 };
 
+/*---------------------------------------------------------------------------*/
+/*
+ * DODAG state kept in non-volatile storage for a fast rejoin after a
+ * reboot. The parent fields describe the preferred parent, which is
+ * also the next hop of the default route.
+ */
+struct rpl_checkpoint {
+  uip_ipaddr_t dag_id;
+  uip_ipaddr_t parent;
+  uip_lladdr_t parent_lladdr;
+  rpl_prefix_t prefix_info;
+  rpl_rank_t parent_rank;
+  rpl_rank_t rank;
+  rpl_rank_t max_rankinc;
+  rpl_rank_t min_hoprankinc;
+  rpl_ocp_t ocp;
+  uint16_t lifetime_unit;
+  uint8_t instance_id;
+  uint8_t version;
+  uint8_t mop;
+  uint8_t grounded;
+  uint8_t preference;
+  uint8_t dtsn;
+  uint8_t dio_intdoubl;
+  uint8_t dio_intmin;
+  uint8_t dio_redundancy;
+  uint8_t default_lifetime;
+  uint16_t crc;
+};
+
+/*
+ * API for RPL checkpoint storage
+ *
+ * load(cp)
+ *
+ *  Reads the last stored checkpoint into cp. Returns 0 if there is
+ *  none. The contents are validated by the caller.
+ *
+ * store(cp)
+ *
+ *  Replaces the stored checkpoint with cp. Returns 0 on failure.
+ */
+struct rpl_checkpoint_driver {
+  char *name;
+  int (*load)(struct rpl_checkpoint *cp);
+  int (*store)(const struct rpl_checkpoint *cp);
+};
 /*---------------------------------------------------------------------------*/
 /* Public RPL functions. */
 void rpl_init(void);
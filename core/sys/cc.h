@@ -118,6 +118,18 @@
 #define CC_ASSIGN_AGGREGATE(dest, src)	*dest = *src
 #endif /* CC_CONF_ASSIGN_AGGREGATE */
 
+/**
+ * Configure if the C compiler and the CPU have an atomic compare and
+ * swap, for the parts of the core that interrupts may enter.
+ * CC_CAS(ptr, old, new) stores new in *ptr if it holds old, and returns
+ * non-zero if it did. GCC's __sync_bool_compare_and_swap does on ARM
+ * and x86, not on msp430, cc65 or sdcc. When CC_CAS is not defined,
+ * these parts fall back to plain C.
+ */
+#ifdef CC_CONF_CAS
+#define CC_CAS(ptr, old, new) CC_CONF_CAS(ptr, old, new)
+#endif /* CC_CONF_CAS */
+
 #if CC_CONF_NO_VA_ARGS
 #define CC_NO_VA_ARGS CC_CONF_VA_ARGS
 #endif
@@ -0,0 +1,134 @@
+/**
+ * \file
+ *      Deferred binary log
+ */
+
+#include "contiki.h"
+#include "sys/dlog.h"
+#include <stdio.h>
+
+#if (DLOG_RECORDS & (DLOG_RECORDS - 1)) != 0
+#error DLOG_CONF_RECORDS must be a power of two
+#endif
+
+/*
+ * Writers claim a record by moving head with a compare and swap, then
+ * fill it. Interrupts may write meanwhile but run to completion, and
+ * records are only read from a process, so a claimed record is always
+ * complete by the time the reader gets to it.
+ *
+ * Without CC_CAS, head and dropped are updated in plain C: a record
+ * written from an interrupt may then overwrite the one being written by
+ * the code it interrupted, and a drop may go uncounted.
+ */
+static struct dlog_record ring[DLOG_RECORDS];
+static volatile unsigned int head;
+static volatile unsigned int tail;
+static volatile uint16_t dropped;
+static uint8_t started;
+
+PROCESS(dlog_process, "Deferred log");
+/*---------------------------------------------------------------------------*/
+void
+dlog_write(const char *fmt, dlog_arg_t a, dlog_arg_t b, dlog_arg_t c,
+           dlog_arg_t d)
+{
+  unsigned int h;
+  struct dlog_record *r;
+#ifdef CC_CAS
+  uint16_t n;
+#endif /* CC_CAS */
+
+#ifdef CC_CAS
+  do {
+    h = head;
+    if(h - tail >= DLOG_RECORDS) {
+      do {
+        n = dropped;
+      } while(!CC_CAS(&dropped, n, n + 1));
+      return;
+    }
+  } while(!CC_CAS(&head, h, h + 1));
+#else /* CC_CAS */
+  h = head;
+  if(h - tail >= DLOG_RECORDS) {
+    dropped++;
+    return;
+  }
+  head = h + 1;
+#endif /* CC_CAS */
+
+  r = &ring[h & (DLOG_RECORDS - 1)];
+  r->fmt = fmt;
+  r->time = RTIMER_NOW();
+  r->args[0] = a;
+  r->args[1] = b;
+  r->args[2] = c;
+  r->args[3] = d;
+
+  if(started) {
+    process_poll(&dlog_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+dlog_read(struct dlog_record *r)
+{
+  if(tail == head) {
+    return 0;
+  }
+  *r = ring[tail & (DLOG_RECORDS - 1)];
+  tail++;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+dlog_dropped(void)
+{
+  uint16_t n;
+
+#ifdef CC_CAS
+  do {
+    n = dropped;
+  } while(!CC_CAS(&dropped, n, 0));
+#else /* CC_CAS */
+  n = dropped;
+  dropped = 0;
+#endif /* CC_CAS */
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+void
+dlog_init(void)
+{
+  process_start(&dlog_process, NULL);
+  started = 1;
+  process_poll(&dlog_process);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(dlog_process, ev, data)
+{
+  static struct dlog_record r;
+  uint16_t n;
+
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+
+    if((n = dlog_dropped()) > 0) {
+      printf("dlog: %u dropped\n", n);
+    }
+    /* One record per poll, the other processes get to run in between */
+    if(dlog_read(&r)) {
+      printf("%lu ", (unsigned long)r.time);
+      printf(r.fmt, r.args[0], r.args[1], r.args[2], r.args[3]);
+      if(tail != head) {
+        process_poll(&dlog_process);
+      }
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,118 @@
+/**
+ * \file
+ *      Deferred binary log
+ *
+ *      DLOG_ERR(), DLOG_WARN(), DLOG_INFO() and DLOG_DBG() record the
+ *      address of their format string, an rtimer timestamp and up to four
+ *      arguments in a ring of records, which is quick and safe from
+ *      interrupts. dlog_process formats the records later, one per poll.
+ *
+ *      The arguments are stored as words: %d, %u, %x, %c, and %s or %p
+ *      for strings that stay put (literals, not packet buffers). Floats
+ *      must be cast to int first. When the ring is full new records are
+ *      dropped and counted.
+ *
+ *      The level is chosen per module, before the include:
+ *
+ *        #define DLOG_LEVEL DLOG_LEVEL_INFO
+ *        #include "sys/dlog.h"
+ *
+ *      the default being DLOG_CONF_LEVEL. Records above it compile to
+ *      nothing.
+ */
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include "contiki.h"
+
+#define DLOG_LEVEL_NONE 0
+#define DLOG_LEVEL_ERR  1
+#define DLOG_LEVEL_WARN 2
+#define DLOG_LEVEL_INFO 3
+#define DLOG_LEVEL_DBG  4
+
+#ifdef DLOG_CONF_LEVEL
+#define DLOG_DEFAULT_LEVEL DLOG_CONF_LEVEL
+#else
+#define DLOG_DEFAULT_LEVEL DLOG_LEVEL_WARN
+#endif
+
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_DEFAULT_LEVEL
+#endif
+
+/* Records in the ring, a power of two */
+#ifdef DLOG_CONF_RECORDS
+#define DLOG_RECORDS DLOG_CONF_RECORDS
+#else
+#define DLOG_RECORDS 32
+#endif
+
+typedef uintptr_t dlog_arg_t;
+
+struct dlog_record {
+  const char *fmt;
+  rtimer_clock_t time;
+  dlog_arg_t args[4];
+};
+
+/* Up to four arguments, the missing ones are 0 */
+#define DLOG_WRITE(...) DLOG_WRITE_(__VA_ARGS__, 0, 0, 0, 0, 0)
+#define DLOG_WRITE_(fmt, a, b, c, d, ...)                               \
+  dlog_write(fmt, (dlog_arg_t)(a), (dlog_arg_t)(b), (dlog_arg_t)(c),    \
+             (dlog_arg_t)(d))
+
+#if DLOG_LEVEL >= DLOG_LEVEL_ERR
+#define DLOG_ERR(...)  DLOG_WRITE(__VA_ARGS__)
+#else
+#define DLOG_ERR(...)
+#endif
+
+#if DLOG_LEVEL >= DLOG_LEVEL_WARN
+#define DLOG_WARN(...) DLOG_WRITE(__VA_ARGS__)
+#else
+#define DLOG_WARN(...)
+#endif
+
+#if DLOG_LEVEL >= DLOG_LEVEL_INFO
+#define DLOG_INFO(...) DLOG_WRITE(__VA_ARGS__)
+#else
+#define DLOG_INFO(...)
+#endif
+
+#if DLOG_LEVEL >= DLOG_LEVEL_DBG
+#define DLOG_DBG(...)  DLOG_WRITE(__VA_ARGS__)
+#else
+#define DLOG_DBG(...)
+#endif
+
+PROCESS_NAME(dlog_process);
+
+/**
+ * \brief Record a format string and its arguments, from anywhere,
+ *        interrupts included. Use the macros rather than this.
+ */
+void dlog_write(const char *fmt, dlog_arg_t a, dlog_arg_t b, dlog_arg_t c,
+                dlog_arg_t d);
+
+/**
+ * \brief Take the oldest record out of the ring
+ * \return 0 if it is empty
+ *
+ * For an output other than dlog_process, e.g. records sent raw to a host
+ * that resolves the format addresses with the ELF file.
+ */
+int dlog_read(struct dlog_record *r);
+
+/**
+ * \brief Records lost to a full ring since the last call
+ */
+uint16_t dlog_dropped(void);
+
+/**
+ * \brief Start dlog_process, which prints the records
+ */
+void dlog_init(void);
+
+#endif /* DLOG_H_ */
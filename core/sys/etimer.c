@@ -49,10 +49,253 @@
 #include "sys/etimer.h"
 #include "sys/process.h"
 
+#if ETIMER_CONF_HEAP
+/*
+ * The pending timers in a binary heap ordered by expiration time. It is
+ * a tree of the timers themselves, linked by their next (parent), left
+ * and right pointers, with the shape of an array heap: the node at
+ * position i (the root at 1) has its children at 2i and 2i + 1, and
+ * the bits of i below the highest one are the path from the root. Each
+ * timer keeps its position, which tells whether it is on the heap.
+ */
+static struct etimer *root;
+static unsigned int heap_size;
+#else
 static struct etimer *timerlist;
 static clock_time_t next_expiration;
+#endif
 
 PROCESS(etimer_process, "Event timer");
+#if ETIMER_CONF_HEAP
+/*---------------------------------------------------------------------------*/
+static clock_time_t
+expiration(struct etimer *t)
+{
+  return t->timer.start + t->timer.interval;
+}
+/*---------------------------------------------------------------------------*/
+/* Whether a expires before b, the clock may wrap in between */
+static int
+earlier(struct etimer *a, struct etimer *b)
+{
+  clock_time_t d = expiration(b) - expiration(a);
+
+  return d != 0 && d <= ((clock_time_t)~(clock_time_t)0 >> 1);
+}
+/*---------------------------------------------------------------------------*/
+static struct etimer *
+heap_at(unsigned int i)
+{
+  struct etimer *t = root;
+  unsigned int bit;
+
+  for(bit = 1; bit <= i / 2; bit <<= 1);
+  for(bit >>= 1; bit != 0; bit >>= 1) {
+    t = (i & bit) ? t->right : t->left;
+  }
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * A timer that was never set may hold anything, the position counts
+ * only if the heap has this timer there.
+ */
+static int
+on_heap(struct etimer *t)
+{
+  return t->pos >= 1 && t->pos <= heap_size && heap_at(t->pos) == t;
+}
+/*---------------------------------------------------------------------------*/
+/* Exchange c and its parent */
+static void
+swap_with_parent(struct etimer *c)
+{
+  struct etimer *p = c->next;
+  struct etimer *g = p->next;
+  struct etimer *l = c->left;
+  struct etimer *r = c->right;
+  unsigned int pos = c->pos;
+
+  c->pos = p->pos;
+  p->pos = pos;
+  if(p->left == c) {
+    c->left = p;
+    c->right = p->right;
+  } else {
+    c->left = p->left;
+    c->right = p;
+  }
+  if(c->left != NULL) {
+    c->left->next = c;
+  }
+  if(c->right != NULL) {
+    c->right->next = c;
+  }
+
+  c->next = g;
+  if(g == NULL) {
+    root = c;
+  } else if(g->left == p) {
+    g->left = c;
+  } else {
+    g->right = c;
+  }
+
+  p->left = l;
+  p->right = r;
+  if(l != NULL) {
+    l->next = p;
+  }
+  if(r != NULL) {
+    r->next = p;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+sift_up(struct etimer *t)
+{
+  while(t->next != NULL && earlier(t, t->next)) {
+    swap_with_parent(t);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+sift_down(struct etimer *t)
+{
+  struct etimer *c;
+
+  while((c = t->left) != NULL) {
+    if(t->right != NULL && earlier(t->right, c)) {
+      c = t->right;
+    }
+    if(!earlier(c, t)) {
+      break;
+    }
+    swap_with_parent(c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_insert(struct etimer *t)
+{
+  struct etimer *p;
+
+  t->left = t->right = NULL;
+  t->pos = ++heap_size;
+  if(heap_size == 1) {
+    t->next = NULL;
+    root = t;
+    return;
+  }
+  p = heap_at(heap_size / 2);
+  if(heap_size & 1) {
+    p->right = t;
+  } else {
+    p->left = t;
+  }
+  t->next = p;
+  sift_up(t);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(struct etimer *t)
+{
+  struct etimer *last = heap_at(heap_size);
+
+  /* Take the last node off */
+  if(last->next == NULL) {
+    root = NULL;
+  } else if(last->next->right == last) {
+    last->next->right = NULL;
+  } else {
+    last->next->left = NULL;
+  }
+  heap_size--;
+
+  /* and put it in the place of t */
+  if(last != t) {
+    last->pos = t->pos;
+    last->next = t->next;
+    last->left = t->left;
+    last->right = t->right;
+    if(last->left != NULL) {
+      last->left->next = last;
+    }
+    if(last->right != NULL) {
+      last->right->next = last;
+    }
+    if(t->next == NULL) {
+      root = last;
+    } else if(t->next->left == t) {
+      t->next->left = last;
+    } else {
+      t->next->right = last;
+    }
+    if(last->next != NULL && earlier(last, last->next)) {
+      sift_up(last);
+    } else {
+      sift_down(last);
+    }
+  }
+
+  t->next = t->left = t->right = NULL;
+  t->pos = 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct etimer *
+find_process(struct etimer *t, struct process *p)
+{
+  struct etimer *f;
+
+  if(t == NULL || t->p == p) {
+    return t;
+  }
+  if((f = find_process(t->left, p)) != NULL) {
+    return f;
+  }
+  return find_process(t->right, p);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(etimer_process, ev, data)
+{
+  struct etimer *t;
+
+  PROCESS_BEGIN();
+
+  root = NULL;
+  heap_size = 0;
+
+  while(1) {
+    PROCESS_YIELD();
+
+    if(ev == PROCESS_EVENT_EXITED) {
+      /* Rare enough for a search of the heap per timer */
+      while((t = find_process(root, data)) != NULL) {
+        heap_remove(t);
+      }
+      continue;
+    } else if(ev != PROCESS_EVENT_POLL) {
+      continue;
+    }
+
+    /* The root expires first */
+    while(root != NULL && timer_expired(&root->timer)) {
+      t = root;
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) != PROCESS_ERR_OK) {
+        etimer_request_poll();
+        break;
+      }
+      /* Reset the process ID of the event timer, to signal that the
+         etimer has expired. This is later checked in the
+         etimer_expired() function. */
+      heap_remove(t);
+      t->p = PROCESS_NONE;
+    }
+  }
+
+  PROCESS_END();
+}
+#else /* ETIMER_CONF_HEAP */
 /*---------------------------------------------------------------------------*/
 static void
 update_time(void)
@@ -140,6 +383,7 @@ PROCESS_THREAD(etimer_process, ev, data)
   
   PROCESS_END();
 }
+#endif /* ETIMER_CONF_HEAP */
 /*---------------------------------------------------------------------------*/
 void
 etimer_request_poll(void)
@@ -150,6 +394,15 @@ etimer_request_poll(void)
 static void
 add_timer(struct etimer *timer)
 {
+#if ETIMER_CONF_HEAP
+  etimer_request_poll();
+
+  if(on_heap(timer)) {
+    heap_remove(timer);
+  }
+  timer->p = PROCESS_CURRENT();
+  heap_insert(timer);
+#else /* ETIMER_CONF_HEAP */
   struct etimer *t;
 
   etimer_request_poll();
@@ -171,6 +424,7 @@ add_timer(struct etimer *timer)
   timerlist = timer;
 
   update_time();
+#endif /* ETIMER_CONF_HEAP */
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -197,8 +451,18 @@ etimer_restart(struct etimer *et)
 void
 etimer_adjust(struct etimer *et, int timediff)
 {
+#if ETIMER_CONF_HEAP
+  if(on_heap(et)) {
+    heap_remove(et);
+    et->timer.start += timediff;
+    heap_insert(et);
+  } else {
+    et->timer.start += timediff;
+  }
+#else
   et->timer.start += timediff;
   update_time();
+#endif
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -222,18 +486,31 @@ etimer_start_time(struct etimer *et)
 int
 etimer_pending(void)
 {
+#if ETIMER_CONF_HEAP
+  return root != NULL;
+#else
   return timerlist != NULL;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 clock_time_t
 etimer_next_expiration_time(void)
 {
+#if ETIMER_CONF_HEAP
+  return root != NULL ? expiration(root) : 0;
+#else
   return etimer_pending() ? next_expiration : 0;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 void
 etimer_stop(struct etimer *et)
 {
+#if ETIMER_CONF_HEAP
+  if(on_heap(et)) {
+    heap_remove(et);
+  }
+#else /* ETIMER_CONF_HEAP */
   struct etimer *t;
 
   /* First check if et is the first event timer on the list. */
@@ -257,6 +534,7 @@ etimer_stop(struct etimer *et)
 
   /* Remove the next pointer from the item to be removed. */
   et->next = NULL;
+#endif /* ETIMER_CONF_HEAP */
   /* Set the timer as expired */
   et->p = PROCESS_NONE;
 }
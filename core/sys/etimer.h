@@ -12,6 +12,13 @@
  * to the event timer is made by a pointer to the declared event
  * timer.
  *
+ * The pending timers are kept in an unsorted list by default. With
+ * ETIMER_CONF_HEAP they are kept in a binary heap ordered by
+ * expiration time instead, for systems with many timers (the hub):
+ * setting and stopping a timer is O(log n) and the next expiration is
+ * at the root. All pending expiration times must then lie within half
+ * the range of clock_time_t, which holds for a 32 bit clock.
+ *
  * \sa \ref timer "Simple timer library"
  * \sa \ref clock "Clock library" (used by the timer library)
  *
@@ -75,8 +82,12 @@
  */
 struct etimer {
   struct timer timer;
-  struct etimer *next;
+  struct etimer *next;  /* the parent in the heap */
   struct process *p;
+#if ETIMER_CONF_HEAP
+  struct etimer *left, *right;
+  unsigned int pos;     /* in the heap, 0 when off it */
+#endif
 };
 
 /**
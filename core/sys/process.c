@@ -44,9 +44,12 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 
 #include "sys/process.h"
 #include "sys/arg.h"
+#include "sys/trace.h"
 
 /*
  * Pointer to the currently running process structure.
@@ -63,16 +66,55 @@ struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+#if PROCESS_CONF_ACCOUNTING
+  uint32_t time;
+#endif
+};
+
+/*
+ * A FIFO of events per priority, the high priority one is emptied
+ * first.
+ */
+struct event_queue {
+  process_num_events_t nevents, fevent, size;
+  struct event_data *events;
 };
 
-static process_num_events_t nevents, fevent;
 static struct event_data events[PROCESS_CONF_NUMEVENTS];
+static struct event_data events_high[PROCESS_CONF_NUMEVENTS_HIGH];
+static struct event_queue queues[PROCESS_PRIORITIES] = {
+  { 0, 0, PROCESS_CONF_NUMEVENTS, events },
+  { 0, 0, PROCESS_CONF_NUMEVENTS_HIGH, events_high },
+};
+static process_num_events_t nevents;
+
+uint16_t process_overflows[PROCESS_PRIORITIES];
 
 #if PROCESS_CONF_STATS
 process_num_events_t process_maxevents;
 #endif
 
+#ifdef CC_CAS
+/*
+ * The processes to poll, pushed by process_poll() from anywhere,
+ * interrupts included, and taken all at once by do_poll().
+ */
+static struct process *volatile poll_list;
+#define POLL_PENDING() (poll_list != NULL)
+#else /* CC_CAS */
+/*
+ * Without CC_CAS, process_poll() only flags the process and do_poll()
+ * looks for the flags in the process list.
+ */
 static volatile unsigned char poll_requested;
+#define POLL_PENDING() poll_requested
+#endif /* CC_CAS */
+
+#if PROCESS_CONF_ACCOUNTING
+#define ACCT_NOW() trace_arch_now()
+/* Run time of the processes called by the running one */
+static uint32_t acct_nested;
+#endif /* PROCESS_CONF_ACCOUNTING */
 
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
@@ -171,10 +213,43 @@ exit_process(struct process *p, struct process *fromprocess)
   process_current = old_current;
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_ACCOUNTING
+static void
+acct_wait(struct process *p, uint32_t since)
+{
+  uint32_t wait = ACCT_NOW() - since;
+
+  p->acct.events++;
+  p->acct.wait += wait;
+  if(wait > p->acct.max_wait) {
+    p->acct.max_wait = wait;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+process_acct_reset(void)
+{
+  struct process *p;
+
+  for(p = process_list; p != NULL; p = p->next) {
+    memset(&p->acct, 0, offsetof(struct process_acct, poll_time));
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+process_acct_us(uint32_t ticks)
+{
+  return (uint64_t)ticks * 1000000 / trace_arch_second();
+}
+#endif /* PROCESS_CONF_ACCOUNTING */
+/*---------------------------------------------------------------------------*/
 static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_ACCOUNTING
+  uint32_t start, outer, elapsed;
+#endif
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -187,7 +262,23 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
+    TRACE_BEGIN(TRACE_ID_PROCESS, p);
+#if PROCESS_CONF_ACCOUNTING
+    outer = acct_nested;
+    acct_nested = 0;
+    start = ACCT_NOW();
+#endif
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_ACCOUNTING
+    elapsed = ACCT_NOW() - start;
+    p->acct.calls++;
+    p->acct.time += elapsed - acct_nested;
+    if(elapsed - acct_nested > p->acct.max_time) {
+      p->acct.max_time = elapsed - acct_nested;
+    }
+    acct_nested = outer + elapsed;
+#endif
+    TRACE_END(TRACE_ID_PROCESS, p);
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -207,12 +298,26 @@ process_exit(struct process *p)
 void
 process_init(void)
 {
+  uint8_t i;
+
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+  for(i = 0; i < PROCESS_PRIORITIES; i++) {
+    queues[i].nevents = queues[i].fevent = 0;
+    process_overflows[i] = 0;
+  }
+#ifdef CC_CAS
+  poll_list = NULL;
+#else /* CC_CAS */
+  poll_requested = 0;
+#endif /* CC_CAS */
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
 #endif /* PROCESS_CONF_STATS */
+#if PROCESS_CONF_ACCOUNTING
+  trace_arch_init();
+#endif
 
   process_current = process_list = NULL;
 }
@@ -222,19 +327,62 @@ process_init(void)
  */
 /*---------------------------------------------------------------------------*/
 static void
-do_poll(void)
+call_polled(struct process *p)
 {
-  struct process *p;
+  struct process *next;
 
-  poll_requested = 0;
-  /* Call the processes that needs to be polled. */
-  for(p = process_list; p != NULL; p = p->next) {
-    if(p->needspoll) {
+  while(p != NULL) {
+    /* p may be polled again, and pushed, once needspoll is cleared */
+    next = p->nextpoll;
+    p->needspoll = 0;
+    if(p->state != PROCESS_STATE_NONE) {
       p->state = PROCESS_STATE_RUNNING;
-      p->needspoll = 0;
+#if PROCESS_CONF_ACCOUNTING
+      acct_wait(p, p->acct.poll_time);
+#endif
       call_process(p, PROCESS_EVENT_POLL, NULL);
     }
+    p = next;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+do_poll(void)
+{
+  struct process *p, *next, *high, *normal;
+
+  /* Take the processes that requested a poll */
+#ifdef CC_CAS
+  do {
+    p = poll_list;
+  } while(!CC_CAS(&poll_list, p, NULL));
+#else /* CC_CAS */
+  poll_requested = 0;
+  p = NULL;
+  for(next = process_list; next != NULL; next = next->next) {
+    if(next->needspoll) {
+      next->nextpoll = p;
+      p = next;
+    }
   }
+#endif /* CC_CAS */
+
+  /* Split them by priority, in the order of the requests (of the
+     process list without CC_CAS) */
+  high = normal = NULL;
+  for(; p != NULL; p = next) {
+    next = p->nextpoll;
+    if(p->priority == PROCESS_PRIO_HIGH) {
+      p->nextpoll = high;
+      high = p;
+    } else {
+      p->nextpoll = normal;
+      normal = p;
+    }
+  }
+
+  call_polled(high);
+  call_polled(normal);
 }
 /*---------------------------------------------------------------------------*/
 /*
@@ -249,6 +397,10 @@ do_event(void)
   static process_data_t data;
   static struct process *receiver;
   static struct process *p;
+  static struct event_queue *q;
+#if PROCESS_CONF_ACCOUNTING
+  static uint32_t posted;
+#endif
   
   /*
    * If there are any events in the queue, take the first one and walk
@@ -259,16 +411,26 @@ do_event(void)
    */
 
   if(nevents > 0) {
-    
+
+    /* The first event of the highest priority queue that has one */
+    q = &queues[PROCESS_PRIORITIES - 1];
+    while(q->nevents == 0) {
+      q--;
+    }
+
     /* There are events that we should deliver. */
-    ev = events[fevent].ev;
+    ev = q->events[q->fevent].ev;
     
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+    data = q->events[q->fevent].data;
+    receiver = q->events[q->fevent].p;
+#if PROCESS_CONF_ACCOUNTING
+    posted = q->events[q->fevent].time;
+#endif
 
     /* Since we have seen the new event, we move pointer upwards
        and decrese the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+    q->fevent = (q->fevent + 1) % q->size;
+    --q->nevents;
     --nevents;
 
     /* If this is a broadcast event, we deliver it to all events, in
@@ -278,9 +440,12 @@ do_event(void)
 
 	/* If we have been requested to poll a process, we do this in
 	   between processing the broadcast event. */
-	if(poll_requested) {
+	if(POLL_PENDING()) {
 	  do_poll();
 	}
+#if PROCESS_CONF_ACCOUNTING
+	acct_wait(p, posted);
+#endif
 	call_process(p, ev, data);
       }
     } else {
@@ -293,6 +458,9 @@ do_event(void)
       }
 
       /* Make sure that the process actually is running. */
+#if PROCESS_CONF_ACCOUNTING
+      acct_wait(receiver, posted);
+#endif
       call_process(receiver, ev, data);
     }
   }
@@ -302,26 +470,40 @@ int
 process_run(void)
 {
   /* Process poll events. */
-  if(poll_requested) {
+  if(POLL_PENDING()) {
     do_poll();
   }
 
   /* Process one event from the queue */
   do_event();
 
-  return nevents + poll_requested;
+  return nevents + POLL_PENDING();
 }
 /*---------------------------------------------------------------------------*/
 int
 process_nevents(void)
 {
-  return nevents + poll_requested;
+  return nevents + POLL_PENDING();
 }
 /*---------------------------------------------------------------------------*/
 int
 process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  return process_post_prio(p, ev, data, PROCESS_PRIO_NORMAL);
+}
+/*---------------------------------------------------------------------------*/
+int
+process_post_prio(struct process *p, process_event_t ev, process_data_t data,
+                  uint8_t priority)
 {
   static process_num_events_t snum;
+  static struct event_queue *q;
+
+  /* Events to a high priority process are high priority */
+  if(p != PROCESS_BROADCAST && p->priority > priority) {
+    priority = p->priority;
+  }
+  q = &queues[priority];
 
   if(PROCESS_CURRENT() == NULL) {
     PRINTF("process_post: NULL process posts event %d to process '%s', nevents %d\n",
@@ -332,7 +514,15 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
   
-  if(nevents == PROCESS_CONF_NUMEVENTS) {
+  if(q->nevents == q->size && priority == PROCESS_PRIO_HIGH) {
+    /* Late rather than lost */
+    process_overflows[PROCESS_PRIO_HIGH]++;
+    priority = PROCESS_PRIO_NORMAL;
+    q = &queues[priority];
+  }
+
+  if(q->nevents == q->size) {
+    process_overflows[PROCESS_PRIO_NORMAL]++;
 #if DEBUG
     if(p == PROCESS_BROADCAST) {
       printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
@@ -343,10 +533,14 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
     return PROCESS_ERR_FULL;
   }
   
-  snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
-  events[snum].ev = ev;
-  events[snum].data = data;
-  events[snum].p = p;
+  snum = (process_num_events_t)(q->fevent + q->nevents) % q->size;
+  q->events[snum].ev = ev;
+  q->events[snum].data = data;
+  q->events[snum].p = p;
+#if PROCESS_CONF_ACCOUNTING
+  q->events[snum].time = ACCT_NOW();
+#endif
+  ++q->nevents;
   ++nevents;
 
 #if PROCESS_CONF_STATS
@@ -373,12 +567,35 @@ process_poll(struct process *p)
   if(p != NULL) {
     if(p->state == PROCESS_STATE_RUNNING ||
        p->state == PROCESS_STATE_CALLED) {
+#ifdef CC_CAS
+      if(CC_CAS(&p->needspoll, 0, 1)) {
+        /* Not on the poll list yet, push it */
+#if PROCESS_CONF_ACCOUNTING
+        p->acct.poll_time = ACCT_NOW();
+#endif
+        do {
+          p->nextpoll = poll_list;
+        } while(!CC_CAS(&poll_list, p->nextpoll, p));
+      }
+#else /* CC_CAS */
+#if PROCESS_CONF_ACCOUNTING
+      if(!p->needspoll) {
+        p->acct.poll_time = ACCT_NOW();
+      }
+#endif
       p->needspoll = 1;
       poll_requested = 1;
+#endif /* CC_CAS */
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+void
+process_set_priority(struct process *p, uint8_t priority)
+{
+  p->priority = priority;
+}
+/*---------------------------------------------------------------------------*/
 int
 process_is_running(struct process *p)
 {
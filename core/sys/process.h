@@ -88,6 +88,25 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/* Queue of the high priority events, separate from the other ones */
+#ifndef PROCESS_CONF_NUMEVENTS_HIGH
+#define PROCESS_CONF_NUMEVENTS_HIGH 8
+#endif /* PROCESS_CONF_NUMEVENTS_HIGH */
+
+/**
+ * \name Priorities
+ *
+ *        Polls of high priority processes are handled before the other
+ *        polls, and high priority events before the other events. Events
+ *        to a high priority process are high priority. Within a priority
+ *        events are delivered in the order they were posted.
+ * @{
+ */
+#define PROCESS_PRIO_NORMAL   0
+#define PROCESS_PRIO_HIGH     1
+#define PROCESS_PRIORITIES    2
+/* @} */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -312,6 +331,24 @@ static PT_THREAD(process_thread_##name(struct pt *process_pt,	\
 
 /** @} */
 
+#if PROCESS_CONF_ACCOUNTING
+/**
+ * Counters of a process, with PROCESS_CONF_ACCOUNTING. The times are in
+ * ticks of the trace time source (sys/trace.h), process_acct_us()
+ * converts them. Interrupts taken while a process runs count as its run
+ * time, processes it calls synchronously do not.
+ */
+struct process_acct {
+  uint32_t calls;       /* invocations */
+  uint32_t time;        /* run time */
+  uint32_t max_time;
+  uint32_t events;      /* events and polls taken from the queue */
+  uint32_t wait;        /* their time between post or poll and dispatch */
+  uint32_t max_wait;
+  uint32_t poll_time;   /* when the pending poll was requested */
+};
+#endif /* PROCESS_CONF_ACCOUNTING */
+
 struct process {
   struct process *next;
 #if PROCESS_CONF_NO_PROCESS_NAMES
@@ -322,7 +359,11 @@ struct process {
 #endif
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
-  unsigned char state, needspoll;
+  unsigned char state, needspoll, priority;
+  struct process *nextpoll;
+#if PROCESS_CONF_ACCOUNTING
+  struct process_acct acct;
+#endif
 };
 
 /**
@@ -364,6 +405,20 @@ CCIF void process_start(struct process *p, const char *arg);
  */
 CCIF int process_post(struct process *p, process_event_t ev, void* data);
 
+/**
+ * Post an asynchronous event with a priority.
+ *
+ * As process_post(), the event is queued as PROCESS_PRIO_HIGH if
+ * either the priority or that of the receiving process is high.
+ *
+ * A high priority event that does not fit in its queue is queued as
+ * a normal one.
+ *
+ * \param priority PROCESS_PRIO_NORMAL or PROCESS_PRIO_HIGH
+ */
+CCIF int process_post_prio(struct process *p, process_event_t ev, void* data,
+                           uint8_t priority);
+
 /**
  * Post a synchronous event to a process.
  *
@@ -389,6 +444,17 @@ CCIF void process_post_synch(struct process *p,
  */
 CCIF void process_exit(struct process *p);
 
+/**
+ * \brief      Set the priority of a process
+ * \param p    The process
+ * \param priority PROCESS_PRIO_NORMAL, the default, or PROCESS_PRIO_HIGH
+ *
+ *             For the processes between an interrupt and the
+ *             application, e.g. a radio driver, so that they do not
+ *             wait behind periodic work.
+ */
+CCIF void process_set_priority(struct process *p, uint8_t priority);
+
 
 /**
  * Get a pointer to the currently running process.
@@ -521,6 +587,25 @@ int process_nevents(void);
 
 /** @} */
 
+/**
+ * Overflows of the event queues since process_init(): high priority
+ * events queued as normal ones as the high queue was full, and events
+ * lost as the normal queue was full.
+ */
+extern uint16_t process_overflows[PROCESS_PRIORITIES];
+
+#if PROCESS_CONF_ACCOUNTING
+/**
+ * \brief      Clear the counters of all processes
+ */
+void process_acct_reset(void);
+
+/**
+ * \brief      Convert a time of struct process_acct to microseconds
+ */
+uint32_t process_acct_us(uint32_t ticks);
+#endif /* PROCESS_CONF_ACCOUNTING */
+
 CCIF extern struct process *process_list;
 
 #define PROCESS_LIST() process_list
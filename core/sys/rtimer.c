@@ -46,6 +46,7 @@
 
 #include "sys/rtimer.h"
 #include "contiki.h"
+#include "sys/trace.h"
 
 #define DEBUG 0
 #if DEBUG
@@ -98,7 +99,9 @@ rtimer_run_next(void)
   }
   t = next_rtimer;
   next_rtimer = NULL;
+  TRACE_BEGIN(TRACE_ID_RTIMER, t->func);
   t->func(t, t->ptr);
+  TRACE_END(TRACE_ID_RTIMER, t->func);
   if(next_rtimer != NULL) {
     rtimer_arch_schedule(next_rtimer->time);
   }
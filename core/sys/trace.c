@@ -0,0 +1,154 @@
+/**
+ * \file
+ *      Hot-path event tracing
+ */
+
+#include "contiki.h"
+#include "sys/trace.h"
+#include <stdio.h>
+
+#if TRACE_ENABLED
+
+#if (TRACE_RECORDS & (TRACE_RECORDS - 1)) != 0
+#error TRACE_CONF_RECORDS must be a power of two
+#endif
+
+/*
+ * A flight recorder: writers claim the next record by moving head with a
+ * compare and swap and overwrite whatever was there. The trace is read
+ * from a process once frozen, interrupts run to completion, so every
+ * claimed record is complete by then. Without CC_CAS, head is moved in
+ * plain C and a record written from an interrupt may take the place of
+ * the one it interrupted.
+ */
+static struct trace_record ring[TRACE_RECORDS];
+static volatile uint32_t head;
+static volatile uint8_t frozen = 1;
+/*---------------------------------------------------------------------------*/
+void
+trace_write(uint8_t id, uint8_t kind, uint16_t arg)
+{
+  uint32_t h;
+  struct trace_record *r;
+
+  if(frozen) {
+    return;
+  }
+#ifdef CC_CAS
+  do {
+    h = head;
+  } while(!CC_CAS(&head, h, h + 1));
+#else /* CC_CAS */
+  h = head++;
+#endif /* CC_CAS */
+
+  r = &ring[h & (TRACE_RECORDS - 1)];
+  r->time = trace_arch_now();
+  r->id = id;
+  r->kind = kind;
+  r->arg = arg;
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_freeze(void)
+{
+  frozen = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_resume(void)
+{
+  head = 0;
+  frozen = 0;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+records(void)
+{
+  return head < TRACE_RECORDS ? head : TRACE_RECORDS;
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+header_byte(uint8_t pos)
+{
+  uint32_t second = trace_arch_second();
+
+  switch(pos) {
+  case 0: return TRACE_MAGIC0;
+  case 1: return TRACE_MAGIC1;
+  case 2: return TRACE_VERSION;
+  case 3: return TRACE_RECORD_SIZE;
+  case 4: case 5: case 6: case 7:
+    return second >> (8 * (pos - 4));
+  case 8: case 9:
+    return records() >> (8 * (pos - 8));
+  case 12: case 13: case 14: case 15:
+    /* Records written in all, the ones before the ring were overwritten */
+    return head >> (8 * (pos - 12));
+  default:
+    return 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint8_t
+record_byte(const struct trace_record *r, uint8_t pos)
+{
+  switch(pos) {
+  case 0: case 1: case 2: case 3:
+    return r->time >> (8 * pos);
+  case 4: return r->id;
+  case 5: return r->kind;
+  case 6: return r->arg & 0xff;
+  default: return r->arg >> 8;
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+trace_read(uint8_t *buf, uint32_t offset, uint16_t len)
+{
+  uint32_t size = TRACE_HEADER_SIZE + (uint32_t)records() * TRACE_RECORD_SIZE;
+  uint32_t first = head - records();
+  uint32_t pos;
+  uint16_t n;
+
+  for(n = 0; n < len && offset + n < size; n++) {
+    pos = offset + n;
+    if(pos < TRACE_HEADER_SIZE) {
+      buf[n] = header_byte(pos);
+    } else {
+      pos -= TRACE_HEADER_SIZE;
+      buf[n] = record_byte(&ring[(first + pos / TRACE_RECORD_SIZE) & (TRACE_RECORDS - 1)],
+                           pos % TRACE_RECORD_SIZE);
+    }
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_dump(void)
+{
+  uint8_t line[32];
+  uint32_t offset = 0;
+  uint16_t i, n;
+
+  trace_freeze();
+  printf("trace:begin\n");
+  while((n = trace_read(line, offset, sizeof(line))) > 0) {
+    for(i = 0; i < n; i++) {
+      printf("%02x", line[i]);
+    }
+    printf("\n");
+    offset += n;
+  }
+  printf("trace:end\n");
+  trace_resume();
+}
+/*---------------------------------------------------------------------------*/
+void
+trace_init(void)
+{
+  trace_arch_init();
+  trace_resume();
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TRACE_ENABLED */
@@ -0,0 +1,125 @@
+/**
+ * \file
+ *      Hot-path event tracing
+ *
+ *      Trace points record an event id, a timestamp and a 16 bit argument
+ *      into a ring of 8 byte records, cheap enough for interrupts:
+ *
+ *        TRACE_BEGIN(TRACE_ID_ZERO_CROSS, 0);
+ *        ...
+ *        TRACE_END(TRACE_ID_ZERO_CROSS, 0);
+ *        TRACE_EVENT(TRACE_ID_TRIAC, device);
+ *
+ *      The ring keeps the latest TRACE_RECORDS records, older ones are
+ *      overwritten. It is read out frozen, as a header followed by the
+ *      records oldest first (trace_read()), e.g. over CoAP, or printed in
+ *      hex with trace_dump(), and tools/trace-decode turns either into a
+ *      timeline with durations and intervals.
+ *
+ *      Trace points compile to nothing unless TRACE_CONF_ENABLED is set.
+ *      The timestamps come from the CPU (trace_arch_now()): the sleep
+ *      timer on the cc2538, or its cycle counter with TRACE_CONF_CYCLES,
+ *      and microseconds on native.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "contiki.h"
+
+#ifdef TRACE_CONF_ENABLED
+#define TRACE_ENABLED TRACE_CONF_ENABLED
+#else
+#define TRACE_ENABLED 0
+#endif
+
+/* Records in the ring, a power of two */
+#ifdef TRACE_CONF_RECORDS
+#define TRACE_RECORDS TRACE_CONF_RECORDS
+#else
+#define TRACE_RECORDS 128
+#endif
+
+/* Event ids, the decoder knows them by name. Applications may use ids
+   from TRACE_ID_USER on. */
+enum {
+  TRACE_ID_PROCESS = 1,    /* a process runs, arg: its address */
+  TRACE_ID_RTIMER,         /* an rtimer callback, arg: its address */
+  TRACE_ID_RF_RX_ISR,      /* the radio RX interrupt */
+  TRACE_ID_RF_READ,        /* a frame is read out of the FIFO, arg: its length */
+  TRACE_ID_COAP,           /* a CoAP resource handler, arg: the method */
+  TRACE_ID_ZERO_CROSS,     /* the dimmer's zero cross interrupt */
+  TRACE_ID_TRIAC,          /* a triac turns on, arg: the triac */
+  TRACE_ID_USER = 32
+};
+
+#define TRACE_KIND_EVENT 0
+#define TRACE_KIND_BEGIN 1
+#define TRACE_KIND_END   2
+
+struct trace_record {
+  uint32_t time;
+  uint8_t id;
+  uint8_t kind;
+  uint16_t arg;
+};
+
+/* trace_read() output: the header, then the records, little endian */
+#define TRACE_MAGIC0      'T'
+#define TRACE_MAGIC1      'R'
+#define TRACE_VERSION     1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 8
+
+#if TRACE_ENABLED
+#define TRACE_EVENT(id, arg) trace_write((id), TRACE_KIND_EVENT, (uint16_t)(uintptr_t)(arg))
+#define TRACE_BEGIN(id, arg) trace_write((id), TRACE_KIND_BEGIN, (uint16_t)(uintptr_t)(arg))
+#define TRACE_END(id, arg)   trace_write((id), TRACE_KIND_END, (uint16_t)(uintptr_t)(arg))
+#else
+#define TRACE_EVENT(id, arg)
+#define TRACE_BEGIN(id, arg)
+#define TRACE_END(id, arg)
+#endif
+
+/**
+ * \brief Record an event, from anywhere. Use the macros rather than this.
+ */
+void trace_write(uint8_t id, uint8_t kind, uint16_t arg);
+
+/**
+ * \brief Stop recording, so that the ring can be read out consistently
+ */
+void trace_freeze(void);
+
+/**
+ * \brief Empty the ring and record again
+ */
+void trace_resume(void);
+
+/**
+ * \brief Copy part of the frozen trace
+ * \param buf    Where to copy
+ * \param offset Offset into the header and records
+ * \param len    Room in buf
+ * \return The bytes copied, less than len at the end
+ */
+uint16_t trace_read(uint8_t *buf, uint32_t offset, uint16_t len);
+
+/**
+ * \brief Freeze the trace and print it in hex between "trace:begin" and
+ *        "trace:end" lines, for tools/trace-decode -x. Recording resumes
+ *        afterwards.
+ */
+void trace_dump(void);
+
+/**
+ * \brief Start the time source and recording
+ */
+void trace_init(void);
+
+/* The time source, from the CPU */
+void trace_arch_init(void);
+uint32_t trace_arch_now(void);
+uint32_t trace_arch_second(void);
+
+#endif /* TRACE_H_ */
@@ -44,6 +44,7 @@
 #include "net/linkaddr.h"
 #include "net/netstack.h"
 #include "sys/energest.h"
+#include "sys/trace.h"
 #include "dev/cc2538-rf.h"
 #include "dev/rfcore.h"
 #include "dev/sys-ctrl.h"
@@ -123,6 +124,9 @@ static const uint8_t magic[] = { 0x53, 0x6E, 0x69, 0x66 };      /** Snif */
 /*---------------------------------------------------------------------------*/
 static uint8_t rf_flags;
 
+/* Taken at the SFD of the last frame received, for its timestamp */
+static volatile rtimer_clock_t sfd_time;
+
 static int on(void);
 static int off(void);
 /*---------------------------------------------------------------------------*/
@@ -330,8 +334,9 @@ init(void)
   cc2538_rf_power_set(CC2538_RF_TX_POWER);
   cc2538_rf_channel_set(CC2538_RF_CHANNEL);
 
-  /* Acknowledge RF interrupts, FIFOP only */
-  REG(RFCORE_XREG_RFIRQM0) |= RFCORE_XREG_RFIRQM0_FIFOP;
+  /* Acknowledge RF interrupts, FIFOP and SFD for the RX timestamp */
+  REG(RFCORE_XREG_RFIRQM0) |= RFCORE_XREG_RFIRQM0_FIFOP |
+    RFCORE_XREG_RFIRQM0_SFD;
   nvic_interrupt_enable(NVIC_INT_RF_RXTX);
 
   /* Acknowledge all RF Error interrupts */
@@ -361,6 +366,8 @@ init(void)
   }
 
   process_start(&cc2538_rf_process, NULL);
+  /* Frames are read out of the FIFO before other polls and events */
+  process_set_priority(&cc2538_rf_process, PROCESS_PRIO_HIGH);
 
   rf_flags |= RF_ON;
 
@@ -580,6 +587,8 @@ read(void *buf, unsigned short bufsize)
   if(crc_corr & CRC_BIT_MASK) {
     packetbuf_set_attr(PACKETBUF_ATTR_RSSI, rssi);
     packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, crc_corr & LQI_BIT_MASK);
+    /* Right for the last frame in the FIFO, the one usually there */
+    packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, (uint16_t)sfd_time);
     RIMESTATS_ADD(llrx);
   } else {
     RIMESTATS_ADD(badcrc);
@@ -671,6 +680,7 @@ PROCESS_THREAD(cc2538_rf_process, ev, data)
 
     packetbuf_clear();
     len = read(packetbuf_dataptr(), PACKETBUF_SIZE);
+    TRACE_EVENT(TRACE_ID_RF_READ, len);
 
     if(len > 0) {
       packetbuf_set_datalen(len);
@@ -695,17 +705,28 @@ PROCESS_THREAD(cc2538_rf_process, ev, data)
  *
  *        This is the interrupt service routine for all RF interrupts relating
  *        to RX and TX. Error conditions are handled by cc2538_rf_err_isr().
- *        Currently, we only acknowledge the FIFOP interrupt source.
+ *        The SFD of a received frame gives its timestamp, FIFOP polls the
+ *        driver process.
  */
 void
 cc2538_rf_rx_tx_isr(void)
 {
+  uint32_t flags;
+
   ENERGEST_ON(ENERGEST_TYPE_IRQ);
 
-  process_poll(&cc2538_rf_process);
+  flags = REG(RFCORE_SFR_RFIRQF0);
+  /* Writing 0 clears a flag, 1 leaves it */
+  REG(RFCORE_SFR_RFIRQF0) = ~flags;
 
-  /* We only acknowledge FIFOP so we can safely wipe out the entire SFR */
-  REG(RFCORE_SFR_RFIRQF0) = 0;
+  if((flags & RFCORE_SFR_RFIRQF0_SFD) &&
+     !(REG(RFCORE_XREG_FSMSTAT1) & RFCORE_XREG_FSMSTAT1_TX_ACTIVE)) {
+    sfd_time = RTIMER_NOW();
+  }
+  if(flags & RFCORE_SFR_RFIRQF0_FIFOP) {
+    TRACE_EVENT(TRACE_ID_RF_RX_ISR, 0);
+    process_poll(&cc2538_rf_process);
+  }
 
   ENERGEST_OFF(ENERGEST_TYPE_IRQ);
 }
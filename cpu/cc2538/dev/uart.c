@@ -143,10 +143,56 @@
 /* DIV_ROUND() divides integers while avoiding a rounding error: */
 #define DIV_ROUND(num, denom) (((num) + (denom) / 2) / (denom))
 
+#define MIN(a, b)             ((a) < (b) ? (a) : (b))
+
 #define BAUD2BRD(baud)        DIV_ROUND(UART_CLOCK_RATE << (UART_CTL_HSE_VALUE + 2), (baud))
 #define BAUD2IBRD(baud)       (BAUD2BRD(baud) >> 6)
 #define BAUD2FBRD(baud)       (BAUD2BRD(baud) & 0x3f)
 /*---------------------------------------------------------------------------*/
+/*
+ * TX ring buffers, drained into the FIFO by the TX interrupt. 0 for a UART
+ * that busy-waits on its FIFO like before. Sizes must be powers of two.
+ */
+#ifndef UART0_CONF_TX_BUF_SIZE
+#define UART0_CONF_TX_BUF_SIZE   0
+#endif
+#ifndef UART1_CONF_TX_BUF_SIZE
+#define UART1_CONF_TX_BUF_SIZE   0
+#endif
+#if (UART0_CONF_TX_BUF_SIZE & (UART0_CONF_TX_BUF_SIZE - 1)) || \
+    (UART1_CONF_TX_BUF_SIZE & (UART1_CONF_TX_BUF_SIZE - 1))
+#error UARTn_CONF_TX_BUF_SIZE must be a power of two
+#endif
+
+typedef struct {
+  uint8_t *buf;
+  uint16_t size;
+  volatile uint16_t head;    /* Free running, advanced by the writers, masked */
+  volatile uint16_t tail;    /* Free running, advanced by the interrupt */
+  volatile uint8_t active;   /* TX interrupt enabled, it will see new bytes */
+  volatile uint8_t low;      /* Filled over half, call back once drained */
+  void (* callback)(void);
+} uart_tx_ring_t;
+
+#if UART0_CONF_TX_BUF_SIZE
+static uint8_t uart0_tx_buf[UART0_CONF_TX_BUF_SIZE];
+#else
+#define uart0_tx_buf NULL
+#endif
+#if UART1_CONF_TX_BUF_SIZE
+static uint8_t uart1_tx_buf[UART1_CONF_TX_BUF_SIZE];
+#else
+#define uart1_tx_buf NULL
+#endif
+
+static uart_tx_ring_t tx_ring[UART_INSTANCE_COUNT] = {
+  { .buf = uart0_tx_buf, .size = UART0_CONF_TX_BUF_SIZE },
+  { .buf = uart1_tx_buf, .size = UART1_CONF_TX_BUF_SIZE }
+};
+
+#define TX_RING_USED(r)  ((uint16_t)((r)->head - (r)->tail))
+#define TX_RING_FREE(r)  ((r)->size - TX_RING_USED(r))
+/*---------------------------------------------------------------------------*/
 typedef struct {
   int8_t port;
   int8_t pin;
@@ -199,6 +245,8 @@ static const uart_regs_t uart_regs[UART_INSTANCE_COUNT] = {
   }
 };
 static int (* input_handler[UART_INSTANCE_COUNT])(unsigned char c);
+static int (* input_block_handler[UART_INSTANCE_COUNT])(const uint8_t *buf,
+                                                         uint16_t len);
 /*---------------------------------------------------------------------------*/
 static void
 reset(uint32_t uart_base)
@@ -235,6 +283,9 @@ permit_pm1(void)
        (REG(regs->base | UART_FR) & UART_FR_TXFE) == 0) {
       return false;
     }
+    if(TX_RING_USED(&tx_ring[regs - uart_regs]) != 0) {
+      return false;
+    }
   }
 
   return true;
@@ -330,19 +381,175 @@ uart_set_input(uint8_t uart, int (* input)(unsigned char c))
 }
 /*---------------------------------------------------------------------------*/
 void
+uart_set_input_block(uint8_t uart, int (* input)(const uint8_t *buf, uint16_t len))
+{
+  if(uart >= UART_INSTANCE_COUNT) {
+    return;
+  }
+
+  input_block_handler[uart] = input;
+}
+/*---------------------------------------------------------------------------*/
+void
+uart_set_baud_rate(uint8_t uart, uint32_t baud)
+{
+  uint32_t uart_base;
+  uint32_t brd;
+
+  if(uart >= UART_INSTANCE_COUNT) {
+    return;
+  }
+  uart_base = uart_regs[uart].base;
+
+  /* Let what is queued go out at the old rate */
+  while(TX_RING_USED(&tx_ring[uart]) != 0);
+  while(REG(uart_base | UART_FR) & UART_FR_BUSY);
+
+  brd = BAUD2BRD(baud);
+  REG(uart_base | UART_CTL) &= ~UART_CTL_UARTEN;
+  REG(uart_base | UART_IBRD) = brd >> 6;
+  REG(uart_base | UART_FBRD) = brd & 0x3f;
+  /* The divisors are latched by a write to LCRH */
+  REG(uart_base | UART_LCRH) = REG(uart_base | UART_LCRH);
+  REG(uart_base | UART_CTL) |= UART_CTL_UARTEN;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Moves bytes from the ring to the FIFO. Runs in the TX interrupt or with
+ * it masked. The interrupt stays enabled only with a full FIFO, so that
+ * the FIFO level goes through the TX trigger level once again.
+ */
+static void
+tx_fill(uint8_t uart)
+{
+  uart_tx_ring_t *r = &tx_ring[uart];
+  uint32_t uart_base = uart_regs[uart].base;
+
+  while(r->tail != r->head && !(REG(uart_base | UART_FR) & UART_FR_TXFF)) {
+    REG(uart_base | UART_DR) = r->buf[r->tail & (r->size - 1)];
+    r->tail++;
+  }
+
+  if(r->tail != r->head) {
+    r->active = 1;
+    REG(uart_base | UART_IM) |= UART_IM_TXIM;
+  } else {
+    r->active = 0;
+    REG(uart_base | UART_IM) &= ~UART_IM_TXIM;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
 uart_write_byte(uint8_t uart, uint8_t b)
 {
+  uart_tx_ring_t *r;
   uint32_t uart_base;
+  uint8_t en;
 
   if(uart >= UART_INSTANCE_COUNT) {
     return;
   }
   uart_base = uart_regs[uart].base;
+  r = &tx_ring[uart];
 
-  /* Block if the TX FIFO is full */
-  while(REG(uart_base | UART_FR) & UART_FR_TXFF);
+  if(r->size == 0) {
+    /* Block if the TX FIFO is full */
+    while(REG(uart_base | UART_FR) & UART_FR_TXFF);
 
-  REG(uart_base | UART_DR) = b;
+    REG(uart_base | UART_DR) = b;
+    return;
+  }
+
+  /*
+   * The TX interrupt may call back into the writers, so the byte is
+   * stored and head published with it masked
+   */
+  en = nvic_interrupt_en_save(uart_regs[uart].nvic_int);
+  nvic_interrupt_disable(uart_regs[uart].nvic_int);
+  /*
+   * Block until the FIFO takes a byte. Fill it from here rather than
+   * wait for the interrupt, which may well be the one we are called from
+   */
+  while(TX_RING_FREE(r) == 0) {
+    tx_fill(uart);
+  }
+  r->buf[r->head & (r->size - 1)] = b;
+  r->head++;
+  if(TX_RING_FREE(r) < r->size / 2) {
+    r->low = 1;
+  }
+  /* Start the transmission unless the TX interrupt is already on it */
+  if(!r->active) {
+    tx_fill(uart);
+  }
+  nvic_interrupt_en_restore(uart_regs[uart].nvic_int, en);
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uart_write(uint8_t uart, const uint8_t *buf, uint16_t len)
+{
+  uart_tx_ring_t *r;
+  uint32_t uart_base;
+  uint16_t n, i, first;
+  uint8_t en;
+
+  if(uart >= UART_INSTANCE_COUNT) {
+    return 0;
+  }
+  uart_base = uart_regs[uart].base;
+  r = &tx_ring[uart];
+
+  if(r->size == 0) {
+    for(n = 0; n < len && !(REG(uart_base | UART_FR) & UART_FR_TXFF); n++) {
+      REG(uart_base | UART_DR) = buf[n];
+    }
+    return n;
+  }
+
+  /*
+   * Reserve, copy and publish with the TX interrupt masked, as for
+   * uart_write_byte(). This never waits: the copy is bounded by the
+   * free space of the ring.
+   */
+  en = nvic_interrupt_en_save(uart_regs[uart].nvic_int);
+  nvic_interrupt_disable(uart_regs[uart].nvic_int);
+  n = MIN(len, TX_RING_FREE(r));
+  i = r->head & (r->size - 1);
+  first = MIN(n, r->size - i);
+  memcpy(&r->buf[i], buf, first);
+  memcpy(r->buf, buf + first, n - first);
+  r->head += n;
+  if(TX_RING_FREE(r) < r->size / 2) {
+    r->low = 1;
+  }
+  if(!r->active) {
+    tx_fill(uart);
+  }
+  nvic_interrupt_en_restore(uart_regs[uart].nvic_int, en);
+
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+uart_tx_space(uint8_t uart)
+{
+  if(uart >= UART_INSTANCE_COUNT) {
+    return 0;
+  }
+  if(tx_ring[uart].size == 0) {
+    return (REG(uart_regs[uart].base | UART_FR) & UART_FR_TXFF) ? 0 : 1;
+  }
+  return TX_RING_FREE(&tx_ring[uart]);
+}
+/*---------------------------------------------------------------------------*/
+void
+uart_set_tx_callback(uint8_t uart, void (* callback)(void))
+{
+  if(uart >= UART_INSTANCE_COUNT) {
+    return;
+  }
+
+  tx_ring[uart].callback = callback;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -361,7 +568,20 @@ uart_isr(uint8_t uart)
 
   REG(uart_base | UART_ICR) = 0x0000FFBF;
 
-  if(mis & (UART_MIS_RXMIS | UART_MIS_RTMIS)) {
+  if((mis & (UART_MIS_RXMIS | UART_MIS_RTMIS)) && input_block_handler[uart] != NULL) {
+    /* Hand over the whole FIFO at once */
+    uint8_t buf[16];
+    uint16_t len;
+
+    do {
+      for(len = 0; len < sizeof(buf) && !(REG(uart_base | UART_FR) & UART_FR_RXFE); len++) {
+        buf[len] = REG(uart_base | UART_DR) & 0xFF;
+      }
+      if(len > 0) {
+        input_block_handler[uart](buf, len);
+      }
+    } while(len == sizeof(buf));
+  } else if(mis & (UART_MIS_RXMIS | UART_MIS_RTMIS)) {
     while(!(REG(uart_base | UART_FR) & UART_FR_RXFE)) {
       if(input_handler[uart] != NULL) {
         input_handler[uart]((unsigned char)(REG(uart_base | UART_DR) & 0xFF));
@@ -374,6 +594,18 @@ uart_isr(uint8_t uart)
   } else if(mis & (UART_MIS_OEMIS | UART_MIS_BEMIS | UART_MIS_FEMIS)) {
     /* ISR triggered due to some error condition */
     reset(uart_base);
+    /* The reset flushed the TX FIFO, refill it */
+    mis |= UART_MIS_TXMIS;
+  }
+
+  if((mis & UART_MIS_TXMIS) && tx_ring[uart].size != 0) {
+    tx_fill(uart);
+    if(tx_ring[uart].low && TX_RING_FREE(&tx_ring[uart]) >= tx_ring[uart].size / 2) {
+      tx_ring[uart].low = 0;
+      if(tx_ring[uart].callback != NULL) {
+        tx_ring[uart].callback();
+      }
+    }
   }
 
   ENERGEST_OFF(ENERGEST_TYPE_IRQ);
@@ -342,12 +342,59 @@ void uart_init(uint8_t uart);
  */
 void uart_write_byte(uint8_t uart, uint8_t b);
 
+/** \brief Queues bytes for transmission without blocking
+ * \param uart The UART instance to use (0 to \c UART_INSTANCE_COUNT - 1)
+ * \param buf The bytes to transmit
+ * \param len The number of bytes
+ * \return The number of bytes queued, less than \e len when the TX ring
+ * buffer (UARTn_CONF_TX_BUF_SIZE) is full. Without a ring buffer, only
+ * what fits in the TX FIFO is written
+ *
+ * uart_write_byte() also goes through the ring buffer, but waits for room
+ * when it is full.
+ */
+uint16_t uart_write(uint8_t uart, const uint8_t *buf, uint16_t len);
+
+/** \brief Room left in the TX ring buffer
+ * \param uart The UART instance to use (0 to \c UART_INSTANCE_COUNT - 1)
+ * \return The number of bytes uart_write() will take now
+ */
+uint16_t uart_tx_space(uint8_t uart);
+
+/** \brief Assigns a callback to be called when the TX ring buffer drains
+ * \param uart The UART instance to use (0 to \c UART_INSTANCE_COUNT - 1)
+ * \param callback A pointer to the function
+ *
+ * The callback is called from the UART interrupt once at least half of the
+ * ring buffer is free again, after it has been filled over half. Writers
+ * that found too little room with uart_tx_space() resume from it.
+ */
+void uart_set_tx_callback(uint8_t uart, void (* callback)(void));
+
 /** \brief Assigns a callback to be called when the UART receives a byte
  * \param uart The UART instance to use (0 to \c UART_INSTANCE_COUNT - 1)
  * \param input A pointer to the function
  */
 void uart_set_input(uint8_t uart, int (* input)(unsigned char c));
 
+/** \brief Assigns a callback to be called with the bytes in the RX FIFO
+ * \param uart The UART instance to use (0 to \c UART_INSTANCE_COUNT - 1)
+ * \param input A pointer to the function
+ *
+ * Takes precedence over the callback of uart_set_input(), for drivers that
+ * would rather take the FIFO contents at once than a byte per call.
+ */
+void uart_set_input_block(uint8_t uart,
+                          int (* input)(const uint8_t *buf, uint16_t len));
+
+/** \brief Changes the baud rate
+ * \param uart The UART instance to use (0 to \c UART_INSTANCE_COUNT - 1)
+ * \param baud The new rate, up to 921600 with the 16 MHz UART clock
+ *
+ * Waits until the bytes already written are out at the old rate.
+ */
+void uart_set_baud_rate(uint8_t uart, uint32_t baud);
+
 /** @} */
 
 #endif /* UART_H_ */
@@ -49,12 +49,18 @@
 
 #if SLIP_ARCH_CONF_USB
 #define write_byte(b) usb_serial_writeb(b)
-#define set_input(f)  usb_serial_set_input(f)
+#define set_input()   usb_serial_set_input_block(slip_input_block)
 #define flush()       usb_serial_flush()
+#define tx_space()    usb_serial_tx_space()
+#define set_tx_callback(f) usb_serial_set_tx_callback(f)
+#define set_baud_rate(b)
 #else
 #define write_byte(b) uart_write_byte(SLIP_ARCH_CONF_UART, b)
-#define set_input(f)  uart_set_input(SLIP_ARCH_CONF_UART, f)
+#define set_input()   uart_set_input_block(SLIP_ARCH_CONF_UART, slip_input_block)
 #define flush()
+#define tx_space()    uart_tx_space(SLIP_ARCH_CONF_UART)
+#define set_tx_callback(f) uart_set_tx_callback(SLIP_ARCH_CONF_UART, f)
+#define set_baud_rate(b) uart_set_baud_rate(SLIP_ARCH_CONF_UART, b)
 #endif
 
 #define SLIP_END     0300
@@ -72,6 +78,65 @@ slip_arch_writeb(unsigned char c)
   }
 }
 /*---------------------------------------------------------------------------*/
+/**
+ * \brief Write a block of SLIP encoded bytes
+ * \param buf The bytes
+ * \param len The number of bytes
+ */
+void
+slip_arch_write(const uint8_t *buf, uint16_t len)
+{
+  uint16_t n;
+
+  /*
+   * What does not fit waits for room a byte at a time. Over USB, for the
+   * host to take a transfer, for a short while before it is dropped.
+   */
+#if SLIP_ARCH_CONF_USB
+  n = usb_serial_write(buf, len);
+#else
+  n = uart_write(SLIP_ARCH_CONF_UART, buf, len);
+#endif
+  while(n < len) {
+    write_byte(buf[n++]);
+  }
+  if(len > 0 && buf[len - 1] == SLIP_END) {
+    flush();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Change the baud rate of the SLIP UART
+ * \param baud The new rate. Ignored over USB
+ */
+void
+slip_arch_set_baud_rate(unsigned long baud)
+{
+  set_baud_rate(baud);
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Room left in the transmit buffer
+ * \return The bytes slip_arch_write() takes without waiting: the free
+ * part of the UART ring, or of the two USB transfers
+ */
+uint16_t
+slip_arch_tx_space(void)
+{
+  return tx_space();
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief Assign a callback called when the transmit buffer drains
+ * \param callback The function, called from the UART interrupt, or from
+ * the USB-Serial process when the host has taken a transfer
+ */
+void
+slip_arch_set_tx_callback(void (* callback)(void))
+{
+  set_tx_callback(callback);
+}
+/*---------------------------------------------------------------------------*/
 /**
  * \brief Initialise the arch-specific SLIP driver
  * \param ubr Ignored for the cc2538
@@ -79,7 +144,7 @@ slip_arch_writeb(unsigned char c)
 void
 slip_arch_init(unsigned long ubr)
 {
-  set_input(slip_input_byte);
+  set_input();
 }
 /*---------------------------------------------------------------------------*/
 
@@ -0,0 +1,57 @@
+/**
+ * \file
+ *      Trace timestamps of the cc2538
+ *
+ *      The sleep timer by default, as the rtimer: 30.5 us ticks that keep
+ *      running in the low power modes. With TRACE_CONF_CYCLES the DWT
+ *      cycle counter of the Cortex-M3 instead, one tick per cycle of the
+ *      16 MHz system clock, which resolves a short ISR but stops while the
+ *      CPU sleeps, so times across idle periods come out short.
+ */
+
+#include "contiki.h"
+#include "sys/trace.h"
+#include "dev/sys-ctrl.h"
+#include "reg.h"
+
+#ifdef TRACE_CONF_CYCLES
+#define TRACE_CYCLES TRACE_CONF_CYCLES
+#else
+#define TRACE_CYCLES 0
+#endif
+
+#define DEMCR              0xE000EDFC
+#define DEMCR_TRCENA       0x01000000
+#define DWT_CTRL           0xE0001000
+#define DWT_CTRL_CYCCNTENA 0x00000001
+#define DWT_CYCCNT         0xE0001004
+/*---------------------------------------------------------------------------*/
+void
+trace_arch_init(void)
+{
+#if TRACE_CYCLES
+  REG(DEMCR) |= DEMCR_TRCENA;
+  REG(DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+#endif
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+trace_arch_now(void)
+{
+#if TRACE_CYCLES
+  return REG(DWT_CYCCNT);
+#else
+  return RTIMER_NOW();
+#endif
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+trace_arch_second(void)
+{
+#if TRACE_CYCLES
+  return SYS_CTRL_16MHZ;
+#else
+  return RTIMER_ARCH_SECOND;
+#endif
+}
+/*---------------------------------------------------------------------------*/
@@ -52,8 +52,10 @@
 #include "usb-arch.h"
 #include "cdc-acm/cdc-acm.h"
 #include "ieee-addr.h"
+#include "dev/watchdog.h"
 
 #include <stdint.h>
+#include <string.h>
 /*---------------------------------------------------------------------------*/
 #define DEBUG 0
 
@@ -116,21 +118,45 @@ static const struct product product = {
 #define EPOUT 0x03
 
 #define RX_BUFFER_SIZE USB_EP3_SIZE
+
+/*
+ * Bytes of a bulk IN transfer. Larger than a packet, a transfer goes out
+ * as several packets, and a zero length packet ends one of an exact
+ * multiple of the packet size.
+ */
+#ifdef USB_SERIAL_CONF_TX_BUF_SIZE
+#define TX_BUFFER_SIZE USB_SERIAL_CONF_TX_BUF_SIZE
+#else
 #define TX_BUFFER_SIZE (USB_EP2_SIZE - 1)
+#endif
+
+/* How long usb_serial_writeb() waits for the host to take a transfer */
+#define TX_TIMEOUT     (CLOCK_SECOND / 8)
+
+#define MIN(a, b)      ((a) < (b) ? (a) : (b))
 
 typedef struct _USBBuffer usb_buffer;
 
-static usb_buffer data_rx_urb;
-static usb_buffer data_tx_urb;
-static uint8_t usb_rx_data[RX_BUFFER_SIZE];
+/*
+ * Two transfers each way: one is filled while the other one is with the
+ * controller
+ */
+static usb_buffer data_rx_urb[2];
+static usb_buffer data_tx_urb[2];
+static uint8_t usb_rx_data[2][RX_BUFFER_SIZE];
+static uint8_t rx_next;
 static uint8_t enabled = 0;
 
-#define SLIP_END 0300
-static uint8_t usb_tx_data[TX_BUFFER_SIZE];
-static uint8_t buffered_data = 0;
+static uint8_t usb_tx_data[2][TX_BUFFER_SIZE];
+static uint8_t tx_current;
+static uint16_t buffered_data = 0;
 
 /* Callback to the input handler */
 static int (* input_handler)(unsigned char c);
+static int (* input_block_handler)(const uint8_t *buf, uint16_t len);
+
+/* Called when the host has taken a TX buffer */
+static void (* tx_callback)(void);
 /*---------------------------------------------------------------------------*/
 uint8_t *
 usb_class_get_string_descriptor(uint16_t lang, uint8_t string)
@@ -170,14 +196,28 @@ set_serial_number(void)
 }
 /*---------------------------------------------------------------------------*/
 static void
-queue_rx_urb(void)
+queue_rx_urb(uint8_t i)
 {
-  data_rx_urb.flags = USB_BUFFER_PACKET_END;
-  data_rx_urb.flags |= USB_BUFFER_NOTIFY;
-  data_rx_urb.data = usb_rx_data;
-  data_rx_urb.left = RX_BUFFER_SIZE;
-  data_rx_urb.next = NULL;
-  usb_submit_recv_buffer(EPOUT, &data_rx_urb);
+  data_rx_urb[i].flags = USB_BUFFER_PACKET_END;
+  data_rx_urb[i].flags |= USB_BUFFER_NOTIFY;
+  data_rx_urb[i].data = usb_rx_data[i];
+  data_rx_urb[i].left = RX_BUFFER_SIZE;
+  data_rx_urb[i].next = NULL;
+  usb_submit_recv_buffer(EPOUT, &data_rx_urb[i]);
+}
+/*---------------------------------------------------------------------------*/
+static void
+input(const uint8_t *buf, uint16_t len)
+{
+  uint16_t i;
+
+  if(input_block_handler) {
+    input_block_handler(buf, len);
+  } else if(input_handler) {
+    for(i = 0; i < len; i++) {
+      input_handler(buf[i]);
+    }
+  }
 }
 /*---------------------------------------------------------------------------*/
 static void
@@ -191,7 +231,9 @@ do_work(void)
     usb_setup_bulk_endpoint(EPIN);
     usb_setup_bulk_endpoint(EPOUT);
 
-    queue_rx_urb();
+    rx_next = 0;
+    queue_rx_urb(0);
+    queue_rx_urb(1);
   }
   if(events & USB_EVENT_RESET) {
     enabled = 0;
@@ -212,38 +254,62 @@ do_work(void)
     return;
   }
 
+  events = usb_get_ep_events(EPIN);
+  if(events & USB_EP_EVENT_NOTIFICATION) {
+    if(tx_callback) {
+      tx_callback();
+    }
+  }
+
   events = usb_get_ep_events(EPOUT);
-  if((events & USB_EP_EVENT_NOTIFICATION)
-     && !(data_rx_urb.flags & USB_BUFFER_SUBMITTED)) {
-    if(!(data_rx_urb.flags & USB_BUFFER_FAILED)) {
-      if(input_handler) {
-        uint8_t len;
-        uint8_t i;
-
-        len = RX_BUFFER_SIZE - data_rx_urb.left;
-        for(i = 0; i < len; i++) {
-          input_handler(usb_rx_data[i]);
-        }
+  if(events & USB_EP_EVENT_NOTIFICATION) {
+    /* The controller releases the two buffers in turn */
+    while(!(data_rx_urb[rx_next].flags & USB_BUFFER_SUBMITTED)) {
+      if(!(data_rx_urb[rx_next].flags & USB_BUFFER_FAILED)) {
+        input(usb_rx_data[rx_next], RX_BUFFER_SIZE - data_rx_urb[rx_next].left);
       }
+      queue_rx_urb(rx_next);
+      rx_next ^= 1;
     }
-    queue_rx_urb();
   }
 }
 /*---------------------------------------------------------------------------*/
+/*
+ * Waits until the buffer about to be filled is no longer with the
+ * controller. Gives up when the host does not read, dropping the data.
+ */
+static int
+tx_wait(void)
+{
+  clock_time_t start = clock_time();
+
+  while(data_tx_urb[tx_current].flags & USB_BUFFER_SUBMITTED) {
+    if(!enabled || clock_time() - start > TX_TIMEOUT) {
+      return 0;
+    }
+    watchdog_periodic();
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
 void
 usb_serial_flush()
 {
+  usb_buffer *urb;
+
   if(buffered_data == 0) {
     return;
   }
 
-  data_tx_urb.flags = USB_BUFFER_SHORT_END;
-  data_tx_urb.flags |= USB_BUFFER_NOTIFY;
-  data_tx_urb.next = NULL;
-  data_tx_urb.data = usb_tx_data;
-  data_tx_urb.left = buffered_data;
+  urb = &data_tx_urb[tx_current];
+  urb->flags = USB_BUFFER_SHORT_END;
+  urb->flags |= USB_BUFFER_NOTIFY;
+  urb->next = NULL;
+  urb->data = usb_tx_data[tx_current];
+  urb->left = buffered_data;
   buffered_data = 0;
-  usb_submit_xmit_buffer(EPIN, &data_tx_urb);
+  tx_current ^= 1;
+  usb_submit_xmit_buffer(EPIN, urb);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -254,7 +320,11 @@ usb_serial_writeb(uint8_t b)
     return;
   }
 
-  usb_tx_data[buffered_data] = b;
+  if(buffered_data == 0 && !tx_wait()) {
+    return;
+  }
+
+  usb_tx_data[tx_current][buffered_data] = b;
   buffered_data++;
 
   if(buffered_data == TX_BUFFER_SIZE) {
@@ -262,6 +332,55 @@ usb_serial_writeb(uint8_t b)
   }
 }
 /*---------------------------------------------------------------------------*/
+uint16_t
+usb_serial_write(const uint8_t *buf, uint16_t len)
+{
+  uint16_t done = 0;
+  uint16_t n;
+
+  if(!enabled) {
+    buffered_data = 0;
+    return 0;
+  }
+
+  /* Only into a buffer the controller has released, the rest is left */
+  while(done < len && !(data_tx_urb[tx_current].flags & USB_BUFFER_SUBMITTED)) {
+    n = MIN(len - done, TX_BUFFER_SIZE - buffered_data);
+    memcpy(&usb_tx_data[tx_current][buffered_data], buf + done, n);
+    buffered_data += n;
+    done += n;
+
+    if(buffered_data == TX_BUFFER_SIZE) {
+      usb_serial_flush();
+    }
+  }
+  return done;
+}
+/*---------------------------------------------------------------------------*/
+uint16_t
+usb_serial_tx_space(void)
+{
+  uint16_t space = 0;
+
+  if(!enabled) {
+    /* Writes are discarded without waiting */
+    return 2 * TX_BUFFER_SIZE;
+  }
+  if(!(data_tx_urb[tx_current].flags & USB_BUFFER_SUBMITTED)) {
+    space = TX_BUFFER_SIZE - buffered_data;
+    if(!(data_tx_urb[tx_current ^ 1].flags & USB_BUFFER_SUBMITTED)) {
+      space += TX_BUFFER_SIZE;
+    }
+  }
+  return space;
+}
+/*---------------------------------------------------------------------------*/
+void
+usb_serial_set_tx_callback(void (* callback)(void))
+{
+  tx_callback = callback;
+}
+/*---------------------------------------------------------------------------*/
 PROCESS(usb_serial_process, "USB-Serial process");
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(usb_serial_process, ev, data)
@@ -298,6 +417,12 @@ usb_serial_set_input(int (* input)(unsigned char c))
 }
 /*---------------------------------------------------------------------------*/
 void
+usb_serial_set_input_block(int (* input)(const uint8_t *buf, uint16_t len))
+{
+  input_block_handler = input;
+}
+/*---------------------------------------------------------------------------*/
+void
 usb_serial_init()
 {
   process_start(&usb_serial_process, NULL);
@@ -62,6 +62,44 @@ void usb_serial_writeb(uint8_t b);
  */
 void usb_serial_set_input(int (* input)(unsigned char c));
 
+/**
+ * \brief Set an input hook for the packets received over USB
+ * \param input A pointer to a function to be called with each packet
+ *
+ * Takes precedence over the hook of usb_serial_set_input()
+ */
+void usb_serial_set_input_block(int (* input)(const uint8_t *buf, uint16_t len));
+
+/**
+ * \brief Write a block of bytes over USB
+ * \param buf The bytes
+ * \param len The number of bytes
+ * \return The number of bytes taken, less than \e len when both TX
+ * buffers are still with the controller
+ *
+ * The bytes are copied into the TX buffers, of USB_SERIAL_CONF_TX_BUF_SIZE
+ * bytes, and each full buffer is sent as one bulk transfer. Call
+ * usb_serial_flush() to send a partial one. Unlike usb_serial_writeb(),
+ * it does not wait for the host to read.
+ */
+uint16_t usb_serial_write(const uint8_t *buf, uint16_t len);
+
+/**
+ * \brief Room left in the TX buffers
+ * \return The bytes usb_serial_write() takes now, up to two buffers of
+ * USB_SERIAL_CONF_TX_BUF_SIZE bytes
+ *
+ * With no host on the line, writes are discarded and the full room is
+ * returned.
+ */
+uint16_t usb_serial_tx_space(void);
+
+/**
+ * \brief Assign a callback called when the host has taken a TX buffer
+ * \param callback The function, called from the USB-Serial process
+ */
+void usb_serial_set_tx_callback(void (* callback)(void));
+
 /**
  * \brief Immediately transmit the content of Serial-over-USB TX buffers
  * \sa usb_serial_writeb()
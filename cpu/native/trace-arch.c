@@ -0,0 +1,36 @@
+/**
+ * \file
+ *      Trace timestamps of native, in microseconds
+ */
+
+#include "contiki.h"
+#include "sys/trace.h"
+#include <sys/time.h>
+
+static struct timeval start;
+/*---------------------------------------------------------------------------*/
+void
+trace_arch_init(void)
+{
+  /* Called by both the trace and the process accounting */
+  if(start.tv_sec == 0) {
+    gettimeofday(&start, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+trace_arch_now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (uint32_t)((tv.tv_sec - start.tv_sec) * 1000000UL +
+                    tv.tv_usec - start.tv_usec);
+}
+/*---------------------------------------------------------------------------*/
+uint32_t
+trace_arch_second(void)
+{
+  return 1000000UL;
+}
+/*---------------------------------------------------------------------------*/
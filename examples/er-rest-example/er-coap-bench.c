@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ */
+
+/**
+ * \file
+ *      Native benchmark of the CoAP request/response path.
+ *
+ *      Feeds BENCH_REQUESTS confirmable GET requests for /bench through
+ *      tcpip_input() and reports the time per request and how many
+ *      transaction buffers are left while a request is being handled.
+ *      Then times discovery: the second block of /.well-known/core and
+ *      an rt= query, with BENCH_LINKS more resources activated.
+ *      Compare the in-place response path with the transaction buffer
+ *      path:
+ *
+ *        make TARGET=native er-coap-bench && ./er-coap-bench.native
+ *        make TARGET=native clean
+ *        make TARGET=native DEFINES=COAP_ZERO_COPY=0 er-coap-bench && ./er-coap-bench.native
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "contiki.h"
+#include "contiki-net.h"
+#include "erbium.h"
+#include "er-coap-13-engine.h"
+
+#ifndef BENCH_REQUESTS
+#define BENCH_REQUESTS 100000UL
+#endif
+
+#ifndef BENCH_LINKS
+#define BENCH_LINKS    24
+#endif
+
+#define UIP_IP_BUF    ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF   ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#define UIP_UDP_PAYLOAD ((uint8_t *)&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+
+#define CLIENT_PORT   61616
+
+/* CON GET, token 0xbeef, Uri-Path "bench"; the MID is filled in per request */
+static const uint8_t request[] = {
+  0x42, COAP_GET, 0x00, 0x00, 0xbe, 0xef,
+  0xb5, 'b', 'e', 'n', 'c', 'h'
+};
+
+/* CON GET /.well-known/core, Block2 1/64 */
+static const uint8_t discovery[] = {
+  0x42, COAP_GET, 0x00, 0x00, 0xbe, 0xef,
+  0xbb, '.', 'w', 'e', 'l', 'l', '-', 'k', 'n', 'o', 'w', 'n',
+  0x04, 'c', 'o', 'r', 'e',
+  0xc1, 0x12
+};
+
+/* CON GET /.well-known/core?rt=ipso.pwr.* */
+static const uint8_t discovery_rt[] = {
+  0x42, COAP_GET, 0x00, 0x00, 0xbe, 0xef,
+  0xbb, '.', 'w', 'e', 'l', 'l', '-', 'k', 'n', 'o', 'w', 'n',
+  0x04, 'c', 'o', 'r', 'e',
+  0x4d, 0x00, 'r', 't', '=', 'i', 'p', 's', 'o', '.', 'p', 'w', 'r', '.', '*'
+};
+
+static uip_ipaddr_t client_addr;
+static int free_transactions = -1;
+static const uip_lladdr_t client_lladdr = { { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02 } };
+
+RESOURCE(bench, METHOD_GET, "bench", "title=\"Benchmark\"");
+void
+bench_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+  coap_transaction_t *t[COAP_MAX_OPEN_TRANSACTIONS];
+  int n;
+
+  if(free_transactions < 0) {
+    for(n = 0; n < COAP_MAX_OPEN_TRANSACTIONS &&
+          (t[n] = coap_new_transaction(n, &client_addr, 0)) != NULL; n++);
+    free_transactions = n;
+    while(n > 0) {
+      coap_clear_transaction(t[--n]);
+    }
+  }
+
+  if(preferred_size < REST_MAX_CHUNK_SIZE) {
+    /* A discovery resource */
+    return;
+  }
+
+  /* A full chunk, so that the payload copies show */
+  memset(buffer, 'x', REST_MAX_CHUNK_SIZE);
+  REST.set_header_content_type(response, REST.type.TEXT_PLAIN);
+  REST.set_response_payload(response, buffer, REST_MAX_CHUNK_SIZE);
+}
+/*---------------------------------------------------------------------------*/
+static void
+inject_request(const uint8_t *request, uint16_t request_len, uint16_t mid)
+{
+  uip_ds6_addr_t *lladdr = uip_ds6_get_link_local(-1);
+
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->len[0] = 0;
+  UIP_IP_BUF->len[1] = UIP_UDPH_LEN + request_len;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &client_addr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &lladdr->ipaddr);
+
+  UIP_UDP_BUF->srcport = UIP_HTONS(CLIENT_PORT);
+  UIP_UDP_BUF->destport = UIP_HTONS(COAP_SERVER_PORT);
+  UIP_UDP_BUF->udplen = UIP_HTONS(UIP_UDPH_LEN + request_len);
+
+  memcpy(UIP_UDP_PAYLOAD, request, request_len);
+  UIP_UDP_PAYLOAD[2] = mid >> 8;
+  UIP_UDP_PAYLOAD[3] = mid & 0xff;
+
+  uip_len = UIP_IPUDPH_LEN + request_len;
+  UIP_UDP_BUF->udpchksum = 0;
+  UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
+
+  tcpip_input();
+}
+/*---------------------------------------------------------------------------*/
+static void
+bench_discovery(const char *name, const uint8_t *request, uint16_t request_len)
+{
+  clock_time_t start;
+  clock_time_t duration;
+  unsigned long i;
+  uint16_t len;
+  uint8_t *payload;
+
+  inject_request(request, request_len, 0);
+  len = uip_htons(UIP_UDP_BUF->udplen) - UIP_UDPH_LEN;
+  payload = memchr(UIP_UDP_PAYLOAD, 0xff, len);
+  printf("Bench: %s response %u bytes: %.*s\n", name, len,
+         payload ? (int)(UIP_UDP_PAYLOAD + len - payload - 1) : 0, (char *)payload + 1);
+
+  start = clock_time();
+  for(i = 1; i <= BENCH_REQUESTS / 10; i++) {
+    inject_request(request, request_len, (uint16_t)i);
+  }
+  duration = clock_time() - start;
+
+  printf("Bench: %s %lu ns/request\n", name,
+         (unsigned long)((unsigned long long)duration * 1000000000ULL /
+                         CLOCK_SECOND / (BENCH_REQUESTS / 10)));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(er_coap_bench, "CoAP benchmark");
+AUTOSTART_PROCESSES(&er_coap_bench);
+
+PROCESS_THREAD(er_coap_bench, ev, data)
+{
+  static struct etimer et;
+  static unsigned long i;
+  static clock_time_t start;
+  static resource_t links[BENCH_LINKS];
+  static char urls[BENCH_LINKS][16];
+  clock_time_t duration;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+  rest_activate_resource(&resource_bench);
+  for(i = 0; i < BENCH_LINKS; i++) {
+    sprintf(urls[i], "dev/pwr/%lu/w", i);
+    links[i] = resource_bench;
+    links[i].url = urls[i];
+    links[i].attributes = (i & 1) ? "title=\"Instantaneous Power\";rt=\"ipso.pwr.w\""
+                                  : "title=\"Relay\";rt=\"ipso.relay\"";
+    rest_activate_resource(&links[i]);
+  }
+
+  uip_ip6addr(&client_addr, 0xfe80, 0, 0, 0, 0, 0, 0, 2);
+  uip_ds6_nbr_add(&client_addr, &client_lladdr, 0, NBR_REACHABLE);
+
+  /* Let the link-local address leave DAD */
+  etimer_set(&et, CLOCK_SECOND * 2);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  /* Check the response of the first request */
+  inject_request(request, sizeof(request), 0);
+  if(UIP_UDP_BUF->srcport != UIP_HTONS(COAP_SERVER_PORT)
+     || UIP_UDP_PAYLOAD[1] != CONTENT_2_05) {
+    printf("Bench: no response\n");
+    exit(1);
+  }
+  printf("Bench: response %u bytes\n", uip_htons(UIP_UDP_BUF->udplen) - UIP_UDPH_LEN);
+
+  start = clock_time();
+  for(i = 1; i <= BENCH_REQUESTS; i++) {
+    inject_request(request, sizeof(request), (uint16_t)i);
+  }
+  duration = clock_time() - start;
+
+  printf("Bench: zero-copy %u, %lu requests in %lu ms, %lu ns/request\n",
+         COAP_ZERO_COPY, BENCH_REQUESTS,
+         (unsigned long)(duration * 1000 / CLOCK_SECOND),
+         (unsigned long)((unsigned long long)duration * 1000000000ULL /
+                         CLOCK_SECOND / BENCH_REQUESTS));
+  printf("Bench: %d of %u transactions (%u bytes each) free during a request\n",
+         free_transactions, COAP_MAX_OPEN_TRANSACTIONS,
+         (unsigned)sizeof(coap_transaction_t));
+
+  bench_discovery("discovery", discovery, sizeof(discovery));
+  bench_discovery("discovery rt", discovery_rt, sizeof(discovery_rt));
+
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -26,6 +26,7 @@
 /* Compiler configurations */
 #define CCIF
 #define CLIF
+#define CC_CONF_CAS(ptr, old, new) __sync_bool_compare_and_swap(ptr, old, new)
 
 /* Platform typedefs */
 typedef uint32_t clock_time_t;
@@ -91,8 +92,12 @@ typedef uint32_t rtimer_clock_t;
  */
 #define UART_CONF_ENABLE            1 /**< Enable/Disable UART I/O */
 
+#ifndef UART0_CONF_BAUD_RATE
 #define UART0_CONF_BAUD_RATE   115200 /**< Default UART0 baud rate */
+#endif
+#ifndef UART1_CONF_BAUD_RATE
 #define UART1_CONF_BAUD_RATE   115200 /**< Default UART0 baud rate */
+#endif
 
 #define DBG_CONF_UART               0 /**< UART to use for debugging */
 
@@ -100,10 +105,15 @@ typedef uint32_t rtimer_clock_t;
 #define SLIP_BRIDGE_CONF_NO_PUTCHAR 1
 #define SLIP_RADIO_CONF_NO_PUTCHAR  1
 
-#undef SLIP_ARCH_CONF_USB
+#ifndef SLIP_ARCH_CONF_USB
+#define SLIP_ARCH_CONF_USB          0 /**< SLIP over UART, 1 for USB CDC-ACM */
+#endif
 #define SLIP_ARCH_CONF_UART         0 /**< UART to use for SLIP */
+#define SLIP_CONF_ARCH_WRITE        1 /**< slip-arch takes blocks */
 
+#ifndef SLIP_ARCH_CONF_ENABLED
 #define SLIP_ARCH_CONF_ENABLED      0
+#endif
 
 #ifndef CC2538_RF_CONF_SNIFFER_USB
 #define CC2538_RF_CONF_SNIFFER_USB  0 /**< Sniffer out over UART by default */
@@ -221,6 +231,13 @@ typedef uint32_t rtimer_clock_t;
 #define CONTIKIMAC_CONF_WITH_PHASE_OPTIMIZATION 0
 #define WITH_FAST_SLEEP                         1
 
+/* Configure TSCH for when it's selected. The RF driver turns the radio
+   back on after a channel change, TSCH turns it off as needed. */
+#ifndef TSCH_CONF_SET_CHANNEL
+int8_t cc2538_rf_channel_set(uint8_t channel);
+#define TSCH_CONF_SET_CHANNEL(c)                cc2538_rf_channel_set(c)
+#endif
+
 #ifndef NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE
 #define NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE    8
 #endif
@@ -335,6 +352,27 @@ typedef uint32_t rtimer_clock_t;
 #define RPL_CONF_OF rpl_mrhof
 #endif
 
+/* Retransmit DAOs until the parent accepts them, and combine the
+ * DAOs forwarded for children */
+#ifndef RPL_CONF_DAO_ACK
+#define RPL_CONF_DAO_ACK                     1
+#endif
+#ifndef RPL_CONF_DAO_AGGREGATION
+#define RPL_CONF_DAO_AGGREGATION             4
+#endif
+
+/* Keep the DODAG across reboots, see rpl-checkpoint-flash.c */
+#ifndef RPL_CONF_WITH_CHECKPOINT
+#define RPL_CONF_WITH_CHECKPOINT             1
+#endif
+#ifndef RPL_CONF_CHECKPOINT_DRIVER
+#define RPL_CONF_CHECKPOINT_DRIVER           rpl_checkpoint_flash
+#endif
+
+#ifndef RPL_CONF_WITH_6CO
+#define RPL_CONF_WITH_6CO                    1
+#endif
+
 #define UIP_CONF_ND6_REACHABLE_TIME     600000
 #define UIP_CONF_ND6_RETRANS_TIMER       10000
 
@@ -365,8 +403,9 @@ typedef uint32_t rtimer_clock_t;
 #endif
 #define SICSLOWPAN_CONF_MAXAGE               8
 
-/* Define our IPv6 prefixes/contexts here */
-#define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS    1
+/* Define our IPv6 prefixes/contexts here. Context 1 is the prefix
+   delegated to the hub, learnt at runtime from 6CO options in DIOs. */
+#define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS    2
 #ifndef SICSLOWPAN_CONF_ADDR_CONTEXT_0
 #define SICSLOWPAN_CONF_ADDR_CONTEXT_0 { \
   addr_contexts[0].prefix[0] = 0xaa; \
@@ -34,6 +34,7 @@
 #include "ieee-addr.h"
 #include "lpm.h"
 #include "lib/sensors.h"
+#include "sys/trace.h"
 #include "net/ipv6/uip-ds6.h"
 
 #include <stdint.h>
@@ -115,6 +116,9 @@ main(void)
   clock_init();
   lpm_init();
   rtimer_init();
+#if TRACE_ENABLED
+  trace_init();
+#endif
   gpio_init();
   ioc_init();
 
@@ -140,6 +144,10 @@ main(void)
   serial_line_init();
 #endif
 
+#if USB_SERIAL_CONF_ENABLE
+  usb_serial_init();
+#endif
+
   INTERRUPTS_ENABLE();
 
   PUTS(CONTIKI_VERSION_STRING);
@@ -164,6 +172,7 @@ main(void)
   memcpy(&uip_lladdr.addr, &linkaddr_node_addr, sizeof(uip_lladdr.addr));
   queuebuf_init();
   process_start(&tcpip_process, NULL);
+  process_set_priority(&tcpip_process, PROCESS_PRIO_HIGH);
 #endif /* UIP_CONF_IPV6 */
 
   print_net_info();
@@ -10,17 +10,17 @@
   */
 #include "dimmer.h"
 
-#define DEBUG 1
-#if DEBUG
-#define PRINTF(...)     printf(__VA_ARGS__)
-#else
-#define PRINTF(...)
-#endif
+/* Called from the zero cross ISR, hence the deferred log */
+#include "sys/dlog.h"
+#include "sys/trace.h"
 
 static int dimmer_configured = 0;
 
 static uint32_t dimmer_cb_granularity_ms;
 static uint32_t rt_time_ms;
+static uint8_t  zc_frequency;
+
+PROCESS(dimmer_process, "Dimmer");
 
 #define TRIAC_ON     1
 #define TRIAC_OFF    0
@@ -39,6 +39,33 @@ void dimmer_timer_callback( struct rtimer *rt, void* ptr)
 {
    int device =(dimmer_config_t *)rt - &dimmer_config[0];
    set_triac(device, TRIAC_ON);
+   TRACE_EVENT(TRACE_ID_TRIAC, device);
+}
+
+/*
+ * \brief Advance a transition by one half cycle.
+ *
+ * Called from the zero cross ISR. Finished transitions are handed to
+ * dimmer_process, which turns off the triacs that faded out.
+ */
+static void
+fade_step(dimmer_config_t *d)
+{
+   int32_t p;
+
+   if(++d->fade_step >= d->fade_steps) {
+      d->level = d->fade_target;
+      d->fade_steps = 0;
+      process_poll(&dimmer_process);
+   } else {
+      p = d->fade_from + ((int32_t)d->fade_to - d->fade_from) * (int32_t)d->fade_step / (int32_t)d->fade_steps;
+      if(d->fade_curve == DIMMER_CURVE_PERCEPTUAL) {
+         /* from and to are square roots of the level, scaled to DIMMER_LEVEL_MAX */
+         p = p * p / DIMMER_LEVEL_MAX;
+      }
+      d->level = p;
+   }
+   d->percent = (d->level + 50) / 100;
 }
 
 /*
@@ -61,22 +88,32 @@ zero_cross_handler(uint8_t port, uint8_t pin)
    rtimer_clock_t rtimer_expire = 0;
    int result;
 
+   TRACE_BEGIN(TRACE_ID_ZERO_CROSS, 0);
+
    for(i = 0; i < MAX_TRIACS; i++)
    {
+      if(dimmer_config[i].enabled == 1 && dimmer_config[i].fade_steps) {
+         fade_step(&dimmer_config[i]);
+      }
+
       /* For Dim percentage of 100 we don't start the timer,
        *  for the rest the timer fires at the closest approximation.
        */
-      if(dimmer_config[i].enabled == 1 && dimmer_config[i].percent != 100) {
+      if(dimmer_config[i].enabled == 1 && dimmer_config[i].level == DIMMER_LEVEL_MAX) {
          set_triac(i, TRIAC_OFF);
-         rtimer_expire = (dimmer_cb_granularity_ms * dimmer_config[i].percent) / rt_time_ms;
+      } else if(dimmer_config[i].enabled == 1) {
+         set_triac(i, TRIAC_OFF);
+         rtimer_expire = (dimmer_cb_granularity_ms * dimmer_config[i].level) / (100 * rt_time_ms);
 
          result = rtimer_set(&dimmer_config[i].rt, RTIMER_NOW() + rtimer_expire + 2, 1,
                              (rtimer_callback_t)dimmer_timer_callback, NULL);
          if(result != RTIMER_OK) {
-            PRINTF("Error Setting Rtimer for device %d\n", i);
+            DLOG_ERR("Error Setting Rtimer for device %d\n", i);
          }
       }
    }
+
+   TRACE_END(TRACE_ID_ZERO_CROSS, 0);
 }
 
 /*
@@ -89,25 +126,28 @@ void
 dimmer_enable(int triac, int percent)
 {
    /* Already enabled, and no change in percent,  nothing to do, return.*/
-   if(dimmer_config[triac].enabled == 1 && dimmer_config[triac].percent == percent) {
+   if(dimmer_config[triac].enabled == 1 && dimmer_config[triac].percent == percent
+      && dimmer_config[triac].fade_steps == 0) {
       return;
    }
 
+   /* Keep the zero cross handler out while the level changes */
+   nvic_interrupt_disable(ZERO_CROSS_VECTOR);
+
    if (!dimmer_config[triac].enabled) {
       dimmer_configured++;
       dimmer_config[triac].enabled = 1;
    }
 
    dimmer_config[triac].percent = percent;
+   dimmer_config[triac].level = percent * 100;
+   dimmer_config[triac].fade_steps = 0;
 
    if(dimmer_config[triac].percent == 100) {
       set_triac(triac, TRIAC_OFF);
    }
 
-   /* If this is the first triac that needs to be dimmed, enable the zero cross interrupt */
-   if (dimmer_configured == 1) {
-      nvic_interrupt_enable(ZERO_CROSS_VECTOR);
-   }
+   nvic_interrupt_enable(ZERO_CROSS_VECTOR);
 }
 
 /*
@@ -123,6 +163,8 @@ dimmer_disable(int triac)
    }
    dimmer_config[triac].enabled = 0;
    dimmer_config[triac].percent = 0;
+   dimmer_config[triac].level = 0;
+   dimmer_config[triac].fade_steps = 0;
 
    set_triac(triac, TRIAC_ON);
 
@@ -133,6 +175,153 @@ dimmer_disable(int triac)
    }
 }
 
+/*
+ * \brief Set all dimmers at once.
+ *
+ * The zero cross interrupt is masked meanwhile, so that no half cycle
+ * runs with some triacs at the old and others at the new brightness.
+ *
+ * \param percent   Brightness(0-100) per triac, 0 disables it and a
+ *                  negative value leaves it unchanged.
+ */
+void
+dimmer_set_all(const int percent[MAX_TRIACS])
+{
+   int i;
+
+   nvic_interrupt_disable(ZERO_CROSS_VECTOR);
+
+   for(i = 0; i < MAX_TRIACS; i++) {
+      if(percent[i] < 0) {
+         continue;
+      }
+      if(percent[i] == 0) {
+         if(dimmer_config[i].enabled) {
+            dimmer_config[i].enabled = 0;
+            dimmer_configured--;
+            set_triac(i, TRIAC_ON);
+         }
+         dimmer_config[i].percent = 0;
+         dimmer_config[i].level = 0;
+         dimmer_config[i].fade_steps = 0;
+         continue;
+      }
+      if(!dimmer_config[i].enabled) {
+         dimmer_config[i].enabled = 1;
+         dimmer_configured++;
+      }
+      dimmer_config[i].percent = percent[i];
+      dimmer_config[i].level = percent[i] * 100;
+      dimmer_config[i].fade_steps = 0;
+      if(percent[i] == 100) {
+         set_triac(i, TRIAC_OFF);
+      }
+   }
+
+   if(dimmer_configured > 0) {
+      nvic_interrupt_enable(ZERO_CROSS_VECTOR);
+   }
+}
+
+/*
+ * Integer square root of a level, scaled back to DIMMER_LEVEL_MAX.
+ */
+static uint16_t
+level_sqrt(uint16_t level)
+{
+   uint32_t n = (uint32_t)level * DIMMER_LEVEL_MAX;
+   uint32_t r = 0;
+   uint32_t bit = 1UL << 30;
+
+   while(bit > n) {
+      bit >>= 2;
+   }
+   while(bit) {
+      if(n >= r + bit) {
+         n -= r + bit;
+         r = (r >> 1) + bit;
+      } else {
+         r >>= 1;
+      }
+      bit >>= 2;
+   }
+   return r;
+}
+
+/*
+ * \brief Fade to a brightness.
+ *
+ * The zero cross handler moves the level a little every half cycle, so
+ * that the transition needs no further requests. Fading to 0 disables
+ * the triac at the end.
+ *
+ * \param triac        Triac number(0-4).
+ * \param percent      Brightness(0-100) at the end.
+ * \param duration_ms  Length of the transition, 0 sets the brightness at once.
+ * \param curve        DIMMER_CURVE_LINEAR or DIMMER_CURVE_PERCEPTUAL.
+ */
+void
+dimmer_fade(int triac, int percent, uint32_t duration_ms, uint8_t curve)
+{
+   dimmer_config_t *d = &dimmer_config[triac];
+   uint32_t steps = duration_ms * zc_frequency / 1000;
+
+   if(steps == 0 || (!d->enabled && percent == 0)) {
+      if(percent == 0) {
+         dimmer_disable(triac);
+      } else {
+         dimmer_enable(triac, percent);
+      }
+      return;
+   }
+
+   nvic_interrupt_disable(ZERO_CROSS_VECTOR);
+
+   if(!d->enabled) {
+      /* Fade in from off */
+      d->enabled = 1;
+      d->level = 0;
+      d->percent = 0;
+      dimmer_configured++;
+   }
+
+   d->fade_curve = curve;
+   d->fade_target = percent * 100;
+   if(curve == DIMMER_CURVE_PERCEPTUAL) {
+      d->fade_from = level_sqrt(d->level);
+      d->fade_to = level_sqrt(d->fade_target);
+   } else {
+      d->fade_from = d->level;
+      d->fade_to = d->fade_target;
+   }
+   d->fade_step = 0;
+   d->fade_steps = steps;
+
+   nvic_interrupt_enable(ZERO_CROSS_VECTOR);
+}
+
+/*
+ * Turns off the triacs that faded out, outside of the ISR.
+ */
+PROCESS_THREAD(dimmer_process, ev, data)
+{
+   int i;
+
+   PROCESS_BEGIN();
+
+   while(1) {
+      PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_POLL);
+      for(i = 0; i < MAX_TRIACS; i++) {
+         if(dimmer_config[i].enabled && dimmer_config[i].fade_steps == 0
+            && dimmer_config[i].level == 0) {
+            dimmer_disable(i);
+         }
+      }
+   }
+
+   PROCESS_END();
+}
+
 /*
  * \brief Initialize the dimmer code.
  */
@@ -142,7 +331,6 @@ dimmer_init(uint8_t ac_frequency)
    /* Can be a macro if zc_frequency is known a-priori, else need
     * to initialize these based on calibration. TODO
     */
-   uint8_t  zc_frequency;
    uint32_t zc_interval_ms;
 
    /* Configure Zero Cross pin as input */
@@ -170,5 +358,7 @@ dimmer_init(uint8_t ac_frequency)
 
    /* Time in microseconds between each RT tick, here it is 30 usec */
    rt_time_ms = 1000000UL / RTIMER_ARCH_SECOND;
+
+   process_start(&dimmer_process, NULL);
 }
 
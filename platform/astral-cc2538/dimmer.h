@@ -19,15 +19,32 @@
 #define ZERO_CROSS_PORT_NUM         GPIO_C_NUM
 #define ZERO_CROSS_VECTOR           NVIC_INT_GPIO_PORT_C
 
+/* Brightness the zero cross handler works with, in 1/100 % */
+#define DIMMER_LEVEL_MAX            10000
+
+/* Transition curves */
+#define DIMMER_CURVE_LINEAR         0
+#define DIMMER_CURVE_PERCEPTUAL     1   /* Even steps of perceived brightness */
+
 typedef struct {
    struct   rtimer rt;
    uint8_t  enabled;
    int      percent;
+   uint16_t level;
+   /* Transition, stepped every half cycle by the zero cross handler */
+   uint8_t  fade_curve;
+   uint16_t fade_from;
+   uint16_t fade_to;
+   uint16_t fade_target;
+   uint32_t fade_step;
+   uint32_t fade_steps;        /* 0 when not fading */
 } dimmer_config_t;
 dimmer_config_t dimmer_config[MAX_TRIACS];
 
 extern void dimmer_init(uint8_t ac_frequency);
 extern void dimmer_enable(int triac, int percent);
 extern void dimmer_disable(int triac);
+extern void dimmer_set_all(const int percent[MAX_TRIACS]);
+extern void dimmer_fade(int triac, int percent, uint32_t duration_ms, uint8_t curve);
 
 #endif /* DIMMER_H_ */
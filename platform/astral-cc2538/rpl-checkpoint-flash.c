@@ -0,0 +1,118 @@
+/**
+ * RPL checkpoint storage in the internal flash.
+ *
+ * The checkpoint lives in the last page of the first flash partition,
+ * which OTA update never writes (see OTA_UPDATE_FIRMWARE_MAX_SIZE in
+ * ota-update.c). Each store appends a record to the page, so the page is
+ * erased only once every CHECKPOINT_SLOTS stores. The last programmed
+ * slot holds the current checkpoint.
+ */
+
+#include <string.h>
+#include "contiki.h"
+#include "net/rpl/rpl.h"
+#include "rom.h"
+#include "flash.h"
+
+#define DEBUG 0
+#if DEBUG
+#include <stdio.h>
+#define PRINTF(...)     printf(__VA_ARGS__)
+#else
+#define PRINTF(...)
+#endif
+
+#define FLASH_START_ADDR        0x200000
+#define FLASH_TOTAL_SIZE        (512 * 1024)
+#define FLASH_PAGE_SIZE         2048
+
+#define CHECKPOINT_PAGE_ADDR    (FLASH_START_ADDR + (FLASH_TOTAL_SIZE / 2) - FLASH_PAGE_SIZE)
+
+/* Flash is programmed in 32 bit words. */
+#define CHECKPOINT_SLOT_SIZE    ((sizeof(struct rpl_checkpoint) + 3) & ~3)
+#define CHECKPOINT_SLOTS        (FLASH_PAGE_SIZE / CHECKPOINT_SLOT_SIZE)
+
+#define SLOT_ADDR(n)            (CHECKPOINT_PAGE_ADDR + (n) * CHECKPOINT_SLOT_SIZE)
+/*---------------------------------------------------------------------------*/
+static int
+slot_erased(int slot)
+{
+  const uint32_t *p = (const uint32_t *)SLOT_ADDR(slot);
+  int i;
+
+  for(i = 0; i < CHECKPOINT_SLOT_SIZE / sizeof(uint32_t); i++) {
+    if(p[i] != 0xFFFFFFFF) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns the first erased slot, CHECKPOINT_SLOTS if the page is full. */
+static int
+find_free_slot(void)
+{
+  int slot;
+
+  for(slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+    if(slot_erased(slot)) {
+      break;
+    }
+  }
+  return slot;
+}
+/*---------------------------------------------------------------------------*/
+static int
+load(struct rpl_checkpoint *cp)
+{
+  int slot;
+
+  slot = find_free_slot();
+  if(slot == 0) {
+    return 0;
+  }
+  memcpy(cp, (const void *)SLOT_ADDR(slot - 1), sizeof(*cp));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+store(const struct rpl_checkpoint *cp)
+{
+  static uint32_t buf[CHECKPOINT_SLOT_SIZE / sizeof(uint32_t)];
+  uint32_t cache_mode;
+  int slot;
+  int result;
+
+  memset(buf, 0, sizeof(buf));
+  memcpy(buf, cp, sizeof(*cp));
+
+  /* Foundation firmware code says cache mode might be modified by
+   * page erase and write, so preserve it. */
+  cache_mode = flash_get_cache_mode();
+
+  slot = find_free_slot();
+  if(slot == CHECKPOINT_SLOTS) {
+    PRINTF("Erasing checkpoint page %lx\n", (uint32_t)CHECKPOINT_PAGE_ADDR);
+    result = ROM_PageErase(CHECKPOINT_PAGE_ADDR, FLASH_PAGE_SIZE);
+    if(result) {
+      flash_set_cache_mode(cache_mode);
+      PRINTF("Erase error %d\n", result);
+      return 0;
+    }
+    slot = 0;
+  }
+
+  result = ROM_ProgramFlash(buf, SLOT_ADDR(slot), sizeof(buf));
+  flash_set_cache_mode(cache_mode);
+  if(result || ROM_Memcmp(buf, (void *)SLOT_ADDR(slot), sizeof(buf))) {
+    PRINTF("Checkpoint programming error %d\n", result);
+    return 0;
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+const struct rpl_checkpoint_driver rpl_checkpoint_flash = {
+  "flash",
+  load,
+  store
+};
@@ -27,6 +27,7 @@
 /* Compiler configurations */
 #define CCIF
 #define CLIF
+#define CC_CONF_CAS(ptr, old, new) __sync_bool_compare_and_swap(ptr, old, new)
 
 /* Platform typedefs */
 typedef uint32_t clock_time_t;
@@ -111,11 +111,13 @@
 
 
 /* Network setup for IPv6 */
+#ifndef NETSTACK_CONF_H
 #define NETSTACK_CONF_NETWORK       sicslowpan_driver
 #define NETSTACK_CONF_MAC           csma_driver
 #define NETSTACK_CONF_RDC           nullrdc_driver
 #define NETSTACK_CONF_RADIO         cooja_radio_driver
 #define NETSTACK_CONF_FRAMER        framer_802154
+#endif /* NETSTACK_CONF_H */
 #define UIP_CONF_IPV6               1
 
 #define LINKADDR_CONF_SIZE          8
@@ -185,6 +187,7 @@
 #define CC_CONF_FUNCTION_POINTER_ARGS  1
 #define CC_CONF_FASTCALL
 #define CC_CONF_VA_ARGS                1
+#define CC_CONF_CAS(ptr, old, new)     __sync_bool_compare_and_swap(ptr, old, new)
 #define CC_CONF_INLINE inline
 
 #define CCIF
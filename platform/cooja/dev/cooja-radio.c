@@ -42,6 +42,7 @@
 
 #include "dev/radio.h"
 #include "dev/cooja-radio.h"
+#include "sys/rtimer.h"
 
 #define COOJA_RADIO_BUFSIZE PACKETBUF_SIZE
 #define CCA_SS_THRESHOLD -95
@@ -66,6 +67,10 @@ int simLQI = 105;
 
 static const void *pending_data;
 
+/* The start of the last frame received, for its timestamp */
+static char was_receiving;
+static rtimer_clock_t rx_start_time;
+
 PROCESS(cooja_radio_process, "cooja radio process");
 
 /*---------------------------------------------------------------------------*/
@@ -117,6 +122,12 @@ radio_off(void)
 static void
 doInterfaceActionsBeforeTick(void)
 {
+  /* Cooja wakes the mote when a reception starts */
+  if(simReceiving && !was_receiving) {
+    rx_start_time = RTIMER_NOW();
+  }
+  was_receiving = simReceiving;
+
   if(!simRadioHWOn) {
     simInSize = 0;
     return;
@@ -154,6 +165,7 @@ radio_read(void *buf, unsigned short bufsize)
   simInSize = 0;
   packetbuf_set_attr(PACKETBUF_ATTR_RSSI, simSignalStrength);
   packetbuf_set_attr(PACKETBUF_ATTR_LINK_QUALITY, simLQI);
+  packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, (uint16_t)rx_start_time);
 
   return tmp;
 }
@@ -48,6 +48,7 @@ int select_set_callback(int fd, const struct select_callback *callback);
 #define CC_CONF_FUNCTION_POINTER_ARGS  1
 #define CC_CONF_FASTCALL
 #define CC_CONF_VA_ARGS                1
+#define CC_CONF_CAS(ptr, old, new)     __sync_bool_compare_and_swap(ptr, old, new)
 /*#define CC_CONF_INLINE                 inline*/
 
 #ifndef EEPROM_CONF_SIZE
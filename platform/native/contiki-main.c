@@ -42,6 +42,7 @@
 
 #include "contiki.h"
 #include "net/netstack.h"
+#include "sys/trace.h"
 
 #include "ctk/ctk.h"
 #include "ctk/ctk-curses.h"
@@ -188,6 +189,9 @@ main(int argc, char **argv)
 #endif
 
   process_init();
+#if TRACE_ENABLED
+  trace_init();
+#endif
   process_start(&etimer_process, NULL);
   ctimer_init();
 
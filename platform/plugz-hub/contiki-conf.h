@@ -27,6 +27,7 @@
 /* Compiler configurations */
 #define CCIF
 #define CLIF
+#define CC_CONF_CAS(ptr, old, new) __sync_bool_compare_and_swap(ptr, old, new)
 
 /* Platform typedefs */
 typedef uint32_t clock_time_t;
@@ -103,6 +104,7 @@ typedef uint32_t rtimer_clock_t;
 
 #undef SLIP_ARCH_CONF_UART
 #define SLIP_ARCH_CONF_USB          1 /**< SLIP over USB :) */
+#define SLIP_CONF_ARCH_WRITE        1 /**< slip-arch takes blocks */
 
 #define SLIP_ARCH_CONF_ENABLED      1
 
@@ -218,6 +220,13 @@ typedef uint32_t rtimer_clock_t;
 #define CONTIKIMAC_CONF_WITH_PHASE_OPTIMIZATION 0
 #define WITH_FAST_SLEEP                         1
 
+/* Configure TSCH for when it's selected. The RF driver turns the radio
+   back on after a channel change, TSCH turns it off as needed. */
+#ifndef TSCH_CONF_SET_CHANNEL
+int8_t cc2538_rf_channel_set(uint8_t channel);
+#define TSCH_CONF_SET_CHANNEL(c)                cc2538_rf_channel_set(c)
+#endif
+
 #ifndef NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE
 #define NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE    8
 #endif
@@ -332,11 +341,24 @@ typedef uint32_t rtimer_clock_t;
 #define RPL_CONF_OF rpl_mrhof
 #endif
 
+/* Keep the DAOs of a rebooting network from flooding the radio queue */
+#ifndef RPL_CONF_DAO_ACK
+#define RPL_CONF_DAO_ACK                     1
+#endif
+#ifndef RPL_CONF_DAO_RATE_LIMIT
+#define RPL_CONF_DAO_RATE_LIMIT              4
+#endif
+
+#ifndef RPL_CONF_WITH_6CO
+#define RPL_CONF_WITH_6CO                    1
+#endif
+
 #define UIP_CONF_ND6_REACHABLE_TIME     600000
 #define UIP_CONF_ND6_RETRANS_TIMER       10000
 
 #ifndef NBR_TABLE_CONF_MAX_NEIGHBORS
-#define NBR_TABLE_CONF_MAX_NEIGHBORS                20
+/* 20 neighbors, plus one entry for the CSMA broadcast queue */
+#define NBR_TABLE_CONF_MAX_NEIGHBORS                21
 #endif
 #ifndef UIP_CONF_MAX_ROUTES
 #define UIP_CONF_MAX_ROUTES                 20
@@ -362,8 +384,9 @@ typedef uint32_t rtimer_clock_t;
 #endif
 #define SICSLOWPAN_CONF_MAXAGE               8
 
-/* Define our IPv6 prefixes/contexts here */
-#define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS    1
+/* Define our IPv6 prefixes/contexts here. Context 1 is the prefix
+   delegated to the hub, learnt at runtime from 6CO options in DIOs. */
+#define SICSLOWPAN_CONF_MAX_ADDR_CONTEXTS    2
 #ifndef SICSLOWPAN_CONF_ADDR_CONTEXT_0
 #define SICSLOWPAN_CONF_ADDR_CONTEXT_0 { \
   addr_contexts[0].prefix[0] = 0xaa; \
@@ -376,6 +399,11 @@ typedef uint32_t rtimer_clock_t;
 #ifndef QUEUEBUF_CONF_NUM
 #define QUEUEBUF_CONF_NUM                    8
 #endif
+
+/* Per-class CSMA counters (csma_stats[]), the hub serves many children */
+#ifndef CSMA_CONF_STATS
+#define CSMA_CONF_STATS                      1
+#endif
 /*---------------------------------------------------------------------------*/
 #else /* UIP_CONF_IPV6 */
 /* Network setup for non-IPv6 (rime). */
@@ -0,0 +1,265 @@
+<?xml version="1.0" encoding="UTF-8"?>
+<simconf>
+  <project EXPORT="discard">[APPS_DIR]/mrm</project>
+  <project EXPORT="discard">[APPS_DIR]/mspsim</project>
+  <project EXPORT="discard">[APPS_DIR]/avrora</project>
+  <project EXPORT="discard">[APPS_DIR]/serial_socket</project>
+  <project EXPORT="discard">[APPS_DIR]/collect-view</project>
+  <project EXPORT="discard">[APPS_DIR]/powertracker</project>
+  <simulation>
+    <title>ContikiMAC bulk transfer, burst against no burst</title>
+    <randomseed>123456</randomseed>
+    <motedelay_us>1000000</motedelay_us>
+    <radiomedium>
+      org.contikios.cooja.radiomediums.UDGM
+      <transmitting_range>50.0</transmitting_range>
+      <interference_range>100.0</interference_range>
+      <success_ratio_tx>1.0</success_ratio_tx>
+      <success_ratio_rx>1.0</success_ratio_rx>
+    </radiomedium>
+    <events>
+      <logoutput>40000</logoutput>
+    </events>
+    <motetype>
+      org.contikios.cooja.contikimote.ContikiMoteType
+      <identifier>mtype351</identifier>
+      <description>Bulk transfer with bursts</description>
+      <source>[CONTIKI_DIR]/regression-tests/11-ipv6/code/bulk/bulk-transfer.c</source>
+      <commands>make TARGET=cooja clean
+make bulk-transfer.cooja TARGET=cooja DEFINES=NETSTACK_CONF_H=netstack-contikimac.h,BUFSIZE=500</commands>
+      <moteinterface>org.contikios.cooja.interfaces.Position</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.Battery</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiVib</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiMoteID</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiRS232</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiBeeper</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiIPAddress</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiRadio</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiButton</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiPIR</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiClock</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiLED</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiCFS</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.Mote2MoteRelations</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.RimeAddress</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.MoteAttributes</moteinterface>
+      <symbols>false</symbols>
+    </motetype>
+    <motetype>
+      org.contikios.cooja.contikimote.ContikiMoteType
+      <identifier>mtype352</identifier>
+      <description>Bulk transfer without bursts</description>
+      <source>[CONTIKI_DIR]/regression-tests/11-ipv6/code/bulk/bulk-transfer.c</source>
+      <commands>make TARGET=cooja clean
+make bulk-transfer.cooja TARGET=cooja DEFINES=NETSTACK_CONF_H=netstack-contikimac.h,BUFSIZE=500,CONTIKIMAC_CONF_WITH_BURST=0</commands>
+      <moteinterface>org.contikios.cooja.interfaces.Position</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.Battery</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiVib</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiMoteID</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiRS232</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiBeeper</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiIPAddress</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiRadio</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiButton</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiPIR</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiClock</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiLED</moteinterface>
+      <moteinterface>org.contikios.cooja.contikimote.interfaces.ContikiCFS</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.Mote2MoteRelations</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.RimeAddress</moteinterface>
+      <moteinterface>org.contikios.cooja.interfaces.MoteAttributes</moteinterface>
+      <symbols>false</symbols>
+    </motetype>
+    <mote>
+      <interface_config>
+        org.contikios.cooja.interfaces.Position
+        <x>0.0</x>
+        <y>0.0</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiMoteID
+        <id>1</id>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiRadio
+        <bitrate>250.0</bitrate>
+      </interface_config>
+      <motetype_identifier>mtype351</motetype_identifier>
+    </mote>
+    <mote>
+      <interface_config>
+        org.contikios.cooja.interfaces.Position
+        <x>30.0</x>
+        <y>0.0</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiMoteID
+        <id>2</id>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiRadio
+        <bitrate>250.0</bitrate>
+      </interface_config>
+      <motetype_identifier>mtype351</motetype_identifier>
+    </mote>
+    <mote>
+      <interface_config>
+        org.contikios.cooja.interfaces.Position
+        <x>300.0</x>
+        <y>0.0</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiMoteID
+        <id>3</id>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiRadio
+        <bitrate>250.0</bitrate>
+      </interface_config>
+      <motetype_identifier>mtype352</motetype_identifier>
+    </mote>
+    <mote>
+      <interface_config>
+        org.contikios.cooja.interfaces.Position
+        <x>330.0</x>
+        <y>0.0</y>
+        <z>0.0</z>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiMoteID
+        <id>4</id>
+      </interface_config>
+      <interface_config>
+        org.contikios.cooja.contikimote.interfaces.ContikiRadio
+        <bitrate>250.0</bitrate>
+      </interface_config>
+      <motetype_identifier>mtype352</motetype_identifier>
+    </mote>
+  </simulation>
+  <plugin>
+    org.contikios.cooja.plugins.SimControl
+    <width>248</width>
+    <z>2</z>
+    <height>200</height>
+    <location_x>0</location_x>
+    <location_y>0</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.LogListener
+    <plugin_config>
+      <filter />
+      <formatted_time />
+      <coloring />
+    </plugin_config>
+    <width>851</width>
+    <z>1</z>
+    <height>187</height>
+    <location_x>1</location_x>
+    <location_y>521</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.Visualizer
+    <plugin_config>
+      <skin>org.contikios.cooja.plugins.skins.UDGMVisualizerSkin</skin>
+      <skin>org.contikios.cooja.plugins.skins.IDVisualizerSkin</skin>
+      <skin>org.contikios.cooja.plugins.skins.TrafficVisualizerSkin</skin>
+      <viewport>2.565713585691764 0.0 0.0 2.565713585691764 -91.30090099174814 -28.413835696190525</viewport>
+    </plugin_config>
+    <width>246</width>
+    <z>3</z>
+    <height>121</height>
+    <location_x>1</location_x>
+    <location_y>201</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.RadioLogger
+    <plugin_config>
+      <split>133</split>
+      <formatted_time />
+      <showdups>false</showdups>
+      <hidenodests>false</hidenodests>
+    </plugin_config>
+    <width>246</width>
+    <z>4</z>
+    <height>198</height>
+    <location_x>0</location_x>
+    <location_y>323</location_y>
+  </plugin>
+  <plugin>
+    org.contikios.cooja.plugins.ScriptRunner
+    <plugin_config>
+      <script>/* Two transfers run side by side, out of radio range of each other.&#xD;
+   Node 2 sends 32 blocks of 400 bytes to node 1 with ContikiMAC bursts,&#xD;
+   node 4 sends the same to node 3 with bursts disabled. Each block&#xD;
+   takes several 6LoWPAN fragments. The test fails if the burst transfer&#xD;
+   is not faster than the one without bursts, if it keeps the radio on&#xD;
+   longer, or if a node of the burst pair has a radio duty cycle above&#xD;
+   MAX_DUTY_CYCLE during the transfer. */&#xD;
+TIMEOUT(600000, log.log("Transfer never completed\n"); log.testFailed(); );&#xD;
+&#xD;
+MAX_DUTY_CYCLE = 0.5;&#xD;
+&#xD;
+tracker = mote.getSimulation().getCooja().getStartedPlugin("PowerTracker");&#xD;
+started = false;&#xD;
+ms = [];&#xD;
+ratio = [];&#xD;
+while(true) {&#xD;
+  YIELD();&#xD;
+  if(msg.equals("Transfer started")) {&#xD;
+    if(!started) {&#xD;
+      tracker.reset();&#xD;
+      started = true;&#xD;
+    }&#xD;
+  } else if(msg.startsWith("Transfer done")) {&#xD;
+    data = msg.split(" ");&#xD;
+    ms[id] = parseInt(data[5]);&#xD;
+    log.log("Throughput node " + id + ": " +&#xD;
+            Math.round(parseInt(data[2]) * 8 * 1000 / ms[id]) + " bit/s\n");&#xD;
+    for(i = id - 1; i &lt;= id; i++) {&#xD;
+      ratio[i] = tracker.getMoteTrackerOf(sim.getMoteWithID(i)).getRadioOnRatio();&#xD;
+      log.log("Radio duty cycle node " + i + ": " +&#xD;
+              (100 * ratio[i]).toFixed(2) + " %\n");&#xD;
+    }&#xD;
+    if(ms[2] != undefined &amp;&amp; ms[4] != undefined) {&#xD;
+      break;&#xD;
+    }&#xD;
+  }&#xD;
+}&#xD;
+&#xD;
+if(ms[2] &gt;= ms[4]) {&#xD;
+  log.log("Bursts did not speed up the transfer\n");&#xD;
+  log.testFailed();&#xD;
+}&#xD;
+for(i = 1; i &lt;= 2; i++) {&#xD;
+  if(ratio[i] * ms[2] &gt; ratio[i + 2] * ms[4]) {&#xD;
+    log.log("Node " + i + " kept the radio on longer than without bursts\n");&#xD;
+    log.testFailed();&#xD;
+  }&#xD;
+  if(ratio[i] &gt; MAX_DUTY_CYCLE) {&#xD;
+    log.log("Node " + i + " duty cycle above " + (100 * MAX_DUTY_CYCLE) + " %\n");&#xD;
+    log.testFailed();&#xD;
+  }&#xD;
+}&#xD;
+log.testOK();</script>
+      <active>true</active>
+    </plugin_config>
+    <width>600</width>
+    <z>0</z>
+    <height>520</height>
+    <location_x>250</location_x>
+    <location_y>-1</location_y>
+  </plugin>
+  <plugin>
+    PowerTracker
+    <width>400</width>
+    <z>-1</z>
+    <height>155</height>
+    <location_x>132</location_x>
+    <location_y>152</location_y>
+    <minimized>true</minimized>
+  </plugin>
+</simconf>
+
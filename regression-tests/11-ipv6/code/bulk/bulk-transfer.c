@@ -0,0 +1,103 @@
+/**
+ * Bulk transfer test node.
+ *
+ * Each even node sends BLOCKS blocks of SIZE bytes over UDP to the odd
+ * node before it, node 2 to node 1, node 4 to node 3, one block at a
+ * time, the way a block-wise CoAP transfer or a firmware update does:
+ * each block is sent when the receiver has acknowledged the previous
+ * one. Blocks larger than a frame go out as several 6LoWPAN fragments.
+ * When the transfer is done the sender prints "Transfer done <bytes>
+ * bytes in <ms> ms".
+ */
+
+#include "contiki.h"
+#include "contiki-lib.h"
+#include "contiki-net.h"
+#include "sys/node-id.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define UDP_PORT 61619
+
+#define RETRANSMIT_INTERVAL (2 * CLOCK_SECOND)
+
+#ifndef SIZE
+#define SIZE 400
+#endif
+
+#ifndef BLOCKS
+#define BLOCKS 32
+#endif
+
+static struct simple_udp_connection connection;
+static uint16_t acked;
+
+/*---------------------------------------------------------------------------*/
+PROCESS(bulk_process, "Bulk transfer process");
+AUTOSTART_PROCESSES(&bulk_process);
+/*---------------------------------------------------------------------------*/
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr,
+         uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr,
+         uint16_t receiver_port,
+         const uint8_t *data,
+         uint16_t datalen)
+{
+  uint16_t block;
+
+  if(datalen < 2) {
+    return;
+  }
+  block = (data[0] << 8) | data[1];
+  if(node_id & 1) {
+    /* Acknowledge the block */
+    simple_udp_sendto(c, data, 2, sender_addr);
+  } else if(block == acked) {
+    acked++;
+    process_poll(&bulk_process);
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(bulk_process, ev, data)
+{
+  static struct etimer et;
+  static uint8_t buf[SIZE];
+  static clock_time_t start;
+  uip_ipaddr_t addr;
+
+  PROCESS_BEGIN();
+
+  simple_udp_register(&connection, UDP_PORT, NULL, UDP_PORT, receiver);
+
+  if(node_id & 1) {
+    PROCESS_WAIT_EVENT_UNTIL(0);
+  }
+
+  /* Let the neighbors settle */
+  etimer_set(&et, 10 * CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  /* The link-local address of the receiver, node_id - 1 */
+  uip_ip6addr(&addr, 0xfe80, 0, 0, 0, 0x0200 | (node_id - 1),
+              node_id - 1, node_id - 1, node_id - 1);
+  memset(buf, 0x55, sizeof(buf));
+  printf("Transfer started\n");
+  start = clock_time();
+  acked = 0;
+  while(acked < BLOCKS) {
+    buf[0] = acked >> 8;
+    buf[1] = acked & 0xff;
+    simple_udp_sendto(&connection, buf, sizeof(buf), &addr);
+    etimer_set(&et, RETRANSMIT_INTERVAL);
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL || etimer_expired(&et));
+  }
+  printf("Transfer done %lu bytes in %lu ms\n",
+         (unsigned long)BLOCKS * SIZE,
+         (unsigned long)(clock_time() - start) * 1000 / CLOCK_SECOND);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
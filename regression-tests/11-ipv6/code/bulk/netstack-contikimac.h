@@ -0,0 +1,9 @@
+/*
+ * Cooja network stack for the bulk transfer tests, selected with
+ * DEFINES=NETSTACK_CONF_H=netstack-contikimac.h
+ */
+#define NETSTACK_CONF_NETWORK sicslowpan_driver
+#define NETSTACK_CONF_MAC     csma_driver
+#define NETSTACK_CONF_RDC     contikimac_driver
+#define NETSTACK_CONF_RADIO   cooja_radio_driver
+#define NETSTACK_CONF_FRAMER  framer_802154
@@ -0,0 +1,4 @@
+#ifdef BUFSIZE
+#undef UIP_CONF_BUFFER_SIZE
+#define UIP_CONF_BUFFER_SIZE BUFSIZE
+#endif /* BUFSIZE */
@@ -0,0 +1,21 @@
+/*
+ * Cooja network stack for the TSCH test, selected with
+ * DEFINES=NETSTACK_CONF_H=netstack-tsch.h
+ */
+#define NETSTACK_CONF_NETWORK sicslowpan_driver
+#define NETSTACK_CONF_MAC     csma_driver
+#define NETSTACK_CONF_RDC     tsch_driver
+#define NETSTACK_CONF_RADIO   cooja_radio_driver
+#define NETSTACK_CONF_FRAMER  framer_802154
+
+/* The Cooja radio has no hardware ACKs and takes 2 ms from transmit()
+   to the frame on air, 1 ms for ACKs. Its clock has a 1 ms tick. */
+#define TSCH_CONF_SEND_802154_ACK 1
+#define TSCH_CONF_RADIO_TX_DELAY  2000
+#define TSCH_CONF_TS_ACK_WAIT     4000
+#define TSCH_CONF_TS_RX_GUARD     3000
+#define TSCH_CONF_TS_TX_OFFSET    4000
+#define TSCH_CONF_TS_LENGTH       15000
+#define TSCH_CONF_EB_PERIOD       (4 * CLOCK_SECOND)
+
+#define WITH_TSCH 1
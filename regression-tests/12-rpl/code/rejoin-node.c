@@ -0,0 +1,125 @@
+/**
+ * Rejoin test node.
+ *
+ * Node 1 is the DODAG root and prints "Routes <n>" whenever the size of
+ * its routing table changes. All other nodes are plain RPL routers that
+ * checkpoint their DODAG state into sim_checkpoint. With RPL_CONF_STATS
+ * every node prints its RPL control traffic counters every 10 seconds.
+ * Cooja re-creates the memory of a rebooted mote, so the test script
+ * copies sim_checkpoint over the reboot, which stands in for the flash of
+ * a real node.
+ *
+ * Built for the rejoin test with
+ * DEFINES=RPL_CONF_WITH_CHECKPOINT=1,RPL_CONF_CHECKPOINT_DRIVER=sim_checkpoint_driver
+ *
+ * With DEFINES=NETSTACK_CONF_H=netstack-tsch.h the nodes run TSCH, with
+ * node 1 as the TSCH coordinator.
+ */
+
+#include "contiki.h"
+#include "sys/etimer.h"
+#include "sys/node-id.h"
+#include "net/ip/uip.h"
+#include "net/ipv6/uip-ds6.h"
+#include "net/ip/uip-debug.h"
+#include "net/rpl/rpl-private.h"
+#if WITH_TSCH
+#include "net/mac/tsch/tsch.h"
+#endif /* WITH_TSCH */
+
+#include <stdio.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------------*/
+struct {
+  uint8_t valid;
+  struct rpl_checkpoint cp;
+} sim_checkpoint;
+int sim_checkpoint_size = sizeof(sim_checkpoint);
+/*---------------------------------------------------------------------------*/
+static int
+load(struct rpl_checkpoint *cp)
+{
+  if(!sim_checkpoint.valid) {
+    return 0;
+  }
+  memcpy(cp, &sim_checkpoint.cp, sizeof(*cp));
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+store(const struct rpl_checkpoint *cp)
+{
+  memcpy(&sim_checkpoint.cp, cp, sizeof(*cp));
+  sim_checkpoint.valid = 1;
+  printf("Checkpoint stored\n");
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+const struct rpl_checkpoint_driver sim_checkpoint_driver = {
+  "sim",
+  load,
+  store
+};
+/*---------------------------------------------------------------------------*/
+PROCESS(rejoin_process, "RPL rejoin test process");
+AUTOSTART_PROCESSES(&rejoin_process);
+/*---------------------------------------------------------------------------*/
+static void
+create_rpl_dag(void)
+{
+  uip_ipaddr_t ipaddr;
+  rpl_dag_t *dag;
+
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&ipaddr, &uip_lladdr);
+  uip_ds6_addr_add(&ipaddr, 0, ADDR_AUTOCONF);
+
+  rpl_set_root(RPL_DEFAULT_INSTANCE, &ipaddr);
+  dag = rpl_get_any_dag();
+  uip_ip6addr(&ipaddr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  rpl_set_prefix(dag, &ipaddr, 64);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(rejoin_process, ev, data)
+{
+  static struct etimer et;
+  static int routes;
+#if RPL_CONF_STATS
+  static int seconds;
+#endif /* RPL_CONF_STATS */
+
+  PROCESS_BEGIN();
+
+  if(node_id == 1) {
+#if WITH_TSCH
+    tsch_set_coordinator(1);
+#endif /* WITH_TSCH */
+    create_rpl_dag();
+  }
+  routes = 0;
+#if RPL_CONF_STATS
+  seconds = 0;
+#endif /* RPL_CONF_STATS */
+
+  etimer_set(&et, CLOCK_SECOND);
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    etimer_reset(&et);
+    if(node_id == 1 && uip_ds6_route_num_routes() != routes) {
+      routes = uip_ds6_route_num_routes();
+      printf("Routes %d\n", routes);
+    }
+#if RPL_CONF_STATS
+    if(++seconds % 10 == 0) {
+      printf("Control dao_rexmit %u dao_rejected %u dao_limited %u dis_suppressed %u"
+             " dao_sent %u dis_sent %u\n",
+             rpl_stats.dao_retransmissions, rpl_stats.dao_rejected,
+             rpl_stats.dao_rate_limited, rpl_stats.dis_suppressed,
+             rpl_stats.dao_sent, rpl_stats.dis_sent);
+    }
+#endif /* RPL_CONF_STATS */
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
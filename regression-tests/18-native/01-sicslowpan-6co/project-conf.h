@@ -0,0 +1,7 @@
+/* Frames are captured and injected by the test, below sicslowpan */
+#undef NETSTACK_CONF_MAC
+#define NETSTACK_CONF_MAC           nullmac_driver
+#undef NETSTACK_CONF_RDC
+#define NETSTACK_CONF_RDC           capture_rdc_driver
+
+#define RPL_CONF_WITH_6CO           1
@@ -0,0 +1,356 @@
+/**
+ * 6LoWPAN contexts learnt from 6CO options in DIOs.
+ *
+ * The node hears DIOs from a parent that carry the context 1 for
+ * bbbb::/64 in a 6CO option (RPL option 0x22), aaaa::/64 being the
+ * static context 0. The frames that the node sends are captured below
+ * sicslowpan, and the frames of the parent are injected there, so that
+ * the test sees both the compression and the decompression with the
+ * learnt context:
+ *
+ * - a compressing context (C=1) is used for our packets and passed on
+ *   in our own DIOs,
+ * - a DIO of a neighbor that is not the preferred parent is ignored,
+ * - a decompress-only context (C=0) is no longer used to compress, but
+ *   packets compressed against it are still read,
+ * - a withdrawn context (lifetime 0) is forgotten.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/ip/simple-udp.h"
+#include "net/ipv6/sicslowpan.h"
+#include "net/rpl/rpl-private.h"
+#include "net/mac/mac.h"
+#include "net/packetbuf.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define UDP_PORT 5683
+
+#define UIP_IP_BUF   ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_ICMP_BUF ((struct uip_icmp_hdr *)&uip_buf[UIP_LLIPH_LEN])
+#define UIP_UDP_BUF  ((struct uip_udp_hdr *)&uip_buf[UIP_LLIPH_LEN])
+
+/* As in rpl-icmp6.c */
+#define RPL_DIO_GROUNDED   0x80
+#define RPL_DIO_MOP_SHIFT  3
+
+#define PARENT_MAC  { { 0x00, 0x12, 0x74, 0x01, 0x00, 0x01, 0x01, 0x01 } }
+#define OTHER_MAC   { { 0x00, 0x12, 0x74, 0x02, 0x00, 0x02, 0x02, 0x02 } }
+
+static const linkaddr_t parent_mac = PARENT_MAC;
+static const linkaddr_t other_mac = OTHER_MAC;
+
+/*---------------------------------------------------------------------------*/
+/* The RDC driver keeps the last frame instead of sending it */
+static uint8_t frame[PACKETBUF_SIZE];
+static uint16_t frame_len;
+static uint16_t frames;
+
+static void
+capture_send(mac_callback_t sent, void *ptr)
+{
+  frame_len = packetbuf_datalen();
+  memcpy(frame, packetbuf_dataptr(), frame_len);
+  frames++;
+  mac_call_sent_callback(sent, ptr, MAC_TX_OK, 1);
+}
+static void
+capture_send_list(mac_callback_t sent, void *ptr, struct rdc_buf_list *list)
+{
+  if(list != NULL) {
+    queuebuf_to_packetbuf(list->buf);
+    capture_send(sent, ptr);
+  }
+}
+static void
+capture_input(void)
+{
+  NETSTACK_MAC.input();
+}
+static void
+capture_init(void)
+{
+}
+static int
+capture_on(void)
+{
+  return 0;
+}
+static int
+capture_off(int keep_radio_on)
+{
+  return 0;
+}
+static unsigned short
+capture_channel_check_interval(void)
+{
+  return 0;
+}
+const struct rdc_driver capture_rdc_driver = {
+  "capture",
+  capture_init,
+  capture_send,
+  capture_send_list,
+  capture_input,
+  capture_on,
+  capture_off,
+  capture_channel_check_interval,
+};
+/*---------------------------------------------------------------------------*/
+static struct simple_udp_connection conn;
+static uip_ipaddr_t received_from;
+static char received[16];
+
+static void
+receiver(struct simple_udp_connection *c,
+         const uip_ipaddr_t *sender_addr, uint16_t sender_port,
+         const uip_ipaddr_t *receiver_addr, uint16_t receiver_port,
+         const uint8_t *data, uint16_t datalen)
+{
+  uip_ipaddr_copy(&received_from, sender_addr);
+  if(datalen < sizeof(received)) {
+    memcpy(received, data, datalen);
+    received[datalen] = '\0';
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Hands a 6LoWPAN frame from mac to sicslowpan */
+static void
+inject(const linkaddr_t *mac, const uint8_t *data, uint16_t len)
+{
+  packetbuf_clear();
+  packetbuf_copyfrom(data, len);
+  packetbuf_set_addr(PACKETBUF_ADDR_SENDER, mac);
+  packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, &linkaddr_node_addr);
+  NETSTACK_NETWORK.input();
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_iid(uip_ipaddr_t *addr, const linkaddr_t *mac)
+{
+  memcpy(&addr->u8[8], mac->u8, 8);
+  addr->u8[8] ^= 0x02;
+}
+/*---------------------------------------------------------------------------*/
+/* Sends a DIO of rank 'rank' from 'mac' for the DODAG bbbb::1, carrying
+   a 6CO option for the context 1 = prefix::/64 */
+static void
+inject_dio(const linkaddr_t *mac, uint16_t rank, uint8_t compress,
+           uint16_t lifetime, uint16_t prefix)
+{
+  static uint8_t buf[UIP_BUFSIZE];
+  uint8_t *p;
+  uint16_t len;
+
+  memset(uip_buf, 0, UIP_IPH_LEN + UIP_ICMPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = UIP_PROTO_ICMP6;
+  UIP_IP_BUF->ttl = 255;
+  uip_ip6addr(&UIP_IP_BUF->srcipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  set_iid(&UIP_IP_BUF->srcipaddr, mac);
+  uip_ip6addr(&UIP_IP_BUF->destipaddr, 0xff02, 0, 0, 0, 0, 0, 0, 0x1a);
+  UIP_ICMP_BUF->type = ICMP6_RPL;
+  UIP_ICMP_BUF->icode = RPL_CODE_DIO;
+
+  p = &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + UIP_ICMPH_LEN];
+  /* DIO base: instance, version, rank, G/MOP/Prf, DTSN, flags,
+     reserved, DODAG ID */
+  *p++ = RPL_DEFAULT_INSTANCE;
+  *p++ = 1;
+  *p++ = rank >> 8;
+  *p++ = rank & 0xff;
+  *p++ = RPL_DIO_GROUNDED | RPL_MOP_DEFAULT << RPL_DIO_MOP_SHIFT;
+  *p++ = 240;
+  *p++ = 0;
+  *p++ = 0;
+  memset(p, 0, 16);
+  p[0] = 0xbb;
+  p[1] = 0xbb;
+  p[15] = 1;
+  p += 16;
+  /* Prefix information, autonomous */
+  *p++ = RPL_OPTION_PREFIX_INFO;
+  *p++ = 30;
+  *p++ = 64;
+  *p++ = UIP_ND6_RA_FLAG_AUTONOMOUS;
+  memset(p, 0xff, 8);
+  p += 8;
+  memset(p, 0, 20);
+  p[4] = 0xbb;
+  p[5] = 0xbb;
+  p += 20;
+  /* 6CO: context length, C and CID, reserved, lifetime, prefix */
+  *p++ = RPL_OPTION_6CO;
+  *p++ = SICSLOWPAN_6CO_BODY_LEN;
+  *p++ = 64;
+  *p++ = (compress ? 0x10 : 0) | 1;
+  *p++ = 0;
+  *p++ = 0;
+  *p++ = lifetime >> 8;
+  *p++ = lifetime & 0xff;
+  memset(p, 0, 8);
+  p[0] = prefix >> 8;
+  p[1] = prefix & 0xff;
+  p += 8;
+
+  len = p - &uip_buf[UIP_LLH_LEN];
+  UIP_IP_BUF->len[0] = (len - UIP_IPH_LEN) >> 8;
+  UIP_IP_BUF->len[1] = (len - UIP_IPH_LEN) & 0xff;
+  uip_len = len;
+  uip_ext_len = 0;
+  UIP_ICMP_BUF->icmpchksum = 0;
+  UIP_ICMP_BUF->icmpchksum = ~uip_icmp6chksum();
+
+  /* Uncompressed IPv6 dispatch */
+  buf[0] = SICSLOWPAN_DISPATCH_IPV6;
+  memcpy(&buf[1], &uip_buf[UIP_LLH_LEN], len);
+  uip_len = 0;
+  inject(mac, buf, len + 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends a UDP datagram from the parent's address in bbbb::/64 to ours,
+   with both addresses compressed against context 1 */
+static void
+inject_udp(const char *payload)
+{
+  static uint8_t buf[64];
+  uint16_t plen = strlen(payload);
+  uip_ipaddr_t src, dst;
+  uint8_t *p;
+
+  uip_ip6addr(&src, 0xbbbb, 0, 0, 0, 0, 0, 0, 0);
+  set_iid(&src, &parent_mac);
+  uip_ip6addr(&dst, 0xbbbb, 0, 0, 0, 0, 0, 0, 0);
+  set_iid(&dst, &linkaddr_node_addr);
+
+  /* The checksum is over the uncompressed packet */
+  memset(uip_buf, 0, UIP_IPUDPH_LEN);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  UIP_IP_BUF->len[1] = UIP_UDPH_LEN + plen;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &src);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &dst);
+  UIP_UDP_BUF->srcport = UIP_HTONS(UDP_PORT);
+  UIP_UDP_BUF->destport = UIP_HTONS(UDP_PORT);
+  UIP_UDP_BUF->udplen = UIP_HTONS(UIP_UDPH_LEN + plen);
+  memcpy(&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN], payload, plen);
+  uip_len = UIP_IPUDPH_LEN + plen;
+  uip_ext_len = 0;
+  UIP_UDP_BUF->udpchksum = 0;
+  UIP_UDP_BUF->udpchksum = ~uip_udpchksum();
+
+  /* IPHC: TF elided, next header inline, hop limit 64, SAC/DAC with
+     CID 1 for both, addresses derived from the MAC addresses */
+  p = buf;
+  *p++ = SICSLOWPAN_DISPATCH_IPHC | SICSLOWPAN_IPHC_FL_C |
+    SICSLOWPAN_IPHC_TC_C | SICSLOWPAN_IPHC_TTL_64;
+  *p++ = SICSLOWPAN_IPHC_CID | SICSLOWPAN_IPHC_SAC | SICSLOWPAN_IPHC_SAM_11 |
+    SICSLOWPAN_IPHC_DAC | SICSLOWPAN_IPHC_DAM_11;
+  *p++ = 0x11;
+  *p++ = UIP_PROTO_UDP;
+  memcpy(p, &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], UIP_UDPH_LEN + plen);
+  p += UIP_UDPH_LEN + plen;
+  uip_len = 0;
+
+  memset(&received_from, 0, sizeof(received_from));
+  received[0] = '\0';
+  inject(&parent_mac, buf, p - buf);
+}
+/*---------------------------------------------------------------------------*/
+/* Sends a datagram to the parent's address in bbbb::/64 and tells
+   whether the captured frame compressed the addresses with context 1 */
+static int
+send_compressed(void)
+{
+  uip_ipaddr_t dst;
+  uint16_t before = frames;
+
+  uip_ip6addr(&dst, 0xbbbb, 0, 0, 0, 0, 0, 0, 0);
+  set_iid(&dst, &parent_mac);
+  simple_udp_sendto(&conn, "up", 2, &dst);
+  if(frames == before || (frame[0] & 0xe0) != SICSLOWPAN_DISPATCH_IPHC) {
+    printf("no IPHC frame sent\n");
+    return -1;
+  }
+  return (frame[1] & SICSLOWPAN_IPHC_CID) && frame[2] == 0x11 &&
+    (frame[1] & SICSLOWPAN_IPHC_SAC) && (frame[1] & SICSLOWPAN_IPHC_DAC);
+}
+/*---------------------------------------------------------------------------*/
+/* Tells whether the last frame holds our 6CO for context 1 */
+static int
+frame_has_6co(uint8_t compress)
+{
+  uint16_t i;
+
+  for(i = 0; i + 4 <= frame_len; i++) {
+    if(frame[i] == RPL_OPTION_6CO && frame[i + 1] == SICSLOWPAN_6CO_BODY_LEN &&
+       frame[i + 2] == 64 && frame[i + 3] == ((compress ? 0x10 : 0) | 1)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "6CO test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static struct etimer et;
+  static uip_ipaddr_t expected;
+  rpl_instance_t *instance;
+
+  PROCESS_BEGIN();
+
+  simple_udp_register(&conn, UDP_PORT, NULL, UDP_PORT, receiver);
+  uip_ip6addr(&expected, 0xbbbb, 0, 0, 0, 0, 0, 0, 0);
+  set_iid(&expected, &parent_mac);
+
+  /* Join through the parent, which announces a compressing context */
+  inject_dio(&parent_mac, 256, 1, 60, 0xbbbb);
+  etimer_set(&et, CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  instance = rpl_get_instance(RPL_DEFAULT_INSTANCE);
+  TEST_CHECK(instance != NULL && instance->current_dag != NULL &&
+             instance->current_dag->preferred_parent != NULL,
+             "joined the DODAG of the parent");
+  TEST_CHECK(send_compressed() == 1, "compress with the learnt context");
+
+  inject_udp("down");
+  TEST_CHECK(uip_ipaddr_cmp(&received_from, &expected) &&
+             strcmp(received, "down") == 0,
+             "decompress with the learnt context");
+
+  dio_output(instance, NULL);
+  TEST_CHECK(frame_has_6co(1), "pass the context on in our DIOs");
+
+  /* Another neighbor, not our preferred parent, has another idea */
+  inject_dio(&other_mac, 1024, 1, 60, 0xcccc);
+  TEST_CHECK(send_compressed() == 1, "ignore the 6CO of other neighbors");
+
+  /* Decompress only */
+  inject_dio(&parent_mac, 256, 0, 60, 0xbbbb);
+  TEST_CHECK(send_compressed() == 0, "no compression with C=0");
+  inject_udp("late");
+  TEST_CHECK(uip_ipaddr_cmp(&received_from, &expected) &&
+             strcmp(received, "late") == 0,
+             "decompression with C=0");
+  dio_output(instance, NULL);
+  TEST_CHECK(frame_has_6co(0), "pass C=0 on in our DIOs");
+
+  /* Withdrawn */
+  inject_dio(&parent_mac, 256, 0, 0, 0xbbbb);
+  inject_udp("gone");
+  TEST_CHECK(received[0] == '\0', "withdrawn context forgotten");
+  TEST_CHECK(send_compressed() == 0, "no compression once withdrawn");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,279 @@
+/**
+ * CoAP transactions and observers in the shared pool.
+ *
+ * The pool of er-coap-13-pool.c holds four transactions and three
+ * observers (project-conf.h). The test drives the transaction layer
+ * directly, the messages go out through the null radio:
+ *
+ * - pool memory is handed out zeroed, whatever held it before,
+ * - observers are refused once they would take the room of the last
+ *   transaction, which is still available,
+ * - transactions and observers allocated in turn reuse freed space,
+ * - at most one CON per peer is outstanding (NSTART), the others are
+ *   queued until the ACK, without holding back other peers,
+ * - the CON released by an ACK is sent after the callback of that ACK,
+ *   which still finds its own message in uip_buf,
+ * - a CON notification queued behind a CON is updated in place,
+ * - the RTO of a peer follows its RTT, unknown peers start from
+ *   COAP_RESPONSE_TIMEOUT.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "er-coap-13-transactions.h"
+#include "er-coap-13-observing.h"
+#include "er-coap-13-pool.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define PEER_PORT UIP_HTONS(COAP_DEFAULT_PORT)
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+static const char ack_payload[] = "payload of the ACK";
+static int ack_seen;
+
+static uip_ipaddr_t peer_a, peer_b, peer_c, peer_d;
+static const char url[] = "obs";
+static const uint8_t token[] = { 0x12, 0x34 };
+static resource_t resource;
+
+/*---------------------------------------------------------------------------*/
+static coap_transaction_t *
+send_con_payload(uip_ipaddr_t *addr, uint16_t mid, const char *payload)
+{
+  coap_transaction_t *t;
+  coap_packet_t request[1];
+
+  t = coap_new_transaction(mid, addr, PEER_PORT);
+  if(t != NULL) {
+    coap_init_message(request, COAP_TYPE_CON, COAP_GET, mid);
+    if(payload != NULL) {
+      coap_set_payload(request, payload, strlen(payload));
+    }
+    t->packet_len = coap_serialize_message(request, t->packet);
+    coap_send_transaction(t);
+  }
+  return t;
+}
+/*---------------------------------------------------------------------------*/
+static coap_transaction_t *
+send_con(uip_ipaddr_t *addr, uint16_t mid)
+{
+  return send_con_payload(addr, mid, NULL);
+}
+/*---------------------------------------------------------------------------*/
+/* Hands an ACK with a payload from addr to the engine, as uIP would */
+static void
+receive_ack(uip_ipaddr_t *addr, uint16_t mid)
+{
+  coap_packet_t ack[1];
+
+  coap_init_message(ack, COAP_TYPE_ACK, CONTENT_2_05, mid);
+  coap_set_payload(ack, ack_payload, strlen(ack_payload));
+  uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN];
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, addr);
+  uip_ip6addr(&UIP_IP_BUF->destipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 1);
+  UIP_UDP_BUF->srcport = PEER_PORT;
+  uip_len = coap_serialize_message(ack, uip_appdata);
+  uip_flags = UIP_NEWDATA;
+  process_post_synch(&coap_receiver, tcpip_event, NULL);
+  uip_flags = 0;
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ack_callback(void *data, void *response)
+{
+  const uint8_t *payload;
+  int len;
+
+  len = coap_get_payload(response, &payload);
+  ack_seen = response != NULL && len == strlen(ack_payload) &&
+    memcmp(payload, ack_payload, len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+notify(const char *payload)
+{
+  coap_packet_t notification[1];
+
+  coap_init_message(notification, COAP_TYPE_CON, CONTENT_2_05, 0);
+  coap_set_payload(notification, payload, strlen(payload));
+  coap_notify_observers(&resource, 1, notification);
+}
+/*---------------------------------------------------------------------------*/
+static int
+transaction_state(uint16_t mid)
+{
+  coap_transaction_t *t = coap_get_transaction_by_mid(mid);
+
+  return t == NULL ? -1 : t->state;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "CoAP pool test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static struct etimer et;
+  static coap_transaction_t *t[6];
+  static coap_observer_t *obs;
+  static uint16_t observers, failed, used, mid;
+  static int i;
+  void *p;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+  resource.url = url;
+  uip_ip6addr(&peer_a, 0xfe80, 0, 0, 0, 0, 0, 0, 2);
+  uip_ip6addr(&peer_b, 0xfe80, 0, 0, 0, 0, 0, 0, 3);
+  uip_ip6addr(&peer_c, 0xfe80, 0, 0, 0, 0, 0, 0, 4);
+  uip_ip6addr(&peer_d, 0xfe80, 0, 0, 0, 0, 0, 0, 5);
+
+  /* A transaction in memory left dirty by a previous user */
+  p = coap_pool_alloc(sizeof(coap_transaction_t), 0);
+  memset(p, 0xa5, sizeof(coap_transaction_t));
+  coap_pool_free(p, sizeof(coap_transaction_t));
+  t[0] = coap_new_transaction(1, &peer_a, PEER_PORT);
+  TEST_CHECK(t[0] == p && t[0]->retrans_timer.p == NULL &&
+             t[0]->retrans_timer.next == NULL && t[0]->backoff == 0 &&
+             t[0]->start == 0 && t[0]->packet_len == 0,
+             "pool memory zeroed");
+  coap_clear_transaction(t[0]);
+
+  /* Observers up to the reserve of one transaction */
+  failed = coap_pool_stats.failed;
+  for(observers = 0; observers < 64; observers++) {
+    if(coap_add_observer(&peer_b, 1000 + observers, token, sizeof(token),
+                         url) == NULL) {
+      break;
+    }
+  }
+  printf("%u observers, pool %u/%u bytes\n", observers,
+         coap_pool_stats.used, coap_pool_stats.size);
+  TEST_CHECK(observers > COAP_MAX_OBSERVERS,
+             "observers use the room of idle transactions");
+  TEST_CHECK(coap_pool_stats.failed == failed + 1, "refusal counted");
+  t[0] = coap_new_transaction(2, &peer_a, PEER_PORT);
+  TEST_CHECK(t[0] != NULL, "room for a transaction once observers are refused");
+  TEST_CHECK(coap_add_observer(&peer_b, 999, token, sizeof(token), url) == NULL,
+             "no observer over the transaction");
+  coap_clear_transaction(t[0]);
+  /* The removal loops stop at the first match, one port at a time */
+  for(i = 0; i < observers; i++) {
+    coap_remove_observer_by_client(&peer_b, 1000 + i);
+  }
+  TEST_CHECK(coap_pool_stats.used == 0, "all freed");
+
+  /* Transactions and observers in turn */
+  observers = 0;
+  observers += coap_add_observer(&peer_b, 1, token, sizeof(token), url) != NULL;
+  t[0] = coap_new_transaction(3, &peer_a, PEER_PORT);
+  observers += coap_add_observer(&peer_b, 2, token, sizeof(token), url) != NULL;
+  t[1] = coap_new_transaction(4, &peer_a, PEER_PORT);
+  observers += coap_add_observer(&peer_b, 3, token, sizeof(token), url) != NULL;
+  t[2] = coap_new_transaction(5, &peer_a, PEER_PORT);
+  t[3] = coap_new_transaction(6, &peer_a, PEER_PORT);
+  TEST_CHECK(t[0] && t[1] && t[2] && t[3] && observers == 3,
+             "configured transactions and observers fit in turn");
+  coap_remove_observer_by_client(&peer_b, 2);
+  coap_clear_transaction(t[1]);
+  coap_clear_transaction(t[0]);
+  t[4] = coap_new_transaction(7, &peer_a, PEER_PORT);
+  t[5] = coap_new_transaction(8, &peer_a, PEER_PORT);
+  TEST_CHECK(t[4] && t[5], "freed transactions reused");
+  for(i = 2; i < 6; i++) {
+    coap_clear_transaction(t[i]);
+  }
+  coap_remove_observer_by_client(&peer_b, 1);
+  coap_remove_observer_by_client(&peer_b, 3);
+  TEST_CHECK(coap_pool_stats.used == 0 &&
+             coap_pool_stats.max_used <= coap_pool_stats.size,
+             "all freed, peak within the pool");
+
+  /* NSTART */
+  send_con(&peer_a, 101);
+  send_con(&peer_a, 102);
+  send_con(&peer_a, 103);
+  send_con(&peer_b, 201);
+  TEST_CHECK(transaction_state(101) == COAP_TRANSACTION_OUTSTANDING &&
+             transaction_state(102) == COAP_TRANSACTION_QUEUED &&
+             transaction_state(103) == COAP_TRANSACTION_QUEUED,
+             "one CON outstanding per peer");
+  TEST_CHECK(transaction_state(201) == COAP_TRANSACTION_OUTSTANDING,
+             "other peers not held back");
+  coap_complete_transaction(coap_get_transaction_by_mid(101));
+  PROCESS_PAUSE();
+  TEST_CHECK(transaction_state(102) == COAP_TRANSACTION_OUTSTANDING &&
+             transaction_state(103) == COAP_TRANSACTION_QUEUED,
+             "the ACK releases the next CON");
+  coap_complete_transaction(coap_get_transaction_by_mid(102));
+  coap_complete_transaction(coap_get_transaction_by_mid(103));
+  coap_complete_transaction(coap_get_transaction_by_mid(201));
+  TEST_CHECK(coap_pool_stats.used == 0, "all completed");
+
+  /* The callback of an ACK, with a CON queued behind it */
+  t[0] = send_con(&peer_a, 151);
+  t[0]->callback = ack_callback;
+  send_con_payload(&peer_a, 152, "a queued CON large enough to cover the ACK");
+  receive_ack(&peer_a, 151);
+  TEST_CHECK(ack_seen, "callback finds its own ACK in uip_buf");
+  TEST_CHECK(transaction_state(151) == -1 &&
+             transaction_state(152) == COAP_TRANSACTION_QUEUED,
+             "released CON waits for the transaction handler");
+  PROCESS_PAUSE();
+  TEST_CHECK(transaction_state(152) == COAP_TRANSACTION_OUTSTANDING,
+             "released CON sent after the callback");
+  coap_complete_transaction(coap_get_transaction_by_mid(152));
+  TEST_CHECK(coap_pool_stats.used == 0, "all completed");
+
+  /* A notification behind a CON to the same observer */
+  obs = coap_add_observer(&peer_a, PEER_PORT, token, sizeof(token), url);
+  send_con(&peer_a, 301);
+  notify("1");
+  mid = obs->last_mid;
+  used = coap_pool_stats.used;
+  TEST_CHECK(transaction_state(mid) == COAP_TRANSACTION_QUEUED,
+             "notification queued behind a CON");
+  notify("2");
+  t[0] = coap_get_transaction_by_mid(mid);
+  TEST_CHECK(obs->last_mid == mid && coap_pool_stats.used == used &&
+             t[0] != NULL && t[0]->packet[t[0]->packet_len - 1] == '2',
+             "queued notification updated in place");
+  coap_complete_transaction(coap_get_transaction_by_mid(301));
+  PROCESS_PAUSE();
+  TEST_CHECK(transaction_state(mid) == COAP_TRANSACTION_OUTSTANDING,
+             "notification sent after the ACK");
+  coap_complete_transaction(t[0]);
+  coap_remove_observer(obs);
+  TEST_CHECK(coap_pool_stats.used == 0, "all freed");
+
+  /* RTO of a peer answering in 200 ms */
+  for(i = 0; i < 10; i++) {
+    t[0] = send_con(&peer_c, 400 + i);
+    etimer_set(&et, CLOCK_SECOND / 5);
+    PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+    coap_complete_transaction(t[0]);
+  }
+  printf("RTO %lu ms\n",
+         (unsigned long)(coap_get_peer_rto(&peer_c, PEER_PORT) * 1000 /
+                         CLOCK_SECOND));
+  TEST_CHECK(coap_get_peer_rto(&peer_c, PEER_PORT) >= CLOCK_SECOND / 2 &&
+             coap_get_peer_rto(&peer_c, PEER_PORT) < CLOCK_SECOND,
+             "RTO follows the RTT down to its floor");
+  TEST_CHECK(coap_get_peer_rto(&peer_d, PEER_PORT) ==
+             CLOCK_SECOND * COAP_RESPONSE_TIMEOUT,
+             "unknown peer starts from COAP_RESPONSE_TIMEOUT");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
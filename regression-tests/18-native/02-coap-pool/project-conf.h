@@ -0,0 +1,5 @@
+/* Pool for four transactions and three observers */
+#define COAP_MAX_OPEN_TRANSACTIONS  4
+#define COAP_MAX_OBSERVERS          3
+
+#define REST_MAX_CHUNK_SIZE         64
@@ -0,0 +1,391 @@
+/**
+ * Bursty uplink through the slip-bridge of the uHub.
+ *
+ * The SLIP driver is replaced by a model of the transport of the hub, in
+ * simulated time:
+ *
+ * - the cc2538 UART0 ring, 1024 bytes drained at 115200 baud,
+ * - or, built with SLIP_ARCH_CONF_USB (11-slip-bridge-usb), the two bulk
+ *   transfers of usb-serial, each taken by a loaded host at one 64 byte
+ *   packet every other frame.
+ *
+ * A write that does not fit blocks the stack until there is room, as
+ * slip_arch_write() does on the hub. The drained callback comes when half
+ * of the ring is free, or when the host has taken a transfer.
+ *
+ * The load is 50 bursts of 16 packets from the radio, one every 2 ms,
+ * a fifth of them ICMPv6, with 100 ms of quiet between the bursts. The
+ * radio holds a single frame: a packet is lost when the previous one is
+ * still being handed to SLIP after 2 ms.
+ *
+ * The run sending every packet at once is the baseline. With the queues
+ * of slip-bridge, the stack must not stall, no control packet may be
+ * dropped, more packets must reach the host and control must go out
+ * ahead of data.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "dev/slip.h"
+#include "lib/random.h"
+#include "slip-bridge.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define UIP_IP_BUF      ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#if SLIP_ARCH_CONF_USB
+#define TRANSFER        USB_SERIAL_CONF_TX_BUF_SIZE
+#define USB_PACKET      64
+#define USB_PACKET_US   2000
+#else
+#define RING            1024    /* UART0 TX ring of the hub */
+#define BYTE_US         87      /* 115200 baud */
+#endif
+
+#define BURSTS          50
+#define BURST_LEN       16
+#define PACKET_US       2000    /* Between two packets of a burst */
+#define QUIET_US        100000  /* Between two bursts */
+#define STACK_US        300     /* Work of the stack per packet */
+
+extern const struct uip_fallback_interface rpl_interface;
+
+struct result {
+  unsigned long stalled;
+  uint16_t radio_lost;
+  uint16_t delivered[2];
+  unsigned long latency[2];
+};
+
+static struct result results[2];
+static struct result *result;
+static uint8_t direct;
+
+static unsigned long now;
+static void (*tx_callback)(void);
+
+static unsigned long sent_at[BURSTS * BURST_LEN];
+
+#if SLIP_ARCH_CONF_USB
+/* The two transfers, filled in turn, and when the host has taken them */
+static uint16_t filled[2];
+static uint8_t submitted[2];
+static unsigned long taken_at[2];
+static uint8_t current;
+/*---------------------------------------------------------------------------*/
+static void
+transport_reset(void)
+{
+  filled[0] = filled[1] = 0;
+  submitted[0] = submitted[1] = 0;
+  current = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The host takes the transfers in order, one USB packet at a time */
+static void
+advance(void)
+{
+  uint8_t i;
+
+  for(i = 0; i < 2; i++) {
+    if(submitted[i] && taken_at[i] <= now) {
+      submitted[i] = 0;
+      filled[i] = 0;
+      if(tx_callback != NULL) {
+        tx_callback();
+      }
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+submit(void)
+{
+  unsigned long start = now;
+
+  if(submitted[current ^ 1] && taken_at[current ^ 1] > start) {
+    start = taken_at[current ^ 1];
+  }
+  taken_at[current] = start +
+    (filled[current] + USB_PACKET - 1) / USB_PACKET * USB_PACKET_US;
+  submitted[current] = 1;
+  current ^= 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns when the last byte reaches the host */
+static unsigned long
+transport_put(uint16_t len)
+{
+  unsigned long wait;
+  uint16_t n;
+
+  advance();
+  while(len > 0) {
+    if(submitted[current]) {
+      wait = taken_at[current] - now;
+      now += wait;
+      result->stalled += wait;
+      advance();
+    }
+    n = len < TRANSFER - filled[current] ? len : TRANSFER - filled[current];
+    filled[current] += n;
+    len -= n;
+    if(filled[current] == TRANSFER) {
+      submit();
+    }
+  }
+  /* Flushed at the END */
+  if(filled[current] > 0) {
+    submit();
+  }
+  return taken_at[current ^ 1];
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+transport_space(void)
+{
+  uint16_t space = 0;
+
+  advance();
+  if(!submitted[current]) {
+    space = TRANSFER - filled[current];
+    if(!submitted[current ^ 1]) {
+      space += TRANSFER;
+    }
+  }
+  return space;
+}
+#else /* SLIP_ARCH_CONF_USB */
+static unsigned long drained_at;
+static uint16_t ring_used;
+static uint8_t low;
+/*---------------------------------------------------------------------------*/
+static void
+transport_reset(void)
+{
+  drained_at = 0;
+  ring_used = 0;
+  low = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The ring drains at line rate */
+static void
+advance(void)
+{
+  unsigned long n;
+
+  n = (now - drained_at) / BYTE_US;
+  if(n >= ring_used) {
+    ring_used = 0;
+    drained_at = now;
+  } else {
+    ring_used -= n;
+    drained_at += n * BYTE_US;
+  }
+  if(low && RING - ring_used >= RING / 2) {
+    low = 0;
+    if(tx_callback != NULL) {
+      tx_callback();
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Returns when the last byte is on the line */
+static unsigned long
+transport_put(uint16_t len)
+{
+  unsigned long wait;
+
+  advance();
+  while(ring_used + len > RING) {
+    wait = (unsigned long)(ring_used + len - RING) * BYTE_US;
+    now += wait;
+    result->stalled += wait;
+    advance();
+  }
+  ring_used += len;
+  if(RING - ring_used < RING / 2) {
+    low = 1;
+  }
+  return now + ring_used * BYTE_US;
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+transport_space(void)
+{
+  advance();
+  return RING - ring_used;
+}
+#endif /* SLIP_ARCH_CONF_USB */
+/*---------------------------------------------------------------------------*/
+/* A packet handed to SLIP, the sequence number follows the IPv6 header */
+static void
+deliver(const uint8_t *packet, uint16_t len)
+{
+  uint16_t seq;
+  uint8_t class;
+
+  seq = (packet[UIP_IPH_LEN] << 8) | packet[UIP_IPH_LEN + 1];
+  class = ((struct uip_ip_hdr *)packet)->proto == UIP_PROTO_ICMP6 ?
+    SLIP_BRIDGE_CONTROL : SLIP_BRIDGE_DATA;
+  /* The two ENDs, the payload has no escapes */
+  result->latency[class] += transport_put(len + 2) - sent_at[seq];
+  result->delivered[class]++;
+}
+/*---------------------------------------------------------------------------*/
+/* The SLIP driver and its architecture part */
+PROCESS(slip_process, "SLIP driver");
+PROCESS_THREAD(slip_process, ev, data)
+{
+  PROCESS_BEGIN();
+  PROCESS_END();
+}
+uint8_t
+slip_send(void)
+{
+  deliver(&uip_buf[UIP_LLH_LEN], uip_len);
+  return 0;
+}
+uint8_t
+slip_write(const void *ptr, int len)
+{
+  deliver(ptr, len);
+  return 0;
+}
+void
+slip_set_input_callback(void (*callback)(void))
+{
+}
+void
+slip_arch_init(unsigned long ubr)
+{
+}
+void
+slip_arch_set_baud_rate(unsigned long baud)
+{
+}
+uint16_t
+slip_arch_tx_space(void)
+{
+  /* Sending at once whatever the room is the baseline */
+  return direct ? 0xffff : transport_space();
+}
+void
+slip_arch_set_tx_callback(void (*callback)(void))
+{
+  tx_callback = callback;
+}
+/* Used by the bridge for !P */
+void
+set_prefix_64(uip_ipaddr_t *prefix)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+radio_input(uint16_t seq, uint8_t control)
+{
+  uip_len = control ? 80 : 48 + random_rand() % 160;
+  memset(&uip_buf[UIP_LLH_LEN], 0x55, uip_len);
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->proto = control ? UIP_PROTO_ICMP6 : UIP_PROTO_UDP;
+  uip_buf[UIP_LLH_LEN + UIP_IPH_LEN] = seq >> 8;
+  uip_buf[UIP_LLH_LEN + UIP_IPH_LEN + 1] = seq & 0xff;
+  uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+  rpl_interface.output();
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Mean latency of a class, in us */
+static unsigned long
+latency(struct result *r, uint8_t class)
+{
+  return r->delivered[class] ? r->latency[class] / r->delivered[class] : 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_result(const char *name)
+{
+  printf("%s: stalled %lu ms, radio lost %u, delivered %u control %u data,"
+         " latency %lu ms control %lu ms data, dropped %u control %u data\n",
+         name, result->stalled / 1000, result->radio_lost,
+         result->delivered[SLIP_BRIDGE_CONTROL],
+         result->delivered[SLIP_BRIDGE_DATA],
+         latency(result, SLIP_BRIDGE_CONTROL) / 1000,
+         latency(result, SLIP_BRIDGE_DATA) / 1000,
+         slip_bridge_stats.dropped[SLIP_BRIDGE_CONTROL],
+         slip_bridge_stats.dropped[SLIP_BRIDGE_DATA]);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "slip-bridge load test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static int run, burst, i;
+  static unsigned long t;
+  static uint16_t seq;
+  static uint16_t control_dropped;
+  uint8_t control;
+
+  PROCESS_BEGIN();
+
+  rpl_interface.init();
+
+  for(run = 0; run < 2; run++) {
+    direct = run == 0;
+    result = &results[run];
+    now = 0;
+    transport_reset();
+    memset(&slip_bridge_stats, 0, sizeof(slip_bridge_stats));
+    random_init(1);
+
+    t = 0;
+    seq = 0;
+    for(burst = 0; burst < BURSTS; burst++) {
+      for(i = 0; i < BURST_LEN; i++, t += PACKET_US) {
+        control = random_rand() % 5 == 0;
+        if(now > t + PACKET_US) {
+          result->radio_lost++;
+          continue;
+        }
+        if(now < t) {
+          now = t;
+          advance();
+        }
+        sent_at[seq] = t;
+        radio_input(seq++, control);
+        now += STACK_US;
+        /* Let the bridge drain its queues */
+        PROCESS_PAUSE();
+      }
+      t += QUIET_US;
+      while(now < t) {
+        now += 1000;
+        advance();
+        PROCESS_PAUSE();
+      }
+    }
+    print_result(direct ? "direct" : "queued");
+    control_dropped = slip_bridge_stats.dropped[SLIP_BRIDGE_CONTROL];
+  }
+
+  TEST_CHECK(results[0].stalled > 0, "direct sending stalls the stack");
+  TEST_CHECK(results[1].stalled == 0, "no stall with the queues");
+  TEST_CHECK(results[1].radio_lost == 0, "no packet lost at the radio");
+  TEST_CHECK(control_dropped == 0, "no control packet dropped");
+  TEST_CHECK(results[1].delivered[SLIP_BRIDGE_CONTROL] +
+             results[1].delivered[SLIP_BRIDGE_DATA] >
+             results[0].delivered[SLIP_BRIDGE_CONTROL] +
+             results[0].delivered[SLIP_BRIDGE_DATA],
+             "more packets reach the host");
+  TEST_CHECK(latency(&results[1], SLIP_BRIDGE_CONTROL) <
+             latency(&results[1], SLIP_BRIDGE_DATA),
+             "control ahead of data");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
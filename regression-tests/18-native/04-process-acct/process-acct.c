@@ -0,0 +1,190 @@
+/**
+ * Run time and queueing delay of the processes (PROCESS_CONF_ACCOUNTING).
+ *
+ * Three workers spin for a known time per event: worker_a 1000 us,
+ * worker_b 200 us and then calls worker_c synchronously, which spins for
+ * 500 us. Ten events are posted to a and b at once, in turn, so the
+ * k-th event of a waits for k runs of a and b before it, and the k-th of
+ * b for one more run of a. A poll of worker_d waits for 500 us spun by
+ * the test process after the request.
+ *
+ * The figures must match within the scheduling noise of a Linux
+ * process: at least the time spun, at most half as much again. The host
+ * can only add time, so a run it slowed down is repeated, up to
+ * ATTEMPTS runs.
+ */
+
+#include "contiki.h"
+#include "sys/trace.h"
+#include "native-test.h"
+
+#define EVENTS  10
+#define A_US    1000
+#define B_US    200
+#define C_US    500
+#define POLL_US 500
+
+#define ATTEMPTS 5
+
+/* Within [expected, 1.5 * expected] */
+#define ABOUT(v, expected) ((v) >= (expected) && (v) <= (expected) * 3 / 2)
+
+#define US(field) process_acct_us(field)
+
+static struct process_acct *a, *b, *c, *d;
+
+/*---------------------------------------------------------------------------*/
+static void
+print_acct(struct process *p)
+{
+  printf("%s: calls %lu run %lu us max %lu us, events %lu wait %lu us"
+         " max %lu us\n", PROCESS_NAME_STRING(p),
+         (unsigned long)p->acct.calls, (unsigned long)US(p->acct.time),
+         (unsigned long)US(p->acct.max_time),
+         (unsigned long)p->acct.events, (unsigned long)US(p->acct.wait),
+         (unsigned long)US(p->acct.max_wait));
+}
+/*---------------------------------------------------------------------------*/
+static void
+spin(uint32_t us)
+{
+  uint32_t start = trace_arch_now();
+
+  while(trace_arch_now() - start < us);
+}
+/*---------------------------------------------------------------------------*/
+/* All the checks below at once */
+static int
+run_ok(void)
+{
+  uint32_t round = A_US + B_US + C_US;
+
+  return a->calls == EVENTS && a->events == EVENTS &&
+    ABOUT(US(a->time), EVENTS * A_US) && ABOUT(US(a->max_time), A_US) &&
+    b->calls == EVENTS && ABOUT(US(b->time), EVENTS * B_US) &&
+    c->calls == EVENTS && c->events == 0 &&
+    ABOUT(US(c->time), EVENTS * C_US) &&
+    ABOUT(US(a->wait), round * EVENTS * (EVENTS - 1) / 2) &&
+    ABOUT(US(a->max_wait), round * (EVENTS - 1)) &&
+    ABOUT(US(b->wait), round * EVENTS * (EVENTS - 1) / 2 + EVENTS * A_US) &&
+    ABOUT(US(b->max_wait), round * (EVENTS - 1) + A_US) &&
+    d->events == 1 && ABOUT(US(d->wait), POLL_US);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(worker_a, "Worker a");
+PROCESS(worker_b, "Worker b");
+PROCESS(worker_c, "Worker c");
+PROCESS(worker_d, "Worker d");
+PROCESS(test_process, "Accounting test");
+AUTOSTART_PROCESSES(&worker_a, &worker_b, &worker_c, &worker_d,
+                    &test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(worker_a, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    spin(A_US);
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(worker_b, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    spin(B_US);
+    process_post_synch(&worker_c, PROCESS_EVENT_CONTINUE, NULL);
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(worker_c, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    spin(C_US);
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(worker_d, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_WAIT_EVENT();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static int i, attempt;
+  uint32_t round;
+
+  PROCESS_BEGIN();
+
+  a = &worker_a.acct;
+  b = &worker_b.acct;
+  c = &worker_c.acct;
+  d = &worker_d.acct;
+
+  /* Let the other processes settle */
+  PROCESS_PAUSE();
+  process_acct_reset();
+  TEST_CHECK(worker_a.acct.calls == 0 && worker_a.acct.events == 0 &&
+             worker_a.acct.time == 0, "counters cleared");
+
+  for(attempt = 1; attempt <= ATTEMPTS; attempt++) {
+    process_acct_reset();
+    for(i = 0; i < EVENTS; i++) {
+      process_post(&worker_a, PROCESS_EVENT_CONTINUE, NULL);
+      process_post(&worker_b, PROCESS_EVENT_CONTINUE, NULL);
+    }
+    /* Back after the workers */
+    PROCESS_PAUSE();
+
+    process_poll(&worker_d);
+    spin(POLL_US);
+    PROCESS_PAUSE();
+
+    if(run_ok()) {
+      break;
+    }
+    printf("run %d off, again\n", attempt);
+  }
+
+  print_acct(&worker_a);
+  print_acct(&worker_b);
+  print_acct(&worker_c);
+  print_acct(&worker_d);
+
+  TEST_CHECK(a->calls == EVENTS && a->events == EVENTS,
+             "a: one call per event");
+  TEST_CHECK(ABOUT(US(a->time), EVENTS * A_US) &&
+             ABOUT(US(a->max_time), A_US), "a: run time");
+  TEST_CHECK(b->calls == EVENTS && ABOUT(US(b->time), EVENTS * B_US),
+             "b: run time without the synchronous calls");
+  TEST_CHECK(c->calls == EVENTS && c->events == 0 &&
+             ABOUT(US(c->time), EVENTS * C_US),
+             "c: synchronous calls counted, not as events");
+
+  /* The k-th events wait for k rounds of a, b and c */
+  round = A_US + B_US + C_US;
+  TEST_CHECK(ABOUT(US(a->wait), round * EVENTS * (EVENTS - 1) / 2) &&
+             ABOUT(US(a->max_wait), round * (EVENTS - 1)),
+             "a: queueing delay");
+  TEST_CHECK(ABOUT(US(b->wait), round * EVENTS * (EVENTS - 1) / 2 +
+                   EVENTS * A_US) &&
+             ABOUT(US(b->max_wait), round * (EVENTS - 1) + A_US),
+             "b: queueing delay");
+  TEST_CHECK(d->events == 1 && ABOUT(US(d->wait), POLL_US),
+             "d: poll delay");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
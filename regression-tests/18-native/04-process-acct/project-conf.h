@@ -0,0 +1 @@
+#define PROCESS_CONF_ACCOUNTING     1
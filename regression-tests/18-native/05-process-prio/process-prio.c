@@ -0,0 +1,168 @@
+/**
+ * Event and poll priorities of the process kernel.
+ *
+ * worker_h runs at PROCESS_PRIO_HIGH, worker_n at the default priority.
+ * The workers log the events and polls they get, one letter each:
+ *
+ * - high priority events go ahead of the normal ones, those that do not
+ *   fit in the high queue are queued as normal events, late but not lost,
+ * - an event is refused only once both queues are full,
+ * - high priority processes are polled first, a process is polled once
+ *   however many requests, and a poll requested while polling is served
+ *   in the next round.
+ *
+ * The polling differs with and without compare and swap. This build
+ * leaves out CC_CONF_CAS (project-conf.h), 13-process-prio-cas builds
+ * the same test with it.
+ */
+
+#include "contiki.h"
+#include "native-test.h"
+
+#include <string.h>
+
+static char log[64];
+static uint8_t logged;
+static uint8_t repoll;
+
+/*---------------------------------------------------------------------------*/
+static void
+log_char(char c)
+{
+  if(logged < sizeof(log) - 1) {
+    log[logged++] = c;
+    log[logged] = '\0';
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+log_clear(void)
+{
+  logged = 0;
+  log[0] = '\0';
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(worker_h, "High priority worker");
+PROCESS(worker_n, "Normal priority worker");
+PROCESS(test_process, "Priority test");
+AUTOSTART_PROCESSES(&worker_h, &worker_n, &test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(worker_h, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == PROCESS_EVENT_POLL) {
+      log_char('H');
+    } else if(ev == PROCESS_EVENT_CONTINUE) {
+      log_char((char)(uintptr_t)data);
+    }
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(worker_n, ev, data)
+{
+  PROCESS_BEGIN();
+  while(1) {
+    PROCESS_WAIT_EVENT();
+    if(ev == PROCESS_EVENT_POLL) {
+      log_char('N');
+      if(repoll) {
+        repoll = 0;
+        process_poll(&worker_h);
+      }
+    } else if(ev == PROCESS_EVENT_CONTINUE) {
+      log_char((char)(uintptr_t)data);
+    }
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static uint16_t overflows[PROCESS_PRIORITIES];
+  static int i, refused, posted;
+
+  PROCESS_BEGIN();
+
+  process_set_priority(&worker_h, PROCESS_PRIO_HIGH);
+  /* Let the other processes settle */
+  PROCESS_PAUSE();
+  memcpy(overflows, process_overflows, sizeof(overflows));
+
+  /* Wait for the queued events one poll at a time, as posting may fail */
+#define DRAIN() do {                                                    \
+    while(process_nevents() > 0) {                                      \
+      process_poll(&test_process);                                      \
+      PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);               \
+    }                                                                   \
+  } while(0)
+
+  /* Two more high priority events than the high queue holds */
+  log_clear();
+  refused = 0;
+  process_post(&worker_n, PROCESS_EVENT_CONTINUE, (void *)'*');
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS_HIGH + 2; i++) {
+    refused += process_post(&worker_h, PROCESS_EVENT_CONTINUE,
+                            (void *)(uintptr_t)('a' + i)) != PROCESS_ERR_OK;
+  }
+  DRAIN();
+  printf("events: %s\n", log);
+  TEST_CHECK(refused == 0, "high priority events accepted");
+  TEST_CHECK(strcmp(log, "abcdefgh*ij") == 0,
+             "high queue first, its overflow in the normal queue");
+  TEST_CHECK(process_overflows[PROCESS_PRIO_HIGH] ==
+             overflows[PROCESS_PRIO_HIGH] + 2 &&
+             process_overflows[PROCESS_PRIO_NORMAL] ==
+             overflows[PROCESS_PRIO_NORMAL], "overflow counted, nothing lost");
+
+  /* Both queues full */
+  log_clear();
+  posted = 0;
+  while(process_post(&worker_n, PROCESS_EVENT_CONTINUE,
+                     (void *)'n') == PROCESS_ERR_OK) {
+    posted++;
+  }
+  for(i = 0; i < PROCESS_CONF_NUMEVENTS_HIGH; i++) {
+    posted += process_post(&worker_h, PROCESS_EVENT_CONTINUE,
+                           (void *)'h') == PROCESS_ERR_OK;
+  }
+  refused = process_post(&worker_h, PROCESS_EVENT_CONTINUE,
+                         (void *)'x') == PROCESS_ERR_FULL;
+  DRAIN();
+  TEST_CHECK(refused && strchr(log, 'x') == NULL,
+             "refused once both queues are full");
+  TEST_CHECK(logged == posted && strspn(log, "h") == PROCESS_CONF_NUMEVENTS_HIGH,
+             "every accepted event delivered, high ones first");
+  TEST_CHECK(process_overflows[PROCESS_PRIO_HIGH] ==
+             overflows[PROCESS_PRIO_HIGH] + 3 &&
+             process_overflows[PROCESS_PRIO_NORMAL] ==
+             overflows[PROCESS_PRIO_NORMAL] + 2,
+             "refusals counted");
+
+  /* Polls, out of the poll handler DRAIN() left us in */
+  PROCESS_PAUSE();
+  log_clear();
+  process_poll(&worker_n);
+  process_poll(&worker_h);
+  process_poll(&worker_n);
+  process_poll(&worker_h);
+  PROCESS_PAUSE();
+  printf("polls: %s\n", log);
+  TEST_CHECK(strcmp(log, "HN") == 0, "high priority polled first, once");
+
+  log_clear();
+  repoll = 1;
+  process_poll(&worker_n);
+  PROCESS_PAUSE();
+  TEST_CHECK(strcmp(log, "N") == 0, "poll from a poll handler not served at once");
+  PROCESS_PAUSE();
+  printf("polls: %s\n", log);
+  TEST_CHECK(strcmp(log, "NH") == 0, "poll from a poll handler served next");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
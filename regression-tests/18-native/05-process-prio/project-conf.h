@@ -0,0 +1,2 @@
+/* The plain C polling of the ports without compare and swap */
+#undef CC_CONF_CAS
@@ -0,0 +1,147 @@
+/**
+ * Thousands of event timers.
+ *
+ * The timers start out filled with garbage, as in memory reused without
+ * clearing: stopping or adjusting a timer that was never set must leave
+ * the pending timers alone. The timers are then set, and stopped, reset
+ * or adjusted at random, and each operation timed. Each pending timer
+ * must fire once, not before its expiration time, the stopped ones
+ * never, and with the heap in the order of their expiration times.
+ *
+ * The test runs with ETIMER_CONF_HEAP. make clean; make HEAP=0 builds
+ * it with the timer list, as a baseline.
+ */
+
+#include "contiki.h"
+#include "lib/random.h"
+#include "sys/trace.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define TIMERS          4000
+#define CHURN           20000
+#define INTERVAL        (CLOCK_SECOND / 10)     /* The shortest */
+#define SPREAD          (CLOCK_SECOND / 2)
+
+static struct etimer timers[TIMERS];
+static uint8_t pending[TIMERS];
+
+/*---------------------------------------------------------------------------*/
+static void
+set_timer(int i)
+{
+  etimer_set(&timers[i], INTERVAL + random_rand() % SPREAD);
+  pending[i] = 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "Event timer test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static struct etimer guard;
+  static clock_time_t next, last, now;
+  static uint32_t start, set_us, churn_us;
+  static int i, left, fired, early, twice, order;
+  static unsigned long late, max_late;
+  int n;
+
+  PROCESS_BEGIN();
+
+  random_init(1);
+  memset(timers, 0xa5, sizeof(timers));
+
+  /* Timers never set, among one that is */
+  etimer_set(&guard, 10 * CLOCK_SECOND);
+  next = etimer_next_expiration_time();
+  for(i = 0; i < TIMERS; i++) {
+    etimer_adjust(&timers[i], 1);
+    etimer_stop(&timers[i]);
+  }
+  TEST_CHECK(etimer_next_expiration_time() == next && !etimer_expired(&guard),
+             "timers never set left out");
+
+  start = trace_arch_now();
+  for(i = 0; i < TIMERS; i++) {
+    set_timer(i);
+  }
+  set_us = trace_arch_now() - start;
+
+  start = trace_arch_now();
+  for(n = 0; n < CHURN; n++) {
+    i = random_rand() % TIMERS;
+    switch(random_rand() % 3) {
+    case 0:
+      etimer_stop(&timers[i]);
+      pending[i] = 0;
+      break;
+    case 1:
+      set_timer(i);
+      break;
+    default:
+      /* Backwards: with a start ahead of clock_time(), timer_expired()
+         is true at once, which the list checks on every timer */
+      etimer_adjust(&timers[i], -(int)(random_rand() % 10));
+      break;
+    }
+  }
+  churn_us = trace_arch_now() - start;
+  printf("%d timers: set %lu ns, stop/set/adjust %lu ns per timer\n",
+         TIMERS, (unsigned long)set_us * 1000 / TIMERS,
+         (unsigned long)churn_us * 1000 / CHURN);
+
+  left = 0;
+  for(i = 0; i < TIMERS; i++) {
+    left += pending[i];
+  }
+  fired = early = twice = order = 0;
+  late = max_late = 0;
+  last = 0;
+  while(left > 0 && !etimer_expired(&guard)) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_TIMER);
+    if(data == &guard) {
+      break;
+    }
+    i = (struct etimer *)data - timers;
+    now = clock_time();
+    next = etimer_expiration_time(&timers[i]);
+    if(!pending[i]) {
+      twice++;
+      continue;
+    }
+    pending[i] = 0;
+    left--;
+    fired++;
+    if((clock_time_t)(now - next) > ((clock_time_t)~(clock_time_t)0 >> 1)) {
+      early++;
+    } else {
+      late += now - next;
+      if(now - next > max_late) {
+        max_late = now - next;
+      }
+    }
+    if(fired > 1 &&
+       (clock_time_t)(next - last) > ((clock_time_t)~(clock_time_t)0 >> 1)) {
+      order++;
+    }
+    last = next;
+  }
+  etimer_stop(&guard);
+  printf("%d fired, %lu ms late on average, %lu ms at most\n", fired,
+         fired ? late / fired : 0, max_late);
+
+  TEST_CHECK(left == 0, "every pending timer fired");
+  TEST_CHECK(twice == 0, "no timer fired twice or once stopped");
+  TEST_CHECK(early == 0, "no timer fired early");
+#if ETIMER_CONF_HEAP
+  TEST_CHECK(order == 0, "fired in the order of expiration");
+#endif /* ETIMER_CONF_HEAP */
+  for(i = 0; i < TIMERS && etimer_expired(&timers[i]); i++);
+  TEST_CHECK(i == TIMERS, "no timer left pending");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
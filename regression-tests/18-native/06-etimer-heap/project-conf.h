@@ -0,0 +1,3 @@
+#ifndef ETIMER_CONF_HEAP
+#define ETIMER_CONF_HEAP            1
+#endif /* ETIMER_CONF_HEAP */
@@ -0,0 +1,200 @@
+/**
+ * CoAP static resources.
+ *
+ * The device information of the Aura firmware is activated as static
+ * resources in the default COAP_STATIC_BUFFER_SIZE, which follows the
+ * size of the pointers. The responses are built by coap_serialize_static()
+ * and parsed back:
+ *
+ * - the device information fits, a representation that does not is
+ *   refused and not served,
+ * - a GET gets 2.05 with ETag, Content-Format, Max-Age and the payload,
+ * - a GET with the current ETag gets 2.03 with ETag and Max-Age only,
+ *   another ETag gets the full 2.05,
+ * - If-None-Match and a different If-Match get 4.12, the current
+ *   If-Match gets 2.05,
+ * - Block2 requests get slices of the payload with the More flag until
+ *   the last one, a block past the end gets 4.02,
+ * - CON requests are answered with an ACK of the same MID and the token.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-static.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define MAX_AGE (24UL * 60 * 60)
+
+STATIC_RESOURCE(mfg, "dev/mfg", "");
+STATIC_RESOURCE(mdl, "dev/mdl", "");
+STATIC_RESOURCE(mdl_hw, "dev/mdl/hw", "");
+STATIC_RESOURCE(mdl_sw, "dev/mdl/sw", "");
+STATIC_RESOURCE(ser, "dev/ser", "");
+STATIC_RESOURCE(n, "dev/n", "");
+STATIC_RESOURCE(pwr, "dev/pwr/0", "");
+STATIC_RESOURCE(blob, "blob", "");
+STATIC_RESOURCE(large, "large", "");
+
+static const char name[] = "Controls the wall outlets.";
+static const char blob_payload[] = "0123456789abcdef0123456789abcdefGHIJKLMN";
+static const uint8_t token[] = { 0xca, 0xfe };
+
+static coap_packet_t request[1];
+static coap_packet_t received[1];
+static coap_packet_t response[1];
+static uint8_t request_buffer[COAP_MAX_PACKET_SIZE];
+static uint8_t buffer[COAP_MAX_PACKET_SIZE];
+
+/*---------------------------------------------------------------------------*/
+static int
+activate(resource_t *resource, const char *payload)
+{
+  return coap_activate_static_resource(resource, REST.type.TEXT_PLAIN,
+                                       MAX_AGE, payload, strlen(payload));
+}
+/*---------------------------------------------------------------------------*/
+static void
+new_request(const char *url)
+{
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0x4242);
+  coap_set_header_token(request, token, sizeof(token));
+  coap_set_header_uri_path(request, url);
+}
+/*---------------------------------------------------------------------------*/
+/* Answers the request, parsed as the engine receives it, from the static
+   resource and parses the response */
+static int
+get(void)
+{
+  coap_static_t *representation;
+  size_t len;
+
+  len = coap_serialize_message(request, request_buffer);
+  if(coap_parse_message(received, request_buffer, len) != NO_ERROR ||
+     (representation = coap_get_static(received)) == NULL) {
+    return 0;
+  }
+  len = coap_serialize_static(representation, received, buffer);
+  return coap_parse_message(response, buffer, len) == NO_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+static int
+payload_is(const char *payload, size_t len)
+{
+  const uint8_t *p;
+
+  return coap_get_payload(response, &p) == len && memcmp(p, payload, len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "CoAP static test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static uint8_t etag[COAP_STATIC_ETAG_LEN];
+  static const uint8_t other_etag[COAP_STATIC_ETAG_LEN] = { 0, 0 };
+  static uint8_t large_payload[REST_MAX_CHUNK_SIZE + 1];
+  static int i, more_count;
+  const uint8_t *p;
+  uint32_t age, num, offset;
+  uint8_t more;
+  uint16_t size;
+
+  PROCESS_BEGIN();
+
+  rest_init_engine();
+
+  /* The device information of Aura, with the longest model name */
+  TEST_CHECK(activate(&resource_mfg, "Astral") &&
+             activate(&resource_mdl, "Norma") &&
+             activate(&resource_mdl_hw, "0.1") &&
+             activate(&resource_mdl_sw, "0.1") &&
+             activate(&resource_ser, "00:12:4b:00:04:0e:33:0c") &&
+             activate(&resource_n, name) &&
+             activate(&resource_pwr, "0"),
+             "device information fits the default buffer");
+  TEST_CHECK(activate(&resource_blob, blob_payload), "room for one more");
+  memset(large_payload, 'x', REST_MAX_CHUNK_SIZE);
+  TEST_CHECK(!activate(&resource_large, (char *)large_payload),
+             "representation that does not fit refused");
+  new_request("large");
+  TEST_CHECK(!get(), "refused one not served");
+
+  /* Plain GET */
+  new_request("dev/n");
+  TEST_CHECK(get() && response->code == CONTENT_2_05 && payload_is(name, strlen(name)),
+             "2.05 with the payload");
+  TEST_CHECK(coap_get_header_etag(response, &p) == COAP_STATIC_ETAG_LEN &&
+             coap_get_header_content_type(response) == REST.type.TEXT_PLAIN &&
+             coap_get_header_max_age(response, &age) && age == MAX_AGE,
+             "ETag, Content-Format and Max-Age");
+  memcpy(etag, p, COAP_STATIC_ETAG_LEN);
+  TEST_CHECK(response->type == COAP_TYPE_ACK && response->mid == 0x4242 &&
+             response->token_len == sizeof(token) &&
+             memcmp(response->token, token, sizeof(token)) == 0,
+             "ACK with the MID and token of the CON");
+
+  /* Revalidation */
+  new_request("dev/n");
+  coap_set_header_etag(request, etag, COAP_STATIC_ETAG_LEN);
+  TEST_CHECK(get() && response->code == VALID_2_03 &&
+             coap_get_payload(response, &p) == 0,
+             "current ETag gets 2.03 without payload");
+  TEST_CHECK(coap_get_header_etag(response, &p) == COAP_STATIC_ETAG_LEN &&
+             memcmp(p, etag, COAP_STATIC_ETAG_LEN) == 0 &&
+             coap_get_header_max_age(response, &age) && age == MAX_AGE &&
+             !IS_OPTION(response, COAP_OPTION_CONTENT_TYPE),
+             "2.03 with ETag and Max-Age only");
+  new_request("dev/n");
+  coap_set_header_etag(request, other_etag, COAP_STATIC_ETAG_LEN);
+  TEST_CHECK(get() && response->code == CONTENT_2_05 && payload_is(name, strlen(name)),
+             "other ETag gets 2.05");
+
+  /* Conditional requests */
+  new_request("dev/n");
+  coap_set_header_if_none_match(request);
+  TEST_CHECK(get() && response->code == PRECONDITION_FAILED_4_12 &&
+             coap_get_payload(response, &p) == 0,
+             "If-None-Match gets 4.12");
+  new_request("dev/n");
+  coap_set_header_if_match(request, other_etag, COAP_STATIC_ETAG_LEN);
+  TEST_CHECK(get() && response->code == PRECONDITION_FAILED_4_12,
+             "other If-Match gets 4.12");
+  new_request("dev/n");
+  coap_set_header_if_match(request, etag, COAP_STATIC_ETAG_LEN);
+  TEST_CHECK(get() && response->code == CONTENT_2_05 && payload_is(name, strlen(name)),
+             "current If-Match gets 2.05");
+
+  /* Block2 slices of 16 bytes */
+  more_count = 0;
+  for(i = 0; i < 3; i++) {
+    new_request("blob");
+    coap_set_header_block2(request, i, 0, 16);
+    if(!get() || response->code != CONTENT_2_05 ||
+       !coap_get_header_block2(response, &num, &more, &size, &offset) ||
+       num != i || size != 16 ||
+       !payload_is(blob_payload + 16 * i, i < 2 ? 16 : 8)) {
+      break;
+    }
+    more_count += more;
+  }
+  TEST_CHECK(i == 3, "blocks are slices of the payload");
+  TEST_CHECK(more_count == 2 && !more, "More set on all but the last block");
+  new_request("blob");
+  coap_set_header_block2(request, 3, 0, 16);
+  TEST_CHECK(get() && response->code == BAD_OPTION_4_02,
+             "block past the end gets 4.02");
+  new_request("blob");
+  TEST_CHECK(get() && response->code == CONTENT_2_05 &&
+             payload_is(blob_payload, strlen(blob_payload)),
+             "whole payload without Block2");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,2 @@
+/* Largest static payload, and the largest Block2 size */
+#define REST_MAX_CHUNK_SIZE         64
@@ -0,0 +1,12 @@
+/* The directory is served by the node itself, at fe80::2 */
+#define RD_CLIENT_CONF_SERVER(addr) uip_ip6addr(addr, 0xfe80, 0, 0, 0, 0, 0, 0, 2)
+
+/* Refreshed every two seconds, registered in blocks of 32 bytes */
+#define RD_CLIENT_CONF_LIFETIME     4
+#define RD_CLIENT_CONF_RETRY        CLOCK_SECOND
+#define RD_CLIENT_CONF_BLOCK_SIZE   32
+
+#define RD_CONF_MAX_ENDPOINTS       2
+#define RD_CONF_LINKS_SIZE          512
+
+#define REST_MAX_CHUNK_SIZE         64
@@ -0,0 +1,222 @@
+/**
+ * Registration of rd-client with the resource directory of the uHub.
+ *
+ * The node serves apps/plugz-hub/resource-directory.c itself. Its
+ * output function loops the unicast UDP to fe80::2 back with the
+ * addresses swapped, so the directory sees the node at fe80::2 and the
+ * node gets the answers from there. The test looks the node up in the
+ * directory and checks that:
+ *
+ * - the links are registered block by block, and an update asked for
+ *   during the blocking request is done after it, not in its place,
+ * - a new resource is registered again on rd_client_update(),
+ * - the refreshes keep the registration past its lifetime,
+ * - the registration expires once the node no longer reaches the
+ *   directory.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/rpl/rpl.h"
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "resource-directory.h"
+#include "rd-client.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+#define LOOPBACK_QUEUE  4
+
+static struct {
+  uint16_t len;
+  uint8_t buf[UIP_BUFSIZE];
+} queue[LOOPBACK_QUEUE];
+static uint8_t queued;
+
+/* CoAP POSTs seen on the way out, dropped when the node goes silent */
+static unsigned posts;
+static uint8_t drop_posts;
+
+static uip_ipaddr_t server;
+static char lookup[256];
+static uint16_t lookup_len;
+
+PROCESS(loopback_process, "Loopback");
+PROCESS(test_process, "RD client test");
+AUTOSTART_PROCESSES(&test_process);
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+loopback_output(const uip_lladdr_t *lladdr)
+{
+  uip_ipaddr_t addr;
+
+  if(UIP_IP_BUF->proto != UIP_PROTO_UDP
+     || !uip_ipaddr_cmp(&UIP_IP_BUF->destipaddr, &server)) {
+    return 0;
+  }
+  if(uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN + 1] == COAP_POST) {
+    ++posts;
+    if(drop_posts) {
+      return 0;
+    }
+  }
+  if(queued == LOOPBACK_QUEUE) {
+    return 0;
+  }
+  /* The pseudo header, and so the checksum, does not change */
+  uip_ipaddr_copy(&addr, &UIP_IP_BUF->srcipaddr);
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &UIP_IP_BUF->destipaddr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &addr);
+
+  queue[queued].len = uip_len;
+  memcpy(queue[queued].buf, uip_buf, uip_len);
+  ++queued;
+  process_poll(&loopback_process);
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(loopback_process, ev, data)
+{
+  PROCESS_BEGIN();
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == PROCESS_EVENT_POLL);
+    while(queued > 0) {
+      uip_len = queue[0].len;
+      memcpy(uip_buf, queue[0].buf, uip_len);
+      --queued;
+      memmove(&queue[0], &queue[1], queued * sizeof(queue[0]));
+      tcpip_input();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+RESOURCE(extra, METHOD_GET, "extra", "title=\"Extra\"");
+void
+extra_handler(void* request, void* response, uint8_t *buffer, uint16_t preferred_size, int32_t *offset)
+{
+}
+/*---------------------------------------------------------------------------*/
+static void
+lookup_response(void *response)
+{
+  const uint8_t *payload = NULL;
+  int len = coap_get_payload(response, &payload);
+
+  if(((coap_packet_t *)response)->code == CONTENT_2_05
+     && lookup_len + len < sizeof(lookup)) {
+    memcpy(lookup + lookup_len, payload, len);
+    lookup_len += len;
+    lookup[lookup_len] = '\0';
+  }
+}
+/*---------------------------------------------------------------------------*/
+static unsigned
+link_format_blocks(void)
+{
+  return (coap_get_link_format_len() + RD_CLIENT_BLOCK_SIZE - 1) / RD_CLIENT_BLOCK_SIZE;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static struct etimer et;
+  static coap_packet_t request[1];
+  static const char *path;
+  static unsigned expected;
+  uip_ipaddr_t addr;
+  uip_lladdr_t lladdr;
+
+  PROCESS_BEGIN();
+
+  process_start(&loopback_process, NULL);
+  tcpip_set_outputfunc(loopback_output);
+
+  RD_CLIENT_CONF_SERVER(&server);
+  memset(&lladdr, 0, sizeof(lladdr));
+  lladdr.addr[sizeof(lladdr.addr) - 1] = 2;
+  uip_ds6_nbr_add(&server, &lladdr, 0, NBR_REACHABLE);
+
+  /* rd-client waits for a DAG */
+  uip_ip6addr(&addr, 0xaaaa, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&addr, &uip_lladdr);
+  uip_ds6_addr_add(&addr, 0, ADDR_AUTOCONF);
+  rpl_set_prefix(rpl_set_root(RPL_DEFAULT_INSTANCE, &addr), &addr, 64);
+
+  rest_init_engine();
+  resource_directory_activate_resources();
+
+  /* The first block is on its way, the update must wait for the response */
+  rd_client_start("node", "test");
+  rd_client_update();
+  expected = link_format_blocks() + 1;
+
+  etimer_set(&et, CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  TEST_CHECK(posts == expected, "registered, then refreshed for the update");
+
+  path = "rd-lookup/ep";
+  lookup_len = 0;
+  lookup[0] = '\0';
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, path);
+  COAP_BLOCKING_REQUEST(&server, UIP_HTONS(COAP_DEFAULT_PORT), request, lookup_response);
+  TEST_CHECK(lookup_len > 0 && strstr(lookup, "<coap://[fe80::2]>;ep=\"node\";et=\"test\"") != NULL,
+             "endpoint in the directory");
+
+  /* A new resource is registered again */
+  rest_activate_resource(&resource_extra);
+  rd_client_update();
+  expected = posts + link_format_blocks();
+
+  etimer_set(&et, CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  TEST_CHECK(posts == expected, "registered again after the update");
+
+  path = "rd-lookup/res";
+  lookup_len = 0;
+  lookup[0] = '\0';
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, path);
+  COAP_BLOCKING_REQUEST(&server, UIP_HTONS(COAP_DEFAULT_PORT), request, lookup_response);
+  TEST_CHECK(strstr(lookup, "<coap://[fe80::2]/extra>;title=\"Extra\"") != NULL,
+             "new resource in the directory");
+
+  /* Refreshed every lifetime / 2 */
+  expected = posts;
+  etimer_set(&et, (RD_CLIENT_LIFETIME + 2) * CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  TEST_CHECK(posts >= expected + 2, "refreshed");
+
+  path = "rd-lookup/ep";
+  lookup_len = 0;
+  lookup[0] = '\0';
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, path);
+  COAP_BLOCKING_REQUEST(&server, UIP_HTONS(COAP_DEFAULT_PORT), request, lookup_response);
+  TEST_CHECK(strstr(lookup, "ep=\"node\"") != NULL, "registration kept past its lifetime");
+
+  /* The directory no longer hears the node */
+  drop_posts = 1;
+  etimer_set(&et, (RD_CLIENT_LIFETIME + 2) * CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+  lookup_len = 0;
+  lookup[0] = '\0';
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0);
+  coap_set_header_uri_path(request, path);
+  COAP_BLOCKING_REQUEST(&server, UIP_HTONS(COAP_DEFAULT_PORT), request, lookup_response);
+  TEST_CHECK(strstr(lookup, "ep=\"node\"") == NULL, "registration expired");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,7 @@
+/* Two clients waiting for separate responses, two upstream requests */
+#define COAP_MAX_OPEN_TRANSACTIONS  6
+
+#define COAP_PROXY_CONF_ENTRIES     4
+#define COAP_PROXY_CONF_CLIENTS     4
+
+#define REST_MAX_CHUNK_SIZE         64
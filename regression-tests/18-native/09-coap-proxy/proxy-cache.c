@@ -0,0 +1,241 @@
+/**
+ * Caching forward proxy of the uHub.
+ *
+ * The test hands requests from two clients and the responses of a node
+ * to the engine as uIP would, and looks at what the proxy sends through
+ * the output function:
+ *
+ * - a miss is forwarded to the node, the client gets a separate response,
+ * - a request for the resource in flight waits for its response
+ *   instead of going to the node,
+ * - the callback of a response finds it intact, although its ACK
+ *   releases the next CON queued for the node,
+ * - a fresh entry is answered from the cache, with 2.03 for its ETag,
+ * - a stale entry is revalidated with its ETag, and 2.03 from the node
+ *   serves the cached payload again.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "erbium.h"
+#include "er-coap-13.h"
+#include "er-coap-13-engine.h"
+#include "coap-proxy.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define COAP_PORT UIP_HTONS(COAP_DEFAULT_PORT)
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+#define SENT_MAX  16
+
+/* CoAP messages sent, in order */
+static struct {
+  uip_ipaddr_t addr;
+  uint16_t len;
+  uint8_t data[COAP_MAX_PACKET_SIZE];
+} sent[SENT_MAX];
+static uint8_t sent_count;
+static uint8_t sent_read;
+
+static uip_ipaddr_t client_a, client_b, node;
+static const uint8_t etag[] = { 0xe1, 0x7a };
+static const char value_a[] = "value of a";
+
+/*---------------------------------------------------------------------------*/
+static uint8_t
+capture_output(const uip_lladdr_t *lladdr)
+{
+  if(UIP_IP_BUF->proto == UIP_PROTO_UDP && sent_count < SENT_MAX) {
+    uip_ipaddr_copy(&sent[sent_count].addr, &UIP_IP_BUF->destipaddr);
+    sent[sent_count].len = uip_len - UIP_LLH_LEN - UIP_IPUDPH_LEN;
+    memcpy(sent[sent_count].data, &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN], sent[sent_count].len);
+    ++sent_count;
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* The next message sent, parsed, or 0 if it was not sent to addr */
+static int
+next_sent(const uip_ipaddr_t *addr, coap_packet_t *message)
+{
+  if(sent_read == sent_count || !uip_ipaddr_cmp(&sent[sent_read].addr, addr)) {
+    return 0;
+  }
+  ++sent_read;
+  return coap_parse_message(message, sent[sent_read - 1].data, sent[sent_read - 1].len) == NO_ERROR;
+}
+/*---------------------------------------------------------------------------*/
+/* Hands a message from addr to the engine, as uIP would */
+static void
+receive(const uip_ipaddr_t *addr, coap_packet_t *message)
+{
+  uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN];
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, addr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &uip_ds6_get_link_local(-1)->ipaddr);
+  UIP_UDP_BUF->srcport = COAP_PORT;
+  uip_len = coap_serialize_message(message, uip_appdata);
+  uip_flags = UIP_NEWDATA;
+  process_post_synch(&coap_receiver, tcpip_event, NULL);
+  uip_flags = 0;
+  uip_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+receive_get(const uip_ipaddr_t *addr, uint16_t mid, const char *uri, const uint8_t *tag)
+{
+  coap_packet_t request[1];
+
+  coap_init_message(request, COAP_TYPE_CON, COAP_GET, mid);
+  coap_set_header_token(request, (const uint8_t *)&mid, sizeof(mid));
+  coap_set_header_proxy_uri(request, uri);
+  if(tag != NULL) {
+    coap_set_header_etag(request, tag, sizeof(etag));
+  }
+  receive(addr, request);
+}
+/*---------------------------------------------------------------------------*/
+static void
+receive_response(uint16_t mid, uint8_t code, const char *payload)
+{
+  coap_packet_t response[1];
+
+  coap_init_message(response, COAP_TYPE_ACK, code, mid);
+  coap_set_header_etag(response, etag, sizeof(etag));
+  coap_set_header_max_age(response, 2);
+  if(payload != NULL) {
+    coap_set_header_content_type(response, TEXT_PLAIN);
+    coap_set_payload(response, payload, strlen(payload));
+  }
+  receive(&node, response);
+}
+/*---------------------------------------------------------------------------*/
+static void
+receive_ack(const uip_ipaddr_t *addr, uint16_t mid)
+{
+  coap_packet_t ack[1];
+
+  coap_init_message(ack, COAP_TYPE_ACK, 0, mid);
+  receive(addr, ack);
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_empty_ack(coap_packet_t *message, uint16_t mid)
+{
+  return message->type == COAP_TYPE_ACK && message->code == 0 && message->mid == mid;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_value_a(coap_packet_t *message, uint8_t type, uint16_t token)
+{
+  const uint8_t *payload = NULL;
+  const uint8_t *tag = NULL;
+  int len = coap_get_payload(message, &payload);
+
+  return message->type == type && message->code == CONTENT_2_05
+    && message->token_len == sizeof(token) && memcmp(message->token, &token, sizeof(token)) == 0
+    && coap_get_header_etag(message, &tag) == sizeof(etag) && memcmp(tag, etag, sizeof(etag)) == 0
+    && len == strlen(value_a) && memcmp(payload, value_a, len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_upstream_get(coap_packet_t *message, const char *path, int revalidate)
+{
+  const char *uri = NULL;
+  const uint8_t *tag = NULL;
+  int len = coap_get_header_uri_path(message, &uri);
+
+  return message->type == COAP_TYPE_CON && message->code == COAP_GET
+    && len == strlen(path) && strncmp(uri, path, len) == 0
+    && (revalidate ? coap_get_header_etag(message, &tag) == sizeof(etag)
+        && memcmp(tag, etag, sizeof(etag)) == 0
+        : !IS_OPTION(message, COAP_OPTION_ETAG));
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "CoAP proxy test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static struct etimer et;
+  static coap_packet_t message[1];
+  static uint16_t mid_a, mid_b;
+  uip_lladdr_t lladdr;
+
+  PROCESS_BEGIN();
+
+  tcpip_set_outputfunc(capture_output);
+  uip_ip6addr(&client_a, 0xfe80, 0, 0, 0, 0, 0, 0, 0x10);
+  uip_ip6addr(&client_b, 0xfe80, 0, 0, 0, 0, 0, 0, 0x11);
+  uip_ip6addr(&node, 0xfe80, 0, 0, 0, 0, 0, 0, 2);
+  /* Neighbors are told apart by their link-layer address */
+  memset(&lladdr, 0, sizeof(lladdr));
+  lladdr.addr[0] = 0x10;
+  uip_ds6_nbr_add(&client_a, &lladdr, 0, NBR_REACHABLE);
+  lladdr.addr[0] = 0x11;
+  uip_ds6_nbr_add(&client_b, &lladdr, 0, NBR_REACHABLE);
+  lladdr.addr[0] = 0x02;
+  uip_ds6_nbr_add(&node, &lladdr, 0, NBR_REACHABLE);
+
+  rest_init_engine();
+  coap_proxy_init();
+
+  /* Miss */
+  receive_get(&client_a, 100, "coap://[fe80::2]/a", NULL);
+  TEST_CHECK(next_sent(&client_a, message) && is_empty_ack(message, 100), "miss acknowledged");
+  TEST_CHECK(next_sent(&node, message) && is_upstream_get(message, "a", 0), "miss forwarded");
+  mid_a = message->mid;
+
+  /* Coalesced */
+  receive_get(&client_b, 200, "coap://[fe80::2]/a", NULL);
+  TEST_CHECK(next_sent(&client_b, message) && is_empty_ack(message, 200)
+             && sent_read == sent_count, "second client waits for the same response");
+
+  /* Queued behind the first CON to the node */
+  receive_get(&client_a, 101, "coap://[fe80::2]/b", NULL);
+  TEST_CHECK(next_sent(&client_a, message) && is_empty_ack(message, 101)
+             && sent_read == sent_count, "other resource queued for the node");
+
+  /* The ACK releases the request for b, the callback still sees a */
+  receive_response(mid_a, CONTENT_2_05, value_a);
+  TEST_CHECK(next_sent(&client_a, message) && is_value_a(message, COAP_TYPE_CON, 100),
+             "first client answered");
+  receive_ack(&client_a, message->mid);
+  TEST_CHECK(next_sent(&client_b, message) && is_value_a(message, COAP_TYPE_CON, 200),
+             "coalesced client answered");
+  receive_ack(&client_b, message->mid);
+  PROCESS_PAUSE();
+  TEST_CHECK(next_sent(&node, message) && is_upstream_get(message, "b", 0),
+             "queued request sent after the callback");
+  mid_b = message->mid;
+
+  /* Fresh */
+  receive_get(&client_b, 201, "coap://[fe80::2]/a", NULL);
+  TEST_CHECK(next_sent(&client_b, message) && is_value_a(message, COAP_TYPE_ACK, 201)
+             && sent_read == sent_count, "hit from the cache");
+  receive_get(&client_b, 202, "coap://[fe80::2]/a", etag);
+  TEST_CHECK(next_sent(&client_b, message) && message->type == COAP_TYPE_ACK
+             && message->code == VALID_2_03 && sent_read == sent_count, "hit with the ETag is 2.03");
+
+  /* Stale after Max-Age */
+  receive_response(mid_b, NOT_FOUND_4_04, NULL);
+  etimer_set(&et, 3 * CLOCK_SECOND);
+  PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+  sent_read = sent_count = 0;
+
+  receive_get(&client_b, 203, "coap://[fe80::2]/a", NULL);
+  TEST_CHECK(next_sent(&client_b, message) && is_empty_ack(message, 203), "stale acknowledged");
+  TEST_CHECK(next_sent(&node, message) && is_upstream_get(message, "a", 1), "stale revalidated");
+  mid_a = message->mid;
+  receive_response(mid_a, VALID_2_03, NULL);
+  TEST_CHECK(next_sent(&client_b, message) && is_value_a(message, COAP_TYPE_CON, 203),
+             "revalidated entry served");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
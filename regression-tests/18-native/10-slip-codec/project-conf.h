@@ -0,0 +1,7 @@
+/* core/dev/slip.c as built for the cc2538 boards */
+#define SLIP_CONF_ARCH_WRITE        1
+#define SLIP_CONF_RX_BUFSIZE        (2 * UIP_CONF_BUFFER_SIZE + 16)
+
+/* The frames go to the test instead of uIP */
+#define SLIP_CONF_TCPIP_INPUT()     slip_codec_input()
+void slip_codec_input(void);
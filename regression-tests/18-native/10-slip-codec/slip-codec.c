@@ -0,0 +1,304 @@
+/**
+ * Block encoder and decoder of core/dev/slip.c.
+ *
+ * The driver is built as for the cc2538 boards (project-conf.h): the
+ * encoded bytes go to slip_arch_write() a chunk at a time and the
+ * received ones come in blocks through slip_input_block(). The test
+ * stands in for the arch and for uIP, and checks that:
+ *
+ * - slip_write() produces the SLIP encoding, in full chunks,
+ * - frames fed back in blocks of any size, escapes split between two
+ *   blocks included, come out unchanged, across the end of the ring,
+ * - a block holding two frames delivers both, a third one in the same
+ *   block is dropped,
+ * - a bad escape or a frame larger than the ring drops that frame only,
+ * - decoding by blocks is faster than byte by byte.
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "dev/slip.h"
+#include "lib/random.h"
+#include "native-test.h"
+
+#include <string.h>
+#include <time.h>
+
+#define SLIP_END      0300
+#define SLIP_ESC      0333
+#define SLIP_ESC_END  0334
+#define SLIP_ESC_ESC  0335
+
+#define TX_CHUNK      64        /* Of slip.c */
+#define RX_BUFSIZE    SLIP_CONF_RX_BUFSIZE
+
+#define FRAME_MAX     (UIP_BUFSIZE - UIP_LLH_LEN)
+#define ENCODED_MAX   (2 * RX_BUFSIZE + 2)
+
+#define SPEED_FRAMES  2000
+#define SPEED_LEN     128
+#define SPEED_RUNS    3
+
+/* What slip_arch_write() got */
+static uint8_t encoded[ENCODED_MAX];
+static uint16_t encoded_len;
+static uint16_t writes;
+static uint16_t short_writes;
+static uint16_t last_write;
+
+/* What the driver handed to uIP */
+#define RECEIVED_MAX  4
+static struct {
+  uint16_t len;
+  uint8_t data[FRAME_MAX];
+} received[RECEIVED_MAX];
+static uint16_t received_count;
+
+static uint8_t frame[RX_BUFSIZE + 16];
+
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_write(const uint8_t *buf, uint16_t len)
+{
+  if(writes > 0 && last_write < TX_CHUNK - 1) {
+    ++short_writes;
+  }
+  ++writes;
+  last_write = len;
+  if(encoded_len + len <= sizeof(encoded)) {
+    memcpy(encoded + encoded_len, buf, len);
+  }
+  encoded_len += len;
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_arch_writeb(unsigned char c)
+{
+  slip_arch_write(&c, 1);
+}
+/*---------------------------------------------------------------------------*/
+void
+slip_codec_input(void)
+{
+  if(received_count < RECEIVED_MAX) {
+    received[received_count].len = uip_len;
+    memcpy(received[received_count].data, &uip_buf[UIP_LLH_LEN], uip_len);
+  }
+  ++received_count;
+}
+/*---------------------------------------------------------------------------*/
+static void
+encode(const uint8_t *data, uint16_t len)
+{
+  encoded_len = writes = short_writes = 0;
+  slip_write(data, len);
+}
+/*---------------------------------------------------------------------------*/
+/* The encoding of RFC 1055, with an END before as slip_write() sends it */
+static int
+is_encoding_of(const uint8_t *data, uint16_t len)
+{
+  uint16_t i, n = 0;
+
+  if(encoded_len > sizeof(encoded) || encoded[n++] != SLIP_END) {
+    return 0;
+  }
+  for(i = 0; i < len; i++) {
+    if(data[i] == SLIP_END || data[i] == SLIP_ESC) {
+      if(encoded[n++] != SLIP_ESC
+         || encoded[n++] != (data[i] == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC)) {
+        return 0;
+      }
+    } else if(encoded[n++] != data[i]) {
+      return 0;
+    }
+  }
+  return encoded[n++] == SLIP_END && n == encoded_len;
+}
+/*---------------------------------------------------------------------------*/
+static void
+feed(const uint8_t *data, uint16_t len, uint16_t block)
+{
+  uint16_t n;
+
+  for(n = 0; n < len; n += block) {
+    slip_input_block(data + n, len - n < block ? len - n : block);
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Runs the driver for the frames it holds, as the scheduler would */
+static void
+deliver(void)
+{
+  uint16_t count;
+
+  do {
+    count = received_count;
+    process_post_synch(&slip_process, PROCESS_EVENT_POLL, NULL);
+  } while(received_count != count);
+}
+/*---------------------------------------------------------------------------*/
+static int
+is_received(uint8_t i, const uint8_t *data, uint16_t len)
+{
+  return i < received_count && i < RECEIVED_MAX && received[i].len == len
+    && memcmp(received[i].data, data, len) == 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+random_frame(uint16_t len, uint8_t escapes)
+{
+  uint16_t i;
+
+  for(i = 0; i < len; i++) {
+    frame[i] = random_rand();
+    if(!escapes && (frame[i] == SLIP_END || frame[i] == SLIP_ESC)) {
+      frame[i] = 0x55;
+    }
+  }
+  if(escapes) {
+    frame[len / 3] = SLIP_END;
+    frame[len / 2] = SLIP_ESC;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static unsigned long
+now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+/*---------------------------------------------------------------------------*/
+/* Microseconds to decode SPEED_FRAMES frames of the encoding in encoded */
+static unsigned long
+decode_time(uint8_t by_block)
+{
+  unsigned long start;
+  uint16_t i, n;
+
+  received_count = 0;
+  start = now_us();
+  for(i = 0; i < SPEED_FRAMES; i++) {
+    if(by_block) {
+      slip_input_block(encoded, encoded_len);
+    } else {
+      for(n = 0; n < encoded_len; n++) {
+        slip_input_byte(encoded[n]);
+      }
+    }
+    process_post_synch(&slip_process, PROCESS_EVENT_POLL, NULL);
+  }
+  return now_us() - start;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "SLIP codec test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static const uint16_t blocks[] = { 1, 2, 7, TX_CHUNK, ENCODED_MAX };
+  static uint8_t stream[2 * ENCODED_MAX];
+  static uint16_t stream_len;
+  static unsigned long t, best[2];
+  static unsigned i, b, ok;
+
+  PROCESS_BEGIN();
+
+  process_start(&slip_process, NULL);
+
+  /* Every byte value */
+  for(i = 0; i < 300; i++) {
+    frame[i] = i;
+  }
+  encode(frame, 300);
+  TEST_CHECK(is_encoding_of(frame, 300), "encoded");
+  TEST_CHECK(writes > 1 && short_writes == 0 && last_write <= TX_CHUNK,
+             "written in full chunks");
+
+  /* Round trip, blocks of any size, the ring wraps a few times */
+  ok = 1;
+  for(b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+    for(i = 0; i < 8; i++) {
+      random_frame(40 + i * 37, 1);
+      encode(frame, 40 + i * 37);
+      received_count = 0;
+      feed(encoded, encoded_len, blocks[b]);
+      deliver();
+      ok &= received_count == 1 && is_received(0, frame, 40 + i * 37);
+    }
+  }
+  TEST_CHECK(ok, "round trip in blocks of 1 to all bytes");
+
+  /* Two frames in a block, then three */
+  random_frame(100, 1);
+  encode(frame, 100);
+  memcpy(stream, encoded, encoded_len);
+  memcpy(stream + encoded_len, encoded + 1, encoded_len - 1);
+  stream_len = 2 * encoded_len - 1;
+  received_count = 0;
+  TEST_CHECK(slip_input_block(stream, stream_len) != 0, "frame end reported");
+  deliver();
+  TEST_CHECK(received_count == 2 && is_received(0, frame, 100) && is_received(1, frame, 100),
+             "two frames of a block delivered");
+
+  memcpy(stream + stream_len, encoded + 1, encoded_len - 1);
+  stream_len += encoded_len - 1;
+  received_count = 0;
+  slip_input_block(stream, stream_len);
+  deliver();
+  TEST_CHECK(received_count == 2, "third frame dropped while two wait");
+
+  /* Bad escape, then a frame larger than the ring */
+  encode(frame, 100);
+  encoded[encoded_len / 2] = SLIP_ESC;
+  encoded[encoded_len / 2 + 1] = 'x';
+  received_count = 0;
+  slip_input_block(encoded, encoded_len);
+  deliver();
+  TEST_CHECK(received_count == 0, "frame with a bad escape dropped");
+
+  random_frame(RX_BUFSIZE + 8, 0);
+  encode(frame, RX_BUFSIZE + 8);
+  slip_input_block(encoded, encoded_len);
+  deliver();
+  TEST_CHECK(received_count == 0, "frame larger than the ring dropped");
+
+  random_frame(100, 1);
+  encode(frame, 100);
+  slip_input_block(encoded, encoded_len);
+  deliver();
+  TEST_CHECK(received_count == 1 && is_received(0, frame, 100), "next frame received");
+
+  /* Throughput, the best of a few runs against the host */
+  random_frame(SPEED_LEN, 0);
+  t = now_us();
+  for(i = 0; i < SPEED_FRAMES; i++) {
+    encode(frame, SPEED_LEN);
+  }
+  t = now_us() - t;
+  printf("encode: %lu frames/s\n", SPEED_FRAMES * 1000000UL / (t ? t : 1));
+
+  best[0] = best[1] = ~0UL;
+  ok = 1;
+  for(i = 0; i < SPEED_RUNS; i++) {
+    for(b = 0; b < 2; b++) {
+      t = decode_time(b);
+      if(t < best[b]) {
+        best[b] = t;
+      }
+      ok &= received_count == SPEED_FRAMES && is_received(RECEIVED_MAX - 1, frame, SPEED_LEN);
+    }
+  }
+  printf("decode: %lu frames/s by byte, %lu by block\n",
+         SPEED_FRAMES * 1000000UL / (best[0] ? best[0] : 1),
+         SPEED_FRAMES * 1000000UL / (best[1] ? best[1] : 1));
+  TEST_CHECK(ok, "all frames decoded");
+  TEST_CHECK(best[1] < best[0], "blocks decoded faster than bytes");
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
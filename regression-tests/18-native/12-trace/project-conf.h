@@ -0,0 +1,2 @@
+#define TRACE_CONF_ENABLED          1
+#define TRACE_CONF_RECORDS          16
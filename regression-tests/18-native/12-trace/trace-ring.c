@@ -0,0 +1,140 @@
+/**
+ * Flight recorder of core/sys/trace.c.
+ *
+ * The test records its own events between trace_resume() and
+ * trace_freeze(), with no other process run in between, and checks
+ * that:
+ *
+ * - trace_read() gives the header, then the records oldest first, in
+ *   the little endian layout tools/trace-decode reads,
+ * - nothing is recorded while the trace is frozen,
+ * - once the ring wraps, it keeps the latest TRACE_RECORDS records and
+ *   the header counts the overwritten ones,
+ * - a readout in small blocks matches the one in a single read,
+ * - trace_resume() empties the ring.
+ */
+
+#include "contiki.h"
+#include "sys/trace.h"
+#include "native-test.h"
+
+#include <string.h>
+
+#define SIZE(n)     (TRACE_HEADER_SIZE + (n) * TRACE_RECORD_SIZE)
+#define BLOCK       5
+
+static uint8_t out[SIZE(TRACE_RECORDS) + 8];
+static uint16_t out_len;
+
+/*---------------------------------------------------------------------------*/
+static uint32_t
+le(const uint8_t *p, uint8_t bytes)
+{
+  uint32_t v = 0;
+
+  while(bytes-- > 0) {
+    v = (v << 8) | p[bytes];
+  }
+  return v;
+}
+/*---------------------------------------------------------------------------*/
+/* Records events with the argument first to last - 1 */
+static void
+record(uint16_t first, uint16_t last)
+{
+  uint16_t i;
+
+  trace_resume();
+  for(i = first; i < last; i++) {
+    switch(i % 3) {
+    case 0: TRACE_BEGIN(TRACE_ID_USER, i); break;
+    case 1: TRACE_END(TRACE_ID_USER, i); break;
+    default: TRACE_EVENT(TRACE_ID_USER + 1, i); break;
+    }
+  }
+  trace_freeze();
+  out_len = trace_read(out, 0, sizeof(out));
+}
+/*---------------------------------------------------------------------------*/
+static int
+header_is(uint16_t records, uint32_t written)
+{
+  return out[0] == TRACE_MAGIC0 && out[1] == TRACE_MAGIC1
+    && out[2] == TRACE_VERSION && out[3] == TRACE_RECORD_SIZE
+    && le(out + 4, 4) == trace_arch_second()
+    && le(out + 8, 2) == records && le(out + 10, 2) == 0
+    && le(out + 12, 4) == written;
+}
+/*---------------------------------------------------------------------------*/
+/* The records hold the events first to last - 1, in time order */
+static int
+records_are(uint16_t first, uint16_t last)
+{
+  const uint8_t *r = out + TRACE_HEADER_SIZE;
+  uint32_t time = 0;
+  uint16_t i;
+
+  for(i = first; i < last; i++, r += TRACE_RECORD_SIZE) {
+    if(le(r, 4) < time || le(r + 6, 2) != i
+       || r[4] != (i % 3 == 2 ? TRACE_ID_USER + 1 : TRACE_ID_USER)
+       || r[5] != (i % 3 == 0 ? TRACE_KIND_BEGIN :
+                   i % 3 == 1 ? TRACE_KIND_END : TRACE_KIND_EVENT)) {
+      return 0;
+    }
+    time = le(r, 4);
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(test_process, "Trace test");
+AUTOSTART_PROCESSES(&test_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(test_process, ev, data)
+{
+  static uint8_t blocks[sizeof(out)];
+  static uint32_t offset;
+  uint16_t n;
+
+  PROCESS_BEGIN();
+
+  /* Less than the ring */
+  record(0, 10);
+  TEST_CHECK(out_len == SIZE(10), "size of header and records");
+  TEST_CHECK(header_is(10, 10), "header");
+  TEST_CHECK(records_are(0, 10), "records oldest first");
+
+  TRACE_EVENT(TRACE_ID_USER, 99);
+  TEST_CHECK(trace_read(out, 0, sizeof(out)) == SIZE(10) && header_is(10, 10),
+             "nothing recorded while frozen");
+
+  /* Wrapped twice and a half */
+  record(0, 2 * TRACE_RECORDS + TRACE_RECORDS / 2);
+  TEST_CHECK(out_len == SIZE(TRACE_RECORDS), "full ring");
+  TEST_CHECK(header_is(TRACE_RECORDS, 2 * TRACE_RECORDS + TRACE_RECORDS / 2),
+             "written and overwritten counted");
+  TEST_CHECK(records_are(TRACE_RECORDS + TRACE_RECORDS / 2, 2 * TRACE_RECORDS + TRACE_RECORDS / 2),
+             "latest records kept");
+
+  /* Block-wise, as over CoAP */
+  offset = 0;
+  while((n = trace_read(blocks + offset, offset, BLOCK)) > 0) {
+    offset += n;
+    if(n < BLOCK) {
+      break;
+    }
+  }
+  TEST_CHECK(offset == out_len && memcmp(blocks, out, out_len) == 0,
+             "read in blocks");
+  TEST_CHECK(trace_read(blocks, out_len, BLOCK) == 0, "nothing past the end");
+
+  /* Emptied */
+  record(0, 0);
+  TEST_CHECK(out_len == SIZE(0) && header_is(0, 0), "empty after resume");
+
+  trace_resume();
+
+  TEST_DONE();
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
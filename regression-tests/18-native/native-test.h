@@ -0,0 +1,31 @@
+/**
+ * \file
+ *      Checks for the native tests of regression-tests/18-native
+ *
+ *      A test prints one line per check and ends with TEST_DONE(), which
+ *      exits with 0 if every check passed.
+ */
+
+#ifndef NATIVE_TEST_H_
+#define NATIVE_TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int native_test_failures;
+
+#define TEST_CHECK(cond, what) do {                                 \
+    if(cond) {                                                      \
+      printf("%s: OK\n", (what));                                   \
+    } else {                                                        \
+      printf("%s: FAIL (%s:%d)\n", (what), __FILE__, __LINE__);     \
+      native_test_failures++;                                       \
+    }                                                               \
+  } while(0)
+
+#define TEST_DONE() do {                                            \
+    printf(native_test_failures ? "TEST FAILED\n" : "TEST OK\n");   \
+    exit(native_test_failures ? 1 : 0);                             \
+  } while(0)
+
+#endif /* NATIVE_TEST_H_ */
@@ -0,0 +1,52 @@
+#!/bin/bash
+RUNALL=$1
+DIR=$2
+CONTIKI=$3
+BASENAME=$4
+
+#set -x
+
+echo -n "Running test $BASENAME "
+
+(cd $DIR && make TARGET=native clean && make TARGET=native) > $BASENAME.log 2>&1
+RV=$?
+
+if [ $RV -eq 0 ] ; then
+  # The program runs its checks and exits, with 0 if they all passed
+  PROGRAM=$(cd $DIR && ls *.native)
+  (cd $DIR && timeout 600 ./$PROGRAM < /dev/null) > NATIVE.testlog 2>&1
+  RV=$?
+else
+  touch NATIVE.testlog
+fi
+
+if [ $RV -eq 0 ] ; then
+  mv NATIVE.testlog $BASENAME.testlog
+  echo " OK"
+  exit 0
+fi
+
+
+
+# In case of failure
+
+echo " FAIL ಠ_ಠ" | tee -a NATIVE.testlog;
+
+#Verbose output when using CI
+if [ "$CI" = "true" ];  then
+  echo "==== $BASENAME.log ====" ; cat $BASENAME.log;
+  echo "==== NATIVE.testlog ====" ; cat NATIVE.testlog;
+else
+  tail -50 NATIVE.testlog ;
+fi;
+
+mv NATIVE.testlog $BASENAME.faillog
+
+# We do not want Make to stop -> Return 0
+if [ "$RUNALL" = "true" ] ; then
+  touch $BASENAME.testlog;
+  exit 0
+fi
+
+#This is a failure
+exit 1
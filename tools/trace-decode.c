@@ -0,0 +1,377 @@
+/**
+ * \file
+ *      Decoder of the traces of core/sys/trace.c
+ *
+ *      Reads a trace as sent by /debug/trace, or with -x as printed by
+ *      trace_dump() (the hex lines between "trace:begin" and "trace:end",
+ *      other lines of the log are skipped), and prints a timeline with
+ *      the duration of every begin/end pair, then per id the durations
+ *      and the intervals between occurrences, and the latencies from an
+ *      RX interrupt to the read of its frame and from a zero cross to
+ *      each triac.
+ *
+ *        coap-client -m get coap://[<node>]/debug/trace -o trace.bin
+ *        trace-decode trace.bin
+ *        trace-decode -x < uart.log
+ *
+ *      Times are in microseconds from the first record. Process and
+ *      rtimer records carry the low 16 bits of the address of the process
+ *      or callback, nm on the ELF file names them.
+ *
+ *      Build: cc -o trace-decode trace-decode.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <unistd.h>
+
+/* As in core/sys/trace.h */
+#define TRACE_VERSION     1
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 8
+#define TRACE_KIND_EVENT  0
+#define TRACE_KIND_BEGIN  1
+#define TRACE_KIND_END    2
+
+enum {
+  TRACE_ID_PROCESS = 1,
+  TRACE_ID_RTIMER,
+  TRACE_ID_RF_RX_ISR,
+  TRACE_ID_RF_READ,
+  TRACE_ID_COAP,
+  TRACE_ID_ZERO_CROSS,
+  TRACE_ID_TRIAC,
+};
+
+#define MAX_ID       256
+#define MAX_DEPTH    8
+#define MAX_LATENCY  16
+
+static const char *names[MAX_ID] = {
+  [TRACE_ID_PROCESS] = "process",
+  [TRACE_ID_RTIMER] = "rtimer",
+  [TRACE_ID_RF_RX_ISR] = "rf-rx-isr",
+  [TRACE_ID_RF_READ] = "rf-read",
+  [TRACE_ID_COAP] = "coap",
+  [TRACE_ID_ZERO_CROSS] = "zero-cross",
+  [TRACE_ID_TRIAC] = "triac",
+};
+
+struct stats {
+  unsigned long n;
+  double min, max, sum;
+};
+
+struct id_state {
+  struct stats duration;
+  struct stats interval;
+  uint32_t last;
+  int seen;
+  int depth;
+  uint32_t begin[MAX_DEPTH];
+};
+
+/* From an occurrence of id 'from' to the next 'to', per argument of 'to' */
+struct latency {
+  uint8_t from, to;
+  const char *name;
+  uint32_t start;
+  int pending;
+  struct {
+    uint16_t arg;
+    struct stats stat;
+  } per_arg[MAX_LATENCY];
+  int args;
+};
+
+static struct latency latencies[] = {
+  { TRACE_ID_RF_RX_ISR, TRACE_ID_RF_READ, "rx latency" },
+  { TRACE_ID_ZERO_CROSS, TRACE_ID_TRIAC, "triac delay" },
+};
+#define LATENCIES (sizeof(latencies) / sizeof(latencies[0]))
+
+static struct id_state ids[MAX_ID];
+static double second;
+static int quiet;
+
+static uint8_t *data;
+static size_t data_len, data_size;
+/*---------------------------------------------------------------------------*/
+static void
+append(uint8_t b)
+{
+  if(data_len == data_size) {
+    data_size = data_size ? 2 * data_size : 4096;
+    data = realloc(data, data_size);
+    if(data == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  data[data_len++] = b;
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_binary(FILE *in)
+{
+  int c;
+
+  while((c = getc(in)) != EOF) {
+    append(c);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+hexval(int c)
+{
+  return isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+}
+/*---------------------------------------------------------------------------*/
+static void
+read_hex(FILE *in)
+{
+  char line[512];
+  int inside = 0;
+  size_t i, n;
+
+  while(fgets(line, sizeof(line), in) != NULL) {
+    if(strncmp(line, "trace:begin", 11) == 0) {
+      /* The last dump of the log wins */
+      data_len = 0;
+      inside = 1;
+      continue;
+    }
+    if(strncmp(line, "trace:end", 9) == 0) {
+      inside = 0;
+      continue;
+    }
+    if(!inside) {
+      continue;
+    }
+    n = strcspn(line, "\r\n");
+    for(i = 0; i < n && isxdigit((unsigned char)line[i]); i++);
+    if(i != n || n % 2 != 0) {
+      /* Another line of the log in between */
+      continue;
+    }
+    for(i = 0; i < n; i += 2) {
+      append(hexval(line[i]) << 4 | hexval(line[i + 1]));
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint32_t
+get32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+/*---------------------------------------------------------------------------*/
+static double
+us(uint32_t ticks)
+{
+  return ticks * 1000000.0 / second;
+}
+/*---------------------------------------------------------------------------*/
+static void
+add(struct stats *s, double v)
+{
+  if(s->n == 0 || v < s->min) {
+    s->min = v;
+  }
+  if(s->n == 0 || v > s->max) {
+    s->max = v;
+  }
+  s->sum += v;
+  s->n++;
+}
+/*---------------------------------------------------------------------------*/
+static void
+print_stat(const char *what, const struct stats *s)
+{
+  if(s->n > 0) {
+    printf("  %-10s n %-6lu min %10.1f  avg %10.1f  max %10.1f  jitter %10.1f\n",
+           what, s->n, s->min, s->sum / s->n, s->max, s->max - s->min);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static const char *
+name(uint8_t id)
+{
+  static char buf[16];
+
+  if(names[id] != NULL) {
+    return names[id];
+  }
+  snprintf(buf, sizeof(buf), "id%u", id);
+  return buf;
+}
+/*---------------------------------------------------------------------------*/
+static void
+latency_record(uint8_t id, uint16_t arg, uint32_t time)
+{
+  struct latency *l;
+  int i;
+
+  for(l = latencies; l < latencies + LATENCIES; l++) {
+    if(id == l->from) {
+      l->start = time;
+      l->pending = 1;
+    } else if(id == l->to && l->pending) {
+      for(i = 0; i < l->args && l->per_arg[i].arg != arg; i++);
+      if(i == l->args) {
+        if(l->args == MAX_LATENCY) {
+          continue;
+        }
+        l->per_arg[l->args++].arg = arg;
+      }
+      add(&l->per_arg[i].stat, us(time - l->start));
+      /* An RX interrupt is for one read, a zero cross for all triacs */
+      l->pending = l->from == TRACE_ID_ZERO_CROSS;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+decode(void)
+{
+  const uint8_t *r;
+  uint32_t records, written, first = 0, prev = 0, time;
+  uint8_t id, kind;
+  uint16_t arg;
+  struct id_state *s;
+  struct latency *l;
+  unsigned i;
+  int j;
+  char label[32];
+
+  if(data_len < TRACE_HEADER_SIZE || data[0] != 'T' || data[1] != 'R') {
+    fprintf(stderr, "trace-decode: not a trace\n");
+    exit(1);
+  }
+  if(data[2] != TRACE_VERSION || data[3] != TRACE_RECORD_SIZE) {
+    fprintf(stderr, "trace-decode: version %u, record size %u unknown\n",
+            data[2], data[3]);
+    exit(1);
+  }
+  second = get32(data + 4);
+  records = data[8] | data[9] << 8;
+  written = get32(data + 12);
+  if(data_len < TRACE_HEADER_SIZE + (size_t)records * TRACE_RECORD_SIZE) {
+    fprintf(stderr, "trace-decode: truncated, %u of %u records\n",
+            (unsigned)((data_len - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE),
+            (unsigned)records);
+    records = (data_len - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE;
+  }
+
+  printf("%u records at %.0f ticks/s, %u overwritten before\n",
+         (unsigned)records, second, (unsigned)(written - records));
+  if(!quiet) {
+    printf("%12s %10s  %-12s %-5s %6s %10s\n",
+           "time", "delta", "id", "kind", "arg", "duration");
+  }
+
+  for(i = 0; i < records; i++) {
+    r = data + TRACE_HEADER_SIZE + i * TRACE_RECORD_SIZE;
+    time = get32(r);
+    id = r[4];
+    kind = r[5];
+    arg = r[6] | r[7] << 8;
+    s = &ids[id];
+    if(i == 0) {
+      first = prev = time;
+    }
+
+    if(kind != TRACE_KIND_END) {
+      if(s->seen) {
+        add(&s->interval, us(time - s->last));
+      }
+      s->seen = 1;
+      s->last = time;
+      latency_record(id, arg, time);
+    }
+
+    if(!quiet) {
+      printf("%12.1f %10.1f  %-12s %-5s 0x%04x", us(time - first),
+             us(time - prev), name(id),
+             kind == TRACE_KIND_BEGIN ? "begin" :
+             kind == TRACE_KIND_END ? "end" : "", arg);
+    }
+    if(kind == TRACE_KIND_BEGIN) {
+      if(s->depth < MAX_DEPTH) {
+        s->begin[s->depth] = time;
+      }
+      s->depth++;
+    } else if(kind == TRACE_KIND_END && s->depth > 0) {
+      /* The begin may have been overwritten, then depth stays 0 */
+      s->depth--;
+      if(s->depth < MAX_DEPTH) {
+        add(&s->duration, us(time - s->begin[s->depth]));
+        if(!quiet) {
+          printf(" %10.1f", us(time - s->begin[s->depth]));
+        }
+      }
+    }
+    if(!quiet) {
+      printf("\n");
+    }
+    prev = time;
+  }
+
+  printf("\nmicroseconds\n");
+  for(i = 0; i < MAX_ID; i++) {
+    if(ids[i].seen) {
+      printf("%s\n", name(i));
+      print_stat("duration", &ids[i].duration);
+      print_stat("interval", &ids[i].interval);
+    }
+  }
+  for(l = latencies; l < latencies + LATENCIES; l++) {
+    for(j = 0; j < l->args; j++) {
+      if(j == 0) {
+        printf("%s\n", l->name);
+      }
+      snprintf(label, sizeof(label), "arg %u", l->per_arg[j].arg);
+      print_stat(label, &l->per_arg[j].stat);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  FILE *in = stdin;
+  int hex = 0;
+  int c;
+
+  while((c = getopt(argc, argv, "xqh")) != -1) {
+    switch(c) {
+    case 'x':
+      hex = 1;
+      break;
+    case 'q':
+      quiet = 1;
+      break;
+    default:
+      fprintf(stderr, "usage: trace-decode [-x] [-q] [file]\n"
+              "  -x  hex dump of trace_dump() in a log\n"
+              "  -q  statistics only, no timeline\n");
+      return 1;
+    }
+  }
+  if(optind < argc && (in = fopen(argv[optind], "rb")) == NULL) {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  if(hex) {
+    read_hex(in);
+  } else {
+    read_binary(in);
+  }
+  decode();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
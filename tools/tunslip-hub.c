@@ -0,0 +1,924 @@
+/*
+ * Copyright (c) 2001, Adam Dunkels.
+ * Copyright (c) 2009, 2010 Joakim Eriksson, Niclas Finne, Dogan Yazar.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+
+/**
+ * \file
+ *      SLIP to TUN bridge for the uHub (plugz-hub)
+ *
+ *      Like tunslip6, but for the slip-bridge of the uHub: answers ?P
+ *      with the 16 byte prefix !P, asks the hub for its address with ?I
+ *      and prints the debug lines the hub sends between SLIP frames.
+ *
+ *      It stays a program of its own. The slip-dev.c and
+ *      tun-bridge.c of examples/ipv6/native-border-router run inside
+ *      Contiki's native main loop and feed its uIP stack and packetbuf,
+ *      while the hub routes itself and only needs the packets moved.
+ *
+ *      The serial line is read a block at a time and decoded with a
+ *      table, the frames of a block are written to the TUN device
+ *      before the next epoll_wait(), and the packets read from the TUN
+ *      device are encoded into one buffer written with a single write().
+ *
+ *      With -R the rate of the serial line is raised after the start, by
+ *      ?B and the rate, which the hub answers with !B and the rate once
+ *      it switches, or 0.
+ *
+ *        tunslip-hub -s ttyUSB1 aaaa::1/64
+ *        tunslip-hub -s ttyUSB1 -R 921600 aaaa::1/64
+ *        tunslip-hub -X 100000       loopback benchmark on a pty pair
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <err.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+#define SLIP_END     0300
+#define SLIP_ESC     0333
+#define SLIP_ESC_END 0334
+#define SLIP_ESC_ESC 0335
+
+#define DEBUG_LINE_MARKER '\r'
+
+/* Largest frame, the hub's uip_buf */
+#define MAX_FRAME        1280
+/* Bytes taken from the serial line per read() */
+#define SERIAL_READ_SIZE 16384
+/* Encoded packets waiting for the serial line */
+#define SERIAL_OUT_SIZE  65536
+/* Decoded packets waiting for the TUN device */
+#define TUN_QUEUE_LEN    64
+
+/* Seconds between ?I until the hub has an address */
+#define ADDRESS_RETRY    1
+/* Seconds of silence before ?I at a negotiated rate, three times that
+   and the hub is assumed to have restarted at the base rate */
+#define KEEPALIVE        5
+
+static int verbose = 1;
+static int flowcontrol = 0;
+static speed_t b_rate = B115200;
+static char tundev[IFNAMSIZ] = { "tun0" };
+static const char *ipaddr;
+
+static int slipfd = -1;
+static int tunfd = -1;
+static int epfd = -1;
+
+static struct in6_addr prefix;
+static int hub_address_known;
+
+/* Rate asked from the hub with ?B (-R), 0 to stay at -B */
+static uint32_t link_rate;
+static int link_rate_on;
+static time_t last_frame;
+
+/*---------------------------------------------------------------------------*/
+/* SLIP */
+/*---------------------------------------------------------------------------*/
+#define SLIP_DATA    0
+#define SLIP_FRAME   1
+#define SLIP_ESCAPE  2
+
+/* What each byte means to the decoder, and its encoded length */
+static uint8_t slip_class[256];
+static uint8_t slip_encoded_len[256];
+
+struct slip_decoder {
+  uint8_t buf[MAX_FRAME];
+  int len;
+  int esc;
+  int overflow;
+};
+
+static struct slip_decoder decoder;
+
+static struct {
+  uint8_t buf[SERIAL_OUT_SIZE];
+  int begin;
+  int end;
+} serial_out;
+
+static struct {
+  uint8_t buf[TUN_QUEUE_LEN][MAX_FRAME];
+  int len[TUN_QUEUE_LEN];
+  int head;
+  int count;
+} tun_queue;
+
+/* Statistics */
+static unsigned long frames_in, frames_out, frames_dropped;
+
+static void frame_input(const uint8_t *frame, int len);
+/*---------------------------------------------------------------------------*/
+static void
+slip_init(void)
+{
+  int i;
+
+  for(i = 0; i < 256; i++) {
+    slip_class[i] = SLIP_DATA;
+    slip_encoded_len[i] = 1;
+  }
+  slip_class[SLIP_END] = SLIP_FRAME;
+  slip_class[SLIP_ESC] = SLIP_ESCAPE;
+  slip_encoded_len[SLIP_END] = 2;
+  slip_encoded_len[SLIP_ESC] = 2;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Decodes a block read from the serial line, runs of plain bytes are
+ * copied at once. Calls frame_input() for each complete frame.
+ */
+static void
+slip_decode(struct slip_decoder *d, const uint8_t *p, int n)
+{
+  const uint8_t *end = p + n;
+  const uint8_t *run;
+  int run_len;
+  uint8_t c;
+
+  while(p < end) {
+    if(d->esc) {
+      d->esc = 0;
+      c = *p++;
+      if(c == SLIP_ESC_END) {
+        c = SLIP_END;
+      } else if(c == SLIP_ESC_ESC) {
+        c = SLIP_ESC;
+      }
+      if(d->len < MAX_FRAME) {
+        d->buf[d->len++] = c;
+      } else {
+        d->overflow = 1;
+      }
+      continue;
+    }
+
+    for(run = p; p < end && slip_class[*p] == SLIP_DATA; p++);
+    if((run_len = p - run) > 0) {
+      if(d->len + run_len <= MAX_FRAME) {
+        memcpy(d->buf + d->len, run, run_len);
+        d->len += run_len;
+      } else {
+        d->overflow = 1;
+      }
+    }
+    if(p == end) {
+      break;
+    }
+
+    if(slip_class[*p++] == SLIP_ESCAPE) {
+      d->esc = 1;
+    } else {
+      if(d->overflow) {
+        if(verbose) {
+          fprintf(stderr, "*** dropping large packet\n");
+        }
+        frames_dropped++;
+      } else if(d->len > 0) {
+        frame_input(d->buf, d->len);
+      }
+      d->len = 0;
+      d->overflow = 0;
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static int
+serial_out_space(void)
+{
+  return SERIAL_OUT_SIZE - serial_out.end;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Appends frame to the serial output, returns 0 if it does not fit.
+ */
+static int
+slip_encode(const uint8_t *frame, int len)
+{
+  uint8_t *out;
+  int need = 2;
+  int i;
+
+  for(i = 0; i < len; i++) {
+    need += slip_encoded_len[frame[i]];
+  }
+  if(need > serial_out_space()) {
+    return 0;
+  }
+
+  out = serial_out.buf + serial_out.end;
+  *out++ = SLIP_END;
+  for(i = 0; i < len; i++) {
+    switch(slip_class[frame[i]]) {
+    case SLIP_DATA:
+      *out++ = frame[i];
+      break;
+    case SLIP_FRAME:
+      *out++ = SLIP_ESC;
+      *out++ = SLIP_ESC_END;
+      break;
+    default:
+      *out++ = SLIP_ESC;
+      *out++ = SLIP_ESC_ESC;
+      break;
+    }
+  }
+  *out++ = SLIP_END;
+  serial_out.end = out - serial_out.buf;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* epoll */
+/*---------------------------------------------------------------------------*/
+static void
+watch(int fd, uint32_t events)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  if(epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1
+     && (errno != ENOENT || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1)) {
+    err(1, "epoll_ctl");
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Reads from the TUN device while the encoded packets fit. The serial
+ * line is written once below.
+ */
+static void
+update_watches(void)
+{
+  watch(slipfd, EPOLLIN | (serial_out.end > serial_out.begin ? EPOLLOUT : 0));
+  watch(tunfd, (serial_out_space() >= 2 * MAX_FRAME + 2 ? EPOLLIN : 0)
+        | (tun_queue.count > 0 ? EPOLLOUT : 0));
+}
+/*---------------------------------------------------------------------------*/
+static void
+serial_flush(void)
+{
+  int n;
+
+  while(serial_out.begin < serial_out.end) {
+    n = write(slipfd, serial_out.buf + serial_out.begin, serial_out.end - serial_out.begin);
+    if(n == -1) {
+      if(errno == EAGAIN || errno == EINTR) {
+        break;
+      }
+      err(1, "serial write");
+    }
+    serial_out.begin += n;
+  }
+  if(serial_out.begin == serial_out.end) {
+    serial_out.begin = serial_out.end = 0;
+  } else if(serial_out.begin > SERIAL_OUT_SIZE / 2) {
+    memmove(serial_out.buf, serial_out.buf + serial_out.begin, serial_out.end - serial_out.begin);
+    serial_out.end -= serial_out.begin;
+    serial_out.begin = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tun_flush(void)
+{
+  while(tun_queue.count > 0) {
+    if(write(tunfd, tun_queue.buf[tun_queue.head], tun_queue.len[tun_queue.head]) == -1) {
+      if(errno == EAGAIN || errno == EINTR) {
+        return;
+      }
+      /* The kernel refuses a packet: drop it, not the link */
+      warn("tun write");
+      frames_dropped++;
+    }
+    tun_queue.head = (tun_queue.head + 1) % TUN_QUEUE_LEN;
+    tun_queue.count--;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tun_queue_packet(const uint8_t *packet, int len)
+{
+  int tail;
+
+  if(tun_queue.count == TUN_QUEUE_LEN) {
+    /* Make room rather than stall the serial line */
+    tun_flush();
+    if(tun_queue.count == TUN_QUEUE_LEN) {
+      frames_dropped++;
+      return;
+    }
+  }
+  tail = (tun_queue.head + tun_queue.count) % TUN_QUEUE_LEN;
+  memcpy(tun_queue.buf[tail], packet, len);
+  tun_queue.len[tail] = len;
+  tun_queue.count++;
+}
+/*---------------------------------------------------------------------------*/
+/* Hub protocol, see apps/plugz-hub/slip-bridge.c */
+/*---------------------------------------------------------------------------*/
+static speed_t
+baud_to_speed(int baud)
+{
+  switch(baud) {
+  case 9600:   return B9600;
+  case 19200:  return B19200;
+  case 38400:  return B38400;
+  case 57600:  return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  case 460800: return B460800;
+  case 921600: return B921600;
+  default:     return 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+set_speed(int fd, speed_t speed)
+{
+  struct termios tty;
+
+  if(tcgetattr(fd, &tty) == -1) {
+    err(1, "tcgetattr");
+  }
+  cfsetispeed(&tty, speed);
+  cfsetospeed(&tty, speed);
+  if(tcsetattr(fd, TCSADRAIN, &tty) == -1) {
+    err(1, "tcsetattr");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+send_control(const char *cmd, const void *data, int len)
+{
+  uint8_t frame[2 + sizeof(struct in6_addr)];
+
+  memcpy(frame, cmd, 2);
+  memcpy(frame + 2, data, len);
+  slip_encode(frame, 2 + len);
+}
+/*---------------------------------------------------------------------------*/
+static void
+request_rate(void)
+{
+  uint8_t rate[4];
+
+  rate[0] = link_rate >> 24;
+  rate[1] = link_rate >> 16;
+  rate[2] = link_rate >> 8;
+  rate[3] = link_rate;
+  send_control("?B", rate, sizeof(rate));
+}
+/*---------------------------------------------------------------------------*/
+static void
+frame_input(const uint8_t *frame, int len)
+{
+  char addr[INET6_ADDRSTRLEN];
+  uint32_t rate;
+
+  frames_in++;
+  last_frame = time(NULL);
+
+  if((frame[0] >> 4) == 6 && len >= 40) {
+    tun_queue_packet(frame, len);
+  } else if(len >= 2 && frame[0] == '?' && frame[1] == 'P') {
+    inet_ntop(AF_INET6, &prefix, addr, sizeof(addr));
+    if(verbose) {
+      fprintf(stderr, "*** Prefix requested, sending %s\n", addr);
+    }
+    send_control("!P", &prefix, sizeof(prefix));
+    send_control("?I", NULL, 0);
+    if(link_rate && !link_rate_on) {
+      request_rate();
+    }
+  } else if(len >= 2 && frame[0] == '!' && frame[1] == 'I') {
+    if(len == 2 + sizeof(struct in6_addr)) {
+      inet_ntop(AF_INET6, frame + 2, addr, sizeof(addr));
+      if(verbose) {
+        fprintf(stderr, "*** Hub address %s\n", addr);
+      }
+      hub_address_known = 1;
+    }
+  } else if(len == 6 && frame[0] == '!' && frame[1] == 'B') {
+    rate = ((uint32_t)frame[2] << 24) | ((uint32_t)frame[3] << 16) |
+      ((uint32_t)frame[4] << 8) | frame[5];
+    if(rate != 0 && rate == link_rate && !link_rate_on) {
+      /* The hub switches once the answer is out */
+      serial_flush();
+      set_speed(slipfd, baud_to_speed(rate));
+      link_rate_on = 1;
+      if(verbose) {
+        fprintf(stderr, "*** Serial line at %u baud\n", rate);
+      }
+    } else if(rate == 0 && verbose) {
+      fprintf(stderr, "*** Hub refused %u baud\n", link_rate);
+    }
+  } else if(frame[0] == DEBUG_LINE_MARKER) {
+    if(verbose) {
+      fwrite(frame + 1, len - 1, 1, stdout);
+    }
+  } else if(verbose > 1) {
+    fprintf(stderr, "*** Unknown frame of %d bytes\n", len);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+serial_input(void)
+{
+  static uint8_t buf[SERIAL_READ_SIZE];
+  int n;
+
+  while((n = read(slipfd, buf, sizeof(buf))) > 0) {
+    slip_decode(&decoder, buf, n);
+    if(n < (int)sizeof(buf)) {
+      break;
+    }
+  }
+  if(n == 0) {
+    errx(1, "serial line closed");
+  }
+  if(n == -1 && errno != EAGAIN && errno != EINTR) {
+    err(1, "serial read");
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+tun_input(void)
+{
+  uint8_t buf[MAX_FRAME];
+  int n;
+
+  /* Every packet read must fit, see update_watches() */
+  while(serial_out_space() >= 2 * MAX_FRAME + 2
+        && (n = read(tunfd, buf, sizeof(buf))) > 0) {
+    if(verbose > 2) {
+      fprintf(stderr, "Packet from TUN of length %d - write SLIP\n", n);
+    }
+    slip_encode(buf, n);
+    frames_out++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * At a negotiated rate the hub is asked for its address when silent, and
+ * after a restart, which brings it back at the base rate, the rate is
+ * negotiated again.
+ */
+static void
+keepalive(speed_t base_rate)
+{
+  time_t silent = time(NULL) - last_frame;
+
+  if(silent >= 3 * KEEPALIVE) {
+    if(verbose) {
+      fprintf(stderr, "*** Hub silent, back to the base rate\n");
+    }
+    serial_flush();
+    set_speed(slipfd, base_rate);
+    link_rate_on = 0;
+    last_frame = time(NULL);
+    request_rate();
+  } else if(silent >= KEEPALIVE) {
+    send_control("?I", NULL, 0);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+run(volatile int *stop)
+{
+  struct epoll_event events[4];
+  int timeout;
+  int i, n;
+
+  while(stop == NULL || !*stop) {
+    update_watches();
+    if(!hub_address_known) {
+      timeout = ADDRESS_RETRY * 1000;
+    } else if(link_rate_on) {
+      timeout = KEEPALIVE * 1000;
+    } else {
+      timeout = -1;
+    }
+    n = epoll_wait(epfd, events, 4, timeout);
+    if(n == -1) {
+      if(errno == EINTR) {
+        continue;
+      }
+      err(1, "epoll_wait");
+    }
+    if(n == 0 && !hub_address_known) {
+      send_control("?I", NULL, 0);
+    }
+    if(link_rate_on) {
+      keepalive(b_rate);
+    }
+    for(i = 0; i < n; i++) {
+      if(events[i].data.fd == slipfd && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+        serial_input();
+      }
+      if(events[i].data.fd == tunfd && (events[i].events & EPOLLIN)) {
+        tun_input();
+      }
+    }
+    /* Everything decoded or read in this round goes out at once */
+    tun_flush();
+    serial_flush();
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* Devices */
+/*---------------------------------------------------------------------------*/
+static int
+ssystem(const char *fmt, ...) __attribute__((__format__ (__printf__, 1, 2)));
+
+static int
+ssystem(const char *fmt, ...)
+{
+  char cmd[128];
+  va_list ap;
+
+  va_start(ap, fmt);
+  vsnprintf(cmd, sizeof(cmd), fmt, ap);
+  va_end(ap);
+  if(verbose) {
+    printf("%s\n", cmd);
+    fflush(stdout);
+  }
+  return system(cmd);
+}
+/*---------------------------------------------------------------------------*/
+static int
+tun_alloc(char *dev)
+{
+  struct ifreq ifr;
+  int fd;
+
+  if((fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK)) < 0) {
+    return -1;
+  }
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+  snprintf(ifr.ifr_name, IFNAMSIZ, "%s", dev);
+  if(ioctl(fd, TUNSETIFF, (void *)&ifr) < 0) {
+    close(fd);
+    return -1;
+  }
+  strcpy(dev, ifr.ifr_name);
+  return fd;
+}
+/*---------------------------------------------------------------------------*/
+static void
+ifconf(void)
+{
+  ssystem("ifconfig %s inet6 add %s up", tundev, ipaddr);
+  ssystem("ifconfig %s inet6 add fe80::1/64", tundev);
+  ssystem("sysctl -q -w net.ipv6.conf.all.forwarding=1");
+}
+/*---------------------------------------------------------------------------*/
+static void
+cleanup(void)
+{
+  ssystem("ifconfig %s down", tundev);
+}
+/*---------------------------------------------------------------------------*/
+static void
+sigcleanup(int signo)
+{
+  fprintf(stderr, "signal %d, %lu frames in, %lu out, %lu dropped\n",
+          signo, frames_in, frames_out, frames_dropped);
+  exit(0); /* exit(0) will call cleanup() */
+}
+/*---------------------------------------------------------------------------*/
+static void
+stty_raw(int fd, int set_speed)
+{
+  struct termios tty;
+
+  if(tcgetattr(fd, &tty) == -1) {
+    err(1, "tcgetattr");
+  }
+  cfmakeraw(&tty);
+  tty.c_cc[VTIME] = 0;
+  tty.c_cc[VMIN] = 0;
+  if(set_speed) {
+    if(flowcontrol) {
+      tty.c_cflag |= CRTSCTS;
+    } else {
+      tty.c_cflag &= ~CRTSCTS;
+    }
+    tty.c_cflag &= ~HUPCL;
+    tty.c_cflag |= CLOCAL;
+    cfsetispeed(&tty, b_rate);
+    cfsetospeed(&tty, b_rate);
+  }
+  if(tcsetattr(fd, TCSAFLUSH, &tty) == -1) {
+    err(1, "tcsetattr");
+  }
+  tcflush(fd, TCIOFLUSH);
+}
+/*---------------------------------------------------------------------------*/
+/* Benchmark */
+/*---------------------------------------------------------------------------*/
+#define BENCH_WINDOW     32   /* Packets in flight */
+
+/* About a 6LoWPAN frame worth of IPv6 by default */
+static int bench_len = 100;
+
+static volatile int bench_done;
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+static int
+cmp_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * The hub is a process echoing the master side of a pty, the TUN device
+ * a SOCK_SEQPACKET pair, which keeps packet boundaries like TUN does.
+ * Packets carry their sequence number and send time, with SLIP_END and
+ * SLIP_ESC in them so that escaping is exercised.
+ */
+static void
+bench(unsigned long count)
+{
+  int master, app[2];
+  pid_t hub, bridge;
+  uint8_t pkt[MAX_FRAME];
+  uint64_t *latency;
+  uint64_t start, t, sum = 0;
+  unsigned long sent = 0, received = 0, seq;
+  ssize_t n;
+
+  if((master = posix_openpt(O_RDWR | O_NOCTTY)) == -1
+     || grantpt(master) == -1 || unlockpt(master) == -1
+     || (slipfd = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+    err(1, "pty");
+  }
+  stty_raw(slipfd, 0);
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, app) == -1) {
+    err(1, "socketpair");
+  }
+  if((latency = calloc(count, sizeof(*latency))) == NULL) {
+    err(1, "calloc");
+  }
+
+  if((hub = fork()) == 0) {
+    uint8_t buf[SERIAL_READ_SIZE];
+    close(slipfd);
+    while((n = read(master, buf, sizeof(buf))) > 0) {
+      if(write(master, buf, n) != n) {
+        break;
+      }
+    }
+    _exit(0);
+  }
+
+  if((bridge = fork()) == 0) {
+    close(app[1]);
+    tunfd = app[0];
+    fcntl(tunfd, F_SETFL, O_NONBLOCK);
+    if((epfd = epoll_create1(0)) == -1) {
+      err(1, "epoll_create1");
+    }
+    hub_address_known = 1;
+    run(NULL);
+    _exit(0);
+  }
+  close(app[0]);
+  close(slipfd);
+
+  memset(pkt, 0, sizeof(pkt));
+  pkt[0] = 0x60;
+  for(n = 40; n < bench_len; n++) {
+    pkt[n] = n & 1 ? SLIP_END : SLIP_ESC;
+  }
+
+  start = now_ns();
+  while(received < count) {
+    while(sent < count && sent - received < BENCH_WINDOW) {
+      t = now_ns();
+      memcpy(pkt + 8, &sent, sizeof(sent));
+      memcpy(pkt + 16, &t, sizeof(t));
+      if(write(app[1], pkt, bench_len) != bench_len) {
+        err(1, "bench write");
+      }
+      sent++;
+    }
+    if((n = read(app[1], pkt, sizeof(pkt))) != bench_len) {
+      err(1, "bench read %d", (int)n);
+    }
+    memcpy(&seq, pkt + 8, sizeof(seq));
+    memcpy(&t, pkt + 16, sizeof(t));
+    if(seq >= count || pkt[bench_len - 1] != ((bench_len - 1) & 1 ? SLIP_END : SLIP_ESC)) {
+      errx(1, "bench: corrupted packet");
+    }
+    latency[received++] = now_ns() - t;
+  }
+  t = now_ns() - start;
+
+  kill(bridge, SIGTERM);
+  kill(hub, SIGTERM);
+  waitpid(bridge, NULL, 0);
+  waitpid(hub, NULL, 0);
+
+  for(seq = 0; seq < count; seq++) {
+    sum += latency[seq];
+  }
+  qsort(latency, count, sizeof(*latency), cmp_u64);
+  printf("%lu packets of %d bytes, window %d: %.0f packets/s\n",
+         count, bench_len, BENCH_WINDOW, count * 1e9 / t);
+  printf("latency avg %.1f us, median %.1f us, 99%% %.1f us, max %.1f us\n",
+         sum / 1e3 / count, latency[count / 2] / 1e3,
+         latency[count * 99 / 100] / 1e3, latency[count - 1] / 1e3);
+  free(latency);
+}
+/*---------------------------------------------------------------------------*/
+static void
+usage(const char *prog)
+{
+  fprintf(stderr, "usage:  %s [options] ipaddress\n", prog);
+  fprintf(stderr, "example: %s -s ttyUSB1 aaaa::1/64\n", prog);
+  fprintf(stderr, "Options are:\n");
+  fprintf(stderr, " -B baudrate    9600,19200,38400,57600,115200 (default),230400,460800,921600\n");
+  fprintf(stderr, " -R baudrate    Rate to switch to with the hub after starting at -B\n");
+  fprintf(stderr, " -H             Hardware CTS/RTS flow control (default disabled)\n");
+  fprintf(stderr, " -s siodev      Serial device (default /dev/ttyUSB1)\n");
+  fprintf(stderr, " -t tundev      Name of interface (default tun0)\n");
+  fprintf(stderr, " -v[level]      Verbosity level, 0 silent, 1 hub debug lines (default),\n");
+  fprintf(stderr, "                3 packet notifications\n");
+  fprintf(stderr, " -X count       Loopback benchmark on a pty pair, no hub or TUN needed\n");
+  fprintf(stderr, " -S size        Packet size of the benchmark, 40-%d (default 100)\n", MAX_FRAME);
+  exit(1);
+}
+/*---------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  const char *siodev = "/dev/ttyUSB1";
+  char dev[32];
+  char *s;
+  unsigned long bench_count = 0;
+  int baudrate = 115200;
+  int c;
+
+  setvbuf(stdout, NULL, _IOLBF, 0); /* Line buffered output. */
+  slip_init();
+
+  while((c = getopt(argc, argv, "B:R:Hs:t:v::X:S:h")) != -1) {
+    switch(c) {
+    case 'B':
+      baudrate = atoi(optarg);
+      break;
+    case 'R':
+      link_rate = atoi(optarg);
+      if(baud_to_speed(link_rate) == 0) {
+        errx(1, "unknown baudrate %u", link_rate);
+      }
+      break;
+    case 'H':
+      flowcontrol = 1;
+      break;
+    case 's':
+      siodev = optarg;
+      break;
+    case 't':
+      strncpy(tundev, strncmp(optarg, "/dev/", 5) == 0 ? optarg + 5 : optarg, sizeof(tundev) - 1);
+      break;
+    case 'v':
+      verbose = optarg ? atoi(optarg) : 3;
+      break;
+    case 'X':
+      bench_count = strtoul(optarg, NULL, 10);
+      break;
+    case 'S':
+      bench_len = atoi(optarg);
+      if(bench_len < 40 || bench_len > MAX_FRAME) {
+        usage(argv[0]);
+      }
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if(bench_count > 0) {
+    bench(bench_count);
+    return 0;
+  }
+  if(optind != argc - 1) {
+    usage(argv[0]);
+  }
+  ipaddr = argv[optind];
+
+  if((b_rate = baud_to_speed(baudrate)) == 0) {
+    errx(1, "unknown baudrate %d", baudrate);
+  }
+
+  /* The hub takes the /64 of the address as its prefix */
+  strncpy(dev, ipaddr, sizeof(dev) - 1);
+  dev[sizeof(dev) - 1] = '\0';
+  if((s = strchr(dev, '/')) != NULL) {
+    *s = '\0';
+  }
+  if(inet_pton(AF_INET6, dev, &prefix) != 1) {
+    errx(1, "bad address %s", ipaddr);
+  }
+  memset(&prefix.s6_addr[8], 0, 8);
+
+  if(strncmp(siodev, "/dev/", 5) != 0) {
+    snprintf(dev, sizeof(dev), "/dev/%s", siodev);
+    siodev = dev;
+  }
+  if((slipfd = open(siodev, O_RDWR | O_NOCTTY | O_NONBLOCK)) == -1) {
+    err(1, "can't open siodev ``%s''", siodev);
+  }
+  stty_raw(slipfd, 1);
+  fprintf(stderr, "********SLIP started on ``%s''\n", siodev);
+
+  if((tunfd = tun_alloc(tundev)) == -1) {
+    err(1, "can't open tun device");
+  }
+  fprintf(stderr, "opened tun device ``/dev/%s''\n", tundev);
+
+  atexit(cleanup);
+  signal(SIGHUP, sigcleanup);
+  signal(SIGTERM, sigcleanup);
+  signal(SIGINT, sigcleanup);
+  ifconf();
+
+  if((epfd = epoll_create1(0)) == -1) {
+    err(1, "epoll_create1");
+  }
+
+  /* Start from a frame boundary and ask for the hub's address */
+  serial_out.buf[serial_out.end++] = SLIP_END;
+  send_control("?I", NULL, 0);
+  if(link_rate) {
+    request_rate();
+  }
+
+  run(NULL);
+  return 0;
+}